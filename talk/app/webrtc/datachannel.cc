@@ -26,6 +26,7 @@
  */
 #include "talk/app/webrtc/datachannel.h"
 
+#include <algorithm>
 #include <string>
 
 #include "talk/app/webrtc/mediastreamprovider.h"
@@ -38,8 +39,17 @@ namespace webrtc {
 static size_t kMaxQueuedReceivedDataBytes = 16 * 1024 * 1024;
 static size_t kMaxQueuedSendDataBytes = 16 * 1024 * 1024;
 
+// Messages larger than the default SCTP send buffer could never be sent
+// whole. On ordered channels whose peer has agreed to reassemble them, they
+// are sent in fragments instead. Peers that don't reassemble would deliver
+// each fragment as a message of its own, so nothing is fragmented for them,
+// and smaller messages are always sent whole.
+static const size_t kMaxUnfragmentedMessageSize = 256 * 1024;
+static const size_t kFragmentSize = 64 * 1024;
+
 enum {
   MSG_CHANNELREADY,
+  MSG_BUFFEREDAMOUNTLOW,
 };
 
 DataChannel::PacketQueue::PacketQueue() : byte_count_(0) {}
@@ -53,7 +63,11 @@ bool DataChannel::PacketQueue::Empty() const {
 }
 
 DataBuffer* DataChannel::PacketQueue::Front() {
-  return packets_.front();
+  return packets_.front().buffer;
+}
+
+bool DataChannel::PacketQueue::FrontIsPartial() const {
+  return packets_.front().partial;
 }
 
 void DataChannel::PacketQueue::Pop() {
@@ -61,18 +75,25 @@ void DataChannel::PacketQueue::Pop() {
     return;
   }
 
-  byte_count_ -= packets_.front()->size();
+  byte_count_ -= packets_.front().buffer->size();
   packets_.pop_front();
 }
 
 void DataChannel::PacketQueue::Push(DataBuffer* packet) {
+  Packet entry = {packet, false};
   byte_count_ += packet->size();
-  packets_.push_back(packet);
+  packets_.push_back(entry);
+}
+
+void DataChannel::PacketQueue::PushPartial(DataBuffer* packet) {
+  Packet entry = {packet, true};
+  byte_count_ += packet->size();
+  packets_.push_back(entry);
 }
 
 void DataChannel::PacketQueue::Clear() {
   while (!packets_.empty()) {
-    delete packets_.front();
+    delete packets_.front().buffer;
     packets_.pop_front();
   }
   byte_count_ = 0;
@@ -114,7 +135,8 @@ DataChannel::DataChannel(
       send_ssrc_set_(false),
       receive_ssrc_set_(false),
       send_ssrc_(0),
-      receive_ssrc_(0) {
+      receive_ssrc_(0),
+      buffered_amount_low_threshold_(0) {
 }
 
 bool DataChannel::Init(const InternalDataChannelInit& config) {
@@ -182,6 +204,10 @@ uint64 DataChannel::buffered_amount() const {
   return queued_send_data_.byte_count();
 }
 
+void DataChannel::SetBufferedAmountLowThreshold(uint64 threshold) {
+  buffered_amount_low_threshold_ = threshold;
+}
+
 void DataChannel::Close() {
   if (state_ == kClosed)
     return;
@@ -215,7 +241,16 @@ bool DataChannel::Send(const DataBuffer& buffer) {
     return true;
   }
 
-  bool success = SendDataMessage(buffer, true);
+  if (ShouldFragment(buffer)) {
+    if (!QueueSendDataMessage(buffer)) {
+      Close();
+      return true;
+    }
+    SendQueuedDataMessages();
+    return true;
+  }
+
+  bool success = SendDataMessage(buffer, false, true);
   if (data_channel_type_ == cricket::DCT_RTP) {
     return success;
   }
@@ -276,6 +311,12 @@ void DataChannel::OnMessage(rtc::Message* msg) {
     case MSG_CHANNELREADY:
       OnChannelReady(true);
       break;
+    case MSG_BUFFEREDAMOUNTLOW:
+      // More data may have been queued since the event was posted.
+      if (observer_ && buffered_amount() <= buffered_amount_low_threshold_) {
+        observer_->OnBufferedAmountLow();
+      }
+      break;
   }
 }
 
@@ -461,18 +502,27 @@ void DataChannel::DeliverQueuedReceivedData() {
 void DataChannel::SendQueuedDataMessages() {
   ASSERT(was_ever_writable_ && state_ == kOpen);
 
+  const uint64 start_buffered_amount = buffered_amount();
   while (!queued_send_data_.Empty()) {
     DataBuffer* buffer = queued_send_data_.Front();
-    if (!SendDataMessage(*buffer, false)) {
+    if (!SendDataMessage(*buffer, queued_send_data_.FrontIsPartial(), false)) {
       // Leave the message in the queue if sending is aborted.
       break;
     }
     queued_send_data_.Pop();
     delete buffer;
   }
+
+  // This may run inside Send(), and the observer may send more data from the
+  // callback, so it is called asynchronously.
+  if (start_buffered_amount > buffered_amount_low_threshold_ &&
+      buffered_amount() <= buffered_amount_low_threshold_ && observer_) {
+    rtc::Thread::Current()->Post(this, MSG_BUFFEREDAMOUNTLOW, NULL);
+  }
 }
 
 bool DataChannel::SendDataMessage(const DataBuffer& buffer,
+                                  bool partial,
                                   bool queue_if_blocked) {
   cricket::SendDataParams send_params;
 
@@ -488,6 +538,7 @@ bool DataChannel::SendDataMessage(const DataBuffer& buffer,
     send_params.max_rtx_count = config_.maxRetransmits;
     send_params.max_rtx_ms = config_.maxRetransmitTime;
     send_params.ssrc = config_.id;
+    send_params.partial = partial;
   } else {
     send_params.ssrc = send_ssrc_;
   }
@@ -523,10 +574,31 @@ bool DataChannel::QueueSendDataMessage(const DataBuffer& buffer) {
     LOG(LS_ERROR) << "Can't buffer any more data for the data channel.";
     return false;
   }
-  queued_send_data_.Push(new DataBuffer(buffer));
+  if (!ShouldFragment(buffer)) {
+    queued_send_data_.Push(new DataBuffer(buffer));
+    return true;
+  }
+
+  // Each fragment is copied once, straight from |buffer|.
+  for (size_t offset = 0; offset < buffer.size(); offset += kFragmentSize) {
+    const size_t length = std::min(kFragmentSize, buffer.size() - offset);
+    DataBuffer* fragment = new DataBuffer(rtc::Buffer(), buffer.binary);
+    fragment->data.SetData(buffer.data.data() + offset, length);
+    if (offset + length < buffer.size()) {
+      queued_send_data_.PushPartial(fragment);
+    } else {
+      queued_send_data_.Push(fragment);
+    }
+  }
   return true;
 }
 
+bool DataChannel::ShouldFragment(const DataBuffer& buffer) const {
+  return data_channel_type_ == cricket::DCT_SCTP && config_.ordered &&
+         config_.fragmentLargeMessages &&
+         buffer.size() > kMaxUnfragmentedMessageSize;
+}
+
 void DataChannel::SendQueuedControlMessages() {
   ASSERT(was_ever_writable_);
 
@@ -124,6 +124,10 @@ class DataChannel : public DataChannelInterface,
   virtual bool negotiated() const { return config_.negotiated; }
   virtual int id() const { return config_.id; }
   virtual uint64 buffered_amount() const;
+  virtual void SetBufferedAmountLowThreshold(uint64 threshold);
+  virtual uint64 buffered_amount_low_threshold() const {
+    return buffered_amount_low_threshold_;
+  }
   virtual void Close();
   virtual DataState state() const { return state_; }
   virtual bool Send(const DataBuffer& buffer);
@@ -177,7 +181,8 @@ class DataChannel : public DataChannelInterface,
 
  private:
   // A packet queue which tracks the total queued bytes. Queued packets are
-  // owned by this class.
+  // owned by this class. A packet can be a fragment of a message, sent with
+  // the following packets as one message.
   class PacketQueue {
    public:
     PacketQueue();
@@ -190,17 +195,26 @@ class DataChannel : public DataChannelInterface,
     bool Empty() const;
 
     DataBuffer* Front();
+    // Whether more fragments of the message follow Front().
+    bool FrontIsPartial() const;
 
     void Pop();
 
     void Push(DataBuffer* packet);
+    // Pushes a fragment of a message that the following packets complete.
+    void PushPartial(DataBuffer* packet);
 
     void Clear();
 
     void Swap(PacketQueue* other);
 
    private:
-    std::deque<DataBuffer*> packets_;
+    struct Packet {
+      DataBuffer* buffer;
+      bool partial;
+    };
+
+    std::deque<Packet> packets_;
     size_t byte_count_;
   };
 
@@ -213,8 +227,12 @@ class DataChannel : public DataChannelInterface,
   void DeliverQueuedReceivedData();
 
   void SendQueuedDataMessages();
-  bool SendDataMessage(const DataBuffer& buffer, bool queue_if_blocked);
+  bool SendDataMessage(const DataBuffer& buffer, bool partial,
+                       bool queue_if_blocked);
+  // Queues |buffer| whole, or split into fragments if ShouldFragment().
   bool QueueSendDataMessage(const DataBuffer& buffer);
+  // Whether |buffer| is too large to be sent as one SCTP message.
+  bool ShouldFragment(const DataBuffer& buffer) const;
 
   void SendQueuedControlMessages();
   void QueueControlMessage(const rtc::Buffer& buffer);
@@ -233,6 +251,7 @@ class DataChannel : public DataChannelInterface,
   bool receive_ssrc_set_;
   uint32 send_ssrc_;
   uint32 receive_ssrc_;
+  uint64 buffered_amount_low_threshold_;
   // Control messages that always have to get sent out before any queued
   // data.
   PacketQueue queued_control_data_;
@@ -264,6 +283,8 @@ BEGIN_PROXY_MAP(DataChannel)
   PROXY_CONSTMETHOD0(int, id)
   PROXY_CONSTMETHOD0(DataState, state)
   PROXY_CONSTMETHOD0(uint64, buffered_amount)
+  PROXY_METHOD1(void, SetBufferedAmountLowThreshold, uint64)
+  PROXY_CONSTMETHOD0(uint64, buffered_amount_low_threshold)
   PROXY_METHOD0(void, Close)
   PROXY_METHOD1(bool, Send, const DataBuffer&)
 END_PROXY()
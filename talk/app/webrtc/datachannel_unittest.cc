@@ -25,6 +25,8 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include "talk/app/webrtc/datachannel.h"
 #include "talk/app/webrtc/sctputils.h"
 #include "talk/app/webrtc/test/fakedatachannelprovider.h"
@@ -35,7 +37,9 @@ using webrtc::DataChannel;
 class FakeDataChannelObserver : public webrtc::DataChannelObserver {
  public:
   FakeDataChannelObserver()
-      : messages_received_(0), on_state_change_count_(0) {}
+      : messages_received_(0),
+        on_state_change_count_(0),
+        on_buffered_amount_low_count_(0) {}
 
   void OnStateChange() {
     ++on_state_change_count_;
@@ -45,6 +49,10 @@ class FakeDataChannelObserver : public webrtc::DataChannelObserver {
     ++messages_received_;
   }
 
+  void OnBufferedAmountLow() {
+    ++on_buffered_amount_low_count_;
+  }
+
   size_t messages_received() const {
     return messages_received_;
   }
@@ -57,9 +65,45 @@ class FakeDataChannelObserver : public webrtc::DataChannelObserver {
     return on_state_change_count_;
   }
 
+  size_t on_buffered_amount_low_count() const {
+    return on_buffered_amount_low_count_;
+  }
+
  private:
   size_t messages_received_;
   size_t on_state_change_count_;
+  size_t on_buffered_amount_low_count_;
+};
+
+// Sends |buffer| again from each OnBufferedAmountLow until it has been called
+// |count| times, and records how deeply the calls nest.
+class ResendingDataChannelObserver : public FakeDataChannelObserver {
+ public:
+  ResendingDataChannelObserver(DataChannel* channel,
+                               const webrtc::DataBuffer& buffer,
+                               size_t count)
+      : channel_(channel), buffer_(buffer), count_(count), depth_(0),
+        max_depth_(0) {}
+
+  void OnBufferedAmountLow() {
+    FakeDataChannelObserver::OnBufferedAmountLow();
+    max_depth_ = std::max(max_depth_, ++depth_);
+    if (on_buffered_amount_low_count() < count_) {
+      channel_->Send(buffer_);
+    }
+    --depth_;
+  }
+
+  size_t max_depth() const {
+    return max_depth_;
+  }
+
+ private:
+  DataChannel* channel_;
+  webrtc::DataBuffer buffer_;
+  size_t count_;
+  size_t depth_;
+  size_t max_depth_;
 };
 
 class SctpDataChannelTest : public testing::Test {
@@ -70,6 +114,14 @@ class SctpDataChannelTest : public testing::Test {
               &provider_, cricket::DCT_SCTP, "test", init_)) {
   }
 
+  // Replaces the channel with one whose peer reassembles fragments.
+  void UseFragmentingChannel() {
+    webrtc_data_channel_->Close();
+    init_.fragmentLargeMessages = true;
+    webrtc_data_channel_ = DataChannel::Create(
+        &provider_, cricket::DCT_SCTP, "test", init_);
+  }
+
   void SetChannelReady() {
     provider_.set_transport_available(true);
     webrtc_data_channel_->OnTransportChannelCreated();
@@ -162,6 +214,116 @@ TEST_F(SctpDataChannelTest, QueuedDataSentWhenUnblocked) {
   EXPECT_EQ(0U, webrtc_data_channel_->buffered_amount());
 }
 
+// Tests that OnBufferedAmountLow is called once the queued data drops to the
+// threshold, and only if it was above it.
+TEST_F(SctpDataChannelTest, OnBufferedAmountLow) {
+  AddObserver();
+  SetChannelReady();
+  webrtc::DataBuffer buffer("abcd");
+  webrtc_data_channel_->SetBufferedAmountLowThreshold(buffer.size());
+  EXPECT_EQ(buffer.size(),
+            webrtc_data_channel_->buffered_amount_low_threshold());
+
+  provider_.set_send_blocked(true);
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  provider_.set_send_blocked(false);
+  EXPECT_EQ(0U, webrtc_data_channel_->buffered_amount());
+  EXPECT_EQ(0U, observer_->on_buffered_amount_low_count());
+
+  provider_.set_send_blocked(true);
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  provider_.set_send_blocked(false);
+  EXPECT_EQ(0U, webrtc_data_channel_->buffered_amount());
+  EXPECT_EQ_WAIT(1U, observer_->on_buffered_amount_low_count(), 1000);
+}
+
+// Tests that an observer can send from OnBufferedAmountLow, as bulk senders
+// do, without the callback being called again inside that Send().
+TEST_F(SctpDataChannelTest, SendFromOnBufferedAmountLow) {
+  const size_t kMessageSize = 300 * 1024;
+  const size_t kSendCount = 5;
+  rtc::Buffer payload;
+  payload.SetLength(kMessageSize);
+  memset(payload.data(), 0, kMessageSize);
+  webrtc::DataBuffer buffer(payload, true);
+  UseFragmentingChannel();
+  ResendingDataChannelObserver observer(webrtc_data_channel_.get(), buffer,
+                                        kSendCount);
+  webrtc_data_channel_->RegisterObserver(&observer);
+  SetChannelReady();
+
+  int sent_message_count = provider_.sent_message_count();
+  // Sent in fragments, so the message is queued and the buffered amount
+  // drops back to the threshold of zero.
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  EXPECT_EQ(0U, observer.on_buffered_amount_low_count());
+  EXPECT_EQ_WAIT(kSendCount, observer.on_buffered_amount_low_count(), 1000);
+  EXPECT_EQ(1U, observer.max_depth());
+  // 64 KB fragments.
+  EXPECT_EQ(static_cast<int>(5 * kSendCount),
+            provider_.sent_message_count() - sent_message_count);
+  webrtc_data_channel_->UnregisterObserver();
+}
+
+// Tests that messages too large for one SCTP message are sent in fragments,
+// and count towards buffered_amount() until all have been sent.
+TEST_F(SctpDataChannelTest, LargeMessageSentInFragments) {
+  UseFragmentingChannel();
+  SetChannelReady();
+  const size_t kMessageSize = 600 * 1024;
+  rtc::Buffer payload;
+  payload.SetLength(kMessageSize);
+  memset(payload.data(), 0, kMessageSize);
+  webrtc::DataBuffer buffer(payload, true);
+
+  provider_.set_send_blocked(true);
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  EXPECT_EQ(kMessageSize, webrtc_data_channel_->buffered_amount());
+
+  int sent_message_count = provider_.sent_message_count();
+  provider_.set_send_blocked(false);
+  EXPECT_EQ(0U, webrtc_data_channel_->buffered_amount());
+  // 64 KB fragments.
+  EXPECT_EQ(10, provider_.sent_message_count() - sent_message_count);
+  EXPECT_FALSE(provider_.last_send_data_params().partial);
+  EXPECT_TRUE(provider_.last_send_data_params().ordered);
+  EXPECT_EQ(cricket::DMT_BINARY, provider_.last_send_data_params().type);
+
+  // The same without being blocked.
+  sent_message_count = provider_.sent_message_count();
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  EXPECT_EQ(0U, webrtc_data_channel_->buffered_amount());
+  EXPECT_EQ(10, provider_.sent_message_count() - sent_message_count);
+
+  // Unordered channels send the message whole.
+  webrtc_data_channel_->Close();
+  init_.ordered = false;
+  webrtc_data_channel_ = DataChannel::Create(
+      &provider_, cricket::DCT_SCTP, "test", init_);
+  SetChannelReady();
+  sent_message_count = provider_.sent_message_count();
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  EXPECT_EQ(1, provider_.sent_message_count() - sent_message_count);
+}
+
+// Tests that large messages are sent whole unless the peer has agreed to
+// reassemble fragments, as a peer that doesn't would deliver each fragment as
+// a separate message.
+TEST_F(SctpDataChannelTest, LargeMessageNotFragmentedByDefault) {
+  SetChannelReady();
+  const size_t kMessageSize = 600 * 1024;
+  rtc::Buffer payload;
+  payload.SetLength(kMessageSize);
+  memset(payload.data(), 0, kMessageSize);
+  webrtc::DataBuffer buffer(payload, true);
+
+  int sent_message_count = provider_.sent_message_count();
+  EXPECT_TRUE(webrtc_data_channel_->Send(buffer));
+  EXPECT_EQ(1, provider_.sent_message_count() - sent_message_count);
+  EXPECT_FALSE(provider_.last_send_data_params().partial);
+}
+
 // Tests that no crash when the channel is blocked right away while trying to
 // send queued data.
 TEST_F(SctpDataChannelTest, BlockedWhenSendQueuedDataNoCrash) {
@@ -47,7 +47,8 @@ struct DataChannelInit {
         maxRetransmitTime(-1),
         maxRetransmits(-1),
         negotiated(false),
-        id(-1) {
+        id(-1),
+        fragmentLargeMessages(false) {
   }
 
   bool reliable;           // Deprecated.
@@ -63,6 +64,11 @@ struct DataChannelInit {
                            // form of an "open" message.
   int id;                  // The stream id, or SID, for SCTP data channels. -1
                            // if unset.
+  bool fragmentLargeMessages;  // True if the remote end has agreed, out of
+                               // band like for |negotiated|, to reassemble
+                               // messages sent in fragments. Only then are
+                               // ordered messages over 256 KB sent, in
+                               // fragments; otherwise they are sent whole.
 };
 
 struct DataBuffer {
@@ -90,6 +96,10 @@ class DataChannelObserver {
   virtual void OnStateChange() = 0;
   //  A data buffer was successfully received.
   virtual void OnMessage(const DataBuffer& buffer) = 0;
+  // The buffered_amount() has dropped to or below the threshold set with
+  // DataChannelInterface::SetBufferedAmountLowThreshold. It is called
+  // asynchronously, never from inside Send(), so it may send more data.
+  virtual void OnBufferedAmountLow() {}
 
  protected:
   virtual ~DataChannelObserver() {}
@@ -128,6 +138,12 @@ class DataChannelInterface : public rtc::RefCountInterface {
   // (UTF-8 text and binary data) that have been queued using SendBuffer but
   // have not yet been transmitted to the network.
   virtual uint64 buffered_amount() const = 0;
+  // Once sending queued data brings buffered_amount() from above |threshold|
+  // to or below it, the observer's OnBufferedAmountLow is called. Senders can
+  // then keep the queue short without polling buffered_amount().
+  // TODO: Make these pure virtual once all classes implement them.
+  virtual void SetBufferedAmountLowThreshold(uint64 threshold) {}
+  virtual uint64 buffered_amount_low_threshold() const { return 0; }
   virtual void Close() = 0;
   // Sends |data| to the remote peer.
   virtual bool Send(const DataBuffer& buffer) = 0;
@@ -88,6 +88,7 @@ const char MediaConstraintsInterface::kEnableRtpDataChannels[] =
 // Google-specific constraint keys.
 const char MediaConstraintsInterface::kEnableDscp[] = "googDscp";
 const char MediaConstraintsInterface::kEnableIPv6[] = "googIPv6";
+const char MediaConstraintsInterface::kEnableDtlsEcdsa[] = "googDtlsEcdsa";
 const char MediaConstraintsInterface::kEnableVideoSuspendBelowMinBitrate[] =
     "googSuspendBelowMinBitrate";
 const char MediaConstraintsInterface::kNumUnsignalledRecvStreams[] =
@@ -109,6 +109,8 @@ class MediaConstraintsInterface {
   static const char kEnableDscp[];  // googDscp
   // Constraint to enable IPv6 through JS.
   static const char kEnableIPv6[];  // googIPv6
+  // Constraint to use an ECDSA instead of an RSA DTLS identity.
+  static const char kEnableDtlsEcdsa[];  // googDtlsEcdsa
   // Temporary constraint to enable suspend below min bitrate feature.
   static const char kEnableVideoSuspendBelowMinBitrate[];
       // googSuspendBelowMinBitrate
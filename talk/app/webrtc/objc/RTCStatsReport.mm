@@ -54,11 +54,12 @@
     _type = @(statsReport.type.c_str());
     _timestamp = statsReport.timestamp;
     NSMutableArray* values =
-        [NSMutableArray arrayWithCapacity:statsReport.values.size()];
-    webrtc::StatsReport::Values::const_iterator it = statsReport.values.begin();
-    for (; it != statsReport.values.end(); ++it) {
+        [NSMutableArray arrayWithCapacity:statsReport.values().size()];
+    const webrtc::StatsReport::Values& reportValues = statsReport.values();
+    webrtc::StatsReport::Values::const_iterator it = reportValues.begin();
+    for (; it != reportValues.end(); ++it) {
       RTCPair* pair = [[RTCPair alloc] initWithKey:@(it->display_name())
-                                             value:@(it->value.c_str())];
+                                             value:@(it->ToString().c_str())];
       [values addObject:pair];
     }
     _values = values;
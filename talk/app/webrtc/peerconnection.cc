@@ -354,6 +354,7 @@ bool PeerConnection::DoInitialize(
                                    port_allocator_.get(),
                                    mediastream_signaling_.get()));
   stats_.reset(new StatsCollector(session_.get()));
+  session_->set_identity_pool(factory_->identity_pool());
 
   // Initialize the WebRtcSession. It creates transport channels etc.
   if (!session_->Initialize(factory_->options(), constraints,
@@ -27,9 +27,12 @@
 
 #include "talk/app/webrtc/peerconnectionfactory.h"
 
+#include <algorithm>
+
 #include "talk/app/webrtc/peerconnection.h"
 #include "talk/app/webrtc/peerconnectionproxy.h"
 #include "talk/app/webrtc/portallocatorfactory.h"
+#include "talk/app/webrtc/webrtcsessiondescriptionfactory.h"
 #include "talk/media/webrtc/webrtcmediaengine.h"
 #include "webrtc/base/bind.h"
 
@@ -129,6 +132,11 @@ PeerConnectionFactory::~PeerConnectionFactory() {
   }
 }
 
+void PeerConnectionFactory::SetOptions(const Options& options) {
+  signaling_thread_->Invoke<void>(
+      rtc::Bind(&PeerConnectionFactory::SetOptions_s, this, options));
+}
+
 bool PeerConnectionFactory::Initialize() {
   InitMessageData result(false);
   signaling_thread_->Send(this, MSG_INIT_FACTORY, &result);
@@ -179,6 +187,17 @@ bool PeerConnectionFactory::Initialize_s() {
   return true;
 }
 
+void PeerConnectionFactory::SetOptions_s(const Options& options) {
+  options_ = options;
+  size_t pool_size = std::max(options.dtls_identity_pool_size, 0);
+  if (identity_pool_) {
+    identity_pool_->SetSize(pool_size);
+  } else if (pool_size > 0) {
+    identity_pool_.reset(
+        new rtc::SSLIdentityPool(kWebRTCIdentityName, pool_size));
+  }
+}
+
 // Terminate what we created on the signaling thread.
 void PeerConnectionFactory::Terminate_s() {
   channel_manager_.reset(NULL);
@@ -33,6 +33,7 @@
 #include "talk/app/webrtc/peerconnectioninterface.h"
 #include "talk/session/media/channelmanager.h"
 #include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/sslidentitypool.h"
 #include "webrtc/base/thread.h"
 
 namespace webrtc {
@@ -40,9 +41,7 @@ namespace webrtc {
 class PeerConnectionFactory : public PeerConnectionFactoryInterface,
                               public rtc::MessageHandler {
  public:
-  virtual void SetOptions(const Options& options) {
-    options_ = options;
-  }
+  virtual void SetOptions(const Options& options);
 
   virtual rtc::scoped_refptr<PeerConnectionInterface>
       CreatePeerConnection(
@@ -58,6 +57,8 @@ class PeerConnectionFactory : public PeerConnectionFactoryInterface,
   virtual rtc::Thread* signaling_thread();
   virtual rtc::Thread* worker_thread();
   const Options& options() const { return options_; }
+  // NULL unless Options::dtls_identity_pool_size has been set.
+  rtc::SSLIdentityPool* identity_pool() { return identity_pool_.get(); }
 
  protected:
   PeerConnectionFactory();
@@ -69,6 +70,7 @@ class PeerConnectionFactory : public PeerConnectionFactoryInterface,
  private:
   bool Initialize_s();
   void Terminate_s();
+  void SetOptions_s(const Options& options);
 
   rtc::scoped_refptr<PeerConnectionInterface> CreatePeerConnection_s(
       const PeerConnectionInterface::RTCConfiguration& configuration,
@@ -88,6 +90,8 @@ class PeerConnectionFactory : public PeerConnectionFactoryInterface,
   Options options_;
   rtc::scoped_refptr<PortAllocatorFactoryInterface> allocator_factory_;
   rtc::scoped_ptr<cricket::ChannelManager> channel_manager_;
+  // Kept once created, since sessions may still take identities from it.
+  rtc::scoped_ptr<rtc::SSLIdentityPool> identity_pool_;
 };
 
 }  // namespace webrtc
@@ -429,10 +429,15 @@ class PeerConnectionFactoryInterface : public rtc::RefCountInterface {
    public:
     Options() :
       disable_encryption(false),
-      disable_sctp_data_channels(false) {
+      disable_sctp_data_channels(false),
+      dtls_identity_pool_size(0) {
     }
     bool disable_encryption;
     bool disable_sctp_data_channels;
+    // The number of DTLS identities of each key type to generate ahead of
+    // time on a low priority thread, so that PeerConnections created without
+    // a DTLSIdentityServiceInterface need not wait for key generation.
+    int dtls_identity_pool_size;
   };
 
   virtual void SetOptions(const Options& options) = 0;
@@ -51,11 +51,30 @@
 // END_PROXY()
 //
 // The proxy can be created using TestProxy::Create(Thread*, TestInterface*).
+//
+// Every call on a proxy blocks until it has run on the proxy's thread. To
+// avoid a thread hop per call, calls can be batched with ProxyCallBatch and
+// sent to the thread together, either waiting for them or not:
+//
+// ProxyCallBatch batch(signaling_thread);
+// rtc::scoped_refptr<ProxyResult<std::string> > a =
+//     batch.Add(test.get(), &TestInterface::FooA);
+// rtc::scoped_refptr<ProxyResult<std::string> > b =
+//     batch.Add(test.get(), &TestInterface::FooB, true);
+// batch.Post();
+// ...
+// std::string value = a->value();  // Waits for the call if needed.
 
 #ifndef TALK_APP_WEBRTC_PROXY_H_
 #define TALK_APP_WEBRTC_PROXY_H_
 
+#include <vector>
+
+#include "webrtc/base/basictypes.h"
+#include "webrtc/base/constructormagic.h"
 #include "webrtc/base/event.h"
+#include "webrtc/base/refcount.h"
+#include "webrtc/base/scoped_ref_ptr.h"
 #include "webrtc/base/thread.h"
 
 namespace webrtc {
@@ -63,6 +82,8 @@ namespace webrtc {
 template <typename R>
 class ReturnType {
  public:
+  ReturnType() : r_() {}
+
   template<typename C, typename M>
   void Invoke(C* c, M m) { r_ = (c->*m)(); }
   template<typename C, typename M, typename T1>
@@ -249,6 +270,322 @@ class MethodCall3 : public rtc::Message,
   T3 a3_;
 };
 
+// The result of a call made through a ProxyCallBatch. It becomes available
+// once the call has run on the batch's thread, or once the call has been
+// canceled because the thread quit or was destroyed before running it.
+template <typename R>
+class ProxyResult : public rtc::RefCountInterface {
+ public:
+  bool done() { return done_.Wait(0); }
+  void Wait() { done_.Wait(rtc::kForever); }
+  // Waits for the call and returns what it returned, or a default-constructed
+  // value if it was canceled.
+  R value() {
+    Wait();
+    return r_.value();
+  }
+  // Only meaningful once done() is true.
+  bool canceled() const { return canceled_; }
+
+  // Used by the batched calls.
+  ReturnType<R>* return_type() { return &r_; }
+  void SetDone() { done_.Set(); }
+  void Cancel() {
+    canceled_ = true;
+    done_.Set();
+  }
+
+ protected:
+  ProxyResult() : canceled_(false), done_(true, false) {}
+  ~ProxyResult() {}
+
+ private:
+  ReturnType<R> r_;
+  bool canceled_;
+  rtc::Event done_;
+};
+
+namespace internal {
+
+// Batched calls may run after the caller has returned, so arguments passed by
+// const reference are stored by value.
+template <typename T>
+struct ProxyArg { typedef T Type; };
+template <typename T>
+struct ProxyArg<const T&> { typedef T Type; };
+
+// Keeps a template parameter from being deduced from an argument.
+template <typename T>
+struct NonDeduced { typedef T Type; };
+
+class QueuedCall {
+ public:
+  virtual ~QueuedCall() {}
+  virtual void Run() = 0;
+  virtual void Cancel() = 0;
+};
+
+template <typename C, typename R, typename M>
+class QueuedCall0 : public QueuedCall {
+ public:
+  QueuedCall0(C* c, M m, ProxyResult<R>* result)
+      : c_(c), m_(m), result_(result) {}
+
+  virtual void Run() {
+    result_->return_type()->Invoke(c_.get(), m_);
+    result_->SetDone();
+  }
+  virtual void Cancel() { result_->Cancel(); }
+
+ private:
+  rtc::scoped_refptr<C> c_;
+  M m_;
+  rtc::scoped_refptr<ProxyResult<R> > result_;
+};
+
+template <typename C, typename R, typename M, typename T1>
+class QueuedCall1 : public QueuedCall {
+ public:
+  QueuedCall1(C* c, M m, ProxyResult<R>* result,
+              const typename ProxyArg<T1>::Type& a1)
+      : c_(c), m_(m), result_(result), a1_(a1) {}
+
+  virtual void Run() {
+    result_->return_type()->Invoke(c_.get(), m_, a1_);
+    result_->SetDone();
+  }
+  virtual void Cancel() { result_->Cancel(); }
+
+ private:
+  rtc::scoped_refptr<C> c_;
+  M m_;
+  rtc::scoped_refptr<ProxyResult<R> > result_;
+  typename ProxyArg<T1>::Type a1_;
+};
+
+template <typename C, typename R, typename M, typename T1, typename T2>
+class QueuedCall2 : public QueuedCall {
+ public:
+  QueuedCall2(C* c, M m, ProxyResult<R>* result,
+              const typename ProxyArg<T1>::Type& a1,
+              const typename ProxyArg<T2>::Type& a2)
+      : c_(c), m_(m), result_(result), a1_(a1), a2_(a2) {}
+
+  virtual void Run() {
+    result_->return_type()->Invoke(c_.get(), m_, a1_, a2_);
+    result_->SetDone();
+  }
+  virtual void Cancel() { result_->Cancel(); }
+
+ private:
+  rtc::scoped_refptr<C> c_;
+  M m_;
+  rtc::scoped_refptr<ProxyResult<R> > result_;
+  typename ProxyArg<T1>::Type a1_;
+  typename ProxyArg<T2>::Type a2_;
+};
+
+template <typename C, typename R, typename M, typename T1, typename T2,
+          typename T3>
+class QueuedCall3 : public QueuedCall {
+ public:
+  QueuedCall3(C* c, M m, ProxyResult<R>* result,
+              const typename ProxyArg<T1>::Type& a1,
+              const typename ProxyArg<T2>::Type& a2,
+              const typename ProxyArg<T3>::Type& a3)
+      : c_(c), m_(m), result_(result), a1_(a1), a2_(a2), a3_(a3) {}
+
+  virtual void Run() {
+    result_->return_type()->Invoke(c_.get(), m_, a1_, a2_, a3_);
+    result_->SetDone();
+  }
+  virtual void Cancel() { result_->Cancel(); }
+
+ private:
+  rtc::scoped_refptr<C> c_;
+  M m_;
+  rtc::scoped_refptr<ProxyResult<R> > result_;
+  typename ProxyArg<T1>::Type a1_;
+  typename ProxyArg<T2>::Type a2_;
+  typename ProxyArg<T3>::Type a3_;
+};
+
+// A batch of calls for the target thread. When posted, it is the message's
+// data, so the thread deletes it along with the message if it is cleared,
+// e.g. because the thread is destroyed before running it. Calls that haven't
+// run by the time the runner is deleted are canceled.
+class QueuedCallRunner : public rtc::MessageData {
+ public:
+  QueuedCallRunner(std::vector<QueuedCall*>* calls, rtc::Event* done)
+      : ran_(false), done_(done) {
+    calls_.swap(*calls);
+  }
+  virtual ~QueuedCallRunner() {
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      if (!ran_)
+        calls_[i]->Cancel();
+      delete calls_[i];
+    }
+    if (done_)
+      done_->Set();
+  }
+
+  void Run() {
+    ran_ = true;
+    for (size_t i = 0; i < calls_.size(); ++i)
+      calls_[i]->Run();
+  }
+
+  // Posts the runner to |thread|, which owns it from then on.
+  void PostTo(rtc::Thread* thread);
+
+ private:
+  std::vector<QueuedCall*> calls_;
+  bool ran_;
+  rtc::Event* done_;
+};
+
+// Runs posted QueuedCallRunners. It is never destroyed, so it can't clear
+// the messages of runners that are still queued.
+class QueuedCallHandler : public rtc::MessageHandler {
+ public:
+  static QueuedCallHandler* Instance() {
+    LIBJINGLE_DEFINE_STATIC_LOCAL(QueuedCallHandler, handler, ());
+    return &handler;
+  }
+
+  virtual void OnMessage(rtc::Message* msg) {
+    QueuedCallRunner* runner = static_cast<QueuedCallRunner*>(msg->pdata);
+    runner->Run();
+    delete runner;
+  }
+};
+
+inline void QueuedCallRunner::PostTo(rtc::Thread* thread) {
+  // A thread that is quitting drops posted messages without deleting their
+  // data, so the calls are canceled right away instead.
+  if (thread->IsQuitting()) {
+    delete this;
+    return;
+  }
+  thread->Post(QueuedCallHandler::Instance(), 0, this);
+}
+
+}  // namespace internal
+
+// Collects calls to objects living on |thread|, typically proxies or the
+// objects behind them, and runs them there in order with a single thread hop.
+// Objects are kept alive and arguments passed by const reference are copied
+// until the calls have run; pointer arguments must stay valid until then.
+class ProxyCallBatch {
+ public:
+  explicit ProxyCallBatch(rtc::Thread* thread) : thread_(thread) {}
+  ~ProxyCallBatch() {
+    // Calls should be sent before the batch goes away; any that weren't are
+    // canceled.
+    ASSERT(calls_.empty());
+    internal::QueuedCallRunner unsent(&calls_, NULL);
+  }
+
+  bool empty() const { return calls_.empty(); }
+  size_t size() const { return calls_.size(); }
+
+  template <typename C, typename R>
+  rtc::scoped_refptr<ProxyResult<R> > Add(
+      typename internal::NonDeduced<C>::Type* c, R (C::*m)()) {
+    rtc::scoped_refptr<ProxyResult<R> > result = CreateResult<R>();
+    calls_.push_back(
+        new internal::QueuedCall0<C, R, R (C::*)()>(c, m, result.get()));
+    return result;
+  }
+
+  template <typename C, typename R>
+  rtc::scoped_refptr<ProxyResult<R> > Add(
+      typename internal::NonDeduced<C>::Type* c, R (C::*m)() const) {
+    rtc::scoped_refptr<ProxyResult<R> > result = CreateResult<R>();
+    calls_.push_back(
+        new internal::QueuedCall0<C, R, R (C::*)() const>(c, m, result.get()));
+    return result;
+  }
+
+  template <typename C, typename R, typename T1>
+  rtc::scoped_refptr<ProxyResult<R> > Add(
+      typename internal::NonDeduced<C>::Type* c, R (C::*m)(T1),
+      const typename internal::ProxyArg<T1>::Type& a1) {
+    rtc::scoped_refptr<ProxyResult<R> > result = CreateResult<R>();
+    calls_.push_back(new internal::QueuedCall1<C, R, R (C::*)(T1), T1>(
+        c, m, result.get(), a1));
+    return result;
+  }
+
+  template <typename C, typename R, typename T1>
+  rtc::scoped_refptr<ProxyResult<R> > Add(
+      typename internal::NonDeduced<C>::Type* c, R (C::*m)(T1) const,
+      const typename internal::ProxyArg<T1>::Type& a1) {
+    rtc::scoped_refptr<ProxyResult<R> > result = CreateResult<R>();
+    calls_.push_back(new internal::QueuedCall1<C, R, R (C::*)(T1) const, T1>(
+        c, m, result.get(), a1));
+    return result;
+  }
+
+  template <typename C, typename R, typename T1, typename T2>
+  rtc::scoped_refptr<ProxyResult<R> > Add(
+      typename internal::NonDeduced<C>::Type* c, R (C::*m)(T1, T2),
+      const typename internal::ProxyArg<T1>::Type& a1,
+      const typename internal::ProxyArg<T2>::Type& a2) {
+    rtc::scoped_refptr<ProxyResult<R> > result = CreateResult<R>();
+    calls_.push_back(
+        new internal::QueuedCall2<C, R, R (C::*)(T1, T2), T1, T2>(
+            c, m, result.get(), a1, a2));
+    return result;
+  }
+
+  template <typename C, typename R, typename T1, typename T2, typename T3>
+  rtc::scoped_refptr<ProxyResult<R> > Add(
+      typename internal::NonDeduced<C>::Type* c, R (C::*m)(T1, T2, T3),
+      const typename internal::ProxyArg<T1>::Type& a1,
+      const typename internal::ProxyArg<T2>::Type& a2,
+      const typename internal::ProxyArg<T3>::Type& a3) {
+    rtc::scoped_refptr<ProxyResult<R> > result = CreateResult<R>();
+    calls_.push_back(
+        new internal::QueuedCall3<C, R, R (C::*)(T1, T2, T3), T1, T2, T3>(
+            c, m, result.get(), a1, a2, a3));
+    return result;
+  }
+
+  // Runs the calls added so far on the thread and waits for them.
+  void Invoke() {
+    if (calls_.empty())
+      return;
+    if (thread_->IsCurrent()) {
+      internal::QueuedCallRunner(&calls_, NULL).Run();
+      return;
+    }
+    rtc::Event done(false, false);
+    (new internal::QueuedCallRunner(&calls_, &done))->PostTo(thread_);
+    done.Wait(rtc::kForever);
+  }
+
+  // Sends the calls added so far to the thread without waiting for them,
+  // even from the thread itself. Each result completes when its call has run
+  // or has been canceled.
+  void Post() {
+    if (!calls_.empty())
+      (new internal::QueuedCallRunner(&calls_, NULL))->PostTo(thread_);
+  }
+
+ private:
+  template <typename R>
+  static rtc::scoped_refptr<ProxyResult<R> > CreateResult() {
+    return new rtc::RefCountedObject<ProxyResult<R> >();
+  }
+
+  rtc::Thread* thread_;
+  std::vector<internal::QueuedCall*> calls_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProxyCallBatch);
+};
+
 #define BEGIN_PROXY_MAP(c) \
   class c##Proxy : public c##Interface {\
    protected:\
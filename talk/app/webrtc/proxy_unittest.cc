@@ -38,6 +38,7 @@
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Exactly;
+using ::testing::InSequence;
 using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
 
@@ -167,4 +168,110 @@ TEST_F(ProxyTest, Method2) {
   EXPECT_EQ("Method2", fake_proxy_->Method2(arg1, arg2));
 }
 
+TEST_F(ProxyTest, BatchInvoke) {
+  InSequence s;
+  EXPECT_CALL(*fake_, VoidMethod0())
+            .WillOnce(InvokeWithoutArgs(this, &ProxyTest::CheckThread));
+  EXPECT_CALL(*fake_, Method1("arg1"))
+            .WillOnce(
+                DoAll(InvokeWithoutArgs(this, &ProxyTest::CheckThread),
+                      Return("Method1")));
+  EXPECT_CALL(*fake_, ConstMethod0())
+            .WillOnce(
+                DoAll(InvokeWithoutArgs(this, &ProxyTest::CheckThread),
+                      Return("ConstMethod0")));
+
+  ProxyCallBatch batch(signaling_thread_.get());
+  rtc::scoped_refptr<ProxyResult<void> > void_result =
+      batch.Add(fake_proxy_.get(), &FakeInterface::VoidMethod0);
+  // The argument is copied, so the temporary can go away.
+  rtc::scoped_refptr<ProxyResult<std::string> > result1 =
+      batch.Add(fake_proxy_.get(), &FakeInterface::Method1,
+                std::string("arg1"));
+  rtc::scoped_refptr<ProxyResult<std::string> > const_result =
+      batch.Add(fake_proxy_.get(), &FakeInterface::ConstMethod0);
+  EXPECT_EQ(3U, batch.size());
+  EXPECT_FALSE(result1->done());
+
+  batch.Invoke();
+  EXPECT_TRUE(batch.empty());
+  EXPECT_TRUE(void_result->done());
+  EXPECT_TRUE(result1->done());
+  EXPECT_EQ("Method1", result1->value());
+  EXPECT_EQ("ConstMethod0", const_result->value());
+}
+
+// Holds up the signaling thread until Set() is called.
+class Blocker {
+ public:
+  Blocker() : event_(false, false) {}
+  void Set() { event_.Set(); }
+  void Wait() { event_.Wait(rtc::kForever); }
+
+ private:
+  rtc::Event event_;
+};
+
+TEST_F(ProxyTest, BatchPost) {
+  Blocker block;
+  EXPECT_CALL(*fake_, Method0())
+            .WillOnce(
+                DoAll(InvokeWithoutArgs(&block, &Blocker::Wait),
+                      Return("Method0")));
+  EXPECT_CALL(*fake_, Method2("arg1", "arg2"))
+            .WillOnce(
+                DoAll(InvokeWithoutArgs(this, &ProxyTest::CheckThread),
+                      Return("Method2")));
+
+  ProxyCallBatch batch(signaling_thread_.get());
+  rtc::scoped_refptr<ProxyResult<std::string> > result0 =
+      batch.Add(fake_.get(), &FakeInterface::Method0);
+  rtc::scoped_refptr<ProxyResult<std::string> > result2 =
+      batch.Add(fake_proxy_.get(), &FakeInterface::Method2,
+                std::string("arg1"), std::string("arg2"));
+  // Posting returns while the first call is still blocked.
+  batch.Post();
+  EXPECT_TRUE(batch.empty());
+  EXPECT_FALSE(result0->done());
+  EXPECT_FALSE(result2->done());
+
+  block.Set();
+  EXPECT_EQ("Method0", result0->value());
+  EXPECT_EQ("Method2", result2->value());
+}
+
+// A batch whose thread is destroyed before running it is canceled.
+TEST_F(ProxyTest, BatchCanceledWhenThreadIsDestroyed) {
+  EXPECT_CALL(*fake_, Method0()).Times(0);
+
+  rtc::scoped_ptr<rtc::Thread> thread(new rtc::Thread());
+  ProxyCallBatch batch(thread.get());
+  rtc::scoped_refptr<ProxyResult<std::string> > result =
+      batch.Add(fake_.get(), &FakeInterface::Method0);
+  // The thread isn't running, so the call stays queued.
+  batch.Post();
+  EXPECT_FALSE(result->done());
+
+  thread.reset();
+  EXPECT_TRUE(result->done());
+  EXPECT_TRUE(result->canceled());
+  EXPECT_EQ("", result->value());
+}
+
+// Calls sent to a thread that has quit are canceled rather than left
+// pending, so Invoke() doesn't block forever.
+TEST_F(ProxyTest, BatchCanceledWhenThreadHasQuit) {
+  EXPECT_CALL(*fake_, Method0()).Times(0);
+
+  rtc::scoped_ptr<rtc::Thread> thread(new rtc::Thread());
+  thread->Start();
+  thread->Stop();
+  ProxyCallBatch batch(thread.get());
+  rtc::scoped_refptr<ProxyResult<std::string> > result =
+      batch.Add(fake_.get(), &FakeInterface::Method0);
+  batch.Invoke();
+  EXPECT_TRUE(result->done());
+  EXPECT_TRUE(result->canceled());
+}
+
 }  // namespace webrtc
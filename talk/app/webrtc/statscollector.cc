@@ -102,14 +102,11 @@ bool ExtractValueFromReport(
     const StatsReport& report,
     StatsReport::StatsValueName name,
     std::string* value) {
-  StatsReport::Values::const_iterator it = report.values.begin();
-  for (; it != report.values.end(); ++it) {
-    if (it->name == name) {
-      *value = it->value;
-      return true;
-    }
-  }
-  return false;
+  const StatsReport::Value* v = report.FindValue(name);
+  if (!v)
+    return false;
+  *value = v->ToString();
+  return true;
 }
 
 void ExtractStats(const cricket::BandwidthEstimationInfo& info,
@@ -121,7 +118,7 @@ void ExtractStats(const cricket::BandwidthEstimationInfo& info,
 
   // Clear out stats from previous GatherStats calls if any.
   if (report->timestamp != stats_gathering_started) {
-    report->values.clear();
+    report->ClearValues();
     report->timestamp = stats_gathering_started;
   }
 
@@ -250,7 +247,7 @@ void StatsCollector::GetStats(StatsReports* reports) {
 
   StatsSet::const_iterator it;
   for (it = reports_.begin(); it != reports_.end(); ++it)
-    reports->push_back(&(*it));
+    reports->push_back(&it->second);
   return;
 }
 
@@ -286,11 +283,9 @@ StatsReport* StatsCollector::PrepareLocalReport(
       StatsReport::kStatsReportTypeSsrc, ssrc_id, direction);
 
   // Clear out stats from previous GatherStats calls if any.
-  // This is required since the report will be returned for the new values.
-  // Having the old values in the report will lead to multiple values with
-  // the same name.
-  // TODO(xians): Consider changing StatsReport to use map instead of vector.
-  report->values.clear();
+  // The set of values depends on the media engine, so values that are no
+  // longer reported must not linger in the report.
+  report->ClearValues();
   report->timestamp = stats_gathering_started_;
 
   report->AddValue(StatsReport::kStatsValueNameSsrc, ssrc_id);
@@ -314,7 +309,7 @@ StatsReport* StatsCollector::PrepareRemoteReport(
 
   // Clear out stats from previous GatherStats calls if any.
   // The timestamp will be added later. Zero it for debugging.
-  report->values.clear();
+  report->ClearValues();
   report->timestamp = 0;
 
   report->AddValue(StatsReport::kStatsValueNameSsrc, ssrc_id);
@@ -326,10 +321,6 @@ StatsReport* StatsCollector::PrepareRemoteReport(
 
 std::string StatsCollector::AddOneCertificateReport(
     const rtc::SSLCertificate* cert, const std::string& issuer_id) {
-  // TODO(bemasc): Move this computation to a helper class that caches these
-  // values to reduce CPU use in GetStats.  This will require adding a fast
-  // SSLCertificate::Equals() method to detect certificate changes.
-
   std::string digest_algorithm;
   if (!cert->GetSignatureDigestAlgorithm(&digest_algorithm))
     return std::string();
@@ -346,14 +337,26 @@ std::string StatsCollector::AddOneCertificateReport(
 
   std::string fingerprint = ssl_fingerprint->GetRfc4572Fingerprint();
 
+  // The report id is derived from the fingerprint, so an existing report
+  // describes this very certificate and only needs a new timestamp. This
+  // avoids re-encoding the DER on every GetStats call.
+  const std::string report_id =
+      StatsId(StatsReport::kStatsReportTypeCertificate, fingerprint);
+  StatsReport* report = reports_.Find(report_id);
+  if (report) {
+    report->timestamp = stats_gathering_started_;
+    if (!issuer_id.empty())
+      report->AddValue(StatsReport::kStatsValueNameIssuerId, issuer_id);
+    return report->id;
+  }
+
   rtc::Buffer der_buffer;
   cert->ToDER(&der_buffer);
   std::string der_base64;
   rtc::Base64::EncodeFromArray(
       der_buffer.data(), der_buffer.length(), &der_base64);
 
-  StatsReport* report = reports_.ReplaceOrAddNew(
-      StatsId(StatsReport::kStatsReportTypeCertificate, fingerprint));
+  report = reports_.InsertNew(report_id);
   report->type = StatsReport::kStatsReportTypeCertificate;
   report->timestamp = stats_gathering_started_;
   report->AddValue(StatsReport::kStatsValueNameFingerprint, fingerprint);
@@ -402,8 +405,9 @@ std::string StatsCollector::AddCandidateReport(
            StatsReport::kStatsReportTypeIceRemoteCandidate == report_type);
     report->type = report_type;
     if (report_type == StatsReport::kStatsReportTypeIceLocalCandidate) {
-      report->AddValue(StatsReport::kStatsValueNameCandidateNetworkType,
-                       AdapterTypeToStatsType(candidate.network_type()));
+      report->AddStaticString(
+          StatsReport::kStatsValueNameCandidateNetworkType,
+          AdapterTypeToStatsType(candidate.network_type()));
     }
     report->timestamp = stats_gathering_started_;
     report->AddValue(StatsReport::kStatsValueNameCandidateIPAddress,
@@ -412,8 +416,8 @@ std::string StatsCollector::AddCandidateReport(
                      candidate.address().PortAsString());
     report->AddValue(StatsReport::kStatsValueNameCandidatePriority,
                      candidate.priority());
-    report->AddValue(StatsReport::kStatsValueNameCandidateType,
-                     IceCandidateTypeToStatsType(candidate.type()));
+    report->AddStaticString(StatsReport::kStatsValueNameCandidateType,
+                            IceCandidateTypeToStatsType(candidate.type()));
     report->AddValue(StatsReport::kStatsValueNameCandidateTransportType,
                      candidate.protocol());
   }
@@ -424,11 +428,10 @@ std::string StatsCollector::AddCandidateReport(
 void StatsCollector::ExtractSessionInfo() {
   ASSERT(session_->signaling_thread()->IsCurrent());
   // Extract information from the base session.
-  StatsReport* report = reports_.ReplaceOrAddNew(
+  StatsReport* report = reports_.FindOrAddNew(
       StatsId(StatsReport::kStatsReportTypeSession, session_->id()));
   report->type = StatsReport::kStatsReportTypeSession;
   report->timestamp = stats_gathering_started_;
-  report->values.clear();
   report->AddBoolean(StatsReport::kStatsValueNameInitiator,
                      session_->initiator());
 
@@ -471,26 +474,36 @@ void StatsCollector::ExtractSessionInfo() {
         std::ostringstream ostc;
         ostc << "Channel-" << transport_iter->second.content_name
              << "-" << channel_iter->component;
-        StatsReport* channel_report = reports_.ReplaceOrAddNew(ostc.str());
+        StatsReport* channel_report = reports_.FindOrAddNew(ostc.str());
         channel_report->type = StatsReport::kStatsReportTypeComponent;
         channel_report->timestamp = stats_gathering_started_;
         channel_report->AddValue(StatsReport::kStatsValueNameComponent,
                                  channel_iter->component);
-        if (!local_cert_report_id.empty())
+        if (!local_cert_report_id.empty()) {
           channel_report->AddValue(
               StatsReport::kStatsValueNameLocalCertificateId,
               local_cert_report_id);
-        if (!remote_cert_report_id.empty())
+        } else {
+          channel_report->RemoveValue(
+              StatsReport::kStatsValueNameLocalCertificateId);
+        }
+        if (!remote_cert_report_id.empty()) {
           channel_report->AddValue(
               StatsReport::kStatsValueNameRemoteCertificateId,
               remote_cert_report_id);
+        } else {
+          channel_report->RemoveValue(
+              StatsReport::kStatsValueNameRemoteCertificateId);
+        }
         for (size_t i = 0;
              i < channel_iter->connection_infos.size();
              ++i) {
           std::ostringstream ost;
           ost << "Conn-" << transport_iter->first << "-"
               << channel_iter->component << "-" << i;
-          StatsReport* report = reports_.ReplaceOrAddNew(ost.str());
+          // Every value below is set on each pass, so the report from the
+          // previous pass is updated in place.
+          StatsReport* report = reports_.FindOrAddNew(ost.str());
           report->type = StatsReport::kStatsReportTypeCandidatePair;
           report->timestamp = stats_gathering_started_;
           // Link from connection to its containing channel.
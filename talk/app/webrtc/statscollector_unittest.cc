@@ -151,10 +151,10 @@ class FakeAudioTrack
 bool GetValue(const StatsReport* report,
               StatsReport::StatsValueName name,
               std::string* value) {
-  StatsReport::Values::const_iterator it = report->values.begin();
-  for (; it != report->values.end(); ++it) {
+  StatsReport::Values::const_iterator it = report->values().begin();
+  for (; it != report->values().end(); ++it) {
     if (it->name == name) {
-      *value = it->value;
+      *value = it->ToString();
       return true;
     }
   }
@@ -672,6 +672,43 @@ class StatsCollectorTest : public testing::Test {
 };
 
 // This test verifies that 64-bit counters are passed successfully.
+// This test verifies that adding a value a report already has replaces it,
+// and that values are only formatted as text when they are asked for.
+TEST(StatsReportTest, AddValueReplacesExistingValue) {
+  StatsReport report("id");
+  report.AddValue(StatsReport::kStatsValueNameBytesSent, 1);
+  report.AddBoolean(StatsReport::kStatsValueNameWritable, false);
+  report.AddValue(StatsReport::kStatsValueNameBytesSent, 2);
+  report.AddBoolean(StatsReport::kStatsValueNameWritable, true);
+  ASSERT_EQ(2U, report.values().size());
+
+  const StatsReport::Value* bytes_sent =
+      report.FindValue(StatsReport::kStatsValueNameBytesSent);
+  ASSERT_TRUE(bytes_sent != NULL);
+  EXPECT_EQ(2, bytes_sent->int64_val());
+  EXPECT_TRUE(bytes_sent->value.empty());
+  EXPECT_EQ("2", bytes_sent->ToString());
+  EXPECT_EQ("2", bytes_sent->value);
+  const StatsReport::Value* writable =
+      report.FindValue(StatsReport::kStatsValueNameWritable);
+  ASSERT_TRUE(writable != NULL);
+  EXPECT_TRUE(writable->bool_val());
+  EXPECT_EQ("true", writable->ToString());
+
+  report.RemoveValue(StatsReport::kStatsValueNameBytesSent);
+  EXPECT_TRUE(report.FindValue(StatsReport::kStatsValueNameBytesSent) == NULL);
+  report.AddValue(StatsReport::kStatsValueNameBytesSent, "3");
+  ASSERT_EQ(2U, report.values().size());
+  EXPECT_EQ("3", report.FindValue(
+      StatsReport::kStatsValueNameBytesSent)->ToString());
+
+  // Changing a value drops the text of the old one.
+  report.AddDouble(StatsReport::kStatsValueNameWritable, 0.5);
+  writable = report.FindValue(StatsReport::kStatsValueNameWritable);
+  EXPECT_EQ(0.5, writable->double_val());
+  EXPECT_EQ("0.5", writable->ToString());
+}
+
 TEST_F(StatsCollectorTest, BytesCounterHandles64Bits) {
   webrtc::StatsCollector stats(&session_);  // Implementation under test.
   MockVideoMediaChannel* media_channel = new MockVideoMediaChannel();
@@ -779,6 +816,31 @@ TEST_F(StatsCollectorTest, OnlyOneSessionObjectExists) {
   EXPECT_EQ(NULL, session_report);
 }
 
+// This test verifies that the session report is kept across calls to
+// UpdateStats and that its values are updated rather than added again.
+TEST_F(StatsCollectorTest, SessionObjectIsUpdatedInPlace) {
+  webrtc::StatsCollector stats(&session_);  // Implementation under test.
+  StatsReports reports;  // returned values.
+  EXPECT_CALL(session_, video_channel()).WillRepeatedly(ReturnNull());
+  EXPECT_CALL(session_, voice_channel()).WillRepeatedly(ReturnNull());
+  stats.UpdateStats(PeerConnectionInterface::kStatsOutputLevelStandard);
+  stats.GetStats(NULL, &reports);
+  const StatsReport* session_report = FindNthReportByType(
+      reports, StatsReport::kStatsReportTypeSession, 1);
+  ASSERT_TRUE(session_report != NULL);
+  size_t num_values = session_report->values().size();
+  EXPECT_TRUE(
+      session_report->FindValue(StatsReport::kStatsValueNameInitiator) !=
+      NULL);
+
+  stats.UpdateStats(PeerConnectionInterface::kStatsOutputLevelStandard);
+  reports.clear();
+  stats.GetStats(NULL, &reports);
+  EXPECT_EQ(session_report, FindNthReportByType(
+      reports, StatsReport::kStatsReportTypeSession, 1));
+  EXPECT_EQ(num_values, session_report->values().size());
+}
+
 // This test verifies that the empty track report exists in the returned stats
 // without calling StatsCollector::UpdateStats.
 TEST_F(StatsCollectorTest, TrackObjectExistsWithoutUpdateStats) {
@@ -27,6 +27,8 @@
 
 #include "talk/app/webrtc/statstypes.h"
 
+#include <string.h>
+
 namespace webrtc {
 
 const char StatsReport::kStatsReportTypeSession[] = "googLibjingleSession";
@@ -44,22 +46,29 @@ const char StatsReport::kStatsReportTypeCertificate[] = "googCertificate";
 
 const char StatsReport::kStatsReportVideoBweId[] = "bweforvideo";
 
+StatsReport::StatsReport() : timestamp(0) {
+  ResetValueIndex();
+}
+
 StatsReport::StatsReport(const StatsReport& src)
   : id(src.id),
     type(src.type),
     timestamp(src.timestamp),
-    values(src.values) {
+    values_(src.values_) {
+  memcpy(value_index_, src.value_index_, sizeof(value_index_));
 }
 
 StatsReport::StatsReport(const std::string& id)
     : id(id), timestamp(0) {
+  ResetValueIndex();
 }
 
 StatsReport& StatsReport::operator=(const StatsReport& src) {
   ASSERT(id == src.id);
   type = src.type;
   timestamp = src.timestamp;
-  values = src.values;
+  values_ = src.values_;
+  memcpy(value_index_, src.value_index_, sizeof(value_index_));
   return *this;
 }
 
@@ -80,23 +89,105 @@ bool StatsReport::operator==(const std::string& other_id) const {
 
 // The copy ctor can't be declared as explicit due to problems with STL.
 StatsReport::Value::Value(const Value& other)
-    : name(other.name), value(other.value) {
+    : name(other.name), value(other.value), type_(other.type_),
+      value_(other.value_), formatted_(other.formatted_) {
 }
 
 StatsReport::Value::Value(StatsValueName name)
-    : name(name) {
+    : name(name), type_(kString), formatted_(true) {
+  value_.int64_ = 0;
 }
 
 StatsReport::Value::Value(StatsValueName name, const std::string& value)
-    : name(name), value(value) {
+    : name(name), value(value), type_(kString), formatted_(true) {
+  value_.int64_ = 0;
 }
 
 StatsReport::Value& StatsReport::Value::operator=(const Value& other) {
   const_cast<StatsValueName&>(name) = other.name;
   value = other.value;
+  type_ = other.type_;
+  value_ = other.value_;
+  formatted_ = other.formatted_;
   return *this;
 }
 
+int64 StatsReport::Value::int64_val() const {
+  ASSERT(type_ == kInt64);
+  return value_.int64_;
+}
+
+double StatsReport::Value::double_val() const {
+  ASSERT(type_ == kDouble);
+  return value_.double_;
+}
+
+bool StatsReport::Value::bool_val() const {
+  ASSERT(type_ == kBool);
+  return value_.bool_;
+}
+
+const char* StatsReport::Value::string_val() const {
+  ASSERT(type_ == kString || type_ == kStaticString);
+  return type_ == kString ? value.c_str() : value_.static_string_;
+}
+
+const std::string& StatsReport::Value::ToString() const {
+  if (formatted_)
+    return value;
+  switch (type_) {
+    case kInt64:
+      value = rtc::ToString<int64>(value_.int64_);
+      break;
+    case kDouble:
+      value = rtc::ToString<double>(value_.double_);
+      break;
+    case kBool:
+      value.assign(value_.bool_ ? "true" : "false");
+      break;
+    case kStaticString:
+      value.assign(value_.static_string_);
+      break;
+    case kString:
+      // Always formatted.
+      ASSERT(false);
+      break;
+  }
+  formatted_ = true;
+  return value;
+}
+
+void StatsReport::Value::SetInt64(int64 int64_value) {
+  type_ = kInt64;
+  value_.int64_ = int64_value;
+  formatted_ = false;
+}
+
+void StatsReport::Value::SetDouble(double double_value) {
+  type_ = kDouble;
+  value_.double_ = double_value;
+  formatted_ = false;
+}
+
+void StatsReport::Value::SetBool(bool bool_value) {
+  type_ = kBool;
+  value_.bool_ = bool_value;
+  formatted_ = false;
+}
+
+void StatsReport::Value::SetString(const std::string& string_value) {
+  type_ = kString;
+  value.assign(string_value);
+  formatted_ = true;
+}
+
+void StatsReport::Value::SetStaticString(const char* static_value) {
+  ASSERT(static_value != NULL);
+  type_ = kStaticString;
+  value_.static_string_ = static_value;
+  formatted_ = false;
+}
+
 const char* StatsReport::Value::display_name() const {
   switch (name) {
     case kStatsValueNameAudioOutputLevel:
@@ -309,11 +400,11 @@ const char* StatsReport::Value::display_name() const {
 
 void StatsReport::AddValue(StatsReport::StatsValueName name,
                            const std::string& value) {
-  values.push_back(Value(name, value));
+  FindOrAddValue(name)->SetString(value);
 }
 
 void StatsReport::AddValue(StatsReport::StatsValueName name, int64 value) {
-  AddValue(name, rtc::ToString<int64>(value));
+  FindOrAddValue(name)->SetInt64(value);
 }
 
 template <typename T>
@@ -331,8 +422,8 @@ void StatsReport::AddValue(StatsReport::StatsValueName name,
 }
 
 // Implementation specializations for the variants of AddValue that we use.
-// TODO(tommi): Converting these ints to strings and copying strings, is not
-// very efficient.  Figure out a way to reduce the string churn.
+// Lists are only reported at the debug output level, so they are formatted
+// as text straight away.
 template
 void StatsReport::AddValue<std::string>(
     StatsReport::StatsValueName, const std::vector<std::string>&);
@@ -346,20 +437,63 @@ void StatsReport::AddValue<int64_t>(
     StatsReport::StatsValueName, const std::vector<int64_t>&);
 
 void StatsReport::AddBoolean(StatsReport::StatsValueName name, bool value) {
-  AddValue(name, value ? "true" : "false");
+  FindOrAddValue(name)->SetBool(value);
+}
+
+void StatsReport::AddDouble(StatsReport::StatsValueName name, double value) {
+  FindOrAddValue(name)->SetDouble(value);
+}
+
+void StatsReport::AddStaticString(StatsReport::StatsValueName name,
+                                  const char* value) {
+  FindOrAddValue(name)->SetStaticString(value);
 }
 
 void StatsReport::ReplaceValue(StatsReport::StatsValueName name,
                                const std::string& value) {
-  for (Values::iterator it = values.begin(); it != values.end(); ++it) {
-    if ((*it).name == name) {
-      it->value = value;
-      return;
-    }
+  // The value is expected to be there already; add an ASSERT to make sure
+  // the overwriting is always a success.
+  ASSERT(FindValue(name) != NULL);
+  FindOrAddValue(name)->SetString(value);
+}
+
+void StatsReport::RemoveValue(StatsReport::StatsValueName name) {
+  int index = value_index_[name];
+  if (index < 0)
+    return;
+  // Move the last value into the hole to keep the removal O(1).
+  if (static_cast<size_t>(index) != values_.size() - 1) {
+    values_[index] = values_.back();
+    value_index_[values_[index].name] = static_cast<int8>(index);
   }
-  // It is not reachable here, add an ASSERT to make sure the overwriting is
-  // always a success.
-  ASSERT(false);
+  values_.pop_back();
+  value_index_[name] = -1;
+}
+
+void StatsReport::ClearValues() {
+  values_.clear();
+  ResetValueIndex();
+}
+
+const StatsReport::Value* StatsReport::FindValue(
+    StatsReport::StatsValueName name) const {
+  int index = value_index_[name];
+  return index < 0 ? NULL : &values_[index];
+}
+
+StatsReport::Value* StatsReport::FindOrAddValue(
+    StatsReport::StatsValueName name) {
+  ASSERT(name >= 0 && name < kStatsValueNameCount);
+  int index = value_index_[name];
+  if (index >= 0)
+    return &values_[index];
+  value_index_[name] = static_cast<int8>(values_.size());
+  values_.push_back(Value(name));
+  return &values_.back();
+}
+
+void StatsReport::ResetValueIndex() {
+  memset(value_index_, -1, sizeof(value_index_));
 }
 
 StatsSet::StatsSet() {
@@ -378,8 +512,8 @@ StatsSet::const_iterator StatsSet::end() const {
 
 StatsReport* StatsSet::InsertNew(const std::string& id) {
   ASSERT(Find(id) == NULL);
-  const StatsReport* ret = &(*list_.insert(StatsReportCopyable(id)).first);
-  return const_cast<StatsReport*>(ret);
+  return &list_.insert(std::make_pair(id, StatsReportCopyable(id)))
+      .first->second;
 }
 
 StatsReport* StatsSet::FindOrAddNew(const std::string& id) {
@@ -395,9 +529,8 @@ StatsReport* StatsSet::ReplaceOrAddNew(const std::string& id) {
 // Looks for a report with the given |id|.  If one is not found, NULL
 // will be returned.
 StatsReport* StatsSet::Find(const std::string& id) {
-  const_iterator it = std::find(begin(), end(), id);
-  return it == end() ? NULL :
-      const_cast<StatsReport*>(static_cast<const StatsReport*>(&(*it)));
+  iterator it = list_.find(id);
+  return it == list_.end() ? NULL : &it->second;
 }
 
 }  // namespace webrtc
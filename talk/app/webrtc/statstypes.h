@@ -32,7 +32,7 @@
 #define TALK_APP_WEBRTC_STATSTYPES_H_
 
 #include <algorithm>
-#include <set>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -46,7 +46,7 @@ class StatsReport {
  public:
   // TODO(tommi): Remove this ctor after removing reliance upon it in Chromium
   // (mock_peer_connection_impl.cc).
-  StatsReport() : timestamp(0) {}
+  StatsReport();
 
   // TODO(tommi): Make protected and disallow copy completely once not needed.
   StatsReport(const StatsReport& src);
@@ -173,9 +173,23 @@ class StatsReport {
     kStatsValueNameTypingNoiseState,
     kStatsValueNameViewLimitedResolution,
     kStatsValueNameWritable,
+
+    // Not a value name; the number of names above.
+    kStatsValueNameCount
   };
 
+  // A single metric. Values are stored in their native type and only
+  // formatted as text by ToString(), when they are handed to the
+  // application.
   struct Value {
+    enum Type {
+      kInt64,
+      kDouble,
+      kBool,
+      kString,        // A copied std::string.
+      kStaticString,  // A pointer to a string that outlives the report.
+    };
+
     // The copy ctor can't be declared as explicit due to problems with STL.
     Value(const Value& other);
     explicit Value(StatsValueName name);
@@ -189,22 +203,68 @@ class StatsReport {
     // Returns the string representation of |name|.
     const char* display_name() const;
 
-    const StatsValueName name;
+    Type type() const { return type_; }
+
+    // Typed accessors. Each must only be called for its own type.
+    int64 int64_val() const;
+    double double_val() const;
+    bool bool_val() const;
+    // Valid for both kString and kStaticString.
+    const char* string_val() const;
+
+    // Returns the value formatted the way it is reported to applications.
+    // The text is kept in |value| until the value changes.
+    const std::string& ToString() const;
+
+    // Setters used by StatsReport. Setting a string value reuses the storage
+    // of the previous one.
+    void SetInt64(int64 value);
+    void SetDouble(double value);
+    void SetBool(bool value);
+    void SetString(const std::string& value);
+    void SetStaticString(const char* value);
 
-    std::string value;
+    const StatsValueName name;
+    // Deprecated: the text returned by ToString(), which fills it in. Only
+    // string values are there before ToString() has been called.
+    // TODO: Remove once all dependent code uses ToString() or the typed
+    // accessors.
+    mutable std::string value;
+
+   private:
+    Type type_;
+    union {
+      int64 int64_;
+      double double_;
+      bool bool_;
+      const char* static_string_;
+    } value_;
+    // True if |value| holds the text of the current value.
+    mutable bool formatted_;
   };
 
+  // Adding a value that the report already has replaces it in place, so a
+  // report can be refreshed without being rebuilt.
   void AddValue(StatsValueName name, const std::string& value);
   void AddValue(StatsValueName name, int64 value);
   template <typename T>
   void AddValue(StatsValueName name, const std::vector<T>& value);
   void AddBoolean(StatsValueName name, bool value);
+  void AddDouble(StatsValueName name, double value);
+  // |value| must outlive the report, e.g. a string literal.
+  void AddStaticString(StatsValueName name, const char* value);
 
   void ReplaceValue(StatsValueName name, const std::string& value);
+  void RemoveValue(StatsValueName name);
+  void ClearValues();
+
+  // Returns the value with |name|, or NULL if the report doesn't have one.
+  const Value* FindValue(StatsValueName name) const;
 
   double timestamp;  // Time since 1970-01-01T00:00:00Z in milliseconds.
   typedef std::vector<Value> Values;
-  Values values;
+  // Use the methods above to modify the values.
+  const Values& values() const { return values_; }
 
   // TODO(tommi): These should all be enum values.
 
@@ -262,6 +322,15 @@ class StatsReport {
 
   // The id of StatsReport of type VideoBWE.
   static const char kStatsReportVideoBweId[];
+
+ private:
+  // Returns the value with |name|, appending a new one if needed.
+  Value* FindOrAddValue(StatsValueName name);
+  void ResetValueIndex();
+
+  Values values_;
+  // Position of each named value in |values_|, or -1.
+  int8 value_index_[kStatsValueNameCount];
 };
 
 // This class is provided for the cases where we need to keep
@@ -285,14 +354,16 @@ typedef std::vector<const StatsReport*> StatsReports;
 
 // A map from the report id to the report.
 // This class wraps an STL container and provides a limited set of
-// functionality in order to keep things simple.
+// functionality in order to keep things simple. Reports keep their address
+// for as long as they are in the set, so they can be updated in place from
+// one collection to the next.
 // TODO(tommi): Use a thread checker here (currently not in libjingle).
 class StatsSet {
  public:
   StatsSet();
   ~StatsSet();
 
-  typedef std::set<StatsReportCopyable> Container;
+  typedef std::map<std::string, StatsReportCopyable> Container;
   typedef Container::iterator iterator;
   typedef Container::const_iterator const_iterator;
 
@@ -33,7 +33,8 @@ class FakeDataChannelProvider : public webrtc::DataChannelProviderInterface {
       : send_blocked_(false),
         transport_available_(false),
         ready_to_send_(false),
-        transport_error_(false) {}
+        transport_error_(false),
+        sent_message_count_(0) {}
   virtual ~FakeDataChannelProvider() {}
 
   virtual bool SendData(const cricket::SendDataParams& params,
@@ -51,6 +52,7 @@ class FakeDataChannelProvider : public webrtc::DataChannelProviderInterface {
     }
 
     last_send_data_params_ = params;
+    ++sent_message_count_;
     return true;
   }
 
@@ -132,6 +134,11 @@ class FakeDataChannelProvider : public webrtc::DataChannelProviderInterface {
     return last_send_data_params_;
   }
 
+  // The number of successful SendData calls, including control messages.
+  int sent_message_count() const {
+    return sent_message_count_;
+  }
+
   bool IsConnected(webrtc::DataChannel* data_channel) const {
     return connected_channels_.find(data_channel) != connected_channels_.end();
   }
@@ -150,6 +157,7 @@ class FakeDataChannelProvider : public webrtc::DataChannelProviderInterface {
   bool transport_available_;
   bool ready_to_send_;
   bool transport_error_;
+  int sent_message_count_;
   std::set<webrtc::DataChannel*> connected_channels_;
   std::set<uint32> send_ssrcs_;
   std::set<uint32> recv_ssrcs_;
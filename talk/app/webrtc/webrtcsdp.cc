@@ -29,6 +29,7 @@
 
 #include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -448,7 +449,8 @@ static bool GetLine(const std::string& message,
   if (line_end > 0 && (message.at(line_end - 1) == kReturn)) {
     --line_end;
   }
-  *line = message.substr(line_begin, (line_end - line_begin));
+  // Assigning in place reuses the capacity of |line| across calls.
+  line->assign(message, line_begin, line_end - line_begin);
   const char* cline = line->c_str();
   // RFC 4566
   // An SDP session description consists of a number of lines of text of
@@ -480,13 +482,36 @@ static void InitAttrLine(const std::string& attribute, std::ostringstream* os) {
   InitLine(kLineTypeAttributes, attribute, os);
 }
 
+// Appends the decimal representation of |value| to |message|.
+static void AppendInt(int64 value, std::string* message) {
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* start = end;
+  uint64 magnitude = value < 0 ? -static_cast<uint64>(value) : value;
+  do {
+    *--start = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0)
+    *--start = '-';
+  message->append(start, end - start);
+}
+
+// Appends "a=|attribute|" to |message|.
+static void AppendAttrLineStart(const std::string& attribute,
+                                std::string* message) {
+  message->push_back(kLineTypeAttributes);
+  message->push_back(kSdpDelimiterEqual);
+  message->append(attribute);
+}
+
 // Writes a SDP attribute line based on |attribute| and |value| to |message|.
 static void AddAttributeLine(const std::string& attribute, int value,
                              std::string* message) {
-  std::ostringstream os;
-  InitAttrLine(attribute, &os);
-  os << kSdpDelimiterColon << value;
-  AddLine(os.str(), message);
+  AppendAttrLineStart(attribute, message);
+  message->push_back(kSdpDelimiterColon);
+  AppendInt(value, message);
+  message->append(kLineBreak);
 }
 
 static bool IsLineType(const std::string& message,
@@ -526,11 +551,16 @@ static bool AddSsrcLine(uint32 ssrc_id, const std::string& attribute,
                         const std::string& value, std::string* message) {
   // RFC 5576
   // a=ssrc:<ssrc-id> <attribute>:<value>
-  std::ostringstream os;
-  InitAttrLine(kAttributeSsrc, &os);
-  os << kSdpDelimiterColon << ssrc_id << kSdpDelimiterSpace
-     << attribute << kSdpDelimiterColon << value;
-  return AddLine(os.str(), message);
+  // These are the bulk of large descriptions, so they are written directly.
+  AppendAttrLineStart(kAttributeSsrc, message);
+  message->push_back(kSdpDelimiterColon);
+  AppendInt(ssrc_id, message);
+  message->push_back(kSdpDelimiterSpace);
+  message->append(attribute);
+  message->push_back(kSdpDelimiterColon);
+  message->append(value);
+  message->append(kLineBreak);
+  return true;
 }
 
 // Split the message into two parts by the first delimiter.
@@ -543,9 +573,9 @@ static bool SplitByDelimiter(const std::string& message,
   if (pos == std::string::npos) {
     return false;
   }
-  *field1 = message.substr(0, pos);
+  field1->assign(message, 0, pos);
   // The rest is the value.
-  *field2 = message.substr(pos + 1);
+  field2->assign(message, pos + 1, std::string::npos);
   return true;
 }
 
@@ -565,12 +595,15 @@ static bool GetValue(const std::string& message, const std::string& attribute,
   return true;
 }
 
-static bool CaseInsensitiveFind(std::string str1, std::string str2) {
-  std::transform(str1.begin(), str1.end(), str1.begin(),
-                 ::tolower);
-  std::transform(str2.begin(), str2.end(), str2.begin(),
-                 ::tolower);
-  return str1.find(str2) != std::string::npos;
+static bool CaseInsensitiveCharEquals(char c1, char c2) {
+  return tolower(static_cast<unsigned char>(c1)) ==
+         tolower(static_cast<unsigned char>(c2));
+}
+
+static bool CaseInsensitiveFind(const std::string& str1,
+                                const std::string& str2) {
+  return std::search(str1.begin(), str1.end(), str2.begin(), str2.end(),
+                     CaseInsensitiveCharEquals) != str1.end();
 }
 
 template <class T>
@@ -586,6 +619,96 @@ static bool GetValueFromString(const std::string& line,
   return true;
 }
 
+// A non-owning view of part of an SDP message. The parser uses these to look
+// at lines and fields without copying them into new strings.
+struct SdpSpan {
+  SdpSpan() : data(NULL), length(0) {}
+  SdpSpan(const char* data, size_t length) : data(data), length(length) {}
+  // The part of |line| after "<type>=".
+  static SdpSpan LineValue(const std::string& line) {
+    ASSERT(line.length() >= kLinePrefixLength);
+    return SdpSpan(line.data() + kLinePrefixLength,
+                   line.length() - kLinePrefixLength);
+  }
+
+  bool Equals(const char* str) const {
+    return strlen(str) == length && memcmp(data, str, length) == 0;
+  }
+  bool EndsWith(const char* str) const {
+    size_t str_length = strlen(str);
+    return str_length <= length &&
+           memcmp(data + length - str_length, str, str_length) == 0;
+  }
+  void CopyTo(std::string* str) const { str->assign(data, length); }
+  std::string ToString() const { return std::string(data, length); }
+
+  const char* data;
+  size_t length;
+};
+
+// Splits a span into the fields between |delimiter|s like rtc::split, so empty
+// fields are kept, but without copying them.
+class SdpTokenizer {
+ public:
+  SdpTokenizer(const SdpSpan& span, char delimiter)
+      : pos_(span.data), end_(span.data + span.length),
+        delimiter_(delimiter), done_(false) {}
+
+  bool Next(SdpSpan* field) {
+    if (done_)
+      return false;
+    const char* found = static_cast<const char*>(
+        memchr(pos_, delimiter_, end_ - pos_));
+    if (!found) {
+      found = end_;
+      done_ = true;
+    }
+    *field = SdpSpan(pos_, found - pos_);
+    pos_ = done_ ? end_ : found + 1;
+    return true;
+  }
+
+  // Everything after the fields returned so far.
+  SdpSpan Rest() const { return SdpSpan(pos_, end_ - pos_); }
+
+ private:
+  const char* pos_;
+  const char* end_;
+  char delimiter_;
+  bool done_;
+};
+
+// Splits |span| into two parts by the first |delimiter|.
+static bool SplitByDelimiter(const SdpSpan& span, char delimiter,
+                             SdpSpan* field1, SdpSpan* field2) {
+  SdpTokenizer tokenizer(span, delimiter);
+  tokenizer.Next(field1);
+  if (field1->length == span.length)
+    return false;
+  *field2 = tokenizer.Rest();
+  return true;
+}
+
+// Like GetValueFromString for a uint32, reading up to the first non-digit, but
+// without a string stream.
+static bool GetValueFromSpan(const std::string& line, const SdpSpan& s,
+                             uint32* t, SdpParseError* error) {
+  uint64 value = 0;
+  size_t i = 0;
+  for (; i < s.length && s.data[i] >= '0' && s.data[i] <= '9'; ++i) {
+    value = value * 10 + (s.data[i] - '0');
+    if (value > 0xFFFFFFFFu)
+      break;
+  }
+  if (i == 0 || value > 0xFFFFFFFFu) {
+    std::ostringstream description;
+    description << "Invalid value: " << s.ToString() << ".";
+    return ParseFailed(line, description.str(), error);
+  }
+  *t = static_cast<uint32>(value);
+  return true;
+}
+
 void CreateTracksFromSsrcInfos(const SsrcInfoVec& ssrc_infos,
                                StreamParamsVec* tracks) {
   ASSERT(tracks != NULL);
@@ -783,13 +906,37 @@ static void GetCandidatesByMindex(const SessionDescriptionInterface& desci,
   }
 }
 
+// Roughly estimates the size of the serialized |desc|.
+static size_t EstimateSdpSize(const cricket::SessionDescription* desc) {
+  // The session part, an m-line with its transport, codec and direction
+  // attributes, and the four lines of an ssrc.
+  const size_t kSessionSize = 256;
+  const size_t kContentSize = 1024;
+  const size_t kSsrcSize = 256;
+  size_t size = kSessionSize;
+  for (cricket::ContentInfos::const_iterator it = desc->contents().begin();
+       it != desc->contents().end(); ++it) {
+    size += kContentSize;
+    const MediaContentDescription* mdesc =
+        static_cast<const MediaContentDescription*>(it->description);
+    for (StreamParamsVec::const_iterator track = mdesc->streams().begin();
+         track != mdesc->streams().end(); ++track) {
+      size += track->ssrcs.size() * kSsrcSize;
+    }
+  }
+  return size;
+}
+
 std::string SdpSerialize(const JsepSessionDescription& jdesc) {
   const cricket::SessionDescription* desc = jdesc.description();
   if (!desc) {
     return "";
   }
 
+  // Appending to a buffer of about the final size avoids regrowing it for
+  // descriptions with many m-lines and ssrcs.
   std::string message;
+  message.reserve(EstimateSdpSize(desc));
 
   // Session Description.
   AddLine(kSessionVersion, &message);
@@ -1456,15 +1603,16 @@ void BuildRtpContentAttributes(
       if (track->ssrc_groups[i].ssrcs.empty()) {
         continue;
       }
-      std::ostringstream os;
-      InitAttrLine(kAttributeSsrcGroup, &os);
-      os << kSdpDelimiterColon << track->ssrc_groups[i].semantics;
+      AppendAttrLineStart(kAttributeSsrcGroup, message);
+      message->push_back(kSdpDelimiterColon);
+      message->append(track->ssrc_groups[i].semantics);
       std::vector<uint32>::const_iterator ssrc =
           track->ssrc_groups[i].ssrcs.begin();
       for (; ssrc != track->ssrc_groups[i].ssrcs.end(); ++ssrc) {
-        os << kSdpDelimiterSpace << rtc::ToString<uint32>(*ssrc);
+        message->push_back(kSdpDelimiterSpace);
+        AppendInt(*ssrc, message);
       }
-      AddLine(os.str(), message);
+      message->append(kLineBreak);
     }
     // Build the ssrc lines for each ssrc.
     for (size_t i = 0; i < track->ssrcs.size(); ++i) {
@@ -1478,13 +1626,10 @@ void BuildRtpContentAttributes(
       // a=ssrc:<ssrc-id> msid:identifier [appdata]
       // The appdata consists of the "id" attribute of a MediaStreamTrack, which
       // is corresponding to the "name" attribute of StreamParams.
-      std::string appdata = track->id;
-      std::ostringstream os;
-      InitAttrLine(kAttributeSsrc, &os);
-      os << kSdpDelimiterColon << ssrc << kSdpDelimiterSpace
-         << kSsrcAttributeMsid << kSdpDelimiterColon << track->sync_label
-         << kSdpDelimiterSpace << appdata;
-      AddLine(os.str(), message);
+      std::string msid = track->sync_label;
+      msid.push_back(kSdpDelimiterSpace);
+      msid.append(track->id);
+      AddSsrcLine(ssrc, kSsrcAttributeMsid, msid, message);
 
       // TODO(ronghuawu): Remove below code which is for backward compatibility.
       // draft-alvestrand-rtcweb-mid-01
@@ -2726,41 +2871,45 @@ bool ParseSsrcAttribute(const std::string& line, SsrcInfoVec* ssrc_infos,
   // RFC 5576
   // a=ssrc:<ssrc-id> <attribute>
   // a=ssrc:<ssrc-id> <attribute>:<value>
-  std::string field1, field2;
-  if (!SplitByDelimiter(line.substr(kLinePrefixLength),
-                        kSdpDelimiterSpace,
-                        &field1,
-                        &field2)) {
+  SdpSpan field1, field2;
+  if (!SplitByDelimiter(SdpSpan::LineValue(line), kSdpDelimiterSpace,
+                        &field1, &field2)) {
     const size_t expected_fields = 2;
     return ParseFailedExpectFieldNum(line, expected_fields, error);
   }
 
   // ssrc:<ssrc-id>
-  std::string ssrc_id_s;
-  if (!GetValue(field1, kAttributeSsrc, &ssrc_id_s, error)) {
-    return false;
+  SdpSpan name, ssrc_id_s;
+  if (!SplitByDelimiter(field1, kSdpDelimiterColon, &name, &ssrc_id_s) ||
+      !name.EndsWith(kAttributeSsrc)) {
+    return ParseFailedGetValue(field1.ToString(), kAttributeSsrc, error);
   }
   uint32 ssrc_id = 0;
-  if (!GetValueFromString(line, ssrc_id_s, &ssrc_id, error)) {
+  if (!GetValueFromSpan(line, ssrc_id_s, &ssrc_id, error)) {
     return false;
   }
 
-  std::string attribute;
-  std::string value;
-  if (!SplitByDelimiter(field2, kSdpDelimiterColon,
-                        &attribute, &value)) {
+  SdpSpan attribute, value;
+  if (!SplitByDelimiter(field2, kSdpDelimiterColon, &attribute, &value)) {
     std::ostringstream description;
-    description << "Failed to get the ssrc attribute value from " << field2
+    description << "Failed to get the ssrc attribute value from "
+                << field2.ToString()
                 << ". Expected format <attribute>:<value>.";
     return ParseFailed(line, description.str(), error);
   }
 
   // Check if there's already an item for this |ssrc_id|. Create a new one if
-  // there isn't.
-  SsrcInfoVec::iterator ssrc_info = ssrc_infos->begin();
-  for (; ssrc_info != ssrc_infos->end(); ++ssrc_info) {
-    if (ssrc_info->ssrc_id == ssrc_id) {
-      break;
+  // there isn't. The lines of an ssrc are normally together, so the last item
+  // is checked first.
+  SsrcInfoVec::iterator ssrc_info = ssrc_infos->end();
+  if (!ssrc_infos->empty() && ssrc_infos->back().ssrc_id == ssrc_id) {
+    --ssrc_info;
+  } else {
+    for (ssrc_info = ssrc_infos->begin(); ssrc_info != ssrc_infos->end();
+         ++ssrc_info) {
+      if (ssrc_info->ssrc_id == ssrc_id) {
+        break;
+      }
     }
   }
   if (ssrc_info == ssrc_infos->end()) {
@@ -2771,32 +2920,34 @@ bool ParseSsrcAttribute(const std::string& line, SsrcInfoVec* ssrc_infos,
   }
 
   // Store the info to the |ssrc_info|.
-  if (attribute == kSsrcAttributeCname) {
+  if (attribute.Equals(kSsrcAttributeCname)) {
     // RFC 5576
     // cname:<value>
-    ssrc_info->cname = value;
-  } else if (attribute == kSsrcAttributeMsid) {
+    value.CopyTo(&ssrc_info->cname);
+  } else if (attribute.Equals(kSsrcAttributeMsid)) {
     // draft-alvestrand-mmusic-msid-00
     // "msid:" identifier [ " " appdata ]
-    std::vector<std::string> fields;
-    rtc::split(value, kSdpDelimiterSpace, &fields);
-    if (fields.size() < 1 || fields.size() > 2) {
+    SdpTokenizer fields(value, kSdpDelimiterSpace);
+    SdpSpan identifier, appdata, extra;
+    fields.Next(&identifier);
+    bool has_appdata = fields.Next(&appdata);
+    if (fields.Next(&extra)) {
       return ParseFailed(line,
                          "Expected format \"msid:<identifier>[ <appdata>]\".",
                          error);
     }
-    ssrc_info->msid_identifier = fields[0];
-    if (fields.size() == 2) {
-      ssrc_info->msid_appdata = fields[1];
+    identifier.CopyTo(&ssrc_info->msid_identifier);
+    if (has_appdata) {
+      appdata.CopyTo(&ssrc_info->msid_appdata);
     }
-  } else if (attribute == kSsrcAttributeMslabel) {
+  } else if (attribute.Equals(kSsrcAttributeMslabel)) {
     // draft-alvestrand-rtcweb-mid-01
     // mslabel:<value>
-    ssrc_info->mslabel = value;
-  } else if (attribute == kSSrcAttributeLabel) {
+    value.CopyTo(&ssrc_info->mslabel);
+  } else if (attribute.Equals(kSSrcAttributeLabel)) {
     // The label isn't defined.
     // label:<value>
-    ssrc_info->label = value;
+    value.CopyTo(&ssrc_info->label);
   }
   return true;
 }
@@ -2807,26 +2958,28 @@ bool ParseSsrcGroupAttribute(const std::string& line,
   ASSERT(ssrc_groups != NULL);
   // RFC 5576
   // a=ssrc-group:<semantics> <ssrc-id> ...
-  std::vector<std::string> fields;
-  rtc::split(line.substr(kLinePrefixLength),
-                   kSdpDelimiterSpace, &fields);
-  const size_t expected_min_fields = 2;
-  if (fields.size() < expected_min_fields) {
+  SdpSpan field1, ssrc_fields;
+  if (!SplitByDelimiter(SdpSpan::LineValue(line), kSdpDelimiterSpace,
+                        &field1, &ssrc_fields)) {
+    const size_t expected_min_fields = 2;
     return ParseFailedExpectMinFieldNum(line, expected_min_fields, error);
   }
-  std::string semantics;
-  if (!GetValue(fields[0], kAttributeSsrcGroup, &semantics, error)) {
-    return false;
+  SdpSpan name, semantics;
+  if (!SplitByDelimiter(field1, kSdpDelimiterColon, &name, &semantics) ||
+      !name.EndsWith(kAttributeSsrcGroup)) {
+    return ParseFailedGetValue(field1.ToString(), kAttributeSsrcGroup, error);
   }
   std::vector<uint32> ssrcs;
-  for (size_t i = 1; i < fields.size(); ++i) {
+  SdpTokenizer fields(ssrc_fields, kSdpDelimiterSpace);
+  SdpSpan ssrc_s;
+  while (fields.Next(&ssrc_s)) {
     uint32 ssrc = 0;
-    if (!GetValueFromString(line, fields[i], &ssrc, error)) {
+    if (!GetValueFromSpan(line, ssrc_s, &ssrc, error)) {
       return false;
     }
     ssrcs.push_back(ssrc);
   }
-  ssrc_groups->push_back(SsrcGroup(semantics, ssrcs));
+  ssrc_groups->push_back(SsrcGroup(semantics.ToString(), ssrcs));
   return true;
 }
 
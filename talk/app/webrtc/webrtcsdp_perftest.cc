@@ -0,0 +1,168 @@
+/*
+ * libjingle
+ * Copyright 2015, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Measures SdpDeserialize and SdpSerialize on large synthetic descriptions,
+// like the simulcast offers with many m-lines that a server renegotiates.
+// Besides the time per operation, the number of heap allocations is reported,
+// which is why this is a separate executable: it replaces the global
+// operator new.
+
+#include <stdlib.h>
+
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "talk/app/webrtc/jsepsessiondescription.h"
+#include "talk/app/webrtc/webrtcsdp.h"
+#include "webrtc/base/gunit.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+static int g_allocations = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc) {
+  ++g_allocations;
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) throw() {
+  free(p);
+}
+
+namespace webrtc {
+
+static const int kIterations = 20;
+
+// Builds an offer with |num_contents| bundled video m-lines, each sending
+// |num_layers| simulcast layers with an RTX ssrc per layer.
+static std::string CreateLargeSdp(int num_contents, int num_layers) {
+  std::ostringstream os;
+  os << "v=0\r\n"
+     << "o=- 18446744069414584320 18446462598732840960 IN IP4 127.0.0.1\r\n"
+     << "s=-\r\n"
+     << "t=0 0\r\n"
+     << "a=group:BUNDLE";
+  for (int i = 0; i < num_contents; ++i)
+    os << " video_" << i;
+  os << "\r\n"
+     << "a=msid-semantic: WMS";
+  for (int i = 0; i < num_contents; ++i)
+    os << " stream_" << i;
+  os << "\r\n";
+
+  uint32 ssrc = 1000;
+  for (int i = 0; i < num_contents; ++i) {
+    os << "m=video 9 RTP/SAVPF 100 116\r\n"
+       << "c=IN IP4 0.0.0.0\r\n"
+       << "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+       << "a=ice-ufrag:ufrag_video\r\n"
+       << "a=ice-pwd:pwd_video_0123456789ab\r\n"
+       << "a=mid:video_" << i << "\r\n"
+       << "a=sendrecv\r\n"
+       << "a=rtcp-mux\r\n"
+       << "a=crypto:1 AES_CM_128_HMAC_SHA1_80 "
+       << "inline:d0RmdmcmVCspeEc3QGZiNWpVLFJhQX1cfHAwJSoj|2^20|1:32\r\n"
+       << "a=rtpmap:100 VP8/90000\r\n"
+       << "a=rtcp-fb:100 nack\r\n"
+       << "a=rtcp-fb:100 nack pli\r\n"
+       << "a=rtcp-fb:100 goog-remb\r\n"
+       << "a=rtpmap:116 red/90000\r\n";
+    const uint32 first_ssrc = ssrc;
+    os << "a=ssrc-group:SIM";
+    for (int j = 0; j < num_layers; ++j)
+      os << " " << first_ssrc + 2 * j;
+    os << "\r\n";
+    for (int j = 0; j < num_layers; ++j) {
+      os << "a=ssrc-group:FID " << first_ssrc + 2 * j << " "
+         << first_ssrc + 2 * j + 1 << "\r\n";
+    }
+    for (int j = 0; j < 2 * num_layers; ++j, ++ssrc) {
+      os << "a=ssrc:" << ssrc << " cname:cname_" << i << "\r\n"
+         << "a=ssrc:" << ssrc << " msid:stream_" << i << " track_" << i
+         << "\r\n"
+         << "a=ssrc:" << ssrc << " mslabel:stream_" << i << "\r\n"
+         << "a=ssrc:" << ssrc << " label:track_" << i << "\r\n";
+    }
+  }
+  return os.str();
+}
+
+static void MeasureParseAndSerialize(int num_contents, int num_layers) {
+  const std::string sdp = CreateLargeSdp(num_contents, num_layers);
+
+  int parse_allocations = g_allocations;
+  uint64 parse_start = rtc::TimeMicros();
+  for (int i = 0; i < kIterations; ++i) {
+    JsepSessionDescription desc(JsepSessionDescription::kOffer);
+    SdpParseError error;
+    ASSERT_TRUE(SdpDeserialize(sdp, &desc, &error)) << error.description;
+  }
+  uint64 parse_elapsed = rtc::TimeMicros() - parse_start;
+  parse_allocations = g_allocations - parse_allocations;
+
+  JsepSessionDescription desc(JsepSessionDescription::kOffer);
+  ASSERT_TRUE(SdpDeserialize(sdp, &desc, NULL));
+  std::string serialized;
+  int serialize_allocations = g_allocations;
+  uint64 serialize_start = rtc::TimeMicros();
+  for (int i = 0; i < kIterations; ++i) {
+    serialized = SdpSerialize(desc);
+  }
+  uint64 serialize_elapsed = rtc::TimeMicros() - serialize_start;
+  serialize_allocations = g_allocations - serialize_allocations;
+
+  // The output must describe the same session.
+  JsepSessionDescription round_trip(JsepSessionDescription::kOffer);
+  ASSERT_TRUE(SdpDeserialize(serialized, &round_trip, NULL));
+  EXPECT_EQ(serialized, SdpSerialize(round_trip));
+
+  LOG(LS_INFO) << num_contents << " m-lines with " << 2 * num_layers
+               << " ssrcs each, " << sdp.size() << " bytes: "
+               << "parse " << parse_elapsed / kIterations << " us, "
+               << parse_allocations / kIterations << " allocations; "
+               << "serialize " << serialize_elapsed / kIterations
+               << " us, " << serialize_allocations / kIterations
+               << " allocations";
+}
+
+TEST(WebRtcSdpPerfTest, SingleStream) {
+  MeasureParseAndSerialize(1, 1);
+}
+
+TEST(WebRtcSdpPerfTest, Simulcast) {
+  MeasureParseAndSerialize(10, 3);
+}
+
+TEST(WebRtcSdpPerfTest, ManyStreams) {
+  MeasureParseAndSerialize(200, 3);
+}
+
+}  // namespace webrtc
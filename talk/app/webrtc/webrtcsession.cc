@@ -481,6 +481,7 @@ WebRtcSession::WebRtcSession(cricket::ChannelManager* channel_manager,
       ice_connection_state_(PeerConnectionInterface::kIceConnectionNew),
       older_version_remote_peer_(false),
       dtls_enabled_(false),
+      identity_pool_(NULL),
       data_channel_type_(cricket::DCT_NONE),
       ice_restart_latch_(new IceRestartAnswerLatch),
       metrics_observer_(NULL) {
@@ -542,11 +543,23 @@ bool WebRtcSession::Initialize(
     mediastream_signaling_->SetDataChannelFactory(this);
   }
 
+  // ECDSA identities are much cheaper to generate than RSA ones, but not all
+  // peers support them yet.
+  rtc::KeyType key_type = rtc::KT_DEFAULT;
+  if (FindConstraint(
+      constraints, MediaConstraintsInterface::kEnableDtlsEcdsa,
+      &value, NULL) && value) {
+    LOG(LS_INFO) << "Using an ECDSA DTLS identity.";
+    key_type = rtc::KT_ECDSA;
+  }
+
   webrtc_session_desc_factory_.reset(new WebRtcSessionDescriptionFactory(
       signaling_thread(),
       channel_manager_,
       mediastream_signaling_,
       dtls_identity_service,
+      identity_pool_,
+      key_type,
       this,
       id(),
       data_channel_type_,
@@ -50,6 +50,10 @@ class Transport;
 
 }  // namespace cricket
 
+namespace rtc {
+class SSLIdentityPool;
+}  // namespace rtc
+
 namespace webrtc {
 
 class IceRestartAnswerLatch;
@@ -120,6 +124,13 @@ class WebRtcSession : public cricket::BaseSession,
     ice_observer_ = observer;
   }
 
+  // Makes the session take its DTLS identity from |pool| when there is no
+  // identity service. Must be called before Initialize(), and |pool| must
+  // outlive the session.
+  void set_identity_pool(rtc::SSLIdentityPool* pool) {
+    identity_pool_ = pool;
+  }
+
   virtual cricket::DataChannel* data_channel() {
     return data_channel_.get();
   }
@@ -301,6 +312,7 @@ class WebRtcSession : public cricket::BaseSession,
   // If the remote peer is using a older version of implementation.
   bool older_version_remote_peer_;
   bool dtls_enabled_;
+  rtc::SSLIdentityPool* identity_pool_;
   // Specifies which kind of data channel is allowed. This is controlled
   // by the chrome command-line flag and constraints:
   // 1. If chrome command-line switch 'enable-sctp-data-channels' is enabled,
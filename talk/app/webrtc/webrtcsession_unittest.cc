@@ -53,6 +53,7 @@
 #include "webrtc/base/network.h"
 #include "webrtc/base/physicalsocketserver.h"
 #include "webrtc/base/ssladapter.h"
+#include "webrtc/base/sslidentitypool.h"
 #include "webrtc/base/sslstreamadapter.h"
 #include "webrtc/base/stringutils.h"
 #include "webrtc/base/thread.h"
@@ -375,6 +376,7 @@ class WebRtcSessionTest : public testing::Test {
         rtc::Thread::Current(), allocator_.get(),
         &observer_,
         &mediastream_signaling_));
+    session_->set_identity_pool(identity_pool_.get());
 
     EXPECT_EQ(PeerConnectionInterface::kIceConnectionNew,
         observer_.ice_connection_state_);
@@ -1234,6 +1236,7 @@ class WebRtcSessionTest : public testing::Test {
   PeerConnectionFactoryInterface::Options options_;
   rtc::scoped_ptr<FakeConstraints> constraints_;
   FakeMediaStreamSignaling mediastream_signaling_;
+  rtc::scoped_ptr<rtc::SSLIdentityPool> identity_pool_;
   rtc::scoped_ptr<WebRtcSessionForTest> session_;
   MockIceObserver observer_;
   cricket::FakeVideoMediaChannel* video_channel_;
@@ -3397,6 +3400,31 @@ TEST_F(WebRtcSessionTest, TestCreateOfferAfterIdentityRequestReturnFailure) {
   EXPECT_TRUE(offer == NULL);
 }
 
+// Verifies that the ECDSA constraint selects the key type of the identity,
+// which is taken from the identity pool when one is ready.
+TEST_F(WebRtcSessionTest, TestDtlsEcdsaIdentityFromPool) {
+  MAYBE_SKIP_TEST(rtc::SSLStreamAdapter::HaveDtlsSrtp);
+  identity_pool_.reset(new rtc::SSLIdentityPool(kWebRTCIdentityName, 1));
+  delete identity_pool_->Take(rtc::KT_ECDSA);
+  EXPECT_EQ_WAIT(1U, identity_pool_->ready_count(rtc::KT_ECDSA), 10000);
+
+  constraints_.reset(new FakeConstraints());
+  constraints_->AddOptional(
+      webrtc::MediaConstraintsInterface::kEnableDtlsSrtp, true);
+  constraints_->AddOptional(
+      webrtc::MediaConstraintsInterface::kEnableDtlsEcdsa, true);
+  Init(NULL);
+
+  EXPECT_TRUE_WAIT(!session_->waiting_for_identity(), 1000);
+  ASSERT_TRUE(session_->identity() != NULL);
+  std::string digest_algorithm;
+  ASSERT_TRUE(session_->identity()->certificate().GetSignatureDigestAlgorithm(
+      &digest_algorithm));
+  EXPECT_EQ(rtc::DIGEST_SHA_256, digest_algorithm);
+  rtc::scoped_ptr<SessionDescriptionInterface> offer(CreateOffer());
+  EXPECT_TRUE(offer != NULL);
+}
+
 // Verifies that CreateOffer succeeds when Multiple CreateOffer calls are made
 // before async identity generation is finished.
 TEST_F(WebRtcSessionTest,
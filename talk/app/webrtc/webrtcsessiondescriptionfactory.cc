@@ -32,6 +32,7 @@
 #include "talk/app/webrtc/mediaconstraintsinterface.h"
 #include "talk/app/webrtc/mediastreamsignaling.h"
 #include "talk/app/webrtc/webrtcsession.h"
+#include "webrtc/base/sslidentitypool.h"
 
 using cricket::MediaSessionOptions;
 
@@ -40,10 +41,6 @@ namespace {
 static const char kFailedDueToIdentityFailed[] =
     " failed because DTLS identity request failed";
 
-// Arbitrary constant used as common name for the identity.
-// Chosen to make the certificates more readable.
-static const char kWebRTCIdentityName[] = "WebRTC";
-
 static const uint64 kInitSessionVersion = 2;
 
 static bool CompareStream(const MediaSessionOptions::Stream& stream1,
@@ -84,6 +81,10 @@ struct CreateSessionDescriptionMsg : public rtc::MessageData {
 };
 }  // namespace
 
+// Arbitrary constant used as common name for the identity.
+// Chosen to make the certificates more readable.
+const char kWebRTCIdentityName[] = "WebRTC";
+
 // static
 void WebRtcSessionDescriptionFactory::CopyCandidatesFromSessionDescription(
     const SessionDescriptionInterface* source_desc,
@@ -108,6 +109,8 @@ WebRtcSessionDescriptionFactory::WebRtcSessionDescriptionFactory(
     cricket::ChannelManager* channel_manager,
     MediaStreamSignaling* mediastream_signaling,
     DTLSIdentityServiceInterface* dtls_identity_service,
+    rtc::SSLIdentityPool* identity_pool,
+    rtc::KeyType key_type,
     WebRtcSession* session,
     const std::string& session_id,
     cricket::DataChannelType dct,
@@ -121,6 +124,8 @@ WebRtcSessionDescriptionFactory::WebRtcSessionDescriptionFactory(
       // |kInitSessionVersion|.
       session_version_(kInitSessionVersion),
       identity_service_(dtls_identity_service),
+      identity_pool_(identity_pool),
+      key_type_(key_type),
       session_(session),
       session_id_(session_id),
       data_channel_type_(dct),
@@ -289,8 +294,15 @@ void WebRtcSessionDescriptionFactory::OnMessage(rtc::Message* msg) {
       break;
     }
     case MSG_GENERATE_IDENTITY: {
-      LOG(LS_INFO) << "Generating identity.";
-      SetIdentity(rtc::SSLIdentity::Generate(kWebRTCIdentityName));
+      rtc::SSLIdentity* identity =
+          identity_pool_ ? identity_pool_->Take(key_type_) : NULL;
+      if (identity) {
+        LOG(LS_INFO) << "Using a pre-generated identity.";
+      } else {
+        LOG(LS_INFO) << "Generating identity.";
+        identity = rtc::SSLIdentity::Generate(kWebRTCIdentityName, key_type_);
+      }
+      SetIdentity(identity);
       break;
     }
     default:
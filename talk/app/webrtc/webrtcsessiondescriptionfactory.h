@@ -28,16 +28,23 @@
 #ifndef TALK_APP_WEBRTC_WEBRTCSESSIONDESCRIPTIONFACTORY_H_
 #define TALK_APP_WEBRTC_WEBRTCSESSIONDESCRIPTIONFACTORY_H_
 
+#include <queue>
+
 #include "talk/app/webrtc/peerconnectioninterface.h"
 #include "webrtc/p2p/base/transportdescriptionfactory.h"
 #include "talk/session/media/mediasession.h"
 #include "webrtc/base/messagehandler.h"
+#include "webrtc/base/sslidentity.h"
 
 namespace cricket {
 class ChannelManager;
 class TransportDescriptionFactory;
 }  // namespace cricket
 
+namespace rtc {
+class SSLIdentityPool;
+}  // namespace rtc
+
 namespace webrtc {
 class CreateSessionDescriptionObserver;
 class MediaConstraintsInterface;
@@ -45,6 +52,9 @@ class MediaStreamSignaling;
 class SessionDescriptionInterface;
 class WebRtcSession;
 
+// Common name of the DTLS identities generated for sessions.
+extern const char kWebRTCIdentityName[];
+
 // DTLS identity request callback class.
 class WebRtcIdentityRequestObserver : public DTLSIdentityRequestObserver,
                                       public sigslot::has_slots<> {
@@ -86,6 +96,9 @@ struct CreateSessionDescriptionRequest {
 // It queues the create offer/answer request until the DTLS identity
 // request has completed, i.e. when OnIdentityRequestFailed or OnIdentityReady
 // is called.
+// Without a |dtls_identity_service|, the identity is taken from
+// |identity_pool| if it has one with a |key_type| key pair ready, and generated
+// otherwise.
 class WebRtcSessionDescriptionFactory : public rtc::MessageHandler,
                                         public sigslot::has_slots<>  {
  public:
@@ -94,6 +107,8 @@ class WebRtcSessionDescriptionFactory : public rtc::MessageHandler,
       cricket::ChannelManager* channel_manager,
       MediaStreamSignaling* mediastream_signaling,
       DTLSIdentityServiceInterface* dtls_identity_service,
+      rtc::SSLIdentityPool* identity_pool,
+      rtc::KeyType key_type,
       // TODO(jiayl): remove the dependency on session once b/10226852 is fixed.
       WebRtcSession* session,
       const std::string& session_id,
@@ -155,6 +170,8 @@ class WebRtcSessionDescriptionFactory : public rtc::MessageHandler,
   cricket::MediaSessionDescriptionFactory session_desc_factory_;
   uint64 session_version_;
   rtc::scoped_ptr<DTLSIdentityServiceInterface> identity_service_;
+  rtc::SSLIdentityPool* identity_pool_;
+  rtc::KeyType key_type_;
   rtc::scoped_refptr<WebRtcIdentityRequestObserver>
       identity_request_observer_;
   WebRtcSession* session_;
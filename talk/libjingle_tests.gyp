@@ -249,6 +249,20 @@
         }],
       ],
     },  # target libjingle_peerconnection_unittest
+    {
+      'target_name': 'webrtcsdp_perftest',
+      'type': 'executable',
+      'dependencies': [
+        '<(webrtc_root)/base/base_tests.gyp:rtc_base_tests_utils',
+        'libjingle.gyp:libjingle',
+        'libjingle.gyp:libjingle_p2p',
+        'libjingle.gyp:libjingle_peerconnection',
+        'libjingle_unittest_main',
+      ],
+      'sources': [
+        'app/webrtc/webrtcsdp_perftest.cc',
+      ],
+    },  # target webrtcsdp_perftest
   ],
   'conditions': [
     ['OS=="linux"', {
@@ -713,6 +713,10 @@ struct SendDataParams {
   // resending for up to this many milliseconds.  Either count or millis
   // is supported, not both at the same time.
   int max_rtx_ms;
+  // For SCTP, whether more fragments of the message follow. Fragments are
+  // sent with the PARTIAL PPIDs and reassembled by the receiver, so they have
+  // to be sent ordered, and only to a receiver known to reassemble them.
+  bool partial;
 
   SendDataParams() :
       ssrc(0),
@@ -721,7 +725,8 @@ struct SendDataParams {
       ordered(false),
       reliable(false),
       max_rtx_count(0),
-      max_rtx_ms(0) {
+      max_rtx_ms(0),
+      partial(false) {
   }
 };
 
@@ -102,24 +102,22 @@ std::string ListArray(const uint16* array, int num_elems) {
 }  // namespace
 
 namespace cricket {
-typedef rtc::ScopedMessageData<SctpInboundPacket> InboundPacketMessage;
-typedef rtc::ScopedMessageData<rtc::Buffer> OutboundPacketMessage;
-
 // The biggest SCTP packet.  Starting from a 'safe' wire MTU value of 1280,
 // take off 80 bytes for DTLS/TURN/TCP/IP overhead.
 static const size_t kSctpMtu = 1200;
 
-enum {
-  MSG_SCTPINBOUNDPACKET = 1,   // MessageData is SctpInboundPacket
-  MSG_SCTPOUTBOUNDPACKET = 2,  // MessageData is rtc:Buffer
-};
+// The most sent packet buffers a channel keeps for reuse.
+static const size_t kMaxFreeBuffers = 128;
+
+// The largest message reassembled from fragments with PARTIAL PPIDs. Matches
+// the most received data a DataChannel queues.
+static const size_t kMaxReassembledMessageSize = 16 * 1024 * 1024;
 
-struct SctpInboundPacket {
-  rtc::Buffer buffer;
-  ReceiveDataParams params;
-  // The |flags| parameter is used by SCTP to distinguish notification packets
-  // from other types of packets.
-  int flags;
+enum {
+  // No MessageData; the packets are in pending_inbound_packets_.
+  MSG_SCTPINBOUNDPACKET = 1,
+  // No MessageData; the packets are in pending_outbound_packets_.
+  MSG_SCTPOUTBOUNDPACKET = 2,
 };
 
 // Helper for logging SCTP messages.
@@ -132,9 +130,10 @@ static void debug_sctp_printf(const char *format, ...) {
   va_end(ap);
 }
 
-// Get the PPID to use for the terminating fragment of this type.
+// Get the PPID to use for a fragment of this type; |partial| if more
+// fragments follow.
 static SctpDataMediaChannel::PayloadProtocolIdentifier GetPpid(
-    cricket::DataMessageType type) {
+    cricket::DataMessageType type, bool partial) {
   switch (type) {
   default:
   case cricket::DMT_NONE:
@@ -142,9 +141,11 @@ static SctpDataMediaChannel::PayloadProtocolIdentifier GetPpid(
   case cricket::DMT_CONTROL:
     return SctpDataMediaChannel::PPID_CONTROL;
   case cricket::DMT_BINARY:
-    return SctpDataMediaChannel::PPID_BINARY_LAST;
+    return partial ? SctpDataMediaChannel::PPID_BINARY_PARTIAL
+                   : SctpDataMediaChannel::PPID_BINARY_LAST;
   case cricket::DMT_TEXT:
-    return SctpDataMediaChannel::PPID_TEXT_LAST;
+    return partial ? SctpDataMediaChannel::PPID_TEXT_PARTIAL
+                   : SctpDataMediaChannel::PPID_TEXT_LAST;
   };
 }
 
@@ -186,9 +187,7 @@ static int OnSctpOutboundPacket(void* addr, void* data, size_t length,
                   << "; tos: " << std::hex << static_cast<int>(tos)
                   << "; set_df: " << std::hex << static_cast<int>(set_df);
   // Note: We have to copy the data; the caller will delete it.
-  OutboundPacketMessage* msg =
-      new OutboundPacketMessage(new rtc::Buffer(data, length));
-  channel->worker_thread()->Post(channel, MSG_SCTPOUTBOUNDPACKET, msg);
+  channel->QueueOutboundPacket(data, length);
   return 0;
 }
 
@@ -201,9 +200,7 @@ static int OnSctpInboundPacket(struct socket* sock, union sctp_sockstore addr,
                                struct sctp_rcvinfo rcv, int flags,
                                void* ulp_info) {
   SctpDataMediaChannel* channel = static_cast<SctpDataMediaChannel*>(ulp_info);
-  // Post data to the channel's receiver thread (copying it).
-  // TODO(ldixon): Unclear if copy is needed as this method is responsible for
-  // memory cleanup. But this does simplify code.
+  // Hand the data over to the channel's receiver thread, which frees it.
   const SctpDataMediaChannel::PayloadProtocolIdentifier ppid =
       static_cast<SctpDataMediaChannel::PayloadProtocolIdentifier>(
           rtc::HostToNetwork32(rcv.rcv_ppid));
@@ -212,19 +209,21 @@ static int OnSctpInboundPacket(struct socket* sock, union sctp_sockstore addr,
     // It's neither a notification nor a recognized data packet.  Drop it.
     LOG(LS_ERROR) << "Received an unknown PPID " << ppid
                   << " on an SCTP packet.  Dropping.";
+    free(data);
   } else {
-    SctpInboundPacket* packet = new SctpInboundPacket;
-    packet->buffer.SetData(data, length);
-    packet->params.ssrc = rcv.rcv_sid;
-    packet->params.seq_num = rcv.rcv_ssn;
-    packet->params.timestamp = rcv.rcv_tsn;
-    packet->params.type = type;
-    packet->flags = flags;
-    // The ownership of |packet| transfers to |msg|.
-    InboundPacketMessage* msg = new InboundPacketMessage(packet);
-    channel->worker_thread()->Post(channel, MSG_SCTPINBOUNDPACKET, msg);
-  }
-  free(data);
+    SctpInboundPacket packet;
+    packet.data = data;
+    packet.length = length;
+    packet.params.ssrc = rcv.rcv_sid;
+    packet.params.seq_num = rcv.rcv_ssn;
+    packet.params.timestamp = rcv.rcv_tsn;
+    packet.params.type = type;
+    packet.partial = ppid == SctpDataMediaChannel::PPID_BINARY_PARTIAL ||
+                     ppid == SctpDataMediaChannel::PPID_TEXT_PARTIAL;
+    packet.flags = flags;
+    // The ownership of |data| transfers to |channel|.
+    channel->QueueInboundPacket(packet);
+  }
   return 1;
 }
 
@@ -306,6 +305,8 @@ SctpDataMediaChannel::SctpDataMediaChannel(rtc::Thread* thread)
       local_port_(kSctpDefaultPort),
       remote_port_(kSctpDefaultPort),
       sock_(NULL),
+      send_buffer_size_(kSctpDefaultSendBufferSize),
+      recv_buffer_size_(kSctpDefaultRecvBufferSize),
       sending_(false),
       receiving_(false),
       debug_name_("SctpDataMediaChannel") {
@@ -313,6 +314,116 @@ SctpDataMediaChannel::SctpDataMediaChannel(rtc::Thread* thread)
 
 SctpDataMediaChannel::~SctpDataMediaChannel() {
   CloseSctpSocket();
+  // usrsctp does not call back for this channel any more, and the messages
+  // for the packets below are cleared by ~MessageHandler.
+  for (size_t i = 0; i < pending_outbound_packets_.size(); ++i) {
+    delete pending_outbound_packets_[i];
+  }
+  for (size_t i = 0; i < free_buffers_.size(); ++i) {
+    delete free_buffers_[i];
+  }
+  for (size_t i = 0; i < pending_inbound_packets_.size(); ++i) {
+    free(pending_inbound_packets_[i].data);
+  }
+}
+
+void SctpDataMediaChannel::QueueOutboundPacket(const void* data,
+                                               size_t length) {
+  bool post;
+  {
+    rtc::CritScope cs(&packets_crit_);
+    rtc::Buffer* buffer;
+    if (free_buffers_.empty()) {
+      buffer = new rtc::Buffer(NULL, 0, kSctpMtu);
+    } else {
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+    buffer->SetData(data, length);
+    pending_outbound_packets_.push_back(buffer);
+    post = pending_outbound_packets_.size() == 1;
+  }
+  if (post) {
+    worker_thread_->Post(this, MSG_SCTPOUTBOUNDPACKET);
+  }
+}
+
+void SctpDataMediaChannel::QueueInboundPacket(
+    const SctpInboundPacket& packet) {
+  bool post;
+  {
+    rtc::CritScope cs(&packets_crit_);
+    pending_inbound_packets_.push_back(packet);
+    post = pending_inbound_packets_.size() == 1;
+  }
+  if (post) {
+    worker_thread_->Post(this, MSG_SCTPINBOUNDPACKET);
+  }
+}
+
+void SctpDataMediaChannel::SendOutboundPackets() {
+  // The batch is taken out of the queue, so that packets queued while it is
+  // sent start a new one.
+  std::vector<rtc::Buffer*> batch;
+  {
+    rtc::CritScope cs(&packets_crit_);
+    batch.swap(pending_outbound_packets_);
+  }
+  for (size_t i = 0; i < batch.size(); ++i) {
+    OnPacketFromSctpToNetwork(batch[i]);
+  }
+
+  rtc::CritScope cs(&packets_crit_);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (free_buffers_.size() < kMaxFreeBuffers) {
+      free_buffers_.push_back(batch[i]);
+    } else {
+      delete batch[i];
+    }
+  }
+  // Give the capacity back to the queue, unless a new batch has started.
+  if (pending_outbound_packets_.empty()) {
+    batch.clear();
+    pending_outbound_packets_.swap(batch);
+  }
+}
+
+void SctpDataMediaChannel::DeliverInboundPackets() {
+  std::vector<SctpInboundPacket> batch;
+  {
+    rtc::CritScope cs(&packets_crit_);
+    batch.swap(pending_inbound_packets_);
+  }
+  for (size_t i = 0; i < batch.size(); ++i) {
+    OnInboundPacketFromSctpToChannel(&batch[i]);
+    free(batch[i].data);
+  }
+
+  rtc::CritScope cs(&packets_crit_);
+  if (pending_inbound_packets_.empty()) {
+    batch.clear();
+    pending_inbound_packets_.swap(batch);
+  }
+}
+
+bool SctpDataMediaChannel::SetSendBufferSize(int size) {
+  send_buffer_size_ = size;
+  return !sock_ || SetSocketBufferSize(SO_SNDBUF, size);
+}
+
+bool SctpDataMediaChannel::SetRecvBufferSize(int size) {
+  recv_buffer_size_ = size;
+  return !sock_ || SetSocketBufferSize(SO_RCVBUF, size);
+}
+
+bool SctpDataMediaChannel::SetSocketBufferSize(int option, int size) {
+  if (usrsctp_setsockopt(sock_, SOL_SOCKET, option, &size, sizeof(size))) {
+    LOG_ERRNO(LS_ERROR) << debug_name_ << "Failed to set "
+                        << (option == SO_SNDBUF ? "SO_SNDBUF" : "SO_RCVBUF")
+                        << " to " << size;
+    return false;
+  }
+  return true;
 }
 
 sockaddr_conn SctpDataMediaChannel::GetSctpSockAddr(int port) {
@@ -359,6 +470,13 @@ bool SctpDataMediaChannel::OpenSctpSocket() {
     return false;
   }
 
+  // The receive buffer has to be sized before connecting, as it is the window
+  // advertised in the INIT chunk.
+  if (!SetSocketBufferSize(SO_SNDBUF, send_buffer_size_) ||
+      !SetSocketBufferSize(SO_RCVBUF, recv_buffer_size_)) {
+    return false;
+  }
+
   // Enable stream ID resets.
   struct sctp_assoc_value stream_rst;
   stream_rst.assoc_id = SCTP_ALL_ASSOC;
@@ -543,7 +661,7 @@ bool SctpDataMediaChannel::SendData(
   spa.sendv_flags |= SCTP_SEND_SNDINFO_VALID;
   spa.sendv_sndinfo.snd_sid = params.ssrc;
   spa.sendv_sndinfo.snd_ppid = rtc::HostToNetwork32(
-      GetPpid(params.type));
+      GetPpid(params.type, params.partial));
 
   // Ordered implies reliable.
   if (!params.ordered) {
@@ -609,34 +727,71 @@ void SctpDataMediaChannel::OnInboundPacketFromSctpToChannel(
                   << "Received SCTP data:"
                   << " ssrc=" << packet->params.ssrc
                   << " notification: " << (packet->flags & MSG_NOTIFICATION)
-                  << " length=" << packet->buffer.length();
+                  << " length=" << packet->length;
   // Sending a packet with data == NULL (no data) is SCTPs "close the
   // connection" message. This sets sock_ = NULL;
-  if (!packet->buffer.length() || !packet->buffer.data()) {
+  if (!packet->length || !packet->data) {
     LOG(LS_INFO) << debug_name_ << "->OnInboundPacketFromSctpToChannel(...): "
                                    "No data, closing.";
     return;
   }
+  const char* data = static_cast<const char*>(packet->data);
   if (packet->flags & MSG_NOTIFICATION) {
-    OnNotificationFromSctp(&packet->buffer);
+    OnNotificationFromSctp(data, packet->length);
+  } else if (packet->partial ||
+             partial_messages_.find(packet->params.ssrc) !=
+                 partial_messages_.end() ||
+             discarded_streams_.find(packet->params.ssrc) !=
+                 discarded_streams_.end()) {
+    OnFragmentFromSctpToChannel(*packet);
   } else {
-    OnDataFromSctpToChannel(packet->params, &packet->buffer);
+    OnDataFromSctpToChannel(packet->params, data, packet->length);
+  }
+}
+
+void SctpDataMediaChannel::OnFragmentFromSctpToChannel(
+    const SctpInboundPacket& packet) {
+  const uint32 sid = packet.params.ssrc;
+  // The rest of a message that was too large is dropped.
+  StreamSet::iterator discarded = discarded_streams_.find(sid);
+  if (discarded != discarded_streams_.end()) {
+    if (!packet.partial) {
+      discarded_streams_.erase(discarded);
+    }
+    return;
+  }
+
+  rtc::Buffer& message = partial_messages_[sid];
+  if (message.length() + packet.length > kMaxReassembledMessageSize) {
+    LOG(LS_ERROR) << debug_name_ << "->OnFragmentFromSctpToChannel(...): "
+                  << "Dropping a message larger than "
+                  << kMaxReassembledMessageSize << " bytes on stream " << sid;
+    partial_messages_.erase(sid);
+    if (packet.partial) {
+      discarded_streams_.insert(sid);
+    }
+    return;
+  }
+  message.AppendData(packet.data, packet.length);
+  if (!packet.partial) {
+    OnDataFromSctpToChannel(packet.params, message.data(), message.length());
+    partial_messages_.erase(sid);
   }
 }
 
 void SctpDataMediaChannel::OnDataFromSctpToChannel(
-    const ReceiveDataParams& params, rtc::Buffer* buffer) {
+    const ReceiveDataParams& params, const char* data, size_t length) {
   if (receiving_) {
     LOG(LS_VERBOSE) << debug_name_ << "->OnDataFromSctpToChannel(...): "
-                    << "Posting with length: " << buffer->length()
+                    << "Posting with length: " << length
                     << " on stream " << params.ssrc;
     // Reports all received messages to upper layers, no matter whether the sid
     // is known.
-    SignalDataReceived(params, buffer->data(), buffer->length());
+    SignalDataReceived(params, data, length);
   } else {
     LOG(LS_WARNING) << debug_name_ << "->OnDataFromSctpToChannel(...): "
                     << "Not receiving packet with sid=" << params.ssrc
-                    << " len=" <<  buffer->length()
+                    << " len=" <<  length
                     << " before SetReceive(true).";
   }
 }
@@ -694,10 +849,11 @@ bool SctpDataMediaChannel::ResetStream(uint32 ssrc) {
   return true;
 }
 
-void SctpDataMediaChannel::OnNotificationFromSctp(rtc::Buffer* buffer) {
+void SctpDataMediaChannel::OnNotificationFromSctp(const char* data,
+                                                  size_t length) {
   const sctp_notification& notification =
-      reinterpret_cast<const sctp_notification&>(*buffer->data());
-  ASSERT(notification.sn_header.sn_length == buffer->length());
+      reinterpret_cast<const sctp_notification&>(*data);
+  ASSERT(notification.sn_header.sn_length == length);
 
   // TODO(ldixon): handle notifications appropriately.
   switch (notification.sn_header.sn_type) {
@@ -829,6 +985,8 @@ void SctpDataMediaChannel::OnStreamResetEvent(
         LOG(LS_VERBOSE) << "SCTP_STREAM_RESET_EVENT(" << debug_name_
                         << "): closing sid " << stream_id;
         open_streams_.erase(it);
+        partial_messages_.erase(stream_id);
+        discarded_streams_.erase(stream_id);
         SignalStreamClosedRemotely(stream_id);
 
       } else if ((it = queued_reset_streams_.find(stream_id))
@@ -941,18 +1099,12 @@ bool SctpDataMediaChannel::SendQueuedStreamResets() {
 
 void SctpDataMediaChannel::OnMessage(rtc::Message* msg) {
   switch (msg->message_id) {
-    case MSG_SCTPINBOUNDPACKET: {
-      rtc::scoped_ptr<InboundPacketMessage> pdata(
-          static_cast<InboundPacketMessage*>(msg->pdata));
-      OnInboundPacketFromSctpToChannel(pdata->data().get());
+    case MSG_SCTPINBOUNDPACKET:
+      DeliverInboundPackets();
       break;
-    }
-    case MSG_SCTPOUTBOUNDPACKET: {
-      rtc::scoped_ptr<OutboundPacketMessage> pdata(
-          static_cast<OutboundPacketMessage*>(msg->pdata));
-      OnPacketFromSctpToNetwork(pdata->data().get());
+    case MSG_SCTPOUTBOUNDPACKET:
+      SendOutboundPackets();
       break;
-    }
   }
 }
 }  // namespace cricket
@@ -29,6 +29,7 @@
 #define TALK_MEDIA_SCTP_SCTPDATAENGINE_H_
 
 #include <errno.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -45,6 +46,7 @@ enum PreservedErrno {
 #include "talk/media/base/mediachannel.h"
 #include "talk/media/base/mediaengine.h"
 #include "webrtc/base/buffer.h"
+#include "webrtc/base/criticalsection.h"
 #include "webrtc/base/scoped_ptr.h"
 
 // Defined by "usrsctplib/usrsctp.h"
@@ -64,6 +66,13 @@ const uint32 kMaxSctpSid = 1023;
 // usrsctp.h)
 const int kSctpDefaultPort = 5000;
 
+// The default sizes of the usrsctp socket buffers, in bytes. The send buffer
+// bounds how much data SendData() queues before returning SDR_BLOCK, and the
+// receive buffer is the window advertised to the peer. Both limit the
+// throughput of bulk transfers to buffer size / round trip time.
+const int kSctpDefaultSendBufferSize = 256 * 1024;
+const int kSctpDefaultRecvBufferSize = 256 * 1024;
+
 // A DataEngine that interacts with usrsctp.
 //
 // From channel calls, data flows like this:
@@ -72,20 +81,24 @@ const int kSctpDefaultPort = 5000;
 //  2.  usrsctp_sendv(data)
 // [worker thread returns; sctp thread then calls the following]
 //  3.  OnSctpOutboundPacket(wrapped_data)
-// [sctp thread returns having posted a message for the worker thread]
-//  4.  SctpDataMediaChannel::OnMessage(wrapped_data)
-//  5.  SctpDataMediaChannel::OnPacketFromSctpToNetwork(wrapped_data)
-//  6.  NetworkInterface::SendPacket(wrapped_data)
-//  7.  ... across network ... a packet is sent back ...
-//  8.  SctpDataMediaChannel::OnPacketReceived(wrapped_data)
-//  9.  usrsctp_conninput(wrapped_data)
+//  4.  SctpDataMediaChannel::QueueOutboundPacket(wrapped_data)
+// [sctp thread returns having posted a message for the worker thread, unless
+//  one is already pending for earlier packets]
+//  5.  SctpDataMediaChannel::OnMessage()
+//  6.  SctpDataMediaChannel::OnPacketFromSctpToNetwork(wrapped_data)
+//  7.  NetworkInterface::SendPacket(wrapped_data)
+//  8.  ... across network ... a packet is sent back ...
+//  9.  SctpDataMediaChannel::OnPacketReceived(wrapped_data)
+//  10. usrsctp_conninput(wrapped_data)
 // [worker thread returns; sctp thread then calls the following]
-//  10.  OnSctpInboundData(data)
-// [sctp thread returns having posted a message fot the worker thread]
-//  11. SctpDataMediaChannel::OnMessage(inboundpacket)
-//  12. SctpDataMediaChannel::OnInboundPacketFromSctpToChannel(inboundpacket)
-//  13. SctpDataMediaChannel::OnDataFromSctpToChannel(data)
-//  14. SctpDataMediaChannel::SignalDataReceived(data)
+//  11. OnSctpInboundPacket(data)
+//  12. SctpDataMediaChannel::QueueInboundPacket(data)
+// [sctp thread returns having posted a message for the worker thread, unless
+//  one is already pending for earlier packets]
+//  13. SctpDataMediaChannel::OnMessage()
+//  14. SctpDataMediaChannel::OnInboundPacketFromSctpToChannel(inboundpacket)
+//  15. SctpDataMediaChannel::OnDataFromSctpToChannel(data)
+//  16. SctpDataMediaChannel::SignalDataReceived(data)
 // [from the same thread, methods registered/connected to
 //  SctpDataMediaChannel are called with the recieved data]
 class SctpDataEngine : public DataEngineInterface {
@@ -102,9 +115,20 @@ class SctpDataEngine : public DataEngineInterface {
   std::vector<DataCodec> codecs_;
 };
 
-// TODO(ldixon): Make into a special type of TypedMessageData.
 // Holds data to be passed on to a channel.
-struct SctpInboundPacket;
+struct SctpInboundPacket {
+  // Allocated by usrsctp and owned by the packet until it has been handled;
+  // released with free().
+  void* data;
+  size_t length;
+  ReceiveDataParams params;
+  // Whether more fragments of the message follow, as indicated by a PARTIAL
+  // PPID.
+  bool partial;
+  // The |flags| parameter is used by SCTP to distinguish notification packets
+  // from other types of packets.
+  int flags;
+};
 
 class SctpDataMediaChannel : public DataMediaChannel,
                              public rtc::MessageHandler {
@@ -163,6 +187,19 @@ class SctpDataMediaChannel : public DataMediaChannel,
   // Exposed to allow Post call from c-callbacks.
   rtc::Thread* worker_thread() const { return worker_thread_; }
 
+  // Called from the usrsctp thread to hand a packet over to the worker
+  // thread. Packets queued before the worker thread gets to them are handled
+  // in one batch. QueueOutboundPacket copies |data| into a pooled buffer;
+  // QueueInboundPacket takes ownership of |packet.data|.
+  void QueueOutboundPacket(const void* data, size_t length);
+  void QueueInboundPacket(const SctpInboundPacket& packet);
+
+  // Sets the size of the SCTP send or receive buffer. Applies to the open
+  // socket, if any, and to sockets opened later. The receive buffer size
+  // should be set before connecting, as it is advertised in the INIT chunk.
+  bool SetSendBufferSize(int size);
+  bool SetRecvBufferSize(int size);
+
   // TODO(ldixon): add a DataOptions class to mediachannel.h
   virtual bool SetOptions(int options) { return false; }
   virtual int GetOptions() const { return 0; }
@@ -202,6 +239,8 @@ class SctpDataMediaChannel : public DataMediaChannel,
   bool OpenSctpSocket();
   // Sets sending_ to false and sock_ to NULL.
   void CloseSctpSocket();
+  // Sets SO_SNDBUF or SO_RCVBUF on sock_.
+  bool SetSocketBufferSize(int option, int size);
 
   // Sends a SCTP_RESET_STREAM for all streams in closing_ssids_.
   bool SendQueuedStreamResets();
@@ -211,13 +250,18 @@ class SctpDataMediaChannel : public DataMediaChannel,
   // Queues a stream for reset.
   bool ResetStream(uint32 ssrc);
 
-  // Called by OnMessage to send packet on the network.
+  // Called by OnMessage to handle all packets queued so far.
+  void SendOutboundPackets();
+  void DeliverInboundPackets();
+  // Called by SendOutboundPackets to send packet on the network.
   void OnPacketFromSctpToNetwork(rtc::Buffer* buffer);
-  // Called by OnMessage to decide what to do with the packet.
+  // Called by DeliverInboundPackets to decide what to do with the packet.
   void OnInboundPacketFromSctpToChannel(SctpInboundPacket* packet);
+  // Reassembles messages sent in fragments with PARTIAL PPIDs.
+  void OnFragmentFromSctpToChannel(const SctpInboundPacket& packet);
   void OnDataFromSctpToChannel(const ReceiveDataParams& params,
-                               rtc::Buffer* buffer);
-  void OnNotificationFromSctp(rtc::Buffer* buffer);
+                               const char* data, size_t length);
+  void OnNotificationFromSctp(const char* data, size_t length);
   void OnNotificationAssocChange(const sctp_assoc_change& change);
 
   void OnStreamResetEvent(const struct sctp_stream_reset_event* evt);
@@ -232,6 +276,17 @@ class SctpDataMediaChannel : public DataMediaChannel,
   int local_port_;
   int remote_port_;
   struct socket* sock_;  // The socket created by usrsctp_socket(...).
+  int send_buffer_size_;
+  int recv_buffer_size_;
+
+  // Packets handed over between the usrsctp thread and the worker thread.
+  // Only the first packet of a batch posts a message; the worker thread
+  // takes the whole batch at once.
+  rtc::CriticalSection packets_crit_;
+  std::vector<rtc::Buffer*> pending_outbound_packets_;
+  std::vector<SctpInboundPacket> pending_inbound_packets_;
+  // Buffers of outbound packets that have been sent, for reuse.
+  std::vector<rtc::Buffer*> free_buffers_;
 
   // sending_ is true iff there is a connected socket.
   bool sending_;
@@ -249,6 +304,11 @@ class SctpDataMediaChannel : public DataMediaChannel,
   StreamSet queued_reset_streams_;
   StreamSet sent_reset_streams_;
 
+  // Messages being reassembled from fragments, by stream ID, and the streams
+  // on which the rest of a message that was too large is dropped.
+  std::map<uint32, rtc::Buffer> partial_messages_;
+  StreamSet discarded_streams_;
+
   // A human-readable name for debugging messages.
   std::string debug_name_;
 };
@@ -44,6 +44,7 @@
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/ssladapter.h"
 #include "webrtc/base/thread.h"
+#include "webrtc/base/timeutils.h"
 
 #ifdef HAVE_NSS_SSL_H
 // TODO(thorcarpenter): Remove after webrtc switches over to BoringSSL.
@@ -54,6 +55,12 @@ enum {
   MSG_PACKET = 1,
 };
 
+// Used by the throughput tests, which send 16 KB messages like file transfer
+// applications usually do.
+static const size_t kThroughputMessageSize = 16 * 1024;
+static const size_t kThroughputBytes = 16 * 1024 * 1024;
+static const int kThroughputTimeoutMs = 30000;
+
 // Fake NetworkInterface that sends/receives sctp packets.  The one in
 // talk/media/base/fakenetworkinterface.h only works with rtp/rtcp.
 class SctpFakeNetworkInterface : public cricket::MediaChannel::NetworkInterface,
@@ -149,6 +156,22 @@ class SctpFakeDataReceiver : public sigslot::has_slots<> {
   cricket::ReceiveDataParams last_params_;
 };
 
+// Only counts the received data, for throughput measurements.
+class SctpByteCounter : public sigslot::has_slots<> {
+ public:
+  SctpByteCounter() : bytes_(0) {}
+
+  void OnDataReceived(const cricket::ReceiveDataParams& params,
+                      const char* data, size_t length) {
+    bytes_ += length;
+  }
+
+  size_t bytes() const { return bytes_; }
+
+ private:
+  size_t bytes_;
+};
+
 class SignalReadyToSendObserver : public sigslot::has_slots<> {
  public:
   SignalReadyToSendObserver() : signaled_(false), writable_(false) {}
@@ -325,6 +348,61 @@ class SctpDataMediaChannelTest : public testing::Test,
     return !thread->IsQuitting();
   }
 
+  // Sends |message_size| byte messages on stream 1 until the send buffer is
+  // full, without letting any of them leave. Returns the number of bytes
+  // sent.
+  size_t FillSendBuffer(cricket::SctpDataMediaChannel* chan,
+                        size_t message_size) {
+    cricket::SendDataParams params;
+    params.ssrc = 1;
+    std::vector<char> buffer(message_size, 0);
+    rtc::Buffer payload(&buffer[0], buffer.size());
+    cricket::SendDataResult result;
+    size_t sent = 0;
+    while (chan->SendData(params, payload, &result)) {
+      sent += message_size;
+    }
+    EXPECT_EQ(cricket::SDR_BLOCK, result);
+    return sent;
+  }
+
+  // Sends |total_bytes| from channel 1 to channel 2 on stream 1 as fast as
+  // possible, and logs the rate.
+  void MeasureThroughput(const char* name, cricket::SendDataParams params,
+                         size_t message_size, size_t total_bytes) {
+    SctpByteCounter counter;
+    // The fake receiver copies every message.
+    channel2()->SignalDataReceived.disconnect(receiver2());
+    channel2()->SignalDataReceived.connect(
+        &counter, &SctpByteCounter::OnDataReceived);
+    params.ssrc = 1;
+    params.type = cricket::DMT_BINARY;
+    std::vector<char> buffer(message_size, 'x');
+    rtc::Buffer payload(&buffer[0], buffer.size());
+
+    rtc::Thread* thread = rtc::Thread::Current();
+    size_t sent = 0;
+    uint64 start = rtc::TimeMicros();
+    uint32 deadline = rtc::TimeAfter(kThroughputTimeoutMs);
+    while (counter.bytes() < total_bytes &&
+           rtc::TimeIsLater(rtc::Time(), deadline)) {
+      cricket::SendDataResult result;
+      while (sent < total_bytes &&
+             channel1()->SendData(params, payload, &result)) {
+        sent += message_size;
+      }
+      // Lets the packets through, and waits for usrsctp's timers if there are
+      // none.
+      thread->ProcessMessages(1);
+    }
+    uint64 elapsed = rtc::TimeMicros() - start;
+    ASSERT_EQ(total_bytes, counter.bytes());
+    LOG(LS_INFO) << name << ": " << total_bytes / message_size
+                 << " messages of " << message_size << " bytes in "
+                 << elapsed / 1000 << " ms, "
+                 << static_cast<double>(total_bytes) / elapsed << " MB/s";
+  }
+
   cricket::SctpDataMediaChannel* channel1() { return chan1_.get(); }
   cricket::SctpDataMediaChannel* channel2() { return chan2_.get(); }
   SctpFakeDataReceiver* receiver1() { return recv1_.get(); }
@@ -415,6 +493,70 @@ TEST_F(SctpDataMediaChannelTest, SendDataBlocked) {
   EXPECT_EQ(cricket::SDR_BLOCK, result);
 }
 
+// Fragments sent with PARTIAL PPIDs are received as one message.
+TEST_F(SctpDataMediaChannelTest, ReassemblesFragments) {
+  SetupConnectedChannels();
+  cricket::SendDataParams params;
+  params.ssrc = 1;
+  params.ordered = true;
+  params.partial = true;
+  cricket::SendDataResult result;
+  ASSERT_TRUE(channel1()->SendData(params, rtc::Buffer("hel", 3), &result));
+  ASSERT_TRUE(channel1()->SendData(params, rtc::Buffer("lo", 2), &result));
+  params.partial = false;
+  ASSERT_TRUE(channel1()->SendData(params, rtc::Buffer("?", 1), &result));
+  EXPECT_TRUE_WAIT(ReceivedData(receiver2(), 1, "hello?"), 1000);
+  EXPECT_EQ(cricket::DMT_TEXT, receiver2()->last_params().type);
+
+  // Unfragmented messages are not affected.
+  ASSERT_TRUE(SendData(channel1(), 1, "hi", &result));
+  EXPECT_TRUE_WAIT(ReceivedData(receiver2(), 1, "hi"), 1000);
+}
+
+// The send buffer size limits what SendData() queues, and can be changed on
+// an open channel.
+TEST_F(SctpDataMediaChannelTest, SendBufferSize) {
+  SetupConnectedChannels();
+  cricket::SendDataResult result;
+  ASSERT_TRUE(SendData(channel1(), 1, "hello?", &result));
+  EXPECT_TRUE_WAIT(ReceivedData(receiver2(), 1, "hello?"), 1000);
+
+  ASSERT_TRUE(channel1()->SetSendBufferSize(16 * 1024));
+  size_t sent = FillSendBuffer(channel1(), 1024);
+  EXPECT_GT(sent, 0U);
+  EXPECT_LE(sent, 16U * 1024);
+
+  ASSERT_TRUE(channel1()->SetSendBufferSize(64 * 1024));
+  sent += FillSendBuffer(channel1(), 1024);
+  EXPECT_GT(sent, 16U * 1024);
+  EXPECT_LE(sent, 64U * 1024);
+}
+
+// Measures the throughput of a reliable, ordered channel over the loopback
+// fake network.
+TEST_F(SctpDataMediaChannelTest, ThroughputReliableOrdered) {
+  SetupConnectedChannels();
+  cricket::SendDataParams params;
+  params.ordered = true;
+  params.reliable = true;
+  MeasureThroughput("Reliable ordered", params, kThroughputMessageSize,
+                    kThroughputBytes);
+}
+
+// Like ThroughputReliableOrdered, with messages sent unordered. Without
+// a retransmit count or time, like a DataChannel with neither maxRetransmits
+// nor maxRetransmitTime, the messages are still retransmitted until acked.
+TEST_F(SctpDataMediaChannelTest, ThroughputReliableUnordered) {
+  SetupConnectedChannels();
+  cricket::SendDataParams params;
+  params.ordered = false;
+  params.reliable = true;
+  params.max_rtx_count = -1;
+  params.max_rtx_ms = -1;
+  MeasureThroughput("Reliable unordered", params, kThroughputMessageSize,
+                    kThroughputBytes);
+}
+
 TEST_F(SctpDataMediaChannelTest, ClosesRemoteStream) {
   SetupConnectedChannels();
   SignalChannelClosedObserver chan_1_sig_receiver, chan_2_sig_receiver;
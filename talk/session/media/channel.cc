@@ -37,6 +37,8 @@
 #include "webrtc/base/common.h"
 #include "webrtc/base/dscp.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/packetbuffer.h"
+#include "webrtc/base/sslstreamadapter.h"
 
 namespace cricket {
 
@@ -45,8 +47,7 @@ using rtc::Bind;
 enum {
   MSG_EARLYMEDIATIMEOUT = 1,
   MSG_SCREENCASTWINDOWEVENT,
-  MSG_RTPPACKET,
-  MSG_RTCPPACKET,
+  MSG_QUEUEDPACKETS,
   MSG_CHANNEL_ERROR,
   MSG_READYTOSENDDATA,
   MSG_DATARECEIVED,
@@ -68,11 +69,6 @@ static void SafeSetError(const std::string& message, std::string* error_desc) {
   }
 }
 
-struct PacketMessageData : public rtc::MessageData {
-  rtc::Buffer packet;
-  rtc::DiffServCodePoint dscp;
-};
-
 struct DataChannelErrorMessageData : public rtc::MessageData {
   DataChannelErrorMessageData(uint32 in_ssrc,
                               DataMediaChannel::Error in_error)
@@ -121,6 +117,7 @@ BaseChannel::BaseChannel(rtc::Thread* thread,
       rtcp_(rtcp),
       transport_channel_(NULL),
       rtcp_transport_channel_(NULL),
+      num_queued_packets_(0),
       enabled_(false),
       writable_(false),
       rtp_ready_to_send_(false),
@@ -322,8 +319,21 @@ void BaseChannel::OnChannelRead(TransportChannel* channel,
   // When using RTCP multiplexing we might get RTCP packets on the RTP
   // transport. We feed RTP traffic into the demuxer to determine if it is RTCP.
   bool rtcp = PacketIsRtcp(channel, data, len);
-  rtc::Buffer packet(data, len);
-  HandlePacket(rtcp, &packet, packet_time);
+  // The packet is unprotected in place. If it is still in the buffer the
+  // socket received it into, which is the case for plain UDP, and this
+  // channel is the only one it is signaled to, the buffer is handed over and
+  // used as is. Otherwise, the packet is copied into a buffer that is reused
+  // for every packet.
+  rtc::scoped_refptr<rtc::PacketBuffer> packet;
+  if (channel->SignalReadPacket.connection_count() == 1) {
+    packet = rtc::PacketBuffer::SignaledWithData(data, len);
+  }
+  if (packet) {
+    HandlePacket(rtcp, packet->buffer(), packet_time);
+    return;
+  }
+  recv_packet_.SetData(data, len);
+  HandlePacket(rtcp, &recv_packet_, packet_time);
 }
 
 void BaseChannel::OnReadyToSend(TransportChannel* channel) {
@@ -366,39 +376,15 @@ bool BaseChannel::SendPacket(bool rtcp, rtc::Buffer* packet,
   // The only downside is that we can't return a proper failure code if
   // needed. Since UDP is unreliable anyway, this should be a non-issue.
   if (rtc::Thread::Current() != worker_thread_) {
-    // Avoid a copy by transferring the ownership of the packet data.
-    int message_id = (!rtcp) ? MSG_RTPPACKET : MSG_RTCPPACKET;
-    PacketMessageData* data = new PacketMessageData;
-    packet->TransferTo(&data->packet);
-    data->dscp = dscp;
-    worker_thread_->Post(this, message_id, data);
+    QueuePacket(rtcp, packet, dscp);
     return true;
   }
 
-  // Now that we are on the correct thread, ensure we have a place to send this
-  // packet before doing anything. (We might get RTCP packets that we don't
-  // intend to send.) If we've negotiated RTCP mux, send RTCP over the RTP
-  // transport.
-  TransportChannel* channel = (!rtcp || rtcp_mux_filter_.IsActive()) ?
-      transport_channel_ : rtcp_transport_channel_;
-  if (!channel || !channel->writable()) {
-    return false;
-  }
-
-  // Protect ourselves against crazy data.
-  if (!ValidPacket(rtcp, packet)) {
-    LOG(LS_ERROR) << "Dropping outgoing " << content_name_ << " "
-                  << PacketType(rtcp) << " packet: wrong size="
-                  << packet->length();
+  TransportChannel* channel = PrepareToSend(rtcp, packet);
+  if (!channel) {
     return false;
   }
 
-  // Signal to the media sink before protecting the packet.
-  {
-    rtc::CritScope cs(&signal_send_packet_cs_);
-    SignalSendPacketPreCrypto(packet->data(), packet->length(), rtcp);
-  }
-
   rtc::PacketOptions options(dscp);
   // Protect if needed.
   if (srtp_filter_.IsActive()) {
@@ -406,41 +392,36 @@ bool BaseChannel::SendPacket(bool rtcp, rtc::Buffer* packet,
     char* data = packet->data();
     int len = static_cast<int>(packet->length());
     if (!rtcp) {
-    // If ENABLE_EXTERNAL_AUTH flag is on then packet authentication is not done
-    // inside libsrtp for a RTP packet. A external HMAC module will be writing
-    // a fake HMAC value. This is ONLY done for a RTP packet.
-    // Socket layer will update rtp sendtime extension header if present in
-    // packet with current time before updating the HMAC.
-#if !defined(ENABLE_EXTERNAL_AUTH)
-      res = srtp_filter_.ProtectRtp(
-          data, len, static_cast<int>(packet->capacity()), &len);
-#else
-      options.packet_time_params.rtp_sendtime_extension_id =
-          rtp_abs_sendtime_extn_id_;
-      res = srtp_filter_.ProtectRtp(
-          data, len, static_cast<int>(packet->capacity()), &len,
-          &options.packet_time_params.srtp_packet_index);
-      // If protection succeeds, let's get auth params from srtp.
-      if (res) {
-        uint8* auth_key = NULL;
-        int key_len;
-        res = srtp_filter_.GetRtpAuthParams(
-            &auth_key, &key_len, &options.packet_time_params.srtp_auth_tag_len);
+      // With external auth, packet authentication is not done inside libsrtp
+      // for a RTP packet. A external HMAC module will be writing a fake HMAC
+      // value. This is ONLY done for a RTP packet, and never for the AEAD
+      // suites. Socket layer will update rtp sendtime extension header if
+      // present in packet with current time before updating the HMAC.
+      if (!srtp_filter_.IsExternalAuthActive()) {
+        res = srtp_filter_.ProtectRtp(
+            data, len, static_cast<int>(packet->capacity()), &len);
+      } else {
+        options.packet_time_params.rtp_sendtime_extension_id =
+            rtp_abs_sendtime_extn_id_;
+        res = srtp_filter_.ProtectRtp(
+            data, len, static_cast<int>(packet->capacity()), &len,
+            &options.packet_time_params.srtp_packet_index);
+        // If protection succeeds, let's get auth params from srtp.
         if (res) {
-          options.packet_time_params.srtp_auth_key.resize(key_len);
-          options.packet_time_params.srtp_auth_key.assign(auth_key,
-                                                          auth_key + key_len);
+          uint8* auth_key = NULL;
+          int key_len;
+          res = srtp_filter_.GetRtpAuthParams(
+              &auth_key, &key_len,
+              &options.packet_time_params.srtp_auth_tag_len);
+          if (res) {
+            options.packet_time_params.srtp_auth_key.resize(key_len);
+            options.packet_time_params.srtp_auth_key.assign(
+                auth_key, auth_key + key_len);
+          }
         }
       }
-#endif
       if (!res) {
-        int seq_num = -1;
-        uint32 ssrc = 0;
-        GetRtpSeqNum(data, len, &seq_num);
-        GetRtpSsrc(data, len, &ssrc);
-        LOG(LS_ERROR) << "Failed to protect " << content_name_
-                      << " RTP packet: size=" << len
-                      << ", seqnum=" << seq_num << ", SSRC=" << ssrc;
+        LogProtectRtpFailure(data, len);
         return false;
       }
     } else {
@@ -467,6 +448,39 @@ bool BaseChannel::SendPacket(bool rtcp, rtc::Buffer* packet,
     return false;
   }
 
+  return SendProtectedPacket(channel, rtcp, packet, options);
+}
+
+TransportChannel* BaseChannel::PrepareToSend(bool rtcp, rtc::Buffer* packet) {
+  // Now that we are on the correct thread, ensure we have a place to send this
+  // packet before doing anything. (We might get RTCP packets that we don't
+  // intend to send.) If we've negotiated RTCP mux, send RTCP over the RTP
+  // transport.
+  TransportChannel* channel = (!rtcp || rtcp_mux_filter_.IsActive()) ?
+      transport_channel_ : rtcp_transport_channel_;
+  if (!channel || !channel->writable()) {
+    return NULL;
+  }
+
+  // Protect ourselves against crazy data.
+  if (!ValidPacket(rtcp, packet)) {
+    LOG(LS_ERROR) << "Dropping outgoing " << content_name_ << " "
+                  << PacketType(rtcp) << " packet: wrong size="
+                  << packet->length();
+    return NULL;
+  }
+
+  // Signal to the media sink before protecting the packet.
+  {
+    rtc::CritScope cs(&signal_send_packet_cs_);
+    SignalSendPacketPreCrypto(packet->data(), packet->length(), rtcp);
+  }
+  return channel;
+}
+
+bool BaseChannel::SendProtectedPacket(TransportChannel* channel, bool rtcp,
+                                      rtc::Buffer* packet,
+                                      const rtc::PacketOptions& options) {
   // Signal to the media sink after protecting the packet.
   {
     rtc::CritScope cs(&signal_send_packet_cs_);
@@ -486,6 +500,16 @@ bool BaseChannel::SendPacket(bool rtcp, rtc::Buffer* packet,
   return true;
 }
 
+void BaseChannel::LogProtectRtpFailure(const char* data, int len) {
+  int seq_num = -1;
+  uint32 ssrc = 0;
+  GetRtpSeqNum(data, len, &seq_num);
+  GetRtpSsrc(data, len, &ssrc);
+  LOG(LS_ERROR) << "Failed to protect " << content_name_
+                << " RTP packet: size=" << len
+                << ", seqnum=" << seq_num << ", SSRC=" << ssrc;
+}
+
 bool BaseChannel::WantsPacket(bool rtcp, rtc::Buffer* packet) {
   // Protect ourselves against crazy data.
   if (!ValidPacket(rtcp, packet)) {
@@ -687,6 +711,14 @@ bool BaseChannel::SetDtlsSrtpCiphers(TransportChannel *tc, bool rtcp) {
   } else {
     GetSupportedDefaultCryptoSuites(&ciphers);
   }
+  // AES-GCM authenticates as part of the encryption, which is cheaper than
+  // the separate HMAC-SHA1 pass, so prefer it when both libsrtp and the DTLS
+  // implementation have it.
+  if (IsGcmCryptoSuiteSupported() &&
+      rtc::SSLStreamAdapter::HaveDtlsSrtpGcm()) {
+    ciphers.insert(ciphers.begin(), CS_AEAD_AES_256_GCM);
+    ciphers.insert(ciphers.begin(), CS_AEAD_AES_128_GCM);
+  }
   return tc->SetSrtpCiphers(ciphers);
 }
 
@@ -717,9 +749,15 @@ bool BaseChannel::SetupDtlsSrtp(bool rtcp_channel) {
                << content_name() << " "
                << PacketType(rtcp_channel);
 
+  int key_len;
+  int salt_len;
+  if (!GetSrtpKeyAndSaltLengths(selected_cipher, &key_len, &salt_len)) {
+    LOG(LS_ERROR) << "Unknown DTLS-SRTP cipher " << selected_cipher;
+    return false;
+  }
+
   // OK, we're now doing DTLS (RFC 5764)
-  std::vector<unsigned char> dtls_buffer(SRTP_MASTER_KEY_KEY_LEN * 2 +
-                                         SRTP_MASTER_KEY_SALT_LEN * 2);
+  std::vector<unsigned char> dtls_buffer(key_len * 2 + salt_len * 2);
 
   // RFC 5705 exporter using the RFC 5764 parameters
   if (!channel->ExportKeyingMaterial(
@@ -732,22 +770,16 @@ bool BaseChannel::SetupDtlsSrtp(bool rtcp_channel) {
   }
 
   // Sync up the keys with the DTLS-SRTP interface
-  std::vector<unsigned char> client_write_key(SRTP_MASTER_KEY_KEY_LEN +
-    SRTP_MASTER_KEY_SALT_LEN);
-  std::vector<unsigned char> server_write_key(SRTP_MASTER_KEY_KEY_LEN +
-    SRTP_MASTER_KEY_SALT_LEN);
+  std::vector<unsigned char> client_write_key(key_len + salt_len);
+  std::vector<unsigned char> server_write_key(key_len + salt_len);
   size_t offset = 0;
-  memcpy(&client_write_key[0], &dtls_buffer[offset],
-    SRTP_MASTER_KEY_KEY_LEN);
-  offset += SRTP_MASTER_KEY_KEY_LEN;
-  memcpy(&server_write_key[0], &dtls_buffer[offset],
-    SRTP_MASTER_KEY_KEY_LEN);
-  offset += SRTP_MASTER_KEY_KEY_LEN;
-  memcpy(&client_write_key[SRTP_MASTER_KEY_KEY_LEN],
-    &dtls_buffer[offset], SRTP_MASTER_KEY_SALT_LEN);
-  offset += SRTP_MASTER_KEY_SALT_LEN;
-  memcpy(&server_write_key[SRTP_MASTER_KEY_KEY_LEN],
-    &dtls_buffer[offset], SRTP_MASTER_KEY_SALT_LEN);
+  memcpy(&client_write_key[0], &dtls_buffer[offset], key_len);
+  offset += key_len;
+  memcpy(&server_write_key[0], &dtls_buffer[offset], key_len);
+  offset += key_len;
+  memcpy(&client_write_key[key_len], &dtls_buffer[offset], salt_len);
+  offset += salt_len;
+  memcpy(&server_write_key[key_len], &dtls_buffer[offset], salt_len);
 
   std::vector<unsigned char> *send_key, *recv_key;
   rtc::SSLRole role;
@@ -1156,11 +1188,8 @@ void BaseChannel::MaybeCacheRtpAbsSendTimeHeaderExtension(
 
 void BaseChannel::OnMessage(rtc::Message *pmsg) {
   switch (pmsg->message_id) {
-    case MSG_RTPPACKET:
-    case MSG_RTCPPACKET: {
-      PacketMessageData* data = static_cast<PacketMessageData*>(pmsg->pdata);
-      SendPacket(pmsg->message_id == MSG_RTCPPACKET, &data->packet, data->dscp);
-      delete data;  // because it is Posted
+    case MSG_QUEUEDPACKETS: {
+      SendQueuedPackets(false);
       break;
     }
     case MSG_FIRSTPACKETRECEIVED: {
@@ -1174,12 +1203,95 @@ void BaseChannel::FlushRtcpMessages() {
   // Flush all remaining RTCP messages. This should only be called in
   // destructor.
   ASSERT(rtc::Thread::Current() == worker_thread_);
-  rtc::MessageList rtcp_messages;
-  worker_thread_->Clear(this, MSG_RTCPPACKET, &rtcp_messages);
-  for (rtc::MessageList::iterator it = rtcp_messages.begin();
-       it != rtcp_messages.end(); ++it) {
-    worker_thread_->Send(this, MSG_RTCPPACKET, it->pdata);
+  SendQueuedPackets(true);
+}
+
+void BaseChannel::QueuePacket(bool rtcp, const rtc::Buffer* packet,
+                              rtc::DiffServCodePoint dscp) {
+  bool wake_worker;
+  {
+    rtc::CritScope cs(&queued_packets_cs_);
+    if (num_queued_packets_ == queued_packets_.size()) {
+      queued_packets_.resize(num_queued_packets_ + 1);
+    }
+    QueuedPacket* queued = &queued_packets_[num_queued_packets_++];
+    // Keep the sender's spare capacity; SRTP needs it for the auth tag.
+    queued->packet.SetCapacity(packet->capacity());
+    queued->packet.SetData(packet->data(), packet->length());
+    queued->rtcp = rtcp;
+    queued->dscp = dscp;
+    wake_worker = (num_queued_packets_ == 1);
+  }
+  if (wake_worker) {
+    worker_thread_->Post(this, MSG_QUEUEDPACKETS);
+  }
+}
+
+void BaseChannel::SendQueuedPackets(bool rtcp_only) {
+  ASSERT(rtc::Thread::Current() == worker_thread_);
+  size_t count;
+  {
+    rtc::CritScope cs(&queued_packets_cs_);
+    queued_packets_.swap(sending_packets_);
+    count = num_queued_packets_;
+    num_queued_packets_ = 0;
+  }
+  // Runs of RTP packets are protected with one call into libsrtp, unless
+  // the socket layer has to authenticate each of them.
+  bool batch = srtp_filter_.IsActive() && !srtp_filter_.IsExternalAuthActive();
+  size_t i = 0;
+  while (i < count) {
+    QueuedPacket* queued = &sending_packets_[i];
+    if (queued->rtcp) {
+      SendPacket(true, &queued->packet, queued->dscp);
+      ++i;
+    } else if (rtcp_only) {
+      ++i;
+    } else if (batch) {
+      i = SendQueuedRtpPackets(i, count);
+    } else {
+      SendPacket(false, &queued->packet, queued->dscp);
+      ++i;
+    }
+  }
+}
+
+size_t BaseChannel::SendQueuedRtpPackets(size_t begin, size_t end) {
+  srtp_batch_.clear();
+  srtp_batch_packets_.clear();
+  TransportChannel* channel = NULL;
+  size_t i = begin;
+  for (; i < end && !sending_packets_[i].rtcp; ++i) {
+    QueuedPacket* queued = &sending_packets_[i];
+    TransportChannel* packet_channel = PrepareToSend(false, &queued->packet);
+    if (!packet_channel) {
+      continue;
+    }
+    channel = packet_channel;
+    srtp_batch_.push_back(SrtpPacket(
+        queued->packet.data(), static_cast<int>(queued->packet.length()),
+        static_cast<int>(queued->packet.capacity())));
+    srtp_batch_packets_.push_back(queued);
+  }
+  if (srtp_batch_.empty()) {
+    return i;
+  }
+
+  srtp_filter_.ProtectRtpBatch(&srtp_batch_[0],
+                               static_cast<int>(srtp_batch_.size()));
+  for (size_t j = 0; j < srtp_batch_.size(); ++j) {
+    const SrtpPacket& protected_packet = srtp_batch_[j];
+    QueuedPacket* queued = srtp_batch_packets_[j];
+    if (!protected_packet.ok) {
+      LogProtectRtpFailure(queued->packet.data(), protected_packet.len);
+      continue;
+    }
+    // Update the length of the packet now that we've added the auth tag.
+    queued->packet.SetLength(protected_packet.len);
+    SendProtectedPacket(channel, false, &queued->packet,
+                        rtc::PacketOptions(queued->dscp));
   }
+  return i;
 }
 
 DataChannel::DataChannel(rtc::Thread* thread,
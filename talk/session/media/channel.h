@@ -264,6 +264,18 @@ class BaseChannel
                     size_t len);
   bool SendPacket(bool rtcp, rtc::Buffer* packet,
                   rtc::DiffServCodePoint dscp);
+  // Returns the channel to send |packet| on, or NULL if it can't be sent.
+  TransportChannel* PrepareToSend(bool rtcp, rtc::Buffer* packet);
+  bool SendProtectedPacket(TransportChannel* channel, bool rtcp,
+                           rtc::Buffer* packet,
+                           const rtc::PacketOptions& options);
+  void LogProtectRtpFailure(const char* data, int len);
+  void QueuePacket(bool rtcp, const rtc::Buffer* packet,
+                   rtc::DiffServCodePoint dscp);
+  void SendQueuedPackets(bool rtcp_only);
+  // Protects and sends the RTP packets in |sending_packets_| from |begin| up
+  // to the next RTCP packet or |end|, and returns the index after them.
+  size_t SendQueuedRtpPackets(size_t begin, size_t end);
   virtual bool WantsPacket(bool rtcp, rtc::Buffer* packet);
   void HandlePacket(bool rtcp, rtc::Buffer* packet,
                     const rtc::PacketTime& packet_time);
@@ -370,6 +382,25 @@ class BaseChannel
   TransportChannel* transport_channel_;
   TransportChannel* rtcp_transport_channel_;
   SrtpFilter srtp_filter_;
+  // Scratch buffer for incoming packets that can't be taken over from the
+  // socket (see OnChannelRead); only used on the worker thread.
+  rtc::Buffer recv_packet_;
+  // Packets sent from other threads wait in |queued_packets_| until the
+  // worker thread swaps it with |sending_packets_| and sends them all. The
+  // entries are reused, so their buffers keep their capacity, and only the
+  // first packet queued after each swap needs to wake up the worker.
+  struct QueuedPacket {
+    rtc::Buffer packet;
+    bool rtcp;
+    rtc::DiffServCodePoint dscp;
+  };
+  rtc::CriticalSection queued_packets_cs_;
+  std::vector<QueuedPacket> queued_packets_;
+  size_t num_queued_packets_;
+  std::vector<QueuedPacket> sending_packets_;
+  // Scratch space for SendQueuedRtpPackets; only used on the worker thread.
+  std::vector<SrtpPacket> srtp_batch_;
+  std::vector<QueuedPacket*> srtp_batch_packets_;
   RtcpMuxFilter rtcp_mux_filter_;
   BundleFilter bundle_filter_;
   rtc::scoped_ptr<SocketMonitor> socket_monitor_;
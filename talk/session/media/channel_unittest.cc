@@ -39,6 +39,7 @@
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/helpers.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/packetbuffer.h"
 #include "webrtc/base/pathutils.h"
 #include "webrtc/base/signalthread.h"
 #include "webrtc/base/ssladapter.h"
@@ -72,6 +73,7 @@ static const uint32 kSsrc2 = 0x2222;
 static const uint32 kSsrc3 = 0x3333;
 static const int kAudioPts[] = {0, 8};
 static const int kVideoPts[] = {97, 99};
+static const int kRtpBurstSize = 20;
 
 template<class ChannelT,
          class MediaChannelT,
@@ -138,7 +140,9 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
         mute_callback_recved_(false),
         mute_callback_value_(false),
         ssrc_(0),
-        error_(T::MediaChannel::ERROR_NONE) {
+        error_(T::MediaChannel::ERROR_NONE),
+        last_recv_data_(NULL),
+        burst_start_(0) {
   }
 
   void CreateChannels(int flags1, int flags2) {
@@ -363,6 +367,15 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
     return media_channel1_->SendRtp(data.c_str(),
                                     static_cast<int>(data.size()));
   }
+  // Sends kRtpBurstSize packets, numbered from |burst_start_|.
+  bool SendRtpBurst1() {
+    for (int i = 0; i < kRtpBurstSize; ++i) {
+      if (!SendCustomRtp1(kSsrc1, burst_start_ + i)) {
+        return false;
+      }
+    }
+    return true;
+  }
   bool SendCustomRtp2(uint32 ssrc, int sequence_number, int pl_type = -1) {
     std::string data(CreateRtpData(ssrc, sequence_number, pl_type));
     return media_channel2_->SendRtp(data.c_str(),
@@ -526,6 +539,10 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
     mute_callback_value_ = muted;
   }
 
+  void OnRecvPacket(const void* data, size_t len, bool rtcp) {
+    last_recv_data_ = data;
+  }
+
   void AddLegacyStreamInContent(uint32 ssrc, int flags,
                         typename T::Content* content) {
     // Base implementation.
@@ -1314,6 +1331,27 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
     EXPECT_TRUE(CheckNoRtcp2());
   }
 
+  // Test that bursts of packets sent from a thread are queued while the worker
+  // thread is busy, and arrive complete and in order once it drains the queue.
+  // The second burst reuses the queue entries of the first.
+  void SendRtpBurstsOnThread() {
+    CreateChannels(RTCP, RTCP);
+    EXPECT_TRUE(SendInitiate());
+    EXPECT_TRUE(SendAccept());
+    for (int burst = 0; burst < 2; ++burst) {
+      burst_start_ = burst * kRtpBurstSize;
+      bool sent = false;
+      // The worker (this thread) is blocked until the whole burst is queued.
+      CallOnThreadAndWaitForDone(&ChannelTest<T>::SendRtpBurst1, &sent);
+      EXPECT_TRUE(sent);
+      EXPECT_TRUE(CheckNoRtp2());
+      for (int i = 0; i < kRtpBurstSize; ++i) {
+        EXPECT_TRUE_WAIT(CheckCustomRtp2(kSsrc1, burst_start_ + i), 1000);
+      }
+      EXPECT_TRUE(CheckNoRtp2());
+    }
+  }
+
   // Test that we properly send SRTP with RTCP from a thread.
   void SendSrtpToSrtpOnThread() {
     bool sent_rtp1, sent_rtp2, sent_rtcp1, sent_rtcp2;
@@ -1700,6 +1738,41 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
     EXPECT_TRUE(CheckRtcp2());
   }
 
+  // Test that a packet still in the buffer the socket received it into is
+  // handled in that buffer, and that other packets are copied.
+  void TestReceivePooledPacket() {
+    CreateChannels(0, 0);
+    EXPECT_TRUE(SendInitiate());
+    EXPECT_TRUE(SendAccept());
+    channel2_->RegisterRecvSink(this, &ChannelTest<T>::OnRecvPacket,
+                                cricket::SINK_POST_CRYPTO);
+
+    rtc::scoped_refptr<rtc::PacketBufferPool> pool(
+        new rtc::PacketBufferPool(1500, 1));
+    rtc::scoped_refptr<rtc::PacketBuffer> packet(pool->Get());
+    rtc::Buffer* buffer = packet->buffer();
+    buffer->SetData(rtp_packet_.c_str(), rtp_packet_.size());
+    cricket::TransportChannel* transport_channel =
+        channel2_->transport_channel();
+    {
+      rtc::SignaledPacketScope scope(packet.get());
+      transport_channel->SignalReadPacket(
+          transport_channel, buffer->data(), buffer->length(),
+          rtc::PacketTime(), 0);
+    }
+    EXPECT_EQ(static_cast<const void*>(buffer->data()), last_recv_data_);
+    EXPECT_TRUE(CheckRtp2());
+    EXPECT_TRUE(packet->HasOneRef());
+
+    transport_channel->SignalReadPacket(
+        transport_channel, buffer->data(), buffer->length(),
+        rtc::PacketTime(), 0);
+    EXPECT_NE(static_cast<const void*>(buffer->data()), last_recv_data_);
+    EXPECT_TRUE(CheckRtp2());
+    EXPECT_TRUE(CheckNoRtp2());
+    channel2_->UnregisterRecvSink(this, cricket::SINK_POST_CRYPTO);
+  }
+
   void TestChangeStateError() {
     CreateChannels(RTCP, RTCP);
     EXPECT_TRUE(SendInitiate());
@@ -1829,6 +1902,10 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
 
   uint32 ssrc_;
   typename T::MediaChannel::Error error_;
+  // The data passed to the last post-crypto receive sink call.
+  const void* last_recv_data_;
+  // The sequence number of the first packet sent by SendRtpBurst1.
+  int burst_start_;
 };
 
 
@@ -2125,6 +2202,10 @@ TEST_F(VoiceChannelTest, SendRtpToRtpOnThread) {
   Base::SendRtpToRtpOnThread();
 }
 
+TEST_F(VoiceChannelTest, SendRtpBurstsOnThread) {
+  Base::SendRtpBurstsOnThread();
+}
+
 TEST_F(VoiceChannelTest, SendSrtpToSrtpOnThread) {
   Base::SendSrtpToSrtpOnThread();
 }
@@ -2246,6 +2327,10 @@ TEST_F(VoiceChannelTest, TestChangeStateError) {
   Base::TestChangeStateError();
 }
 
+TEST_F(VoiceChannelTest, TestReceivePooledPacket) {
+  Base::TestReceivePooledPacket();
+}
+
 TEST_F(VoiceChannelTest, TestSrtpError) {
   Base::TestSrtpError(kAudioPts[0]);
 }
@@ -2547,6 +2632,10 @@ TEST_F(VideoChannelTest, SendRtpToRtpOnThread) {
   Base::SendRtpToRtpOnThread();
 }
 
+TEST_F(VideoChannelTest, SendRtpBurstsOnThread) {
+  Base::SendRtpBurstsOnThread();
+}
+
 TEST_F(VideoChannelTest, SendSrtpToSrtpOnThread) {
   Base::SendSrtpToSrtpOnThread();
 }
@@ -2607,6 +2696,10 @@ TEST_F(VideoChannelTest, SendBundleToBundleWithRtcpMuxSecure) {
 
 // TODO(gangji): Add VideoChannelTest.TestChangeStateError.
 
+TEST_F(VideoChannelTest, TestReceivePooledPacket) {
+  Base::TestReceivePooledPacket();
+}
+
 TEST_F(VideoChannelTest, TestSrtpError) {
   Base::TestSrtpError(kVideoPts[0]);
 }
@@ -64,6 +64,10 @@ extern "C" debug_module_t mod_alloc;
 extern "C" debug_module_t mod_aes_icm;
 extern "C" debug_module_t mod_aes_hmac;
 #endif
+// libsrtp has the AES-GCM transforms only when it is built with OpenSSL.
+#if defined(OPENSSL) && defined(AES_128_GCM)
+#define HAVE_SRTP_GCM
+#endif
 #else
 // SrtpFilter needs that constant.
 #define SRTP_MASTER_KEY_LEN 30
@@ -73,10 +77,15 @@ namespace cricket {
 
 const char CS_AES_CM_128_HMAC_SHA1_80[] = "AES_CM_128_HMAC_SHA1_80";
 const char CS_AES_CM_128_HMAC_SHA1_32[] = "AES_CM_128_HMAC_SHA1_32";
+const char CS_AEAD_AES_128_GCM[] = "AEAD_AES_128_GCM";
+const char CS_AEAD_AES_256_GCM[] = "AEAD_AES_256_GCM";
 const int SRTP_MASTER_KEY_BASE64_LEN = SRTP_MASTER_KEY_LEN * 4 / 3;
 const int SRTP_MASTER_KEY_KEY_LEN = 16;
 const int SRTP_MASTER_KEY_SALT_LEN = 14;
 
+// The AES-GCM suites use a 96-bit salt (RFC 7714, section 12).
+static const int kSrtpGcmSaltLen = 12;
+
 #ifndef HAVE_SRTP
 
 // This helper function is used on systems that don't (yet) have SRTP,
@@ -114,6 +123,31 @@ void ShutdownSrtp() {
 #endif
 }
 
+bool GetSrtpKeyAndSaltLengths(const std::string& cs,
+                              int* key_len, int* salt_len) {
+  if (cs == CS_AES_CM_128_HMAC_SHA1_80 || cs == CS_AES_CM_128_HMAC_SHA1_32) {
+    *key_len = SRTP_MASTER_KEY_KEY_LEN;
+    *salt_len = SRTP_MASTER_KEY_SALT_LEN;
+  } else if (cs == CS_AEAD_AES_128_GCM) {
+    *key_len = 16;
+    *salt_len = kSrtpGcmSaltLen;
+  } else if (cs == CS_AEAD_AES_256_GCM) {
+    *key_len = 32;
+    *salt_len = kSrtpGcmSaltLen;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool IsGcmCryptoSuiteSupported() {
+#ifdef HAVE_SRTP_GCM
+  return true;
+#else
+  return false;
+#endif
+}
+
 SrtpFilter::SrtpFilter()
     : state_(ST_INIT),
       signal_silent_time_in_ms_(0) {
@@ -261,6 +295,22 @@ bool SrtpFilter::UnprotectRtcp(void* p, int in_len, int* out_len) {
   }
 }
 
+int SrtpFilter::ProtectRtpBatch(SrtpPacket* packets, int count) {
+  if (!IsActive()) {
+    LOG(LS_WARNING) << "Failed to ProtectRtpBatch: SRTP not active";
+    return 0;
+  }
+  ASSERT(send_session_ != NULL);
+  return send_session_->ProtectRtpBatch(packets, count);
+}
+
+bool SrtpFilter::IsExternalAuthActive() const {
+  if (!IsActive())
+    return false;
+  ASSERT(send_session_ != NULL);
+  return send_session_->IsExternalAuthActive();
+}
+
 bool SrtpFilter::GetRtpAuthParams(uint8** key, int* key_len, int* tag_len) {
   if (!IsActive()) {
     LOG(LS_WARNING) << "Failed to GetRtpAuthParams: SRTP not active";
@@ -477,6 +527,7 @@ SrtpSession::SrtpSession()
     : session_(NULL),
       rtp_auth_tag_len_(0),
       rtcp_auth_tag_len_(0),
+      external_auth_active_(false),
       srtp_stat_(new SrtpStat()),
       last_send_seq_num_(-1) {
   sessions()->push_back(this);
@@ -595,9 +646,57 @@ bool SrtpSession::UnprotectRtcp(void* p, int in_len, int* out_len) {
   return true;
 }
 
+int SrtpSession::ProtectRtpBatch(SrtpPacket* packets, int count) {
+  if (!session_) {
+    LOG(LS_WARNING) << "Failed to protect SRTP packets: no SRTP Session";
+    return 0;
+  }
+
+  // Failures are reported to |srtp_stat_| one by one, but logged once for
+  // the batch. Successes need no reporting.
+  int protected_count = 0;
+  int err = err_status_ok;
+  for (int i = 0; i < count; ++i) {
+    SrtpPacket& packet = packets[i];
+    packet.ok = false;
+    if (packet.max_len < packet.len + rtp_auth_tag_len_) {
+      err = err_status_bad_param;
+      continue;
+    }
+    int out_len = packet.len;
+    int packet_err = srtp_protect(session_, packet.data, &out_len);
+    if (packet_err != err_status_ok) {
+      uint32 ssrc;
+      if (GetRtpSsrc(packet.data, packet.len, &ssrc)) {
+        srtp_stat_->AddProtectRtpResult(ssrc, packet_err);
+      }
+      err = packet_err;
+      continue;
+    }
+    GetRtpSeqNum(packet.data, packet.len, &last_send_seq_num_);
+    packet.len = out_len;
+    packet.ok = true;
+    ++protected_count;
+  }
+  if (protected_count < count) {
+    LOG(LS_WARNING) << "Failed to protect " << count - protected_count
+                    << " of " << count << " SRTP packets, last err=" << err;
+  }
+  return protected_count;
+}
+
+bool SrtpSession::IsExternalAuthActive() const {
+  return external_auth_active_;
+}
+
 bool SrtpSession::GetRtpAuthParams(uint8** key, int* key_len,
                                    int* tag_len) {
 #if defined(ENABLE_EXTERNAL_AUTH)
+  if (!external_auth_active_) {
+    LOG(LS_WARNING) << "Failed to get auth keys: external auth not active";
+    return false;
+  }
+
   ExternalHmacContext* external_hmac = NULL;
   // stream_template will be the reference context for other streams.
   // Let's use it for getting the keys.
@@ -657,13 +756,23 @@ bool SrtpSession::SetKey(int type, const std::string& cs,
   } else if (cs == CS_AES_CM_128_HMAC_SHA1_32) {
     crypto_policy_set_aes_cm_128_hmac_sha1_32(&policy.rtp);   // rtp is 32,
     crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy.rtcp);  // rtcp still 80
+#ifdef HAVE_SRTP_GCM
+  } else if (cs == CS_AEAD_AES_128_GCM) {
+    crypto_policy_set_aes_gcm_128_16_auth(&policy.rtp);
+    crypto_policy_set_aes_gcm_128_16_auth(&policy.rtcp);
+  } else if (cs == CS_AEAD_AES_256_GCM) {
+    crypto_policy_set_aes_gcm_256_16_auth(&policy.rtp);
+    crypto_policy_set_aes_gcm_256_16_auth(&policy.rtcp);
+#endif
   } else {
     LOG(LS_WARNING) << "Failed to create SRTP session: unsupported"
                     << " cipher_suite " << cs.c_str();
     return false;
   }
 
-  if (!key || len != SRTP_MASTER_KEY_LEN) {
+  int key_len, salt_len;
+  if (!key || !GetSrtpKeyAndSaltLengths(cs, &key_len, &salt_len) ||
+      len != key_len + salt_len) {
     LOG(LS_WARNING) << "Failed to create SRTP session: invalid key";
     return false;
   }
@@ -678,10 +787,15 @@ bool SrtpSession::SetKey(int type, const std::string& cs,
   // id EXTERNAL_HMAC_SHA1 in the policy structure.
   // We want to set this option only for rtp packets.
   // By default policy structure is initialized to HMAC_SHA1.
+  bool external_auth = false;
 #if defined(ENABLE_EXTERNAL_AUTH)
-  // Enable external HMAC authentication only for outgoing streams.
-  if (type == ssrc_any_outbound) {
+  // Enable external HMAC authentication only for outgoing streams, and not
+  // for the AEAD suites: their tag is computed by the cipher, and an
+  // external HMAC would overwrite it.
+  bool aead = cs == CS_AEAD_AES_128_GCM || cs == CS_AEAD_AES_256_GCM;
+  if (type == ssrc_any_outbound && !aead) {
     policy.rtp.auth_type = EXTERNAL_HMAC_SHA1;
+    external_auth = true;
   }
 #endif
   policy.next = NULL;
@@ -695,6 +809,7 @@ bool SrtpSession::SetKey(int type, const std::string& cs,
 
   rtp_auth_tag_len_ = policy.rtp.auth_tag_len;
   rtcp_auth_tag_len_ = policy.rtcp.auth_tag_len;
+  external_auth_active_ = external_auth;
   return true;
 }
 
@@ -808,6 +923,15 @@ bool SrtpSession::UnprotectRtcp(void* data, int in_len, int* out_len) {
   return SrtpNotAvailable(__FUNCTION__);
 }
 
+int SrtpSession::ProtectRtpBatch(SrtpPacket* packets, int count) {
+  SrtpNotAvailable(__FUNCTION__);
+  return 0;
+}
+
+bool SrtpSession::IsExternalAuthActive() const {
+  return false;
+}
+
 void SrtpSession::set_signal_silent_time(uint32 signal_silent_time) {
   // Do nothing.
 }
@@ -53,6 +53,12 @@ namespace cricket {
 extern const char CS_AES_CM_128_HMAC_SHA1_80[];
 // 128-bit AES with 32-bit SHA-1 HMAC.
 extern const char CS_AES_CM_128_HMAC_SHA1_32[];
+// 128-bit AES in Galois/Counter Mode, authenticating with a 128-bit tag as
+// part of the encryption (RFC 7714). The AES-GCM suites are only available
+// if libsrtp is built with them, and are only negotiated through DTLS-SRTP.
+extern const char CS_AEAD_AES_128_GCM[];
+// 256-bit AES in Galois/Counter Mode with a 128-bit tag.
+extern const char CS_AEAD_AES_256_GCM[];
 // Key is 128 bits and salt is 112 bits == 30 bytes. B64 bloat => 40 bytes.
 extern const int SRTP_MASTER_KEY_BASE64_LEN;
 
@@ -66,6 +72,29 @@ class SrtpStat;
 void EnableSrtpDebugging();
 void ShutdownSrtp();
 
+// Gets the master key and salt lengths of the cipher suite |cs|. Returns
+// false if |cs| is not a known cipher suite.
+bool GetSrtpKeyAndSaltLengths(const std::string& cs,
+                              int* key_len, int* salt_len);
+// Whether the AES-GCM cipher suites can be used.
+bool IsGcmCryptoSuiteSupported();
+
+// An RTP packet to be protected in-place as part of a batch.
+struct SrtpPacket {
+  SrtpPacket() : data(NULL), len(0), max_len(0), ok(false) {}
+  SrtpPacket(void* data, int len, int max_len)
+      : data(data), len(len), max_len(max_len), ok(false) {}
+
+  void* data;
+  // The length of the packet, updated to the length after protection.
+  int len;
+  // The size of the buffer at |data|. Protection adds the authentication
+  // tag, so it needs room for it.
+  int max_len;
+  // Whether the packet was protected. If not, |len| is left unchanged.
+  bool ok;
+};
+
 // Class to transform SRTP to/from RTP.
 // Initialize by calling SetSend with the local security params, then call
 // SetRecv once the remote security params are received. At that point
@@ -130,6 +159,16 @@ class SrtpFilter {
   bool UnprotectRtp(void* data, int in_len, int* out_len);
   bool UnprotectRtcp(void* data, int in_len, int* out_len);
 
+  // Encrypts/signs |count| RTP packets in-place, with one call for all of
+  // them. A packet that fails does not stop the others; its |ok| is left
+  // false. Returns the number of packets that succeeded.
+  int ProtectRtpBatch(SrtpPacket* packets, int count);
+
+  // Whether RTP packets are sent without their authentication tag, which the
+  // socket layer adds with the params from GetRtpAuthParams. This is only
+  // the case in builds with ENABLE_EXTERNAL_AUTH, and never for the AEAD
+  // suites, whose tag comes out of the encryption.
+  bool IsExternalAuthActive() const;
   // Returns rtp auth params from srtp context.
   bool GetRtpAuthParams(uint8** key, int* key_len, int* tag_len);
 
@@ -214,6 +253,11 @@ class SrtpSession {
   bool UnprotectRtp(void* data, int in_len, int* out_len);
   bool UnprotectRtcp(void* data, int in_len, int* out_len);
 
+  // Batch version of ProtectRtp; see SrtpFilter.
+  int ProtectRtpBatch(SrtpPacket* packets, int count);
+
+  // See SrtpFilter::IsExternalAuthActive.
+  bool IsExternalAuthActive() const;
   // Helper method to get authentication params.
   bool GetRtpAuthParams(uint8** key, int* key_len, int* tag_len);
 
@@ -240,6 +284,7 @@ class SrtpSession {
   srtp_ctx_t* session_;
   int rtp_auth_tag_len_;
   int rtcp_auth_tag_len_;
+  bool external_auth_active_;
   rtc::scoped_ptr<SrtpStat> srtp_stat_;
   static bool inited_;
   int last_send_seq_num_;
@@ -25,6 +25,9 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <vector>
+
 #include "talk/media/base/cryptoparams.h"
 #include "talk/media/base/fakertp.h"
 #include "webrtc/p2p/base/sessiondescription.h"
@@ -32,6 +35,7 @@
 #include "webrtc/base/byteorder.h"
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/thread.h"
+#include "webrtc/base/timeutils.h"
 #ifdef SRTP_RELATIVE_PATH
 #include "crypto/include/err.h"
 #else
@@ -40,6 +44,8 @@
 
 using cricket::CS_AES_CM_128_HMAC_SHA1_80;
 using cricket::CS_AES_CM_128_HMAC_SHA1_32;
+using cricket::CS_AEAD_AES_128_GCM;
+using cricket::CS_AEAD_AES_256_GCM;
 using cricket::CryptoParams;
 using cricket::CS_LOCAL;
 using cricket::CS_REMOTE;
@@ -47,6 +53,12 @@ using cricket::CS_REMOTE;
 static const uint8 kTestKey1[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234";
 static const uint8 kTestKey2[] = "4321ZYXWVUTSRQPONMLKJIHGFEDCBA";
 static const int kTestKeyLen = 30;
+static const uint8 kTestKeyGcm256[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890abcdefgh";
+static const int kTestKeyGcm128Len = 28;
+static const int kTestKeyGcm256Len = 44;
+// The largest authentication tag of all cipher suites, of AES-GCM.
+static const int kMaxAuthTagLen = 16;
 static const std::string kTestKeyParams1 =
     "inline:WVNfX19zZW1jdGwgKCkgewkyMjA7fQp9CnVubGVz";
 static const std::string kTestKeyParams2 =
@@ -60,13 +72,24 @@ static const cricket::CryptoParams kTestCryptoParams1(
 static const cricket::CryptoParams kTestCryptoParams2(
     1, "AES_CM_128_HMAC_SHA1_80", kTestKeyParams2, "");
 
+static bool IsGcm(const std::string& cs) {
+  return cs == CS_AEAD_AES_128_GCM || cs == CS_AEAD_AES_256_GCM;
+}
 static int rtp_auth_tag_len(const std::string& cs) {
+  if (IsGcm(cs))
+    return kMaxAuthTagLen;
   return (cs == CS_AES_CM_128_HMAC_SHA1_32) ? 4 : 10;
 }
 static int rtcp_auth_tag_len(const std::string& cs) {
-  return 10;
+  return IsGcm(cs) ? kMaxAuthTagLen : 10;
 }
 
+#define MAYBE_SKIP_GCM_TEST()                         \
+  if (!cricket::IsGcmCryptoSuiteSupported()) {        \
+    LOG(LS_INFO) << "AES-GCM not supported, skipping"; \
+    return;                                           \
+  }
+
 class SrtpFilterTest : public testing::Test {
  protected:
   SrtpFilterTest()
@@ -578,6 +601,35 @@ TEST_F(SrtpFilterTest, TestGetSendAuthParams) {
   EXPECT_TRUE(auth_key != NULL);
   EXPECT_EQ(20, auth_key_len);
   EXPECT_EQ(4, auth_tag_len);
+  EXPECT_TRUE(f1_.IsExternalAuthActive());
+}
+
+// Test that the AEAD suites never use external auth, since their tag comes
+// out of the encryption, and that their packets still round-trip.
+TEST_F(SrtpFilterTest, TestNoExternalAuthForGcm) {
+  MAYBE_SKIP_GCM_TEST();
+  EXPECT_TRUE(f1_.SetRtpParams(CS_AEAD_AES_128_GCM,
+                               kTestKey1, kTestKeyGcm128Len,
+                               CS_AEAD_AES_128_GCM,
+                               kTestKey2, kTestKeyGcm128Len));
+  EXPECT_TRUE(f2_.SetRtpParams(CS_AEAD_AES_128_GCM,
+                               kTestKey2, kTestKeyGcm128Len,
+                               CS_AEAD_AES_128_GCM,
+                               kTestKey1, kTestKeyGcm128Len));
+  EXPECT_FALSE(f1_.IsExternalAuthActive());
+  uint8* auth_key = NULL;
+  int auth_key_len = 0, auth_tag_len = 0;
+  EXPECT_FALSE(f1_.GetRtpAuthParams(&auth_key, &auth_key_len, &auth_tag_len));
+
+  char packet[sizeof(kPcmuFrame) + kMaxAuthTagLen];
+  int len = sizeof(kPcmuFrame);
+  memcpy(packet, kPcmuFrame, len);
+  EXPECT_TRUE(f1_.ProtectRtp(packet, len, sizeof(packet), &len));
+  EXPECT_EQ(static_cast<int>(sizeof(kPcmuFrame)) +
+                rtp_auth_tag_len(CS_AEAD_AES_128_GCM), len);
+  EXPECT_TRUE(f2_.UnprotectRtp(packet, len, &len));
+  EXPECT_EQ(static_cast<int>(sizeof(kPcmuFrame)), len);
+  EXPECT_EQ(0, memcmp(packet, kPcmuFrame, len));
 }
 #endif
 
@@ -619,8 +671,8 @@ class SrtpSessionTest : public testing::Test {
   }
   cricket::SrtpSession s1_;
   cricket::SrtpSession s2_;
-  char rtp_packet_[sizeof(kPcmuFrame) + 10];
-  char rtcp_packet_[sizeof(kRtcpReport) + 4 + 10];
+  char rtp_packet_[sizeof(kPcmuFrame) + kMaxAuthTagLen];
+  char rtcp_packet_[sizeof(kRtcpReport) + 4 + kMaxAuthTagLen];
   int rtp_len_;
   int rtcp_len_;
 };
@@ -665,6 +717,177 @@ TEST_F(SrtpSessionTest, TestProtect_AES_CM_128_HMAC_SHA1_32) {
   TestUnprotectRtcp(CS_AES_CM_128_HMAC_SHA1_32);
 }
 
+// Test that we can encrypt and decrypt RTP/RTCP using AEAD_AES_128_GCM.
+TEST_F(SrtpSessionTest, TestProtect_AEAD_AES_128_GCM) {
+  MAYBE_SKIP_GCM_TEST();
+  EXPECT_TRUE(s1_.SetSend(CS_AEAD_AES_128_GCM, kTestKey1, kTestKeyGcm128Len));
+  EXPECT_TRUE(s2_.SetRecv(CS_AEAD_AES_128_GCM, kTestKey1, kTestKeyGcm128Len));
+  TestProtectRtp(CS_AEAD_AES_128_GCM);
+  TestProtectRtcp(CS_AEAD_AES_128_GCM);
+  TestUnprotectRtp(CS_AEAD_AES_128_GCM);
+  TestUnprotectRtcp(CS_AEAD_AES_128_GCM);
+}
+
+// Test that we can encrypt and decrypt RTP/RTCP using AEAD_AES_256_GCM.
+TEST_F(SrtpSessionTest, TestProtect_AEAD_AES_256_GCM) {
+  MAYBE_SKIP_GCM_TEST();
+  EXPECT_TRUE(s1_.SetSend(CS_AEAD_AES_256_GCM, kTestKeyGcm256,
+                          kTestKeyGcm256Len));
+  EXPECT_TRUE(s2_.SetRecv(CS_AEAD_AES_256_GCM, kTestKeyGcm256,
+                          kTestKeyGcm256Len));
+  TestProtectRtp(CS_AEAD_AES_256_GCM);
+  TestProtectRtcp(CS_AEAD_AES_256_GCM);
+  TestUnprotectRtp(CS_AEAD_AES_256_GCM);
+  TestUnprotectRtcp(CS_AEAD_AES_256_GCM);
+}
+
+// Test that AES-GCM keys must have the AES-GCM length, and that the AES-GCM
+// suites are refused if libsrtp does not have them.
+TEST_F(SrtpSessionTest, TestGcmKeyLengths) {
+  int key_len, salt_len;
+  EXPECT_TRUE(cricket::GetSrtpKeyAndSaltLengths(CS_AEAD_AES_128_GCM,
+                                                &key_len, &salt_len));
+  EXPECT_EQ(kTestKeyGcm128Len, key_len + salt_len);
+  EXPECT_TRUE(cricket::GetSrtpKeyAndSaltLengths(CS_AEAD_AES_256_GCM,
+                                                &key_len, &salt_len));
+  EXPECT_EQ(kTestKeyGcm256Len, key_len + salt_len);
+  EXPECT_FALSE(cricket::GetSrtpKeyAndSaltLengths("NO_SUCH_SUITE",
+                                                 &key_len, &salt_len));
+
+  EXPECT_FALSE(s1_.SetSend(CS_AEAD_AES_128_GCM, kTestKey1, kTestKeyLen));
+  EXPECT_EQ(cricket::IsGcmCryptoSuiteSupported(),
+            s2_.SetRecv(CS_AEAD_AES_128_GCM, kTestKey1, kTestKeyGcm128Len));
+}
+
+// Test that a batch is protected like single packets, and that failing
+// packets do not stop the rest of the batch.
+TEST_F(SrtpSessionTest, TestProtectRtpBatch) {
+  static const int kNumPackets = 4;
+  EXPECT_TRUE(s1_.SetSend(CS_AES_CM_128_HMAC_SHA1_80, kTestKey1, kTestKeyLen));
+  EXPECT_TRUE(s2_.SetRecv(CS_AES_CM_128_HMAC_SHA1_80, kTestKey1, kTestKeyLen));
+
+  char buffers[kNumPackets][sizeof(rtp_packet_)];
+  cricket::SrtpPacket packets[kNumPackets];
+  for (int i = 0; i < kNumPackets; ++i) {
+    memcpy(buffers[i], kPcmuFrame, rtp_len_);
+    rtc::SetBE16(reinterpret_cast<uint8*>(buffers[i]) + 2, i + 1);
+    packets[i] = cricket::SrtpPacket(buffers[i], rtp_len_, sizeof(buffers[i]));
+  }
+  // No room for the authentication tag.
+  packets[1].max_len = rtp_len_;
+
+  EXPECT_EQ(kNumPackets - 1, s1_.ProtectRtpBatch(packets, kNumPackets));
+  EXPECT_FALSE(packets[1].ok);
+  EXPECT_EQ(rtp_len_, packets[1].len);
+  for (int i = 0; i < kNumPackets; ++i) {
+    if (i == 1)
+      continue;
+    EXPECT_TRUE(packets[i].ok);
+    EXPECT_EQ(rtp_len_ + rtp_auth_tag_len(CS_AES_CM_128_HMAC_SHA1_80),
+              packets[i].len);
+    EXPECT_NE(0, memcmp(buffers[i] + 12, kPcmuFrame + 12, rtp_len_ - 12));
+  }
+
+  // The protected packets unprotect one by one; the unprotected one fails to
+  // authenticate.
+  int out_len = 0;
+  EXPECT_FALSE(s2_.UnprotectRtp(buffers[1], packets[1].len, &out_len));
+  for (int i = 0; i < kNumPackets; ++i) {
+    if (i == 1)
+      continue;
+    EXPECT_TRUE(s2_.UnprotectRtp(buffers[i], packets[i].len, &out_len));
+    EXPECT_EQ(rtp_len_, out_len);
+    EXPECT_EQ(0, memcmp(buffers[i] + 12, kPcmuFrame + 12, rtp_len_ - 12));
+  }
+}
+
+static const int kPerfNumPackets = 10000;
+static const int kPerfPacketLen = 1000;
+static const int kPerfBufferLen = kPerfPacketLen + kMaxAuthTagLen;
+static const int kPerfBatchSize = 16;
+
+// Measures the packets per second of each supported cipher suite, for
+// single packets and for protecting batches.
+class SrtpSessionPerformanceTest : public testing::Test {
+ protected:
+  void Measure(const std::string& cs, const uint8* key, int key_len) {
+    MeasureOne(cs, key, key_len, false);
+    MeasureOne(cs, key, key_len, true);
+  }
+
+  void MeasureOne(const std::string& cs, const uint8* key, int key_len,
+                  bool batch) {
+    cricket::SrtpSession send_session;
+    cricket::SrtpSession recv_session;
+    ASSERT_TRUE(send_session.SetSend(cs, key, key_len));
+    ASSERT_TRUE(recv_session.SetRecv(cs, key, key_len));
+
+    std::vector<char> buffers(kPerfNumPackets * kPerfBufferLen);
+    std::vector<cricket::SrtpPacket> packets(kPerfNumPackets);
+    for (int i = 0; i < kPerfNumPackets; ++i) {
+      char* buffer = &buffers[i * kPerfBufferLen];
+      memcpy(buffer, kPcmuFrame, 12);
+      memset(buffer + 12, i & 0xff, kPerfPacketLen - 12);
+      rtc::SetBE16(reinterpret_cast<uint8*>(buffer) + 2, i + 1);
+      packets[i] = cricket::SrtpPacket(buffer, kPerfPacketLen, kPerfBufferLen);
+    }
+
+    uint64 start = rtc::TimeMicros();
+    int count = 0;
+    if (batch) {
+      for (int i = 0; i < kPerfNumPackets; i += kPerfBatchSize) {
+        count += send_session.ProtectRtpBatch(
+            &packets[i], std::min(kPerfBatchSize, kPerfNumPackets - i));
+      }
+    } else {
+      for (int i = 0; i < kPerfNumPackets; ++i) {
+        count += send_session.ProtectRtp(packets[i].data, packets[i].len,
+                                         packets[i].max_len, &packets[i].len);
+      }
+    }
+    uint64 protected_time = rtc::TimeMicros();
+    EXPECT_EQ(kPerfNumPackets, count);
+
+    count = 0;
+    for (int i = 0; i < kPerfNumPackets; ++i) {
+      count += recv_session.UnprotectRtp(packets[i].data, packets[i].len,
+                                         &packets[i].len);
+    }
+    uint64 unprotected_time = rtc::TimeMicros();
+    EXPECT_EQ(kPerfNumPackets, count);
+    EXPECT_EQ(kPerfPacketLen, packets[kPerfNumPackets - 1].len);
+
+    LOG(LS_INFO) << cs << (batch ? ", batched" : ", single") << ": protect "
+                 << PacketsPerSecond(start, protected_time)
+                 << " packets/s, unprotect "
+                 << PacketsPerSecond(protected_time, unprotected_time)
+                 << " packets/s";
+  }
+
+  static uint64 PacketsPerSecond(uint64 start, uint64 end) {
+    return kPerfNumPackets * rtc::kNumMicrosecsPerSec /
+        std::max<uint64>(end - start, 1);
+  }
+};
+
+TEST_F(SrtpSessionPerformanceTest, AES_CM_128_HMAC_SHA1_80) {
+  Measure(CS_AES_CM_128_HMAC_SHA1_80, kTestKey1, kTestKeyLen);
+}
+
+TEST_F(SrtpSessionPerformanceTest, AES_CM_128_HMAC_SHA1_32) {
+  Measure(CS_AES_CM_128_HMAC_SHA1_32, kTestKey1, kTestKeyLen);
+}
+
+TEST_F(SrtpSessionPerformanceTest, AEAD_AES_128_GCM) {
+  MAYBE_SKIP_GCM_TEST();
+  Measure(CS_AEAD_AES_128_GCM, kTestKey1, kTestKeyGcm128Len);
+}
+
+TEST_F(SrtpSessionPerformanceTest, AEAD_AES_256_GCM) {
+  MAYBE_SKIP_GCM_TEST();
+  Measure(CS_AEAD_AES_256_GCM, kTestKeyGcm256, kTestKeyGcm256Len);
+}
+
 TEST_F(SrtpSessionTest, TestGetSendStreamPacketIndex) {
   EXPECT_TRUE(s1_.SetSend(CS_AES_CM_128_HMAC_SHA1_32, kTestKey1, kTestKeyLen));
   int64 index;
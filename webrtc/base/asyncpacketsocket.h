@@ -90,6 +90,25 @@ class AsyncPacketSocket : public sigslot::has_slots<> {
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr,
                      const PacketOptions& options) = 0;
 
+  // Sends a burst of packets, each to its own address, using the same
+  // |options|. Like Socket::SendToBatch, a packet that fails is dropped and
+  // the rest are still sent, until the socket would block. Returns the number
+  // of packets sent, or -1 if none could be sent.
+  // The default implementation calls SendTo for each packet.
+  virtual int SendToBatch(const SendBatchEntry* packets, size_t count,
+                          const PacketOptions& options) {
+    size_t sent = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const SendBatchEntry& packet = packets[i];
+      if (SendTo(packet.data, packet.length, packet.addr, options) >= 0) {
+        ++sent;
+      } else if (IsBlockingError(GetError())) {
+        break;
+      }
+    }
+    return (sent > 0 || count == 0) ? static_cast<int>(sent) : -1;
+  }
+
   // Close the socket.
   virtual int Close() = 0;
 
@@ -12,6 +12,8 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include "webrtc/base/byteorder.h"
 #include "webrtc/base/common.h"
 #include "webrtc/base/logging.h"
@@ -31,6 +33,14 @@ static const size_t kBufSize = kMaxPacketSize + kPacketLenSize;
 
 static const int kListenBacklog = 5;
 
+// Buffers are allocated in multiples of this, and the input buffer starts
+// out with one chunk.
+static const size_t kBufferChunkSize = 4 * 1024;
+
+static size_t RoundUpToChunk(size_t size) {
+  return (size + kBufferChunkSize - 1) / kBufferChunkSize * kBufferChunkSize;
+}
+
 // Binds and connects |socket|
 AsyncSocket* AsyncTCPSocketBase::ConnectSocket(
     rtc::AsyncSocket* socket,
@@ -52,13 +62,12 @@ AsyncTCPSocketBase::AsyncTCPSocketBase(AsyncSocket* socket, bool listen,
                                        size_t max_packet_size)
     : socket_(socket),
       listen_(listen),
-      insize_(max_packet_size),
+      max_packet_size_(max_packet_size),
+      insize_(0),
       inpos_(0),
-      outsize_(max_packet_size),
-      outpos_(0) {
-  inbuf_ = new char[insize_];
-  outbuf_ = new char[outsize_];
-
+      outsize_(0),
+      outbegin_(0),
+      outend_(0) {
   ASSERT(socket_.get() != NULL);
   socket_->SignalConnectEvent.connect(
       this, &AsyncTCPSocketBase::OnConnectEvent);
@@ -74,8 +83,6 @@ AsyncTCPSocketBase::AsyncTCPSocketBase(AsyncSocket* socket, bool listen,
 }
 
 AsyncTCPSocketBase::~AsyncTCPSocketBase() {
-  delete [] inbuf_;
-  delete [] outbuf_;
 }
 
 SocketAddress AsyncTCPSocketBase::GetLocalAddress() const {
@@ -136,38 +143,94 @@ int AsyncTCPSocketBase::SendTo(const void *pv, size_t cb,
 }
 
 int AsyncTCPSocketBase::SendRaw(const void * pv, size_t cb) {
-  if (outpos_ + cb > outsize_) {
+  if (outend_ - outbegin_ + cb > max_packet_size_) {
     socket_->SetError(EMSGSIZE);
     return -1;
   }
 
-  memcpy(outbuf_ + outpos_, pv, cb);
-  outpos_ += cb;
+  AppendToOutBuffer(pv, cb);
 
   return FlushOutBuffer();
 }
 
 int AsyncTCPSocketBase::FlushOutBuffer() {
-  int res = socket_->Send(outbuf_, outpos_);
+  size_t pending = outend_ - outbegin_;
+  int res = socket_->Send(outbuf_.get() + outbegin_, pending);
   if (res <= 0) {
     return res;
   }
-  if (static_cast<size_t>(res) <= outpos_) {
-    outpos_ -= res;
+  if (static_cast<size_t>(res) <= pending) {
+    outbegin_ += res;
   } else {
     ASSERT(false);
     return -1;
   }
-  if (outpos_ > 0) {
-    memmove(outbuf_, outbuf_ + res, outpos_);
+  // Rather than moving the unsent tail, start over once everything is sent.
+  if (outbegin_ == outend_) {
+    ClearOutBuffer();
   }
   return res;
 }
 
 void AsyncTCPSocketBase::AppendToOutBuffer(const void* pv, size_t cb) {
-  ASSERT(outpos_ + cb < outsize_);
-  memcpy(outbuf_ + outpos_, pv, cb);
-  outpos_ += cb;
+  ReserveOutBuffer(cb);
+  memcpy(outbuf_.get() + outend_, pv, cb);
+  outend_ += cb;
+}
+
+int AsyncTCPSocketBase::SendFrame(const IoVec* pieces, size_t count) {
+  ASSERT(IsOutBufferEmpty());
+  int res = socket_->SendV(pieces, count);
+  if (res <= 0) {
+    return res;
+  }
+  size_t sent = static_cast<size_t>(res);
+  for (size_t i = 0; i < count; ++i) {
+    if (sent >= pieces[i].length) {
+      sent -= pieces[i].length;
+      continue;
+    }
+    AppendToOutBuffer(static_cast<const char*>(pieces[i].data) + sent,
+                      pieces[i].length - sent);
+    sent = 0;
+  }
+  return res;
+}
+
+void AsyncTCPSocketBase::ReserveOutBuffer(size_t cb) {
+  size_t pending = outend_ - outbegin_;
+  ASSERT(pending + cb <= max_packet_size_);
+  if (outend_ + cb <= outsize_) {
+    return;
+  }
+  if (pending + cb <= outsize_) {
+    memmove(outbuf_.get(), outbuf_.get() + outbegin_, pending);
+  } else {
+    size_t size = std::min(RoundUpToChunk(pending + cb), max_packet_size_);
+    scoped_ptr<char[]> buf(new char[size]);
+    if (pending > 0) {
+      memcpy(buf.get(), outbuf_.get() + outbegin_, pending);
+    }
+    outbuf_.swap(buf);
+    outsize_ = size;
+  }
+  outbegin_ = 0;
+  outend_ = pending;
+}
+
+bool AsyncTCPSocketBase::GrowInBuffer() {
+  if (insize_ >= max_packet_size_) {
+    return false;
+  }
+  size_t size = std::min(std::max(2 * insize_, kBufferChunkSize),
+                         max_packet_size_);
+  scoped_ptr<char[]> buf(new char[size]);
+  if (inpos_ > 0) {
+    memcpy(buf.get(), inbuf_.get(), inpos_);
+  }
+  inbuf_.swap(buf);
+  insize_ = size;
+  return true;
 }
 
 void AsyncTCPSocketBase::OnConnectEvent(AsyncSocket* socket) {
@@ -192,23 +255,38 @@ void AsyncTCPSocketBase::OnReadEvent(AsyncSocket* socket) {
     // Prime a read event in case data is waiting.
     new_socket->SignalReadEvent(new_socket);
   } else {
-    int len = socket_->Recv(inbuf_ + inpos_, insize_ - inpos_);
-    if (len < 0) {
-      // TODO: Do something better like forwarding the error to the user.
-      if (!socket_->IsBlocking()) {
-        LOG(LS_ERROR) << "Recv() returned error: " << socket_->GetError();
+    while (true) {
+      if (inpos_ == insize_ && !GrowInBuffer()) {
+        LOG(LS_ERROR) << "input buffer overflow";
+        ASSERT(false);
+        inpos_ = 0;
       }
-      return;
-    }
 
-    inpos_ += len;
+      int len = socket_->Recv(inbuf_.get() + inpos_, insize_ - inpos_);
+      if (len < 0) {
+        // TODO: Do something better like forwarding the error to the user.
+        if (!socket_->IsBlocking()) {
+          LOG(LS_ERROR) << "Recv() returned error: " << socket_->GetError();
+        }
+        break;
+      }
 
-    ProcessInput(inbuf_, &inpos_);
+      inpos_ += len;
+      bool filled = (inpos_ == insize_);
 
-    if (inpos_ >= insize_) {
-      LOG(LS_ERROR) << "input buffer overflow";
-      ASSERT(false);
-      inpos_ = 0;
+      ProcessInput(inbuf_.get(), &inpos_);
+
+      // A full buffer means there may be more to read, possibly the rest of
+      // a frame that needs a larger buffer.
+      if (!filled) {
+        break;
+      }
+    }
+
+    // Give back a grown buffer once no partial frame is left in it.
+    if (inpos_ == 0 && insize_ > kBufferChunkSize) {
+      inbuf_.reset();
+      insize_ = 0;
     }
   }
 }
@@ -216,11 +294,14 @@ void AsyncTCPSocketBase::OnReadEvent(AsyncSocket* socket) {
 void AsyncTCPSocketBase::OnWriteEvent(AsyncSocket* socket) {
   ASSERT(socket_.get() == socket);
 
-  if (outpos_ > 0) {
+  if (!IsOutBufferEmpty()) {
     FlushOutBuffer();
   }
 
-  if (outpos_ == 0) {
+  if (IsOutBufferEmpty()) {
+    // Only needed while the socket was blocked.
+    outbuf_.reset();
+    outsize_ = 0;
     SignalReadyToSend(this);
   }
 }
@@ -257,13 +338,10 @@ int AsyncTCPSocket::Send(const void *pv, size_t cb,
     return static_cast<int>(cb);
 
   PacketLength pkt_len = HostToNetwork16(static_cast<PacketLength>(cb));
-  AppendToOutBuffer(&pkt_len, kPacketLenSize);
-  AppendToOutBuffer(pv, cb);
-
-  int res = FlushOutBuffer();
+  IoVec pieces[] = {IoVec(&pkt_len, kPacketLenSize), IoVec(pv, cb)};
+  int res = SendFrame(pieces, ARRAY_SIZE(pieces));
   if (res <= 0) {
     // drop packet if we made no progress
-    ClearOutBuffer();
     return res;
   }
 
@@ -274,21 +352,23 @@ int AsyncTCPSocket::Send(const void *pv, size_t cb,
 void AsyncTCPSocket::ProcessInput(char * data, size_t* len) {
   SocketAddress remote_addr(GetRemoteAddress());
 
-  while (true) {
-    if (*len < kPacketLenSize)
-      return;
-
-    PacketLength pkt_len = rtc::GetBE16(data);
-    if (*len < kPacketLenSize + pkt_len)
-      return;
+  // Frames are signaled where they are; only a partial frame at the end is
+  // moved to the front, once.
+  size_t pos = 0;
+  while (*len - pos >= kPacketLenSize) {
+    PacketLength pkt_len = rtc::GetBE16(data + pos);
+    if (*len - pos < kPacketLenSize + pkt_len)
+      break;
 
-    SignalReadPacket(this, data + kPacketLenSize, pkt_len, remote_addr,
+    SignalReadPacket(this, data + pos + kPacketLenSize, pkt_len, remote_addr,
                      CreatePacketTime(0));
 
-    *len -= kPacketLenSize + pkt_len;
-    if (*len > 0) {
-      memmove(data, data + kPacketLenSize + pkt_len, *len);
-    }
+    pos += kPacketLenSize + pkt_len;
+  }
+
+  *len -= pos;
+  if (*len > 0 && pos > 0) {
+    memmove(data, data + pos, *len);
   }
 }
 
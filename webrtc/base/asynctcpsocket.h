@@ -20,6 +20,11 @@ namespace rtc {
 // Simulates UDP semantics over TCP.  Send and Recv packet sizes
 // are preserved, and drops packets silently on Send, rather than
 // buffer them in user space.
+//
+// Only the part of a frame that the socket did not take is buffered, and the
+// input buffer grows up to |max_packet_size| as frames need it. Both buffers
+// are allocated in chunks when first needed and released again once drained,
+// so idle connections hold little memory.
 class AsyncTCPSocketBase : public AsyncPacketSocket {
  public:
   AsyncTCPSocketBase(AsyncSocket* socket, bool listen, size_t max_packet_size);
@@ -55,10 +60,14 @@ class AsyncTCPSocketBase : public AsyncPacketSocket {
   int FlushOutBuffer();
   // Add data to |outbuf_|.
   void AppendToOutBuffer(const void* pv, size_t cb);
+  // Writes the |count| pieces of a frame with a single gathering send, and
+  // buffers only what the socket did not take. The out buffer must be empty.
+  // Returns the result of the send; nothing is buffered if it is <= 0.
+  int SendFrame(const IoVec* pieces, size_t count);
 
-  // Helper methods for |outpos_|.
-  bool IsOutBufferEmpty() const { return outpos_ == 0; }
-  void ClearOutBuffer() { outpos_ = 0; }
+  // Helper methods for the unsent data in |outbuf_|.
+  bool IsOutBufferEmpty() const { return outbegin_ == outend_; }
+  void ClearOutBuffer() { outbegin_ = outend_ = 0; }
 
  private:
   // Called by the underlying socket
@@ -67,10 +76,19 @@ class AsyncTCPSocketBase : public AsyncPacketSocket {
   void OnWriteEvent(AsyncSocket* socket);
   void OnCloseEvent(AsyncSocket* socket, int error);
 
+  // Makes room for |cb| more bytes at the end of |outbuf_|.
+  void ReserveOutBuffer(size_t cb);
+  // Grows |inbuf_| when it is full; returns false if it is at its maximum.
+  bool GrowInBuffer();
+
   scoped_ptr<AsyncSocket> socket_;
   bool listen_;
-  char* inbuf_, * outbuf_;
-  size_t insize_, inpos_, outsize_, outpos_;
+  const size_t max_packet_size_;
+  scoped_ptr<char[]> inbuf_;
+  size_t insize_, inpos_;
+  // The unsent data is |outbuf_[outbegin_, outend_)|.
+  scoped_ptr<char[]> outbuf_;
+  size_t outsize_, outbegin_, outend_;
 
   DISALLOW_EVIL_CONSTRUCTORS(AsyncTCPSocketBase);
 };
@@ -8,6 +8,7 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <list>
 #include <string>
 
 #include "webrtc/base/asynctcpsocket.h"
@@ -50,4 +51,76 @@ TEST_F(AsyncTCPSocketTest, OnWriteEvent) {
   EXPECT_TRUE(ready_to_send_);
 }
 
+class AsyncTCPSocketPairTest
+    : public testing::Test,
+      public sigslot::has_slots<> {
+ public:
+  AsyncTCPSocketPairTest()
+      : vss_(new VirtualSocketServer(NULL)),
+        ss_scope_(vss_.get()) {
+    // Large enough to take a maximum-size frame in one go.
+    vss_->set_send_buffer_capacity(128 * 1024);
+  }
+
+  virtual void SetUp() {
+    AsyncSocket* server = vss_->CreateAsyncSocket(SOCK_STREAM);
+    server->Bind(SocketAddress("22.22.22.22", 0));
+    listen_socket_.reset(new AsyncTCPSocket(server, true));
+    listen_socket_->SignalNewConnection.connect(
+        this, &AsyncTCPSocketPairTest::OnNewConnection);
+
+    send_socket_.reset(AsyncTCPSocket::Create(
+        vss_->CreateAsyncSocket(SOCK_STREAM), SocketAddress("11.11.11.11", 0),
+        listen_socket_->GetLocalAddress()));
+    ASSERT_TRUE(send_socket_.get() != NULL);
+    vss_->ProcessMessagesUntilIdle();
+    ASSERT_TRUE(recv_socket_.get() != NULL);
+  }
+
+  void OnNewConnection(AsyncPacketSocket* server,
+                       AsyncPacketSocket* new_socket) {
+    recv_socket_.reset(new_socket);
+    new_socket->SignalReadPacket.connect(
+        this, &AsyncTCPSocketPairTest::OnReadPacket);
+  }
+
+  void OnReadPacket(AsyncPacketSocket* socket, const char* data, size_t len,
+                    const SocketAddress& remote_addr,
+                    const PacketTime& packet_time) {
+    recv_packets_.push_back(std::string(data, len));
+  }
+
+ protected:
+  scoped_ptr<VirtualSocketServer> vss_;
+  SocketServerScope ss_scope_;
+  scoped_ptr<AsyncTCPSocket> listen_socket_;
+  scoped_ptr<AsyncTCPSocket> send_socket_;
+  scoped_ptr<AsyncPacketSocket> recv_socket_;
+  std::list<std::string> recv_packets_;
+};
+
+// Frames of all sizes arrive intact, including ones that need the input
+// buffer to grow and several that arrive in a single read.
+TEST_F(AsyncTCPSocketPairTest, SendFramesOfVaryingSize) {
+  static const size_t kSizes[] = {0, 1, 100, 4093, 4094, 40000, 65535, 10};
+  PacketOptions options;
+  std::list<std::string> sent;
+  for (size_t i = 0; i < ARRAY_SIZE(kSizes); ++i) {
+    std::string packet(kSizes[i], static_cast<char>('a' + i));
+    EXPECT_EQ(static_cast<int>(packet.size()),
+              send_socket_->Send(packet.data(), packet.size(), options));
+    sent.push_back(packet);
+    vss_->ProcessMessagesUntilIdle();
+  }
+  EXPECT_TRUE(sent == recv_packets_);
+
+  // Small frames sent back to back are read together.
+  recv_packets_.clear();
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(3, send_socket_->Send("abc", 3, options));
+  }
+  vss_->ProcessMessagesUntilIdle();
+  EXPECT_EQ(10U, recv_packets_.size());
+}
+
 }  // namespace rtc
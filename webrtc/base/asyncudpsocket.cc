@@ -9,11 +9,26 @@
  */
 
 #include "webrtc/base/asyncudpsocket.h"
+
+#include <algorithm>
+
 #include "webrtc/base/logging.h"
 
 namespace rtc {
 
-static const int BUF_SIZE = 64 * 1024;
+static const size_t BUF_SIZE = 64 * 1024;
+// Buffers kept for reuse by each socket, beyond the one it reads into.
+static const size_t kMaxFreeBuffers = 2;
+
+static bool SameOptions(const PacketOptions& a, const PacketOptions& b) {
+  const PacketTimeUpdateParams& ta = a.packet_time_params;
+  const PacketTimeUpdateParams& tb = b.packet_time_params;
+  return a.dscp == b.dscp &&
+         ta.rtp_sendtime_extension_id == tb.rtp_sendtime_extension_id &&
+         ta.srtp_auth_key == tb.srtp_auth_key &&
+         ta.srtp_auth_tag_len == tb.srtp_auth_tag_len &&
+         ta.srtp_packet_index == tb.srtp_packet_index;
+}
 
 AsyncUDPSocket* AsyncUDPSocket::Create(
     AsyncSocket* socket,
@@ -36,10 +51,12 @@ AsyncUDPSocket* AsyncUDPSocket::Create(SocketFactory* factory,
 }
 
 AsyncUDPSocket::AsyncUDPSocket(AsyncSocket* socket)
-    : socket_(socket) {
+    : socket_(socket),
+      pool_(new PacketBufferPool(BUF_SIZE, kMaxFreeBuffers)),
+      batch_packet_size_(0),
+      signaling_batch_(false),
+      dropped_queued_sends_(0) {
   ASSERT(socket_);
-  size_ = BUF_SIZE;
-  buf_ = new char[size_];
 
   // The socket should start out readable but not writable.
   socket_->SignalReadEvent.connect(this, &AsyncUDPSocket::OnReadEvent);
@@ -47,7 +64,6 @@ AsyncUDPSocket::AsyncUDPSocket(AsyncSocket* socket)
 }
 
 AsyncUDPSocket::~AsyncUDPSocket() {
-  delete [] buf_;
 }
 
 SocketAddress AsyncUDPSocket::GetLocalAddress() const {
@@ -66,9 +82,22 @@ int AsyncUDPSocket::Send(const void *pv, size_t cb,
 int AsyncUDPSocket::SendTo(const void *pv, size_t cb,
                            const SocketAddress& addr,
                            const rtc::PacketOptions& options) {
+  if (signaling_batch_) {
+    send_offsets_.push_back(send_buf_.size());
+    send_entries_.push_back(SendBatchEntry(NULL, cb, addr));
+    send_options_.push_back(options);
+    const char* data = static_cast<const char*>(pv);
+    send_buf_.insert(send_buf_.end(), data, data + cb);
+    return static_cast<int>(cb);
+  }
   return socket_->SendTo(pv, cb, addr);
 }
 
+int AsyncUDPSocket::SendToBatch(const SendBatchEntry* packets, size_t count,
+                                const rtc::PacketOptions& options) {
+  return socket_->SendToBatch(packets, count);
+}
+
 int AsyncUDPSocket::Close() {
   return socket_->Close();
 }
@@ -93,11 +122,43 @@ void AsyncUDPSocket::SetError(int error) {
   return socket_->SetError(error);
 }
 
+void AsyncUDPSocket::SetBatchedReceive(size_t max_packets,
+                                       size_t max_packet_size) {
+  ASSERT(!signaling_batch_);
+  if (max_packets <= 1) {
+    batch_entries_.clear();
+    batch_buf_.clear();
+    batch_packet_size_ = 0;
+    return;
+  }
+
+  // Each slot gets one spare byte, so that a datagram which didn't fit can be
+  // told apart from one that exactly filled the slot.
+  size_t slot_size = max_packet_size + 1;
+  batch_buf_.resize(max_packets * slot_size);
+  batch_entries_.resize(max_packets);
+  for (size_t i = 0; i < max_packets; ++i) {
+    batch_entries_[i].buffer = &batch_buf_[i * slot_size];
+    batch_entries_[i].size = slot_size;
+  }
+  batch_packet_size_ = max_packet_size;
+}
+
 void AsyncUDPSocket::OnReadEvent(AsyncSocket* socket) {
   ASSERT(socket_.get() == socket);
 
+  if (!batch_entries_.empty()) {
+    ReadBatch();
+    return;
+  }
+
+  if (!recv_packet_ || !recv_packet_->HasOneRef()) {
+    recv_packet_ = pool_->Get();
+  }
+  Buffer* buffer = recv_packet_->buffer();
   SocketAddress remote_addr;
-  int len = socket_->RecvFrom(buf_, size_, &remote_addr);
+  int len = socket_->RecvFrom(buffer->data(), buffer->capacity(),
+                              &remote_addr);
   if (len < 0) {
     // An error here typically means we got an ICMP error in response to our
     // send datagram, indicating the remote address was unreachable.
@@ -111,10 +172,78 @@ void AsyncUDPSocket::OnReadEvent(AsyncSocket* socket) {
 
   // TODO: Make sure that we got all of the packet.
   // If we did not, then we should resize our buffer to be large enough.
-  SignalReadPacket(this, buf_, static_cast<size_t>(len), remote_addr,
+  buffer->SetLength(static_cast<size_t>(len));
+  // The local reference keeps the packet valid even if a handler destroys
+  // the socket.
+  scoped_refptr<PacketBuffer> packet(recv_packet_);
+  SignaledPacketScope scope(packet.get());
+  SignalReadPacket(this, buffer->data(), buffer->length(), remote_addr,
                    CreatePacketTime(0));
 }
 
+void AsyncUDPSocket::ReadBatch() {
+  int count = socket_->RecvFromBatch(&batch_entries_[0],
+                                     batch_entries_.size());
+  if (count < 0) {
+    // See OnReadEvent.
+    SocketAddress local_addr = socket_->GetLocalAddress();
+    LOG(LS_INFO) << "AsyncUDPSocket[" << local_addr.ToSensitiveString() << "] "
+                 << "receive failed with error " << socket_->GetError();
+    return;
+  }
+
+  signaling_batch_ = true;
+  for (int i = 0; i < count; ++i) {
+    const RecvBatchEntry& entry = batch_entries_[i];
+    if (entry.length > batch_packet_size_) {
+      LOG(LS_WARNING) << "AsyncUDPSocket dropped a datagram larger than "
+                      << batch_packet_size_ << " bytes from "
+                      << entry.addr.ToSensitiveString();
+      continue;
+    }
+    SignalReadPacket(this, static_cast<const char*>(entry.buffer),
+                     entry.length, entry.addr, CreatePacketTime(0));
+  }
+  signaling_batch_ = false;
+
+  if (!send_entries_.empty()) {
+    FlushQueuedSends();
+  }
+}
+
+void AsyncUDPSocket::FlushQueuedSends() {
+  const char* base = send_buf_.empty() ? NULL : &send_buf_[0];
+  for (size_t i = 0; i < send_entries_.size(); ++i) {
+    send_entries_[i].data = base + send_offsets_[i];
+  }
+  // Packets are sent in runs that share the same options, so each one is
+  // sent just as it would have been outside of a batch.
+  size_t dropped = 0;
+  size_t begin = 0;
+  while (begin < send_entries_.size()) {
+    size_t end = begin + 1;
+    while (end < send_entries_.size() &&
+           SameOptions(send_options_[begin], send_options_[end])) {
+      ++end;
+    }
+    int sent = SendToBatch(&send_entries_[begin], end - begin,
+                           send_options_[begin]);
+    dropped += end - begin - std::max(sent, 0);
+    begin = end;
+  }
+  if (dropped > 0) {
+    // Like any other UDP send, packets that would block are dropped.
+    dropped_queued_sends_ += dropped;
+    LOG(LS_INFO) << "AsyncUDPSocket[" << GetLocalAddress().ToSensitiveString()
+                 << "] dropped " << dropped << " of " << send_entries_.size()
+                 << " queued packets, error " << socket_->GetError();
+  }
+  send_entries_.clear();
+  send_offsets_.clear();
+  send_options_.clear();
+  send_buf_.clear();
+}
+
 void AsyncUDPSocket::OnWriteEvent(AsyncSocket* socket) {
   SignalReadyToSend(this);
 }
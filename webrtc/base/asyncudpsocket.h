@@ -11,7 +11,10 @@
 #ifndef WEBRTC_BASE_ASYNCUDPSOCKET_H_
 #define WEBRTC_BASE_ASYNCUDPSOCKET_H_
 
+#include <vector>
+
 #include "webrtc/base/asyncpacketsocket.h"
+#include "webrtc/base/packetbuffer.h"
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/socketfactory.h"
 
@@ -19,6 +22,9 @@ namespace rtc {
 
 // Provides the ability to receive packets asynchronously.  Sends are not
 // buffered since it is acceptable to drop packets under high load.
+// Packets are received into pooled PacketBuffers, and each one is the
+// PacketBuffer::Signaled() packet while SignalReadPacket is emitted for it, so
+// receivers can keep or modify it without a copy.
 class AsyncUDPSocket : public AsyncPacketSocket {
  public:
   // Binds |socket| and creates AsyncUDPSocket for it. Takes ownership
@@ -39,6 +45,8 @@ class AsyncUDPSocket : public AsyncPacketSocket {
                    const rtc::PacketOptions& options);
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr,
                      const rtc::PacketOptions& options);
+  virtual int SendToBatch(const SendBatchEntry* packets, size_t count,
+                          const rtc::PacketOptions& options);
   virtual int Close();
 
   virtual State GetState() const;
@@ -47,15 +55,52 @@ class AsyncUDPSocket : public AsyncPacketSocket {
   virtual int GetError() const;
   virtual void SetError(int error);
 
+  // Makes each read event drain up to |max_packets| datagrams of at most
+  // |max_packet_size| bytes from the socket, using a single system call where
+  // the platform supports it. SignalReadPacket is still emitted once per
+  // packet; larger datagrams are dropped. Handlers of SignalReadPacket must
+  // not destroy the socket while batching is enabled. A |max_packets| of 1
+  // restores the default of reading one datagram of up to 64 KB per event.
+  // While a batch is being signaled, packets sent on this socket (typically
+  // replies from the SignalReadPacket handlers) are queued, together with
+  // their options, and then sent together with SendToBatch once the batch is
+  // done. SendTo can't report the errors of queued packets, so the ones that
+  // fail are counted by dropped_queued_sends() instead.
+  void SetBatchedReceive(size_t max_packets, size_t max_packet_size);
+
+  // Returns the number of packets queued while signaling a batch that could
+  // not be sent.
+  size_t dropped_queued_sends() const { return dropped_queued_sends_; }
+
  private:
   // Called when the underlying socket is ready to be read from.
   void OnReadEvent(AsyncSocket* socket);
   // Called when the underlying socket is ready to send.
   void OnWriteEvent(AsyncSocket* socket);
+  // Reads and signals a batch of packets; see SetBatchedReceive.
+  void ReadBatch();
+  // Sends the packets queued while signaling a batch.
+  void FlushQueuedSends();
 
   scoped_ptr<AsyncSocket> socket_;
-  char* buf_;
-  size_t size_;
+  scoped_refptr<PacketBufferPool> pool_;
+  // The buffer the next packet is read into. It's reused as long as no
+  // receiver keeps a reference to the previous packet.
+  scoped_refptr<PacketBuffer> recv_packet_;
+  // Storage for batched receive, empty unless SetBatchedReceive was called.
+  std::vector<char> batch_buf_;
+  std::vector<RecvBatchEntry> batch_entries_;
+  size_t batch_packet_size_;
+  // Packets sent while signaling a batch, stored back to back in
+  // |send_buf_| at |send_offsets_|, with their options in |send_options_|.
+  // The entries' data pointers are only set when they're flushed, since
+  // |send_buf_| may move as it grows.
+  bool signaling_batch_;
+  std::vector<char> send_buf_;
+  std::vector<size_t> send_offsets_;
+  std::vector<SendBatchEntry> send_entries_;
+  std::vector<PacketOptions> send_options_;
+  size_t dropped_queued_sends_;
 };
 
 }  // namespace rtc
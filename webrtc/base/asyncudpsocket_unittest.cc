@@ -9,6 +9,7 @@
  */
 
 #include <string>
+#include <vector>
 
 #include "webrtc/base/asyncudpsocket.h"
 #include "webrtc/base/gunit.h"
@@ -50,4 +51,273 @@ TEST_F(AsyncUdpSocketTest, OnWriteEvent) {
   EXPECT_TRUE(ready_to_send_);
 }
 
+// Records the DSCP value each packet is sent with.
+class DscpRecordingUDPSocket : public AsyncUDPSocket {
+ public:
+  explicit DscpRecordingUDPSocket(AsyncSocket* socket)
+      : AsyncUDPSocket(socket) {}
+
+  virtual int SendToBatch(const SendBatchEntry* packets, size_t count,
+                          const PacketOptions& options) {
+    sent_dscps_.insert(sent_dscps_.end(), count, options.dscp);
+    return AsyncUDPSocket::SendToBatch(packets, count, options);
+  }
+
+  const std::vector<DiffServCodePoint>& sent_dscps() const {
+    return sent_dscps_;
+  }
+
+ private:
+  std::vector<DiffServCodePoint> sent_dscps_;
+};
+
+class AsyncUdpSocketBatchTest
+    : public testing::Test,
+      public sigslot::has_slots<> {
+ public:
+  AsyncUdpSocketBatchTest()
+      : pss_(new rtc::PhysicalSocketServer),
+        sender_(AsyncUDPSocket::Create(pss_.get(),
+                                       SocketAddress("127.0.0.1", 0))),
+        receiver_(AsyncUDPSocket::Create(pss_.get(),
+                                         SocketAddress("127.0.0.1", 0))),
+        echo_(false),
+        keep_(false) {
+    receiver_->SignalReadPacket.connect(
+        this, &AsyncUdpSocketBatchTest::OnReadPacket);
+    sender_->SignalReadPacket.connect(
+        this, &AsyncUdpSocketBatchTest::OnEchoPacket);
+  }
+
+  void OnReadPacket(AsyncPacketSocket* socket, const char* data, size_t size,
+                    const SocketAddress& remote_addr,
+                    const PacketTime& packet_time) {
+    EXPECT_EQ(sender_->GetLocalAddress(), remote_addr);
+    if (echo_) {
+      // Replies to |unsendable_| go to an address an IPv4 socket can't send
+      // to. Queued replies are reported as sent either way.
+      SocketAddress reply_addr(remote_addr);
+      if (std::string(data, size) == unsendable_) {
+        reply_addr = SocketAddress("::1", remote_addr.port());
+      }
+      PacketOptions options;
+      if (received_.size() < reply_dscps_.size()) {
+        options.dscp = reply_dscps_[received_.size()];
+      }
+      EXPECT_EQ(static_cast<int>(size),
+                socket->SendTo(data, size, reply_addr, options));
+    }
+    received_.push_back(std::string(data, size));
+  }
+
+  // Keeps the packets that are handed off as PacketBuffers, if |keep_|.
+  void OnPooledPacket(AsyncPacketSocket* socket, const char* data,
+                      size_t size, const SocketAddress& remote_addr,
+                      const PacketTime& packet_time) {
+    PacketBuffer* packet = PacketBuffer::SignaledWithData(data, size);
+    EXPECT_TRUE(packet != NULL);
+    handed_off_.push_back(packet);
+    if (keep_) {
+      kept_.push_back(packet);
+    }
+  }
+
+  void OnEchoPacket(AsyncPacketSocket* socket, const char* data, size_t size,
+                    const SocketAddress& remote_addr,
+                    const PacketTime& packet_time) {
+    echoed_.push_back(std::string(data, size));
+  }
+
+  // Replaces the receiver with one that records the DSCP of its packets.
+  DscpRecordingUDPSocket* UseDscpRecordingReceiver() {
+    AsyncSocket* socket = pss_->CreateAsyncSocket(AF_INET, SOCK_DGRAM);
+    EXPECT_EQ(0, socket->Bind(SocketAddress("127.0.0.1", 0)));
+    DscpRecordingUDPSocket* receiver = new DscpRecordingUDPSocket(socket);
+    receiver_.reset(receiver);
+    receiver_->SignalReadPacket.connect(
+        this, &AsyncUdpSocketBatchTest::OnReadPacket);
+    return receiver;
+  }
+
+  // Waits for the receiver's replies to |expected_count| packets.
+  void WaitForEchoes(size_t expected_count) {
+    uint32 start = Time();
+    while (echoed_.size() < expected_count && TimeSince(start) < kTimeout) {
+      pss_->Wait(10, true);
+    }
+    pss_->Wait(10, true);
+  }
+
+  // Sends |packets| to the receiver in one batch and waits for
+  // |expected_count| packets to arrive.
+  void SendAndReceive(const std::vector<std::string>& packets,
+                      size_t expected_count) {
+    std::vector<SendBatchEntry> entries;
+    for (size_t i = 0; i < packets.size(); ++i) {
+      entries.push_back(SendBatchEntry(packets[i].data(), packets[i].size(),
+                                       receiver_->GetLocalAddress()));
+    }
+    EXPECT_EQ(static_cast<int>(entries.size()),
+              sender_->SendToBatch(&entries[0], entries.size(),
+                                   PacketOptions()));
+    uint32 start = Time();
+    while (received_.size() < expected_count && TimeSince(start) < kTimeout) {
+      pss_->Wait(10, true);
+    }
+    // Give any unexpected extra packets a chance to show up.
+    pss_->Wait(10, true);
+  }
+
+ protected:
+  static const int kTimeout = 5000;
+
+  scoped_ptr<PhysicalSocketServer> pss_;
+  scoped_ptr<AsyncUDPSocket> sender_;
+  scoped_ptr<AsyncUDPSocket> receiver_;
+  bool echo_;
+  bool keep_;
+  std::string unsendable_;
+  std::vector<DiffServCodePoint> reply_dscps_;
+  std::vector<std::string> received_;
+  std::vector<std::string> echoed_;
+  std::vector<PacketBuffer*> handed_off_;
+  std::vector<scoped_refptr<PacketBuffer> > kept_;
+};
+
+TEST_F(AsyncUdpSocketBatchTest, SendBatchReceiveSingle) {
+  std::vector<std::string> packets;
+  packets.push_back(std::string(100, 'a'));
+  packets.push_back(std::string(1200, 'b'));
+  packets.push_back(std::string(1, 'c'));
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+}
+
+TEST_F(AsyncUdpSocketBatchTest, SendBatchReceiveBatch) {
+  receiver_->SetBatchedReceive(4, 1500);
+  std::vector<std::string> packets;
+  for (int i = 0; i < 10; ++i) {
+    packets.push_back(std::string(100 + i * 100, 'a' + i));
+  }
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+}
+
+TEST_F(AsyncUdpSocketBatchTest, ReceiveBatchDropsOversizedPackets) {
+  receiver_->SetBatchedReceive(4, 1000);
+  std::vector<std::string> packets;
+  packets.push_back(std::string(1000, 'a'));
+  packets.push_back(std::string(1001, 'b'));
+  packets.push_back(std::string(10, 'c'));
+  SendAndReceive(packets, 2);
+  ASSERT_EQ(2U, received_.size());
+  EXPECT_EQ(packets[0], received_[0]);
+  EXPECT_EQ(packets[2], received_[1]);
+}
+
+// Packets are handed off in pooled buffers, and a buffer is read into again
+// unless a receiver kept a reference to it.
+TEST_F(AsyncUdpSocketBatchTest, ReceiveHandsOffPooledBuffers) {
+  receiver_->SignalReadPacket.connect(
+      static_cast<AsyncUdpSocketBatchTest*>(this),
+      &AsyncUdpSocketBatchTest::OnPooledPacket);
+  std::vector<std::string> packets;
+  packets.push_back("first");
+  packets.push_back("second");
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+  ASSERT_EQ(2U, handed_off_.size());
+  EXPECT_EQ(handed_off_[0], handed_off_[1]);
+
+  keep_ = true;
+  received_.clear();
+  handed_off_.clear();
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+  ASSERT_EQ(2U, kept_.size());
+  EXPECT_NE(kept_[0].get(), kept_[1].get());
+  EXPECT_EQ("first", std::string(kept_[0]->buffer()->data(),
+                                 kept_[0]->buffer()->length()));
+  EXPECT_EQ("second", std::string(kept_[1]->buffer()->data(),
+                                  kept_[1]->buffer()->length()));
+  EXPECT_TRUE(PacketBuffer::Signaled() == NULL);
+}
+
+// Replies sent while a batch is signaled are queued and sent afterwards.
+TEST_F(AsyncUdpSocketBatchTest, RepliesToBatchAreSent) {
+  receiver_->SetBatchedReceive(4, 1500);
+  echo_ = true;
+  std::vector<std::string> packets;
+  for (int i = 0; i < 10; ++i) {
+    packets.push_back(std::string(100 + i * 100, 'a' + i));
+  }
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+  WaitForEchoes(packets.size());
+  EXPECT_EQ(packets, echoed_);
+  EXPECT_EQ(0U, receiver_->dropped_queued_sends());
+}
+
+// A datagram that fails doesn't keep the rest of the batch from being sent.
+TEST_F(AsyncUdpSocketBatchTest, SendBatchSkipsFailedPackets) {
+  std::string first("first");
+  std::string unsendable("unsendable");
+  std::string last("last");
+  std::vector<SendBatchEntry> entries;
+  entries.push_back(SendBatchEntry(first.data(), first.size(),
+                                   receiver_->GetLocalAddress()));
+  entries.push_back(SendBatchEntry(unsendable.data(), unsendable.size(),
+                                   SocketAddress("::1", 1)));
+  entries.push_back(SendBatchEntry(last.data(), last.size(),
+                                   receiver_->GetLocalAddress()));
+  EXPECT_EQ(2, sender_->SendToBatch(&entries[0], entries.size(),
+                                    PacketOptions()));
+  EXPECT_NE(0, sender_->GetError());
+  uint32 start = Time();
+  while (received_.size() < 2 && TimeSince(start) < kTimeout) {
+    pss_->Wait(10, true);
+  }
+  ASSERT_EQ(2U, received_.size());
+  EXPECT_EQ(first, received_[0]);
+  EXPECT_EQ(last, received_[1]);
+}
+
+// Queued replies that fail are counted, and the others are still sent.
+TEST_F(AsyncUdpSocketBatchTest, FailedRepliesToBatchAreCounted) {
+  receiver_->SetBatchedReceive(4, 1500);
+  echo_ = true;
+  unsendable_ = "b";
+  std::vector<std::string> packets;
+  packets.push_back("a");
+  packets.push_back("b");
+  packets.push_back("c");
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+  WaitForEchoes(2);
+  ASSERT_EQ(2U, echoed_.size());
+  EXPECT_EQ("a", echoed_[0]);
+  EXPECT_EQ("c", echoed_[1]);
+  EXPECT_EQ(1U, receiver_->dropped_queued_sends());
+}
+
+// Queued replies are sent with the options they were queued with.
+TEST_F(AsyncUdpSocketBatchTest, RepliesToBatchKeepTheirOptions) {
+  DscpRecordingUDPSocket* receiver = UseDscpRecordingReceiver();
+  receiver->SetBatchedReceive(4, 1500);
+  echo_ = true;
+  reply_dscps_.push_back(DSCP_NO_CHANGE);
+  reply_dscps_.push_back(DSCP_EF);
+  reply_dscps_.push_back(DSCP_EF);
+  reply_dscps_.push_back(DSCP_CS1);
+  std::vector<std::string> packets;
+  for (size_t i = 0; i < reply_dscps_.size(); ++i) {
+    packets.push_back(std::string(10, 'a' + i));
+  }
+  SendAndReceive(packets, packets.size());
+  EXPECT_EQ(packets, received_);
+  WaitForEchoes(packets.size());
+  EXPECT_EQ(packets, echoed_);
+  EXPECT_EQ(reply_dscps_, receiver->sent_dscps());
+}
+
 }  // namespace rtc
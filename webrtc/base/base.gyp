@@ -200,6 +200,8 @@
         'nullsocketserver.h',
         'optionsfile.cc',
         'optionsfile.h',
+        'packetbuffer.cc',
+        'packetbuffer.h',
         'pathutils.cc',
         'pathutils.h',
         'physicalsocketserver.cc',
@@ -258,6 +260,8 @@
         'sslfingerprint.h',
         'sslidentity.cc',
         'sslidentity.h',
+        'sslidentitypool.cc',
+        'sslidentitypool.h',
         'sslroots.h',
         'sslsocketfactory.cc',
         'sslsocketfactory.h',
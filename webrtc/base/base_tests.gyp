@@ -78,6 +78,7 @@
           'network_unittest.cc',
           'nullsocketserver_unittest.cc',
           'optionsfile_unittest.cc',
+          'packetbuffer_unittest.cc',
           'pathutils_unittest.cc',
           'physicalsocketserver_unittest.cc',
           'profiler_unittest.cc',
@@ -151,6 +152,7 @@
             'sources': [
               'ssladapter_unittest.cc',
               'sslidentity_unittest.cc',
+              'sslidentitypool_unittest.cc',
               'sslstreamadapter_unittest.cc',
             ],
           }],
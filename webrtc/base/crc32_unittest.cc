@@ -32,4 +32,31 @@ TEST(Crc32Test, TestMultipleUpdates) {
   EXPECT_EQ(0x171A3F5FU, c);
 }
 
+// The eight-bytes-at-a-time loop must agree with a plain bytewise CRC for
+// every length and alignment, including the tail bytes.
+TEST(Crc32Test, TestMatchesBytewise) {
+  uint32 table[256];
+  for (uint32 i = 0; i < 256; ++i) {
+    uint32 c = i;
+    for (int j = 0; j < 8; ++j) {
+      c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+    }
+    table[i] = c;
+  }
+  uint8 input[80];
+  for (size_t i = 0; i < sizeof(input); ++i) {
+    input[i] = static_cast<uint8>(i * 131 + 7);
+  }
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t len = 0; offset + len <= sizeof(input); ++len) {
+      uint32 c = 0xFFFFFFFF;
+      for (size_t i = 0; i < len; ++i) {
+        c = table[(c ^ input[offset + i]) & 0xFF] ^ (c >> 8);
+      }
+      EXPECT_EQ(c ^ 0xFFFFFFFF, ComputeCrc32(input + offset, len))
+          << "offset " << offset << ", length " << len;
+    }
+  }
+}
+
 }  // namespace rtc
@@ -165,6 +165,16 @@ class AtomicOps {
   static int Decrement(int* i) {
     return ::InterlockedDecrement(reinterpret_cast<LONG*>(i));
   }
+  template <class T>
+  static T* CompareAndSwapPtr(T* volatile* ptr, T* old_value, T* new_value) {
+    return static_cast<T*>(::InterlockedCompareExchangePointer(
+        reinterpret_cast<PVOID volatile*>(ptr), new_value, old_value));
+  }
+  // Volatile accesses have acquire/release semantics with MSVC.
+  template <class T>
+  static T* AcquireLoadPtr(T* volatile* ptr) {
+    return *ptr;
+  }
 #else
   static int Increment(int* i) {
     return __sync_add_and_fetch(i, 1);
@@ -172,6 +182,16 @@ class AtomicOps {
   static int Decrement(int* i) {
     return __sync_sub_and_fetch(i, 1);
   }
+  // Stores |new_value| in |*ptr| if it holds |old_value|, with a full memory
+  // barrier. Returns the previous value of |*ptr|.
+  template <class T>
+  static T* CompareAndSwapPtr(T* volatile* ptr, T* old_value, T* new_value) {
+    return __sync_val_compare_and_swap(ptr, old_value, new_value);
+  }
+  template <class T>
+  static T* AcquireLoadPtr(T* volatile* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+  }
 #endif
 };
 
@@ -108,9 +108,48 @@ void MessageQueueManager::ClearInternal(MessageHandler *handler) {
 //------------------------------------------------------------------
 // MessageQueue
 
+void MessageQueue::QueuedList::InsertAfter(QueuedMessage* pos,
+                                           QueuedMessage* qmsg) {
+  qmsg->list = this;
+  qmsg->prev = pos;
+  qmsg->next = pos ? pos->next : head;
+  if (qmsg->next) {
+    qmsg->next->prev = qmsg;
+  } else {
+    tail = qmsg;
+  }
+  if (pos) {
+    pos->next = qmsg;
+  } else {
+    head = qmsg;
+  }
+}
+
+void MessageQueue::QueuedList::Remove(QueuedMessage* qmsg) {
+  ASSERT(qmsg->list == this);
+  if (qmsg->prev) {
+    qmsg->prev->next = qmsg->next;
+  } else {
+    head = qmsg->next;
+  }
+  if (qmsg->next) {
+    qmsg->next->prev = qmsg->prev;
+  } else {
+    tail = qmsg->prev;
+  }
+  qmsg->list = NULL;
+  qmsg->next = NULL;
+  qmsg->prev = NULL;
+}
+
 MessageQueue::MessageQueue(SocketServer* ss)
-    : ss_(ss), fStop_(false), fPeekKeep_(false),
-      dmsgq_next_num_(0) {
+    : ss_(ss), fStop_(false), fPeekKeep_(false), inbox_(NULL),
+      inbox_size_(0), ready_size_(0), wheel_time_(Time()), wheel_size_(0),
+      near_size_(0), dmsgq_next_num_(0) {
+  std::fill(handler_heads_, handler_heads_ + kHandlerBuckets,
+            static_cast<QueuedMessage*>(NULL));
+  std::fill(handler_tails_, handler_tails_ + kHandlerBuckets,
+            static_cast<QueuedMessage*>(NULL));
   if (!ss_) {
     // Currently, MessageQueue holds a socket server, and is the base class for
     // Thread.  It seems like it makes more sense for Thread to hold the socket
@@ -193,29 +232,25 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
       // All queue operations need to be locked, but nothing else in this loop
       // (specifically handling disposed message) can happen inside the crit.
       // Otherwise, disposed MessageHandlers will cause deadlocks.
+      QueuedMessage* qmsg = NULL;
       {
         CritScope cs(&crit_);
-        // On the first pass, check for delayed messages that have been
-        // triggered and calculate the next trigger time.
+        DrainInbox();
+        // On the first pass, move delayed messages that have been triggered
+        // to the ready list and calculate the next trigger time.
         if (first_pass) {
           first_pass = false;
-          while (!dmsgq_.empty()) {
-            if (TimeIsLater(msCurrent, dmsgq_.top().msTrigger_)) {
-              cmsDelayNext = TimeDiff(dmsgq_.top().msTrigger_, msCurrent);
-              break;
-            }
-            msgq_.push_back(dmsgq_.top().msg_);
-            dmsgq_.pop();
-          }
+          ExpireTimers(msCurrent);
+          cmsDelayNext = NextTimerDelay(msCurrent);
         }
         // Pull a message off the message queue, if available.
-        if (msgq_.empty()) {
+        qmsg = ready_.head;
+        if (!qmsg)
           break;
-        } else {
-          *pmsg = msgq_.front();
-          msgq_.pop_front();
-        }
+        Unlink(qmsg);
       }  // crit_ is released here.
+      *pmsg = qmsg->msg;
+      delete qmsg;
 
       // Log a warning for time-sensitive messages that we're late to deliver.
       if (pmsg->ts_sensitive) {
@@ -273,11 +308,9 @@ void MessageQueue::Post(MessageHandler *phandler, uint32 id,
   if (fStop_)
     return;
 
-  // Keep thread safe
-  // Add the message to the end of the queue
-  // Signal for the multiplexer to return
+  // Keep thread safe without taking the lock: push the message onto the
+  // inbox and signal for the multiplexer to return.
 
-  CritScope cs(&crit_);
   Message msg;
   msg.phandler = phandler;
   msg.message_id = id;
@@ -285,7 +318,7 @@ void MessageQueue::Post(MessageHandler *phandler, uint32 id,
   if (time_sensitive) {
     msg.ts_sensitive = Time() + kMaxMsgLatency;
   }
-  msgq_.push_back(msg);
+  PushInbox(new QueuedMessage(msg));
   ss_->WakeUp();
 }
 
@@ -294,43 +327,39 @@ void MessageQueue::DoDelayPost(int cmsDelay, uint32 tstamp,
   if (fStop_)
     return;
 
-  // Keep thread safe
-  // Add to the priority queue. Gets sorted soonest first.
-  // Signal for the multiplexer to return.
+  // Like Post(). The message goes to the timer wheel when it leaves the
+  // inbox.
 
-  CritScope cs(&crit_);
   Message msg;
   msg.phandler = phandler;
   msg.message_id = id;
   msg.pdata = pdata;
-  DelayedMessage dmsg(cmsDelay, tstamp, dmsgq_next_num_, msg);
-  dmsgq_.push(dmsg);
-  // If this message queue processes 1 message every millisecond for 50 days,
-  // we will wrap this number.  Even then, only messages with identical times
-  // will be misordered, and then only briefly.  This is probably ok.
-  VERIFY(0 != ++dmsgq_next_num_);
+  QueuedMessage* qmsg = new QueuedMessage(msg);
+  qmsg->delayed = true;
+  qmsg->trigger = tstamp;
+  PushInbox(qmsg);
   ss_->WakeUp();
 }
 
 int MessageQueue::GetDelay() {
   CritScope cs(&crit_);
+  DrainInbox();
 
-  if (!msgq_.empty())
+  if (ready_.head)
     return 0;
 
-  if (!dmsgq_.empty()) {
-    int delay = TimeUntil(dmsgq_.top().msTrigger_);
-    if (delay < 0)
-      delay = 0;
-    return delay;
-  }
+  return NextTimerDelay(Time());
+}
 
-  return kForever;
+size_t MessageQueue::size() const {
+  CritScope cs(&crit_);
+  return ready_size_ + wheel_size_ + inbox_size_ + (fPeekKeep_ ? 1u : 0u);
 }
 
 void MessageQueue::Clear(MessageHandler *phandler, uint32 id,
                          MessageList* removed) {
   CritScope cs(&crit_);
+  DrainInbox();
 
   // Remove messages with phandler
 
@@ -343,38 +372,269 @@ void MessageQueue::Clear(MessageHandler *phandler, uint32 id,
     fPeekKeep_ = false;
   }
 
-  // Remove from ordered message queue
+  // The messages of a handler are all in one bucket of the index, whichever
+  // list they are on. Without a handler, every bucket has to be searched.
 
-  for (MessageList::iterator it = msgq_.begin(); it != msgq_.end();) {
-    if (it->Match(phandler, id)) {
-      if (removed) {
-        removed->push_back(*it);
-      } else {
-        delete it->pdata;
+  int first = 0;
+  int last = kHandlerBuckets;
+  if (phandler) {
+    first = HandlerBucket(phandler);
+    last = first + 1;
+  }
+  for (int i = first; i < last; ++i) {
+    QueuedMessage* qmsg = handler_heads_[i];
+    while (qmsg) {
+      QueuedMessage* next = qmsg->handler_next;
+      if (qmsg->msg.Match(phandler, id)) {
+        Unlink(qmsg);
+        if (removed) {
+          removed->push_back(qmsg->msg);
+        } else {
+          delete qmsg->msg.pdata;
+        }
+        delete qmsg;
       }
-      it = msgq_.erase(it);
+      qmsg = next;
+    }
+  }
+}
+
+void MessageQueue::PushInbox(QueuedMessage* qmsg) {
+  // The consumer only ever takes the whole stack, so a plain CAS loop is
+  // safe from ABA problems.
+  AtomicOps::Increment(&inbox_size_);
+  QueuedMessage* head = inbox_;
+  while (true) {
+    qmsg->next = head;
+    QueuedMessage* prev = AtomicOps::CompareAndSwapPtr(&inbox_, head, qmsg);
+    if (prev == head)
+      break;
+    head = prev;
+  }
+}
+
+void MessageQueue::DrainInbox() {
+  QueuedMessage* head = inbox_;
+  if (!head)
+    return;
+  while (true) {
+    QueuedMessage* prev = AtomicOps::CompareAndSwapPtr(
+        &inbox_, head, static_cast<QueuedMessage*>(NULL));
+    if (prev == head)
+      break;
+    head = prev;
+  }
+
+  // Reverse the stack to get the messages in posting order.
+  QueuedMessage* qmsg = NULL;
+  while (head) {
+    QueuedMessage* next = head->next;
+    head->next = qmsg;
+    qmsg = head;
+    head = next;
+  }
+
+  while (qmsg) {
+    QueuedMessage* next = qmsg->next;
+    qmsg->next = NULL;
+    AtomicOps::Decrement(&inbox_size_);
+
+    int bucket = HandlerBucket(qmsg->msg.phandler);
+    qmsg->handler_prev = handler_tails_[bucket];
+    if (handler_tails_[bucket]) {
+      handler_tails_[bucket]->handler_next = qmsg;
     } else {
-      ++it;
+      handler_heads_[bucket] = qmsg;
     }
+    handler_tails_[bucket] = qmsg;
+
+    if (qmsg->delayed) {
+      AddTimer(qmsg);
+    } else {
+      ready_.PushBack(qmsg);
+      ++ready_size_;
+    }
+    qmsg = next;
   }
+}
 
-  // Remove from priority queue. Not directly iterable, so use this approach
+void MessageQueue::AddTimer(QueuedMessage* qmsg) {
+  // If this message queue processes 1 message every millisecond for 50 days,
+  // we will wrap this number.  Even then, only messages with identical times
+  // will be misordered, and then only briefly.  This is probably ok.
+  qmsg->num = dmsgq_next_num_++;
+  // An empty wheel can skip ahead to the current time.
+  if (wheel_size_ == 0)
+    wheel_time_ = Time();
+  ++wheel_size_;
+  PlaceTimer(qmsg);
+}
 
-  PriorityQueue::container_type::iterator new_end = dmsgq_.container().begin();
-  for (PriorityQueue::container_type::iterator it = new_end;
-       it != dmsgq_.container().end(); ++it) {
-    if (it->msg_.Match(phandler, id)) {
-      if (removed) {
-        removed->push_back(it->msg_);
-      } else {
-        delete it->msg_.pdata;
+void MessageQueue::PlaceTimer(QueuedMessage* qmsg) {
+  int32 delta = TimeDiff(qmsg->trigger, wheel_time_);
+  if (delta < 0) {
+    // Already due. Keep these sorted by trigger time, then |num|; they are
+    // usually added in that order.
+    QueuedMessage* pos = late_.tail;
+    while (pos) {
+      int32 diff = TimeDiff(pos->trigger, qmsg->trigger);
+      if (diff < 0 ||
+          (diff == 0 && static_cast<int32>(pos->num - qmsg->num) < 0)) {
+        break;
       }
-    } else {
-      *new_end++ = *it;
+      pos = pos->prev;
+    }
+    late_.InsertAfter(pos, qmsg);
+  } else if (delta < kWheelSlots) {
+    // All messages in a slot have the same trigger time, but the ones
+    // cascaded from the upper levels may be older than those already there.
+    QueuedList* slot = &wheel_[qmsg->trigger & (kWheelSlots - 1)];
+    QueuedMessage* pos = slot->tail;
+    while (pos && static_cast<int32>(pos->num - qmsg->num) > 0)
+      pos = pos->prev;
+    slot->InsertAfter(pos, qmsg);
+    ++near_size_;
+  } else {
+    int level = 0;
+    int shift = kWheelBits;
+    while (level < kLevels - 1 && delta >= (1 << (shift + kLevelBits))) {
+      ++level;
+      shift += kLevelBits;
+    }
+    levels_[level][(qmsg->trigger >> shift) & (kLevelSlots - 1)].PushBack(
+        qmsg);
+  }
+}
+
+void MessageQueue::CascadeTimers(int level, int index) {
+  QueuedList* slot = &levels_[level][index];
+  QueuedMessage* qmsg = slot->head;
+  slot->head = NULL;
+  slot->tail = NULL;
+  while (qmsg) {
+    QueuedMessage* next = qmsg->next;
+    qmsg->next = NULL;
+    qmsg->prev = NULL;
+    PlaceTimer(qmsg);
+    qmsg = next;
+  }
+}
+
+void MessageQueue::ExpireTimers(uint32 now) {
+  while (QueuedMessage* qmsg = late_.head) {
+    late_.Remove(qmsg);
+    --wheel_size_;
+    ready_.PushBack(qmsg);
+    ++ready_size_;
+  }
+
+  while (wheel_size_ > 0 && !TimeIsLater(now, wheel_time_)) {
+    int index = wheel_time_ & (kWheelSlots - 1);
+    if (index == 0) {
+      // The first level has turned; bring down the next range of messages.
+      int shift = kWheelBits;
+      for (int level = 0; level < kLevels; ++level, shift += kLevelBits) {
+        int level_index = (wheel_time_ >> shift) & (kLevelSlots - 1);
+        CascadeTimers(level, level_index);
+        if (level_index != 0)
+          break;
+      }
+    }
+
+    if (near_size_ == 0) {
+      // Nothing can be due before the first level turns again.
+      uint32 next_turn = (wheel_time_ | (kWheelSlots - 1)) + 1;
+      if (TimeIsLater(now, next_turn)) {
+        wheel_time_ = now + 1;
+        break;
+      }
+      wheel_time_ = next_turn;
+      continue;
+    }
+
+    QueuedList* slot = &wheel_[index];
+    while (QueuedMessage* qmsg = slot->head) {
+      slot->Remove(qmsg);
+      --near_size_;
+      --wheel_size_;
+      ready_.PushBack(qmsg);
+      ++ready_size_;
     }
+    ++wheel_time_;
   }
-  dmsgq_.container().erase(new_end, dmsgq_.container().end());
-  dmsgq_.reheap();
+}
+
+int MessageQueue::NextTimerDelay(uint32 now) {
+  if (wheel_size_ == 0)
+    return kForever;
+  if (late_.head)
+    return 0;
+
+  bool found = false;
+  uint32 next = 0;
+  if (near_size_ > 0) {
+    for (uint32 t = wheel_time_; !found; ++t) {
+      if (wheel_[t & (kWheelSlots - 1)].head) {
+        next = t;
+        found = true;
+      }
+    }
+  }
+  // Messages on the upper levels can be due before the first level ones, as
+  // they are only cascaded when the first level turns. Within a level, the
+  // first occupied slot after the current one holds the earliest messages.
+  int shift = kWheelBits;
+  for (int level = 0; level < kLevels; ++level, shift += kLevelBits) {
+    int current = (wheel_time_ >> shift) & (kLevelSlots - 1);
+    for (int i = 1; i <= kLevelSlots; ++i) {
+      const QueuedList& slot =
+          levels_[level][(current + i) & (kLevelSlots - 1)];
+      if (!slot.head)
+        continue;
+      for (QueuedMessage* qmsg = slot.head; qmsg; qmsg = qmsg->next) {
+        if (!found || TimeIsLater(qmsg->trigger, next)) {
+          next = qmsg->trigger;
+          found = true;
+        }
+      }
+      break;
+    }
+  }
+  ASSERT(found);
+  return _max(0, TimeDiff(next, now));
+}
+
+void MessageQueue::Unlink(QueuedMessage* qmsg) {
+  QueuedList* list = qmsg->list;
+  if (list == &ready_) {
+    --ready_size_;
+  } else {
+    --wheel_size_;
+    if (list == &wheel_[qmsg->trigger & (kWheelSlots - 1)])
+      --near_size_;
+  }
+  list->Remove(qmsg);
+
+  int bucket = HandlerBucket(qmsg->msg.phandler);
+  if (qmsg->handler_prev) {
+    qmsg->handler_prev->handler_next = qmsg->handler_next;
+  } else {
+    handler_heads_[bucket] = qmsg->handler_next;
+  }
+  if (qmsg->handler_next) {
+    qmsg->handler_next->handler_prev = qmsg->handler_prev;
+  } else {
+    handler_tails_[bucket] = qmsg->handler_prev;
+  }
+  qmsg->handler_next = NULL;
+  qmsg->handler_prev = NULL;
+}
+
+int MessageQueue::HandlerBucket(MessageHandler* handler) {
+  // Handlers are heap objects, so the lowest bits carry little information.
+  size_t bits = reinterpret_cast<size_t>(handler);
+  bits ^= bits >> 12;
+  return static_cast<int>((bits >> 4) & (kHandlerBuckets - 1));
 }
 
 void MessageQueue::Dispatch(Message *pmsg) {
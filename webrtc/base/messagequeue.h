@@ -15,7 +15,6 @@
 
 #include <algorithm>
 #include <list>
-#include <queue>
 #include <vector>
 
 #include "webrtc/base/basictypes.h"
@@ -144,25 +143,6 @@ struct Message {
 
 typedef std::list<Message> MessageList;
 
-// DelayedMessage goes into a priority queue, sorted by trigger time.  Messages
-// with the same trigger time are processed in num_ (FIFO) order.
-
-class DelayedMessage {
- public:
-  DelayedMessage(int delay, uint32 trigger, uint32 num, const Message& msg)
-  : cmsDelay_(delay), msTrigger_(trigger), num_(num), msg_(msg) { }
-
-  bool operator< (const DelayedMessage& dmsg) const {
-    return (dmsg.msTrigger_ < msTrigger_)
-           || ((dmsg.msTrigger_ == msTrigger_) && (dmsg.num_ < num_));
-  }
-
-  int cmsDelay_;  // for debugging
-  uint32 msTrigger_;
-  uint32 num_;
-  Message msg_;
-};
-
 class MessageQueue {
  public:
   explicit MessageQueue(SocketServer* ss = NULL);
@@ -207,10 +187,7 @@ class MessageQueue {
   virtual int GetDelay();
 
   bool empty() const { return size() == 0u; }
-  size_t size() const {
-    CritScope cs(&crit_);  // msgq_.size() is not thread safe.
-    return msgq_.size() + dmsgq_.size() + (fPeekKeep_ ? 1u : 0u);
-  }
+  size_t size() const;
 
   // Internally posts a message which causes the doomed object to be deleted
   template<class T> void Dispose(T* doomed) {
@@ -224,15 +201,73 @@ class MessageQueue {
   sigslot::signal0<> SignalQueueDestroyed;
 
  protected:
-  class PriorityQueue : public std::priority_queue<DelayedMessage> {
-   public:
-    container_type& container() { return c; }
-    void reheap() { make_heap(c.begin(), c.end(), comp); }
+  // A posted message together with the links that keep it in the queue.
+  // Posts push these onto a lock-free stack, the inbox, from which the
+  // thread calling Get() moves them to the ready list or the timer wheel.
+  struct QueuedMessage;
+
+  // A doubly-linked list of QueuedMessages.
+  struct QueuedList {
+    QueuedList() : head(NULL), tail(NULL) {}
+    // Inserts |qmsg| after |pos|, or at the front if |pos| is NULL.
+    void InsertAfter(QueuedMessage* pos, QueuedMessage* qmsg);
+    void PushBack(QueuedMessage* qmsg) { InsertAfter(tail, qmsg); }
+    void Remove(QueuedMessage* qmsg);
+
+    QueuedMessage* head;
+    QueuedMessage* tail;
+  };
+
+  struct QueuedMessage {
+    explicit QueuedMessage(const Message& msg)
+        : msg(msg), trigger(0), num(0), delayed(false), list(NULL),
+          next(NULL), prev(NULL), handler_next(NULL), handler_prev(NULL) {}
+
+    Message msg;
+    // When a delayed message is due. Messages with the same trigger time are
+    // processed in |num| (FIFO) order.
+    uint32 trigger;
+    uint32 num;
+    bool delayed;
+    // The list the message is on, NULL while it is in the inbox.
+    QueuedList* list;
+    QueuedMessage* next;
+    QueuedMessage* prev;
+    // Links the messages whose handlers share a bucket of the handler index.
+    QueuedMessage* handler_next;
+    QueuedMessage* handler_prev;
   };
 
+  // Delayed messages are kept in a hierarchical timer wheel: the first level
+  // has one slot per millisecond for the next 256 ms, and each further level
+  // covers 64 times the range of the one below with 64 slots. Slots of the
+  // upper levels are cascaded down as the wheel turns.
+  static const int kWheelBits = 8;
+  static const int kWheelSlots = 1 << kWheelBits;
+  static const int kLevelBits = 6;
+  static const int kLevelSlots = 1 << kLevelBits;
+  static const int kLevels = 4;
+  static const int kHandlerBuckets = 64;
+
   void DoDelayPost(int cmsDelay, uint32 tstamp, MessageHandler *phandler,
                    uint32 id, MessageData* pdata);
 
+  // Called by any thread, without |crit_|.
+  void PushInbox(QueuedMessage* qmsg);
+  // The remaining helpers require |crit_|.
+  // Moves everything posted so far out of the inbox, in posting order.
+  void DrainInbox();
+  void AddTimer(QueuedMessage* qmsg);
+  void PlaceTimer(QueuedMessage* qmsg);
+  void CascadeTimers(int level, int index);
+  // Moves the delayed messages due at |now| to the ready list.
+  void ExpireTimers(uint32 now);
+  // Returns the time until the next delayed message is due, or kForever.
+  int NextTimerDelay(uint32 now);
+  // Unlinks |qmsg| from its list and the handler index.
+  void Unlink(QueuedMessage* qmsg);
+  static int HandlerBucket(MessageHandler* handler);
+
   // The SocketServer is not owned by MessageQueue.
   SocketServer* ss_;
   // If a server isn't supplied in the constructor, use this one.
@@ -240,9 +275,27 @@ class MessageQueue {
   bool fStop_;
   bool fPeekKeep_;
   Message msgPeek_;
-  MessageList msgq_;
-  PriorityQueue dmsgq_;
+  // Newest first. Any thread pushes to it with AtomicOps.
+  QueuedMessage* volatile inbox_;
+  int inbox_size_;
+  QueuedList ready_;
+  size_t ready_size_;
+  // Delayed messages whose trigger time had passed when they were added to
+  // the wheel, sorted by trigger time.
+  QueuedList late_;
+  QueuedList wheel_[kWheelSlots];
+  QueuedList levels_[kLevels][kLevelSlots];
+  // The next millisecond of the wheel to process.
+  uint32 wheel_time_;
+  // All delayed messages, including |late_|.
+  size_t wheel_size_;
+  // How many of them are in |wheel_|.
+  size_t near_size_;
   uint32 dmsgq_next_num_;
+  // All queued messages in posting order, hashed by handler, so that
+  // Clear(handler) only looks at a fraction of them.
+  QueuedMessage* handler_heads_[kHandlerBuckets];
+  QueuedMessage* handler_tails_[kHandlerBuckets];
   mutable CriticalSection crit_;
 
  private:
@@ -139,3 +139,140 @@ TEST(MessageQueueManager, Clear) {
   EXPECT_TRUE(deleted);
   EXPECT_FALSE(MessageQueueManager::IsInitialized());
 }
+
+class CountingHandler : public MessageHandler {
+ public:
+  CountingHandler() : count_(0) {}
+  void OnMessage(Message* msg) { ++count_; }
+  int count() const { return count_; }
+ private:
+  int count_;
+};
+
+TEST_F(MessageQueueTest, DelayedPostsOnUpperWheelLevels) {
+  CountingHandler handler;
+  PostDelayed(20, &handler, 1);
+  PostDelayed(300, &handler, 2);
+  PostDelayed(20000, &handler, 3);
+  PostDelayed(5000000, &handler, 4);
+  EXPECT_EQ(4U, size());
+  int delay = GetDelay();
+  EXPECT_LE(0, delay);
+  EXPECT_GE(20, delay);
+
+  Message msg;
+  EXPECT_TRUE(Get(&msg, 1000));
+  EXPECT_EQ(1U, msg.message_id);
+  // This one has to be cascaded down from the second level.
+  delay = GetDelay();
+  EXPECT_LT(200, delay);
+  EXPECT_GE(300, delay);
+  EXPECT_TRUE(Get(&msg, 1000));
+  EXPECT_EQ(2U, msg.message_id);
+
+  delay = GetDelay();
+  EXPECT_LT(19000, delay);
+  EXPECT_GE(20000, delay);
+  Clear(&handler, 3);
+  delay = GetDelay();
+  EXPECT_LT(4000000, delay);
+  EXPECT_GE(5000000, delay);
+  Clear(&handler);
+  EXPECT_TRUE(empty());
+  EXPECT_EQ(kForever, GetDelay());
+}
+
+TEST_F(MessageQueueTest, ClearOnlyRemovesMatchingMessages) {
+  CountingHandler handler1;
+  CountingHandler handler2;
+  for (uint32 i = 0; i < 10; ++i) {
+    Post(&handler1, i);
+    Post(&handler2, i);
+    PostDelayed(1000, &handler1, i);
+    PostDelayed(1000, &handler2, i);
+  }
+  EXPECT_EQ(40U, size());
+
+  MessageList removed;
+  Clear(&handler1, 5, &removed);
+  EXPECT_EQ(2U, removed.size());
+  EXPECT_EQ(38U, size());
+
+  // Removed messages are returned in the order they were posted.
+  removed.clear();
+  Clear(&handler1, MQID_ANY, &removed);
+  ASSERT_EQ(18U, removed.size());
+  EXPECT_EQ(0U, removed.front().message_id);
+  EXPECT_EQ(9U, removed.back().message_id);
+  for (MessageList::iterator it = removed.begin(); it != removed.end(); ++it)
+    EXPECT_EQ(&handler1, it->phandler);
+  EXPECT_EQ(20U, size());
+
+  Message msg;
+  for (uint32 i = 0; i < 10; ++i) {
+    EXPECT_TRUE(Get(&msg, 0));
+    EXPECT_EQ(&handler2, msg.phandler);
+    EXPECT_EQ(i, msg.message_id);
+  }
+  EXPECT_FALSE(Get(&msg, 0));
+  Clear(NULL);
+  EXPECT_TRUE(empty());
+}
+
+// Posts |count| messages to a queue from its own thread.
+class PostingThread : public Thread {
+ public:
+  PostingThread(MessageQueue* queue, MessageHandler* handler, int count)
+      : queue_(queue), handler_(handler), count_(count) {}
+  virtual ~PostingThread() { Stop(); }
+  virtual void Run() {
+    for (int i = 0; i < count_; ++i)
+      queue_->Post(handler_, i);
+  }
+ private:
+  MessageQueue* queue_;
+  MessageHandler* handler_;
+  int count_;
+};
+
+TEST_F(MessageQueueTest, ContendedPostPerformance) {
+  const int kThreads = 4;
+  const int kPostsPerThread = 50000;
+  CountingHandler handler;
+  scoped_ptr<PostingThread> threads[kThreads];
+  uint32 start = Time();
+  for (int i = 0; i < kThreads; ++i) {
+    threads[i].reset(new PostingThread(this, &handler, kPostsPerThread));
+    threads[i]->Start();
+  }
+  Message msg;
+  while (handler.count() < kThreads * kPostsPerThread &&
+         Get(&msg, 10000)) {
+    Dispatch(&msg);
+  }
+  uint32 elapsed = TimeSince(start);
+  EXPECT_EQ(kThreads * kPostsPerThread, handler.count());
+  LOG(LS_INFO) << kThreads << " threads posting " << kPostsPerThread
+               << " messages each: " << elapsed << " ms";
+}
+
+TEST_F(MessageQueueTest, DelayedPostAndClearPerformance) {
+  const int kHandlers = 100;
+  const int kPostsPerHandler = 200;
+  CountingHandler handlers[kHandlers];
+  uint64 start = TimeMicros();
+  for (int i = 0; i < kPostsPerHandler; ++i) {
+    for (int j = 0; j < kHandlers; ++j)
+      PostDelayed(1000 + (i * 7919 + j * 104729) % 100000, &handlers[j], i);
+  }
+  // Moves the posts onto the timer wheel.
+  EXPECT_LT(0, GetDelay());
+  uint64 posted = TimeMicros();
+  for (int j = 0; j < kHandlers; ++j)
+    Clear(&handlers[j]);
+  uint64 cleared = TimeMicros();
+  EXPECT_TRUE(empty());
+  LOG(LS_INFO) << kHandlers * kPostsPerHandler << " delayed posts: "
+               << posted - start << " us, clearing them by handler: "
+               << cleared - posted << " us";
+}
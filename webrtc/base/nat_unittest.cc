@@ -9,6 +9,7 @@
  */
 
 #include <string>
+#include <vector>
 
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/logging.h"
@@ -18,6 +19,7 @@
 #include "webrtc/base/network.h"
 #include "webrtc/base/physicalsocketserver.h"
 #include "webrtc/base/testclient.h"
+#include "webrtc/base/timeutils.h"
 #include "webrtc/base/virtualsocketserver.h"
 #include "webrtc/test/testsupport/gtest_disable.h"
 
@@ -50,6 +52,7 @@ void TestSend(
   server_addr.SetPort(0);  // Auto-select a port
   NATServer* nat = new NATServer(
       nat_type, internal, server_addr, external, external_addrs[0]);
+  nat->set_external_thread(&th_ext);
   NATSocketFactory* natsf = new NATSocketFactory(internal,
                                                  nat->internal_address());
 
@@ -101,6 +104,7 @@ void TestRecv(
   server_addr.SetPort(0);  // Auto-select a port
   NATServer* nat = new NATServer(
       nat_type, internal, server_addr, external, external_addrs[0]);
+  nat->set_external_thread(&th_ext);
   NATSocketFactory* natsf = new NATSocketFactory(internal,
                                                  nat->internal_address());
 
@@ -291,6 +295,177 @@ TEST(NatTest, TestVirtualIPv6) {
   }
 }
 
+// Tests that a translation that stays idle past the mapping timeout stops
+// letting packets in, and is replaced when the internal client sends again.
+TEST(NatTest, TestMappingExpiry) {
+  const int kMappingTimeout = 200;
+  scoped_ptr<TestVirtualSocketServer> int_vss(new TestVirtualSocketServer(
+      new PhysicalSocketServer()));
+  scoped_ptr<TestVirtualSocketServer> ext_vss(new TestVirtualSocketServer(
+      new PhysicalSocketServer()));
+  SocketAddress int_addr(int_vss->GetNextIP(AF_INET), 0);
+  SocketAddress ext_addr(ext_vss->GetNextIP(AF_INET), 0);
+  Thread th_int(int_vss.get());
+  Thread th_ext(ext_vss.get());
+
+  NATServer nat(NAT_PORT_RESTRICTED, int_vss.get(), int_addr,
+                ext_vss.get(), ext_addr);
+  nat.set_mapping_timeout(kMappingTimeout);
+  nat.set_external_thread(&th_ext);
+  NATSocketFactory natsf(int_vss.get(), nat.internal_address());
+  scoped_ptr<TestClient> in(CreateTestClient(&natsf, int_addr));
+  scoped_ptr<TestClient> out(CreateTestClient(ext_vss.get(), ext_addr));
+
+  th_int.Start();
+  th_ext.Start();
+
+  const char* buf = "expiry_test";
+  size_t len = strlen(buf);
+
+  in->SendTo(buf, len, out->address());
+  SocketAddress trans_addr;
+  EXPECT_TRUE(out->CheckNextPacket(buf, len, &trans_addr));
+  out->SendTo(buf, len, trans_addr);
+  EXPECT_TRUE(in->CheckNextPacket(buf, len, NULL));
+  EXPECT_EQ(1U, nat.mapping_count());
+
+  Thread::Current()->SleepMs(kMappingTimeout + 50);
+  out->SendTo(buf, len, trans_addr);
+  EXPECT_TRUE(in->CheckNoPacket());
+
+  in->SendTo(buf, len, out->address());
+  SocketAddress trans_addr2;
+  EXPECT_TRUE(out->CheckNextPacket(buf, len, &trans_addr2));
+  EXPECT_NE(trans_addr, trans_addr2);
+  EXPECT_EQ(1U, nat.mapping_count());
+
+  th_int.Stop();
+  th_ext.Stop();
+}
+
+// Tests that each internal IP gets its own block of external ports, and that
+// translations beyond the block are refused.
+TEST(NatTest, TestPortBlocks) {
+  const int kBlockSize = 4;
+  scoped_ptr<TestVirtualSocketServer> int_vss(new TestVirtualSocketServer(
+      new PhysicalSocketServer()));
+  scoped_ptr<TestVirtualSocketServer> ext_vss(new TestVirtualSocketServer(
+      new PhysicalSocketServer()));
+  SocketAddress int_addr1(int_vss->GetNextIP(AF_INET), 0);
+  SocketAddress int_addr2(int_vss->GetNextIP(AF_INET), 0);
+  SocketAddress ext_addr(ext_vss->GetNextIP(AF_INET), 0);
+  Thread th_int(int_vss.get());
+  Thread th_ext(ext_vss.get());
+
+  NATServer nat(NAT_SYMMETRIC, int_vss.get(), int_addr1,
+                ext_vss.get(), ext_addr);
+  nat.set_port_block_size(kBlockSize);
+  nat.set_external_thread(&th_ext);
+  NATSocketFactory natsf(int_vss.get(), nat.internal_address());
+  scoped_ptr<TestClient> in1(CreateTestClient(&natsf, int_addr1));
+  scoped_ptr<TestClient> in2(CreateTestClient(&natsf, int_addr2));
+  scoped_ptr<TestClient> out[kBlockSize + 1];
+  for (int i = 0; i < kBlockSize + 1; ++i)
+    out[i].reset(CreateTestClient(ext_vss.get(), ext_addr));
+
+  th_int.Start();
+  th_ext.Start();
+
+  const char* buf = "port_block_test";
+  size_t len = strlen(buf);
+
+  // A symmetric NAT needs a new port for every destination.
+  SocketAddress first_addr;
+  for (int i = 0; i < kBlockSize; ++i) {
+    in1->SendTo(buf, len, out[i]->address());
+    SocketAddress trans_addr;
+    EXPECT_TRUE(out[i]->CheckNextPacket(buf, len, &trans_addr));
+    if (i == 0)
+      first_addr = trans_addr;
+    EXPECT_EQ(first_addr.port() + i, trans_addr.port());
+  }
+
+  // The block of the first IP is used up.
+  in1->SendTo(buf, len, out[kBlockSize]->address());
+  EXPECT_TRUE(out[kBlockSize]->CheckNoPacket());
+
+  // The second IP starts a block of its own.
+  in2->SendTo(buf, len, out[kBlockSize]->address());
+  SocketAddress trans_addr;
+  EXPECT_TRUE(out[kBlockSize]->CheckNextPacket(buf, len, &trans_addr));
+  EXPECT_EQ(first_addr.port() + kBlockSize, trans_addr.port());
+  EXPECT_EQ(static_cast<size_t>(kBlockSize + 1), nat.mapping_count());
+
+  th_int.Stop();
+  th_ext.Stop();
+}
+
+// Measures how fast the NAT forwards outbound packets of many synthetic flows,
+// to see whether the cost per packet grows with the number of flows. Both runs
+// forward the same number of packets, among 100 times as many flows in the
+// second. The timings are only logged, as they depend on the machine; the
+// test is disabled by default and takes a few seconds.
+TEST(NatTest, DISABLED_TranslationPerformance) {
+  const int kFlowsPerIP = 4;
+  const int kPacketsPerRun = 200000;
+  const int kInternalIPCounts[] = { 25, 2500 };
+  const char kPayload[] = "synthetic flow payload";
+
+  // One encoded packet per destination; flows differ by their source.
+  char packets[kFlowsPerIP][kNATEncodedIPv6AddressSize + sizeof(kPayload)];
+  size_t packet_sizes[kFlowsPerIP];
+  for (int i = 0; i < kFlowsPerIP; ++i) {
+    SocketAddress dest(IPAddress(0xC0A80001 + i), 3478);
+    size_t addr_size = PackAddressForNAT(packets[i], sizeof(packets[i]), dest);
+    memcpy(packets[i] + addr_size, kPayload, sizeof(kPayload));
+    packet_sizes[i] = addr_size + sizeof(kPayload);
+  }
+
+  for (size_t run = 0; run < ARRAY_SIZE(kInternalIPCounts); ++run) {
+    const int ip_count = kInternalIPCounts[run];
+    scoped_ptr<TestVirtualSocketServer> int_vss(new TestVirtualSocketServer(
+        new PhysicalSocketServer()));
+    scoped_ptr<TestVirtualSocketServer> ext_vss(new TestVirtualSocketServer(
+        new PhysicalSocketServer()));
+    Thread th_int(int_vss.get());
+    Thread th_ext(ext_vss.get());
+    NATServer nat(NAT_SYMMETRIC, int_vss.get(),
+                  SocketAddress(int_vss->GetNextIP(AF_INET), 0),
+                  ext_vss.get(), SocketAddress(ext_vss->GetNextIP(AF_INET), 0));
+
+    std::vector<SocketAddress> sources;
+    for (int i = 0; i < ip_count; ++i)
+      sources.push_back(SocketAddress(IPAddress(0x0A000000 + i), 5000));
+
+    // The first packet of every flow creates its translation.
+    uint64 start = TimeMicros();
+    for (int i = 0; i < ip_count; ++i) {
+      for (int j = 0; j < kFlowsPerIP; ++j) {
+        nat.OnInternalPacket(NULL, packets[j], packet_sizes[j], sources[i],
+                             PacketTime());
+      }
+    }
+    uint64 setup_us = TimeMicros() - start;
+    EXPECT_EQ(static_cast<size_t>(ip_count * kFlowsPerIP),
+              nat.mapping_count());
+
+    start = TimeMicros();
+    for (int n = 0; n < kPacketsPerRun; ++n) {
+      int flow = n % (ip_count * kFlowsPerIP);
+      nat.OnInternalPacket(NULL, packets[flow % kFlowsPerIP],
+                           packet_sizes[flow % kFlowsPerIP],
+                           sources[flow / kFlowsPerIP], PacketTime());
+    }
+    uint64 forward_us = TimeMicros() - start;
+
+    LOG(LS_INFO) << ip_count * kFlowsPerIP << " flows: set up in "
+                 << setup_us / 1000 << " ms, forwarded " << kPacketsPerRun
+                 << " packets in " << forward_us / 1000 << " ms ("
+                 << kPacketsPerRun * 1000LL / (forward_us + 1)
+                 << " packets/ms)";
+  }
+}
+
 // TODO: Finish this test
 class NatTcpTest : public testing::Test, public sigslot::has_slots<> {
  public:
@@ -8,84 +8,229 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <algorithm>
+
 #include "webrtc/base/natsocketfactory.h"
 #include "webrtc/base/natserver.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
 
 namespace rtc {
 
-RouteCmp::RouteCmp(NAT* nat) : symmetric(nat->IsSymmetric()) {
-}
+namespace {
 
-size_t RouteCmp::operator()(const SocketAddressPair& r) const {
-  size_t h = r.source().Hash();
-  if (symmetric)
-    h ^= r.destination().Hash();
-  return h;
-}
+// Port blocks are carved out of this range, leaving the well-known ports alone.
+const int kFirstBlockPort = 1024;
+const int kLastBlockPort = 65535;
 
-bool RouteCmp::operator()(
-      const SocketAddressPair& r1, const SocketAddressPair& r2) const {
-  if (r1.source() < r2.source())
-    return true;
-  if (r2.source() < r1.source())
-    return false;
-  if (symmetric && (r1.destination() < r2.destination()))
-    return true;
-  if (symmetric && (r2.destination() < r1.destination()))
-    return false;
-  return false;
-}
+// Packets up to this size are forwarded inward without a heap allocation.
+const size_t kStackPacketSize = 2048;
 
-AddrCmp::AddrCmp(NAT* nat)
-    : use_ip(nat->FiltersIP()), use_port(nat->FiltersPort()) {
-}
+enum {
+  MSG_DELETE_RETIRED,
+};
+
+// Hashes keys that have a Hash() method.
+struct KeyHash {
+  template <class T>
+  size_t operator()(const T& key) const { return key.Hash(); }
+};
+
+struct PointerHash {
+  size_t operator()(const void* p) const {
+    uintptr_t v = reinterpret_cast<uintptr_t>(p);
+    return static_cast<size_t>(v ^ (v >> 4) ^ (v >> 12));
+  }
+};
+
+// A small chained hash map. |Key| needs operator==, and |Hash| maps it to a
+// size_t.
+template <class Key, class Value, class Hash>
+class HashMap {
+ public:
+  HashMap() : buckets_(kInitialBuckets, static_cast<Node*>(NULL)), size_(0) {}
+  ~HashMap() {
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      Node* node = buckets_[i];
+      while (node) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+      }
+    }
+  }
+
+  size_t size() const { return size_; }
+
+  // Returns the value stored for |key|, or NULL.
+  Value* Find(const Key& key) {
+    for (Node* node = buckets_[BucketOf(key)]; node; node = node->next) {
+      if (node->key == key)
+        return &node->value;
+    }
+    return NULL;
+  }
+
+  // Adds |key|, which must not be in the map yet.
+  void Insert(const Key& key, const Value& value) {
+    ASSERT(Find(key) == NULL);
+    if (size_ >= buckets_.size())
+      Grow();
+    Node*& head = buckets_[BucketOf(key)];
+    head = new Node(key, value, head);
+    ++size_;
+  }
+
+  void Erase(const Key& key) {
+    for (Node** link = &buckets_[BucketOf(key)]; *link;
+         link = &(*link)->next) {
+      if ((*link)->key == key) {
+        Node* node = *link;
+        *link = node->next;
+        delete node;
+        --size_;
+        return;
+      }
+    }
+  }
+
+  void GetValues(std::vector<Value>* values) const {
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      for (Node* node = buckets_[i]; node; node = node->next)
+        values->push_back(node->value);
+    }
+  }
+
+ private:
+  static const size_t kInitialBuckets = 16;
 
-size_t AddrCmp::operator()(const SocketAddress& a) const {
-  size_t h = 0;
-  if (use_ip)
-    h ^= HashIP(a.ipaddr());
-  if (use_port)
-    h ^= a.port() | (a.port() << 16);
-  return h;
+  struct Node {
+    Node(const Key& k, const Value& v, Node* n) : key(k), value(v), next(n) {}
+    Key key;
+    Value value;
+    Node* next;
+  };
+
+  // The bucket count is always a power of two.
+  size_t BucketOf(const Key& key) const {
+    return hash_(key) & (buckets_.size() - 1);
+  }
+
+  void Grow() {
+    std::vector<Node*> old_buckets(buckets_.size() * 2,
+                                   static_cast<Node*>(NULL));
+    old_buckets.swap(buckets_);
+    for (size_t i = 0; i < old_buckets.size(); ++i) {
+      Node* node = old_buckets[i];
+      while (node) {
+        Node* next = node->next;
+        Node*& head = buckets_[BucketOf(node->key)];
+        node->next = head;
+        head = node;
+        node = next;
+      }
+    }
+  }
+
+  std::vector<Node*> buckets_;
+  size_t size_;
+  Hash hash_;
+};
+
+}  // namespace
+
+class NATServer::InternalMap
+    : public HashMap<NATServer::RouteKey, NATServer::TransEntry*, KeyHash> {
+};
+
+class NATServer::ExternalMap
+    : public HashMap<const AsyncPacketSocket*, NATServer::TransEntry*,
+                     PointerHash> {
+};
+
+class NATServer::PortBlockMap
+    : public HashMap<SocketAddressKey, NATServer::PortBlock*, KeyHash> {
+};
+
+// Owns the external socket of a translation and forwards its packets.  The
+// socket signals this object rather than the server, so that the two can be
+// deleted on the external thread without touching the server's slots, which
+// the internal thread uses.
+class NATServer::ExternalReceiver : public sigslot::has_slots<> {
+ public:
+  ExternalReceiver(NATServer* server, AsyncUDPSocket* socket)
+      : server_(server), socket_(socket) {
+    socket_->SignalReadPacket.connect(this, &ExternalReceiver::OnReadPacket);
+  }
+  ~ExternalReceiver() { delete socket_; }
+
+  AsyncUDPSocket* socket() const { return socket_; }
+
+ private:
+  void OnReadPacket(AsyncPacketSocket* socket, const char* buf, size_t size,
+                    const SocketAddress& remote_addr,
+                    const PacketTime& packet_time) {
+    server_->OnExternalPacket(socket, buf, size, remote_addr, packet_time);
+  }
+
+  NATServer* server_;
+  AsyncUDPSocket* socket_;
+  DISALLOW_COPY_AND_ASSIGN(ExternalReceiver);
+};
+
+bool NATServer::RouteKey::operator==(const RouteKey& key) const {
+  return source == key.source && destination == key.destination;
 }
 
-bool AddrCmp::operator()(
-      const SocketAddress& a1, const SocketAddress& a2) const {
-  if (use_ip && (a1.ipaddr() < a2.ipaddr()))
-    return true;
-  if (use_ip && (a2.ipaddr() < a1.ipaddr()))
-    return false;
-  if (use_port && (a1.port() < a2.port()))
-    return true;
-  if (use_port && (a2.port() < a1.port()))
-    return false;
-  return false;
+size_t NATServer::RouteKey::Hash() const {
+  return source.Hash() ^ (destination.Hash() * 16777619U);
 }
 
 NATServer::NATServer(
     NATType type, SocketFactory* internal, const SocketAddress& internal_addr,
     SocketFactory* external, const SocketAddress& external_ip)
-    : external_(external), external_ip_(external_ip.ipaddr(), 0) {
+    : external_(external), external_ip_(external_ip.ipaddr(), 0),
+      external_thread_(NULL), mapping_timeout_(0), last_sweep_(Time()),
+      port_block_size_(0), next_block_port_(kFirstBlockPort) {
   nat_ = NAT::Create(type);
+  symmetric_ = nat_->IsSymmetric();
+  filters_ip_ = nat_->FiltersIP();
+  filters_port_ = nat_->FiltersPort();
 
   server_socket_ = AsyncUDPSocket::Create(internal, internal_addr);
   server_socket_->SignalReadPacket.connect(this, &NATServer::OnInternalPacket);
 
-  int_map_ = new InternalMap(RouteCmp(nat_));
+  int_map_ = new InternalMap();
   ext_map_ = new ExternalMap();
+  block_map_ = new PortBlockMap();
 }
 
 NATServer::~NATServer() {
-  for (InternalMap::iterator iter = int_map_->begin();
-       iter != int_map_->end();
-       iter++)
-    delete iter->second;
+  if (external_thread_)
+    external_thread_->Clear(this);
+  for (size_t i = 0; i < retired_.size(); ++i)
+    delete retired_[i];
+
+  std::vector<TransEntry*> entries;
+  int_map_->GetValues(&entries);
+  for (size_t i = 0; i < entries.size(); ++i)
+    delete entries[i];
+
+  std::vector<PortBlock*> blocks;
+  block_map_->GetValues(&blocks);
+  for (size_t i = 0; i < blocks.size(); ++i)
+    delete blocks[i];
 
   delete nat_;
   delete server_socket_;
   delete int_map_;
   delete ext_map_;
+  delete block_map_;
+}
+
+size_t NATServer::mapping_count() const {
+  CritScope cs(&crit_);
+  return ext_map_->size();
 }
 
 void NATServer::OnInternalPacket(
@@ -96,91 +241,258 @@ void NATServer::OnInternalPacket(
   SocketAddress dest_addr;
   size_t length = UnpackAddressFromNAT(buf, size, &dest_addr);
 
+  uint32 now = Time();
+  if (mapping_timeout_ > 0)
+    ExpireIdleEntries(now);
+
   // Find the translation for these addresses (allocating one if necessary).
-  SocketAddressPair route(addr, dest_addr);
-  InternalMap::iterator iter = int_map_->find(route);
-  if (iter == int_map_->end()) {
-    Translate(route);
-    iter = int_map_->find(route);
+  RouteKey key = MakeRouteKey(addr, dest_addr);
+  TransEntry* const* found = int_map_->Find(key);
+  TransEntry* entry = found ? *found : NULL;
+  if (entry && IsExpired(entry, now)) {
+    RemoveEntry(entry);
+    entry = NULL;
+  }
+  if (!entry) {
+    entry = Translate(SocketAddressPair(addr, dest_addr), key);
+    if (!entry)
+      return;
   }
-  ASSERT(iter != int_map_->end());
 
-  // Allow the destination to send packets back to the source.
-  iter->second->WhitelistInsert(dest_addr);
+  {
+    CritScope cs(&crit_);
+    entry->last_activity = now;
+    // Allow the destination to send packets back to the source.
+    SocketAddressKey filter_key = MakeFilterKey(dest_addr);
+    std::vector<SocketAddressKey>::iterator it = std::lower_bound(
+        entry->whitelist.begin(), entry->whitelist.end(), filter_key);
+    if (it == entry->whitelist.end() || *it != filter_key)
+      entry->whitelist.insert(it, filter_key);
+  }
 
-  // Send the packet to its intended destination.
+  // Send the packet to its intended destination.  Entries are only removed on
+  // this thread, so |entry| stays valid without the lock.
   rtc::PacketOptions options;
-  iter->second->socket->SendTo(buf + length, size - length, dest_addr, options);
+  entry->socket->SendTo(buf + length, size - length, dest_addr, options);
 }
 
 void NATServer::OnExternalPacket(
     AsyncPacketSocket* socket, const char* buf, size_t size,
     const SocketAddress& remote_addr, const PacketTime& packet_time) {
 
-  SocketAddress local_addr = socket->GetLocalAddress();
-
-  // Find the translation for this addresses.
-  ExternalMap::iterator iter = ext_map_->find(local_addr);
-  ASSERT(iter != ext_map_->end());
-
-  // Allow the NAT to reject this packet.
-  if (ShouldFilterOut(iter->second, remote_addr)) {
-    LOG(LS_INFO) << "Packet from " << remote_addr.ToSensitiveString()
-                 << " was filtered out by the NAT.";
-    return;
+  SocketAddress internal_addr;
+  {
+    CritScope cs(&crit_);
+    // Find the translation for this socket.  It may have just expired.
+    TransEntry* const* found = ext_map_->Find(socket);
+    if (!found || IsExpired(*found, Time()))
+      return;
+
+    // Allow the NAT to reject this packet.
+    if (ShouldFilterOut(*found, remote_addr)) {
+      LOG(LS_INFO) << "Packet from " << remote_addr.ToSensitiveString()
+                   << " was filtered out by the NAT.";
+      return;
+    }
+    internal_addr = (*found)->route.source();
   }
 
   // Forward this packet to the internal address.
   // First prepend the address in a quasi-STUN format.
-  scoped_ptr<char[]> real_buf(new char[size + kNATEncodedIPv6AddressSize]);
-  size_t addrlength = PackAddressForNAT(real_buf.get(),
-                                        size + kNATEncodedIPv6AddressSize,
-                                        remote_addr);
+  size_t buf_size = size + kNATEncodedIPv6AddressSize;
+  char stack_buf[kStackPacketSize];
+  scoped_ptr<char[]> heap_buf;
+  char* real_buf = stack_buf;
+  if (buf_size > sizeof(stack_buf)) {
+    heap_buf.reset(new char[buf_size]);
+    real_buf = heap_buf.get();
+  }
+  size_t addrlength = PackAddressForNAT(real_buf, buf_size, remote_addr);
   // Copy the data part after the address.
   rtc::PacketOptions options;
-  memcpy(real_buf.get() + addrlength, buf, size);
-  server_socket_->SendTo(real_buf.get(), size + addrlength,
-                         iter->second->route.source(), options);
+  memcpy(real_buf + addrlength, buf, size);
+  server_socket_->SendTo(real_buf, size + addrlength, internal_addr, options);
+}
+
+NATServer::RouteKey NATServer::MakeRouteKey(
+    const SocketAddress& source, const SocketAddress& destination) const {
+  RouteKey key;
+  key.source = SocketAddressKey(source);
+  if (symmetric_)
+    key.destination = SocketAddressKey(destination);
+  return key;
+}
+
+SocketAddressKey NATServer::MakeFilterKey(const SocketAddress& addr) const {
+  SocketAddressKey key(addr);
+  if (!filters_ip_) {
+    memset(key.ip, 0, sizeof(key.ip));
+    key.family = 0;
+  }
+  if (!filters_port_)
+    key.port = 0;
+  return key;
 }
 
-void NATServer::Translate(const SocketAddressPair& route) {
-  AsyncUDPSocket* socket = AsyncUDPSocket::Create(external_, external_ip_);
+NATServer::TransEntry* NATServer::Translate(const SocketAddressPair& route,
+                                            const RouteKey& key) {
+  PortBlock* block = NULL;
+  AsyncUDPSocket* socket = CreateExternalSocket(route.source(), &block);
 
   if (!socket) {
     LOG(LS_ERROR) << "Couldn't find a free port!";
+    return NULL;
+  }
+
+  TransEntry* entry =
+      new TransEntry(route, key, new ExternalReceiver(this, socket), block);
+  int_map_->Insert(key, entry);
+  {
+    CritScope cs(&crit_);
+    ext_map_->Insert(socket, entry);
+  }
+  return entry;
+}
+
+AsyncUDPSocket* NATServer::CreateExternalSocket(const SocketAddress& source,
+                                                PortBlock** block) {
+  if (port_block_size_ <= 0)
+    return AsyncUDPSocket::Create(external_, external_ip_);
+
+  *block = FindOrCreatePortBlock(source);
+  if (!*block)
+    return NULL;
+  PortBlock* b = *block;
+  for (size_t i = 0; i < b->in_use.size(); ++i) {
+    if (b->in_use[i])
+      continue;
+    // The port may still be taken by a socket outside the NAT; try the next.
+    AsyncUDPSocket* socket = AsyncUDPSocket::Create(
+        external_, SocketAddress(external_ip_.ipaddr(),
+                                 static_cast<int>(b->first + i)));
+    if (socket) {
+      b->in_use[i] = true;
+      ++b->use_count;
+      return socket;
+    }
+  }
+  LOG(LS_WARNING) << "Port block " << b->first << " of "
+                  << source.ipaddr().ToSensitiveString() << " is used up.";
+  return NULL;
+}
+
+NATServer::PortBlock* NATServer::FindOrCreatePortBlock(
+    const SocketAddress& source) {
+  SocketAddressKey ip_key(SocketAddress(source.ipaddr(), 0));
+  PortBlock* const* found = block_map_->Find(ip_key);
+  if (found)
+    return *found;
+
+  int first;
+  if (!free_blocks_.empty()) {
+    first = free_blocks_.back();
+    free_blocks_.pop_back();
+  } else if (next_block_port_ + port_block_size_ - 1 <= kLastBlockPort) {
+    first = next_block_port_;
+    next_block_port_ += port_block_size_;
+  } else {
+    LOG(LS_WARNING) << "No port blocks left for "
+                    << source.ipaddr().ToSensitiveString();
+    return NULL;
+  }
+  PortBlock* block = new PortBlock(first, port_block_size_);
+  block_map_->Insert(ip_key, block);
+  return block;
+}
+
+bool NATServer::IsExpired(const TransEntry* entry, uint32 now) const {
+  return mapping_timeout_ > 0 &&
+      TimeDiff(now, entry->last_activity) >= mapping_timeout_;
+}
+
+void NATServer::ExpireIdleEntries(uint32 now) {
+  if (TimeDiff(now, last_sweep_) < mapping_timeout_ / 2)
     return;
+  last_sweep_ = now;
+
+  std::vector<TransEntry*> entries;
+  int_map_->GetValues(&entries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (IsExpired(entries[i], now))
+      RemoveEntry(entries[i]);
+  }
+}
+
+void NATServer::RemoveEntry(TransEntry* entry) {
+  int_map_->Erase(entry->key);
+  {
+    CritScope cs(&crit_);
+    ext_map_->Erase(entry->socket);
+  }
+
+  PortBlock* block = entry->block;
+  if (block) {
+    int offset = entry->socket->GetLocalAddress().port() - block->first;
+    ASSERT(offset >= 0 && offset < static_cast<int>(block->in_use.size()));
+    block->in_use[offset] = false;
+    if (--block->use_count == 0) {
+      // Hand the block back, as the internal IP has no translations left.
+      SocketAddressKey ip_key(SocketAddress(entry->route.source().ipaddr(), 0));
+      block_map_->Erase(ip_key);
+      free_blocks_.push_back(block->first);
+      delete block;
+    }
   }
 
-  TransEntry* entry = new TransEntry(route, socket, nat_);
-  (*int_map_)[route] = entry;
-  (*ext_map_)[socket->GetLocalAddress()] = entry;
-  socket->SignalReadPacket.connect(this, &NATServer::OnExternalPacket);
+  // The external thread may be inside OnExternalPacket for this socket, and
+  // read the packet from the socket's buffer after dropping |crit_|.  So the
+  // socket is deleted on that thread, once it is done with the packet.  If the
+  // thread has quit, the message is dropped, and the socket is deleted along
+  // with the server instead.
+  if (external_thread_ && !external_thread_->IsCurrent()) {
+    bool post;
+    {
+      CritScope cs(&crit_);
+      post = retired_.empty();
+      retired_.push_back(entry->receiver);
+    }
+    entry->receiver = NULL;
+    if (post)
+      external_thread_->Post(this, MSG_DELETE_RETIRED);
+  }
+  delete entry;
 }
 
-bool NATServer::ShouldFilterOut(TransEntry* entry,
-                                const SocketAddress& ext_addr) {
-  return entry->WhitelistContains(ext_addr);
+void NATServer::OnMessage(Message* msg) {
+  ASSERT(msg->message_id == MSG_DELETE_RETIRED);
+  std::vector<ExternalReceiver*> retired;
+  {
+    CritScope cs(&crit_);
+    retired.swap(retired_);
+  }
+  for (size_t i = 0; i < retired.size(); ++i)
+    delete retired[i];
 }
 
-NATServer::TransEntry::TransEntry(
-    const SocketAddressPair& r, AsyncUDPSocket* s, NAT* nat)
-    : route(r), socket(s) {
-  whitelist = new AddressSet(AddrCmp(nat));
+bool NATServer::ShouldFilterOut(const TransEntry* entry,
+                                const SocketAddress& ext_addr) const {
+  return !std::binary_search(entry->whitelist.begin(), entry->whitelist.end(),
+                             MakeFilterKey(ext_addr));
 }
 
-NATServer::TransEntry::~TransEntry() {
-  delete whitelist;
-  delete socket;
+NATServer::TransEntry::TransEntry(
+    const SocketAddressPair& r, const RouteKey& k, ExternalReceiver* rc,
+    PortBlock* b)
+    : route(r), key(k), receiver(rc), socket(rc->socket()), block(b),
+      last_activity(Time()) {
 }
 
-void NATServer::TransEntry::WhitelistInsert(const SocketAddress& addr) {
-  CritScope cs(&crit_);
-  whitelist->insert(addr);
+NATServer::TransEntry::~TransEntry() {
+  delete receiver;
 }
 
-bool NATServer::TransEntry::WhitelistContains(const SocketAddress& ext_addr) {
-  CritScope cs(&crit_);
-  return whitelist->find(ext_addr) == whitelist->end();
+NATServer::PortBlock::PortBlock(int first, int size)
+    : first(first), in_use(size, false), use_count(0) {
 }
 
 }  // namespace rtc
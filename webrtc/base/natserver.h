@@ -11,8 +11,7 @@
 #ifndef WEBRTC_BASE_NATSERVER_H_
 #define WEBRTC_BASE_NATSERVER_H_
 
-#include <map>
-#include <set>
+#include <vector>
 
 #include "webrtc/base/asyncudpsocket.h"
 #include "webrtc/base/socketaddresspair.h"
@@ -22,34 +21,19 @@
 
 namespace rtc {
 
-// Change how routes (socketaddress pairs) are compared based on the type of
-// NAT.  The NAT server maintains a hashtable of the routes that it knows
-// about.  So these affect which routes are treated the same.
-struct RouteCmp {
-  explicit RouteCmp(NAT* nat);
-  size_t operator()(const SocketAddressPair& r) const;
-  bool operator()(
-      const SocketAddressPair& r1, const SocketAddressPair& r2) const;
-
-  bool symmetric;
-};
-
-// Changes how addresses are compared based on the filtering rules of the NAT.
-struct AddrCmp {
-  explicit AddrCmp(NAT* nat);
-  size_t operator()(const SocketAddress& r) const;
-  bool operator()(const SocketAddress& r1, const SocketAddress& r2) const;
-
-  bool use_ip;
-  bool use_port;
-};
-
 // Implements the NAT device.  It listens for packets on the internal network,
 // translates them, and sends them out over the external network.
+//
+// Packets from the internal network must all be delivered on one thread, which
+// is also the thread that creates and removes translations.  Packets from the
+// external network may be delivered on another thread, so that both directions
+// are forwarded in parallel; that thread must then be passed to
+// set_external_thread().  The server must only be destroyed once neither
+// thread delivers packets to it, and before the external thread is destroyed.
 
 const int NAT_SERVER_PORT = 4237;
 
-class NATServer : public sigslot::has_slots<> {
+class NATServer : public sigslot::has_slots<>, public MessageHandler {
  public:
   NATServer(
       NATType type, SocketFactory* internal, const SocketAddress& internal_addr,
@@ -60,6 +44,26 @@ class NATServer : public sigslot::has_slots<> {
     return server_socket_->GetLocalAddress();
   }
 
+  // A translation that has sent nothing for |timeout_ms| is removed, and
+  // packets that arrive for it from outside are dropped, as on most NATs.  The
+  // default, 0, keeps translations until the server is destroyed.
+  void set_mapping_timeout(int timeout_ms) { mapping_timeout_ = timeout_ms; }
+
+  // Gives each internal IP its own block of |size| consecutive external ports,
+  // like a carrier-grade NAT; once the block is used up, packets that need a
+  // new translation are dropped.  The default, 0, lets the external socket
+  // factory pick any free port.  Must be set before the first packet.
+  void set_port_block_size(int size) { port_block_size_ = size; }
+
+  // The thread that delivers packets from the external network, if it is not
+  // the internal one.  The external sockets of removed translations are
+  // deleted on it, as it may be delivering a packet from them.  Must be set
+  // before the first packet.
+  void set_external_thread(Thread* thread) { external_thread_ = thread; }
+
+  // Returns the number of translations currently held.
+  size_t mapping_count() const;
+
   // Packets received on one of the networks.
   void OnInternalPacket(AsyncPacketSocket* socket, const char* buf,
                         size_t size, const SocketAddress& addr,
@@ -68,40 +72,104 @@ class NATServer : public sigslot::has_slots<> {
                         size_t size, const SocketAddress& remote_addr,
                         const PacketTime& packet_time);
 
+  // Deletes the external sockets of removed translations on the external
+  // thread.
+  virtual void OnMessage(Message* msg);
+
  private:
-  typedef std::set<SocketAddress, AddrCmp> AddressSet;
+  // The parts of a route that select its translation.  The destination is
+  // only kept on a symmetric NAT; otherwise it is left empty.
+  struct RouteKey {
+    bool operator==(const RouteKey& key) const;
+    size_t Hash() const;
+
+    SocketAddressKey source;
+    SocketAddressKey destination;
+  };
+
+  struct PortBlock;
+  class ExternalReceiver;
 
   /* Records a translation and the associated external socket. */
   struct TransEntry {
-    TransEntry(const SocketAddressPair& r, AsyncUDPSocket* s, NAT* nat);
+    TransEntry(const SocketAddressPair& r, const RouteKey& k,
+               ExternalReceiver* rc, PortBlock* b);
     ~TransEntry();
 
-    void WhitelistInsert(const SocketAddress& addr);
-    bool WhitelistContains(const SocketAddress& ext_addr);
-
     SocketAddressPair route;
+    RouteKey key;
+    // Owns |socket|; NULL once it has been handed to the external thread.
+    ExternalReceiver* receiver;
     AsyncUDPSocket* socket;
-    AddressSet* whitelist;
-    CriticalSection crit_;
+    PortBlock* block;
+    // Filter keys of the addresses this translation has sent to, sorted.
+    std::vector<SocketAddressKey> whitelist;
+    uint32 last_activity;
+  };
+
+  // A range of external ports that belongs to one internal IP.
+  struct PortBlock {
+    PortBlock(int first, int size);
+
+    int first;
+    std::vector<bool> in_use;
+    int use_count;
   };
 
-  typedef std::map<SocketAddressPair, TransEntry*, RouteCmp> InternalMap;
-  typedef std::map<SocketAddress, TransEntry*> ExternalMap;
+  // Hash tables, defined in the .cc file.
+  class InternalMap;
+  class ExternalMap;
+  class PortBlockMap;
+
+  RouteKey MakeRouteKey(const SocketAddress& source,
+                        const SocketAddress& destination) const;
+  // Reduces an external address to the parts that the NAT filters on.
+  SocketAddressKey MakeFilterKey(const SocketAddress& addr) const;
 
   /* Creates a new entry that translates the given route. */
-  void Translate(const SocketAddressPair& route);
+  TransEntry* Translate(const SocketAddressPair& route, const RouteKey& key);
+
+  // Creates the external socket of a translation from |source|.  If port
+  // blocks are in use, |*block| is set to the block the port was taken from.
+  AsyncUDPSocket* CreateExternalSocket(const SocketAddress& source,
+                                       PortBlock** block);
+  PortBlock* FindOrCreatePortBlock(const SocketAddress& source);
+
+  bool IsExpired(const TransEntry* entry, uint32 now) const;
+  // Removes the translations that have been idle for too long.  Runs at most
+  // once per half timeout.
+  void ExpireIdleEntries(uint32 now);
+  void RemoveEntry(TransEntry* entry);
 
   /* Determines whether the NAT would filter out a packet from this address. */
-  bool ShouldFilterOut(TransEntry* entry, const SocketAddress& ext_addr);
+  bool ShouldFilterOut(const TransEntry* entry,
+                       const SocketAddress& ext_addr) const;
 
   NAT* nat_;
+  bool symmetric_;
+  bool filters_ip_;
+  bool filters_port_;
   SocketFactory* internal_;
   SocketFactory* external_;
   SocketAddress external_ip_;
   AsyncUDPSocket* server_socket_;
   AsyncSocket* tcp_server_socket_;
+  Thread* external_thread_;
+  int mapping_timeout_;
+  uint32 last_sweep_;
+  int port_block_size_;
+  int next_block_port_;
+  std::vector<int> free_blocks_;
+  // Only used on the internal thread.
   InternalMap* int_map_;
+  PortBlockMap* block_map_;
+  // Shared with the external thread; guarded by |crit_|, as are the whitelist
+  // and the last activity of every entry.
   ExternalMap* ext_map_;
+  // The receivers of removed translations, waiting to be deleted on the
+  // external thread.  Guarded by |crit_|.
+  std::vector<ExternalReceiver*> retired_;
+  mutable CriticalSection crit_;
   DISALLOW_EVIL_CONSTRUCTORS(NATServer);
 };
 
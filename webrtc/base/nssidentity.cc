@@ -8,6 +8,8 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <string.h>
+
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -47,17 +49,40 @@ NSSKeyPair::~NSSKeyPair() {
     SECKEY_DestroyPublicKey(pubkey_);
 }
 
-NSSKeyPair *NSSKeyPair::Generate() {
+NSSKeyPair *NSSKeyPair::Generate(KeyType key_type) {
   SECKEYPrivateKey *privkey = NULL;
   SECKEYPublicKey *pubkey = NULL;
-  PK11RSAGenParams rsaparams;
-  rsaparams.keySizeInBits = 1024;
-  rsaparams.pe = 0x010001;  // 65537 -- a common RSA public exponent.
-
-  privkey = PK11_GenerateKeyPair(NSSContext::GetSlot(),
-                                 CKM_RSA_PKCS_KEY_PAIR_GEN,
-                                 &rsaparams, &pubkey, PR_FALSE /*permanent*/,
-                                 PR_FALSE /*sensitive*/, NULL);
+  if (key_type == KT_ECDSA) {
+    // The parameters of an EC key are the DER encoded OID of its curve.
+    SECOidData* curve = SECOID_FindOIDByTag(SEC_OID_ANSIX962_EC_PRIME256V1);
+    if (!curve) {
+      LOG(LS_ERROR) << "Couldn't find the P-256 curve";
+      return NULL;
+    }
+    unsigned char encoded_curve[2 + 16];
+    ASSERT(curve->oid.len <= sizeof(encoded_curve) - 2);
+    encoded_curve[0] = SEC_ASN1_OBJECT_ID;
+    encoded_curve[1] = static_cast<unsigned char>(curve->oid.len);
+    memcpy(encoded_curve + 2, curve->oid.data, curve->oid.len);
+    SECKEYECParams ecparams;
+    ecparams.type = siDEROID;
+    ecparams.data = encoded_curve;
+    ecparams.len = curve->oid.len + 2;
+
+    privkey = PK11_GenerateKeyPair(NSSContext::GetSlot(),
+                                   CKM_EC_KEY_PAIR_GEN,
+                                   &ecparams, &pubkey, PR_FALSE /*permanent*/,
+                                   PR_FALSE /*sensitive*/, NULL);
+  } else {
+    PK11RSAGenParams rsaparams;
+    rsaparams.keySizeInBits = 1024;
+    rsaparams.pe = 0x010001;  // 65537 -- a common RSA public exponent.
+
+    privkey = PK11_GenerateKeyPair(NSSContext::GetSlot(),
+                                   CKM_RSA_PKCS_KEY_PAIR_GEN,
+                                   &rsaparams, &pubkey, PR_FALSE /*permanent*/,
+                                   PR_FALSE /*sensitive*/, NULL);
+  }
   if (!privkey) {
     LOG(LS_ERROR) << "Couldn't generate key pair";
     return NULL;
@@ -339,7 +364,11 @@ NSSIdentity* NSSIdentity::GenerateInternal(const SSLIdentityParams& params) {
   CERTCertificateRequest *certreq = NULL;
   CERTValidity *validity = NULL;
   CERTCertificate *certificate = NULL;
-  NSSKeyPair *keypair = NSSKeyPair::Generate();
+  NSSKeyPair *keypair = NSSKeyPair::Generate(params.key_type);
+  // RSA certificates keep using SHA-1 for compatibility with older peers.
+  SECOidTag signature_algorithm = params.key_type == KT_ECDSA ?
+      SEC_OID_ANSIX962_ECDSA_SHA256_SIGNATURE :
+      SEC_OID_PKCS1_SHA1_WITH_RSA_ENCRYPTION;
   SECItem inner_der;
   SECStatus rv;
   PLArenaPool* arena;
@@ -399,7 +428,7 @@ NSSIdentity* NSSIdentity::GenerateInternal(const SSLIdentityParams& params) {
   arena = certificate->arena;
 
   rv = SECOID_SetAlgorithmID(arena, &certificate->signature,
-                             SEC_OID_PKCS1_SHA1_WITH_RSA_ENCRYPTION, NULL);
+                             signature_algorithm, NULL);
   if (rv != SECSuccess)
     goto fail;
 
@@ -412,8 +441,7 @@ NSSIdentity* NSSIdentity::GenerateInternal(const SSLIdentityParams& params) {
     goto fail;
 
   rv = SEC_DerSignData(arena, &signed_cert, inner_der.data, inner_der.len,
-                       keypair->privkey(),
-                       SEC_OID_PKCS1_SHA1_WITH_RSA_ENCRYPTION);
+                       keypair->privkey(), signature_algorithm);
   if (rv != SECSuccess) {
     LOG(LS_ERROR) << "Couldn't sign certificate";
     goto fail;
@@ -436,9 +464,11 @@ NSSIdentity* NSSIdentity::GenerateInternal(const SSLIdentityParams& params) {
   return identity;
 }
 
-NSSIdentity* NSSIdentity::Generate(const std::string &common_name) {
+NSSIdentity* NSSIdentity::Generate(const std::string &common_name,
+                                   KeyType key_type) {
   SSLIdentityParams params;
   params.common_name = common_name;
+  params.key_type = key_type;
   params.not_before = CERTIFICATE_WINDOW;
   params.not_after = CERTIFICATE_LIFETIME;
   return GenerateInternal(params);
@@ -450,9 +480,13 @@ NSSIdentity* NSSIdentity::GenerateForTest(const SSLIdentityParams& params) {
 
 SSLIdentity* NSSIdentity::FromPEMStrings(const std::string& private_key,
                                          const std::string& certificate) {
+  // Either label may hold a PKCS#8 PrivateKeyInfo; EC keys only come as
+  // "PRIVATE KEY".
   std::string private_key_der;
   if (!SSLIdentity::PemToDer(
-      kPemTypeRsaPrivateKey, private_key, &private_key_der))
+          kPemTypeRsaPrivateKey, private_key, &private_key_der) &&
+      !SSLIdentity::PemToDer(
+          kPemTypePrivateKey, private_key, &private_key_der))
     return NULL;
 
   SECItem private_key_item;
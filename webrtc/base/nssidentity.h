@@ -31,8 +31,8 @@ class NSSKeyPair {
       privkey_(privkey), pubkey_(pubkey) {}
   ~NSSKeyPair();
 
-  // Generate a 1024-bit RSA key pair.
-  static NSSKeyPair* Generate();
+  // Generate a 1024-bit RSA or a P-256 ECDSA key pair.
+  static NSSKeyPair* Generate(KeyType key_type);
   NSSKeyPair* GetReference();
 
   SECKEYPrivateKey* privkey() const { return privkey_; }
@@ -100,7 +100,8 @@ class NSSCertificate : public SSLCertificate {
 // Represents a SSL key pair and certificate for NSS.
 class NSSIdentity : public SSLIdentity {
  public:
-  static NSSIdentity* Generate(const std::string& common_name);
+  static NSSIdentity* Generate(const std::string& common_name,
+                               KeyType key_type);
   static NSSIdentity* GenerateForTest(const SSLIdentityParams& params);
   static SSLIdentity* FromPEMStrings(const std::string& private_key,
                                      const std::string& certificate);
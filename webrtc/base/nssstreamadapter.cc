@@ -471,9 +471,11 @@ int NSSStreamAdapter::BeginSSL() {
       Error("BeginSSL", -1, false);
       return -1;
     }
-    rv = SSL_ConfigSecureServer(ssl_fd_, identity->certificate().certificate(),
+    CERTCertificate* cert = identity->certificate().certificate();
+    // The key exchange type follows the key, which may be RSA or ECDSA.
+    rv = SSL_ConfigSecureServer(ssl_fd_, cert,
                                 identity->keypair()->privkey(),
-                                kt_rsa);
+                                NSS_FindCertKEAType(cert));
     if (rv != SECSuccess) {
       Error("BeginSSL", -1, false);
       return -1;
@@ -1007,6 +1009,10 @@ bool NSSStreamAdapter::HaveDtlsSrtp() {
 #endif
 }
 
+bool NSSStreamAdapter::HaveDtlsSrtpGcm() {
+  return false;
+}
+
 bool NSSStreamAdapter::HaveExporter() {
   return true;
 }
@@ -76,6 +76,7 @@ class NSSStreamAdapter : public SSLStreamAdapterHelper {
   // Capabilities interfaces
   static bool HaveDtls();
   static bool HaveDtlsSrtp();
+  static bool HaveDtlsSrtpGcm();
   static bool HaveExporter();
 
  protected:
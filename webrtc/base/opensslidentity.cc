@@ -19,6 +19,9 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/objects.h>
 #include <openssl/rsa.h>
 #include <openssl/crypto.h>
 
@@ -33,7 +36,7 @@ namespace rtc {
 // We could have exposed a myriad of parameters for the crypto stuff,
 // but keeping it simple seems best.
 
-// Strength of generated keys. Those are RSA.
+// Strength of generated RSA keys. ECDSA keys use the P-256 curve.
 static const int KEY_LENGTH = 1024;
 
 // Random bits for certificate serial number
@@ -45,9 +48,9 @@ static const int CERTIFICATE_LIFETIME = 60*60*24*30;  // 30 days, arbitrarily
 // This is to compensate for slightly incorrect system clocks.
 static const int CERTIFICATE_WINDOW = -60*60*24;
 
-// Generate a key pair. Caller is responsible for freeing the returned object.
-static EVP_PKEY* MakeKey() {
-  LOG(LS_INFO) << "Making key pair";
+// Generate an RSA key pair. Caller is responsible for freeing the returned
+// object.
+static EVP_PKEY* MakeRSAKey() {
   EVP_PKEY* pkey = EVP_PKEY_new();
   // RSA_generate_key is deprecated. Use _ex version.
   BIGNUM* exponent = BN_new();
@@ -63,7 +66,47 @@ static EVP_PKEY* MakeKey() {
   }
   // ownership of rsa struct was assigned, don't free it.
   BN_free(exponent);
-  LOG(LS_INFO) << "Returning key pair";
+  return pkey;
+}
+
+// Generate an ECDSA key pair on the P-256 curve. Caller is responsible for
+// freeing the returned object.
+static EVP_PKEY* MakeECDSAKey() {
+  EVP_PKEY* pkey = EVP_PKEY_new();
+  EC_KEY* ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+  if (!pkey || !ec_key || !EC_KEY_generate_key(ec_key)) {
+    EVP_PKEY_free(pkey);
+    EC_KEY_free(ec_key);
+    return NULL;
+  }
+#if !defined(OPENSSL_IS_BORINGSSL)
+  // Refer to the curve by name in the certificate, which is what DTLS peers
+  // expect. BoringSSL always does.
+  EC_KEY_set_asn1_flag(ec_key, OPENSSL_EC_NAMED_CURVE);
+#endif
+  if (!EVP_PKEY_assign_EC_KEY(pkey, ec_key)) {
+    EVP_PKEY_free(pkey);
+    EC_KEY_free(ec_key);
+    return NULL;
+  }
+  // ownership of ec_key struct was assigned, don't free it.
+  return pkey;
+}
+
+// Generate a key pair. Caller is responsible for freeing the returned object.
+static EVP_PKEY* MakeKey(KeyType key_type) {
+  LOG(LS_INFO) << "Making key pair";
+  EVP_PKEY* pkey = NULL;
+  switch (key_type) {
+    case KT_RSA:
+      pkey = MakeRSAKey();
+      break;
+    case KT_ECDSA:
+      pkey = MakeECDSAKey();
+      break;
+  }
+  if (pkey)
+    LOG(LS_INFO) << "Returning key pair";
   return pkey;
 }
 
@@ -112,7 +155,10 @@ static X509* MakeCertificate(EVP_PKEY* pkey, const SSLIdentityParams& params) {
       !X509_gmtime_adj(X509_get_notAfter(x509), params.not_after))
     goto error;
 
-  if (!X509_sign(x509, pkey, EVP_sha1()))
+  // RSA certificates keep using SHA-1 for compatibility with older peers.
+  // ECDSA support is recent enough everywhere to go with SHA-256.
+  if (!X509_sign(x509, pkey, EVP_PKEY_id(pkey) == EVP_PKEY_EC ?
+                 EVP_sha256() : EVP_sha1()))
     goto error;
 
   BN_free(serial_number);
@@ -138,8 +184,8 @@ static void LogSSLErrors(const std::string& prefix) {
   }
 }
 
-OpenSSLKeyPair* OpenSSLKeyPair::Generate() {
-  EVP_PKEY* pkey = MakeKey();
+OpenSSLKeyPair* OpenSSLKeyPair::Generate(KeyType key_type) {
+  EVP_PKEY* pkey = MakeKey(key_type);
   if (!pkey) {
     LogSSLErrors("Generating key pair");
     return NULL;
@@ -214,8 +260,15 @@ OpenSSLCertificate* OpenSSLCertificate::FromPEMString(
 // and before CleanupSSL.
 bool OpenSSLCertificate::GetSignatureDigestAlgorithm(
     std::string* algorithm) const {
-  return OpenSSLDigest::GetDigestName(
-      EVP_get_digestbyobj(x509_->sig_alg->algorithm), algorithm);
+  // The signature algorithm names the digest and the key type. Only the
+  // digests of RSA signatures can be looked up by the algorithm directly.
+  int digest_nid;
+  if (!OBJ_find_sigid_algs(OBJ_obj2nid(x509_->sig_alg->algorithm),
+                           &digest_nid, NULL)) {
+    return false;
+  }
+  const EVP_MD* md = EVP_get_digestbynid(digest_nid);
+  return md && OpenSSLDigest::GetDigestName(md, algorithm);
 }
 
 bool OpenSSLCertificate::ComputeDigest(const std::string& algorithm,
@@ -293,7 +346,7 @@ void OpenSSLCertificate::AddReference() const {
 
 OpenSSLIdentity* OpenSSLIdentity::GenerateInternal(
     const SSLIdentityParams& params) {
-  OpenSSLKeyPair *key_pair = OpenSSLKeyPair::Generate();
+  OpenSSLKeyPair *key_pair = OpenSSLKeyPair::Generate(params.key_type);
   if (key_pair) {
     OpenSSLCertificate *certificate = OpenSSLCertificate::Generate(
         key_pair, params);
@@ -305,9 +358,11 @@ OpenSSLIdentity* OpenSSLIdentity::GenerateInternal(
   return NULL;
 }
 
-OpenSSLIdentity* OpenSSLIdentity::Generate(const std::string& common_name) {
+OpenSSLIdentity* OpenSSLIdentity::Generate(const std::string& common_name,
+                                           KeyType key_type) {
   SSLIdentityParams params;
   params.common_name = common_name;
+  params.key_type = key_type;
   params.not_before = CERTIFICATE_WINDOW;
   params.not_after = CERTIFICATE_LIFETIME;
   return GenerateInternal(params);
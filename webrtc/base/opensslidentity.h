@@ -32,7 +32,7 @@ class OpenSSLKeyPair {
     ASSERT(pkey_ != NULL);
   }
 
-  static OpenSSLKeyPair* Generate();
+  static OpenSSLKeyPair* Generate(KeyType key_type);
 
   virtual ~OpenSSLKeyPair();
 
@@ -110,7 +110,8 @@ class OpenSSLCertificate : public SSLCertificate {
 // them consistently.
 class OpenSSLIdentity : public SSLIdentity {
  public:
-  static OpenSSLIdentity* Generate(const std::string& common_name);
+  static OpenSSLIdentity* Generate(const std::string& common_name,
+                                   KeyType key_type);
   static OpenSSLIdentity* GenerateForTest(const SSLIdentityParams& params);
   static SSLIdentity* FromPEMStrings(const std::string& private_key,
                                      const std::string& certificate);
@@ -120,6 +121,10 @@ class OpenSSLIdentity : public SSLIdentity {
     return *certificate_;
   }
 
+  const OpenSSLKeyPair& key_pair() const {
+    return *key_pair_;
+  }
+
   virtual OpenSSLIdentity* GetReference() const {
     return new OpenSSLIdentity(key_pair_->GetReference(),
                                certificate_->GetReference());
@@ -22,9 +22,12 @@
 #include <openssl/rand.h>
 #include <openssl/x509v3.h>
 
+#include <functional>
+#include <map>
 #include <vector>
 
 #include "webrtc/base/common.h"
+#include "webrtc/base/criticalsection.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/safe_conversions.h"
 #include "webrtc/base/stream.h"
@@ -41,6 +44,10 @@ namespace rtc {
 #define HAVE_DTLS_SRTP
 #endif
 
+#if defined(HAVE_DTLS_SRTP) && defined(SRTP_AEAD_AES_128_GCM)
+#define HAVE_DTLS_SRTP_GCM
+#endif
+
 #ifdef HAVE_DTLS_SRTP
 // SRTP cipher suite table
 struct SrtpCipherMapEntry {
@@ -52,6 +59,10 @@ struct SrtpCipherMapEntry {
 static SrtpCipherMapEntry SrtpCipherMap[] = {
   {"AES_CM_128_HMAC_SHA1_80", "SRTP_AES128_CM_SHA1_80"},
   {"AES_CM_128_HMAC_SHA1_32", "SRTP_AES128_CM_SHA1_32"},
+#ifdef HAVE_DTLS_SRTP_GCM
+  {"AEAD_AES_128_GCM", "SRTP_AEAD_AES_128_GCM"},
+  {"AEAD_AES_256_GCM", "SRTP_AEAD_AES_256_GCM"},
+#endif
   {NULL, NULL}
 };
 #endif
@@ -163,6 +174,112 @@ static long stream_ctrl(BIO* b, int cmd, long num, void* ptr) {
   }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// SSLContextCache
+/////////////////////////////////////////////////////////////////////////////
+
+// Everything an SSL_CTX is configured with. Adapters with equal keys share a
+// context; whatever differs between connections (the expected peer
+// certificate digest, the server name, the BIO) is set on the SSL object.
+struct SSLContextKey {
+  SSLContextKey()
+      : role(SSL_CLIENT), mode(SSL_MODE_TLS), client_auth(true),
+        certificate(NULL), private_key(NULL) {
+  }
+
+  bool operator<(const SSLContextKey& other) const {
+    if (role != other.role)
+      return role < other.role;
+    if (mode != other.mode)
+      return mode < other.mode;
+    if (client_auth != other.client_auth)
+      return client_auth < other.client_auth;
+    if (certificate != other.certificate)
+      return std::less<X509*>()(certificate, other.certificate);
+    if (private_key != other.private_key)
+      return std::less<EVP_PKEY*>()(private_key, other.private_key);
+    return srtp_ciphers < other.srtp_ciphers;
+  }
+
+  SSLRole role;
+  SSLMode mode;
+  bool client_auth;
+  std::string srtp_ciphers;
+  // The identity, compared by address. Identity references share these
+  // objects, and a cached context holds references to both, so an address
+  // cannot be reused for another identity while its context is cached.
+  X509* certificate;
+  EVP_PKEY* private_key;
+};
+
+// Reference counted contexts, shared by all adapters in the process. A
+// context is freed when the last adapter using it releases it.
+class SSLContextCache {
+ public:
+  static SSLContextCache* Instance() {
+    LIBJINGLE_DEFINE_STATIC_LOCAL(SSLContextCache, instance, ());
+    return &instance;
+  }
+
+  // Returns the context for |key| with a reference added, or NULL if there
+  // is none.
+  SSL_CTX* Acquire(const SSLContextKey& key) {
+    CritScope cs(&crit_);
+    ContextMap::iterator it = contexts_.find(key);
+    if (it == contexts_.end())
+      return NULL;
+    ++it->second.refs;
+    return it->second.ctx;
+  }
+
+  // Takes ownership of |ctx|, created for |key|, and returns it with a
+  // reference added. If a context for |key| was added in the meantime, |ctx|
+  // is freed and that one is returned instead.
+  SSL_CTX* Add(const SSLContextKey& key, SSL_CTX* ctx) {
+    CritScope cs(&crit_);
+    std::pair<ContextMap::iterator, bool> result =
+        contexts_.insert(std::make_pair(key, Entry(ctx)));
+    if (result.second) {
+      keys_[ctx] = result.first;
+    } else {
+      SSL_CTX_free(ctx);
+    }
+    ++result.first->second.refs;
+    return result.first->second.ctx;
+  }
+
+  // Releases a reference returned by Acquire() or Add().
+  void Release(SSL_CTX* ctx) {
+    CritScope cs(&crit_);
+    KeyMap::iterator it = keys_.find(ctx);
+    ASSERT(it != keys_.end());
+    if (it == keys_.end())
+      return;
+    if (--it->second->second.refs > 0)
+      return;
+    contexts_.erase(it->second);
+    keys_.erase(it);
+    SSL_CTX_free(ctx);
+  }
+
+ private:
+  struct Entry {
+    explicit Entry(SSL_CTX* ctx) : ctx(ctx), refs(0) {}
+    SSL_CTX* ctx;
+    int refs;
+  };
+  typedef std::map<SSLContextKey, Entry> ContextMap;
+  typedef std::map<SSL_CTX*, ContextMap::iterator> KeyMap;
+
+  SSLContextCache() {}
+
+  CriticalSection crit_;
+  ContextMap contexts_;
+  KeyMap keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLContextCache);
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // OpenSSLStreamAdapter
 /////////////////////////////////////////////////////////////////////////////
@@ -593,9 +710,9 @@ int OpenSSLStreamAdapter::BeginSSL() {
 
   BIO* bio = NULL;
 
-  // First set up the context
+  // First find or set up the context
   ASSERT(ssl_ctx_ == NULL);
-  ssl_ctx_ = SetupSSLContext();
+  ssl_ctx_ = AcquireSSLContext();
   if (!ssl_ctx_)
     return -1;
 
@@ -616,16 +733,6 @@ int OpenSSLStreamAdapter::BeginSSL() {
   SSL_set_mode(ssl_, SSL_MODE_ENABLE_PARTIAL_WRITE |
                SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
-  // Specify an ECDH group for ECDHE ciphers, otherwise they cannot be
-  // negotiated when acting as the server. Use NIST's P-256 which is commonly
-  // supported.
-  EC_KEY* ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
-  if (ecdh == NULL)
-    return -1;
-  SSL_set_options(ssl_, SSL_OP_SINGLE_ECDH_USE);
-  SSL_set_tmp_ecdh(ssl_, ecdh);
-  EC_KEY_free(ecdh);
-
   // Do the connect
   return ContinueSSL();
 }
@@ -706,7 +813,7 @@ void OpenSSLStreamAdapter::Cleanup() {
     ssl_ = NULL;
   }
   if (ssl_ctx_) {
-    SSL_CTX_free(ssl_ctx_);
+    SSLContextCache::Instance()->Release(ssl_ctx_);
     ssl_ctx_ = NULL;
   }
   identity_.reset();
@@ -728,6 +835,30 @@ void OpenSSLStreamAdapter::OnMessage(Message* msg) {
   }
 }
 
+SSL_CTX* OpenSSLStreamAdapter::AcquireSSLContext() {
+  SSLContextKey key;
+  key.role = role_;
+  key.mode = ssl_mode_;
+  key.client_auth = client_auth_enabled();
+  key.srtp_ciphers = srtp_ciphers_;
+  if (identity_) {
+    key.certificate = identity_->certificate().x509();
+    key.private_key = identity_->key_pair().pkey();
+  }
+
+  SSLContextCache* cache = SSLContextCache::Instance();
+  SSL_CTX* ctx = cache->Acquire(key);
+  if (ctx)
+    return ctx;
+
+  // Set up outside of the cache's lock; if another adapter gets there
+  // first, the cache keeps its context and frees this one.
+  ctx = SetupSSLContext();
+  if (!ctx)
+    return NULL;
+  return cache->Add(key, ctx);
+}
+
 SSL_CTX* OpenSSLStreamAdapter::SetupSSLContext() {
   SSL_CTX *ctx = NULL;
 
@@ -762,6 +893,24 @@ SSL_CTX* OpenSSLStreamAdapter::SetupSSLContext() {
   SSL_CTX_set_verify_depth(ctx, 4);
   SSL_CTX_set_cipher_list(ctx, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
 
+  // The context is shared between connections to different peers, so a
+  // session must never be resumed: that would skip the check of the peer
+  // certificate against its digest.
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+
+  // Specify an ECDH group for ECDHE ciphers, otherwise they cannot be
+  // negotiated when acting as the server. Use NIST's P-256 which is commonly
+  // supported.
+  EC_KEY* ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+  if (ecdh == NULL) {
+    SSL_CTX_free(ctx);
+    return NULL;
+  }
+  SSL_CTX_set_options(ctx, SSL_OP_SINGLE_ECDH_USE);
+  SSL_CTX_set_tmp_ecdh(ctx, ecdh);
+  EC_KEY_free(ecdh);
+
 #ifdef HAVE_DTLS_SRTP
   if (!srtp_ciphers_.empty()) {
     if (SSL_CTX_set_tlsext_use_srtp(ctx, srtp_ciphers_.c_str())) {
@@ -868,6 +1017,14 @@ bool OpenSSLStreamAdapter::HaveDtlsSrtp() {
 #endif
 }
 
+bool OpenSSLStreamAdapter::HaveDtlsSrtpGcm() {
+#ifdef HAVE_DTLS_SRTP_GCM
+  return true;
+#else
+  return false;
+#endif
+}
+
 bool OpenSSLStreamAdapter::HaveExporter() {
 #ifdef HAVE_DTLS_SRTP
   return true;
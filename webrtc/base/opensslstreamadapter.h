@@ -97,6 +97,7 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
   // Capabilities interfaces
   static bool HaveDtls();
   static bool HaveDtlsSrtp();
+  static bool HaveDtlsSrtpGcm();
   static bool HaveExporter();
 
  protected:
@@ -145,7 +146,10 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
   // Flush the input buffers by reading left bytes (for DTLS)
   void FlushInput(unsigned int left);
 
-  // SSL library configuration
+  // SSL library configuration. Returns the shared context for this
+  // adapter's configuration, setting it up if no other adapter uses it yet.
+  // It is released in Cleanup().
+  SSL_CTX* AcquireSSLContext();
   SSL_CTX* SetupSSLContext();
   // SSL verification check
   bool SSLPostConnectionCheck(SSL* ssl, const char* server_name,
@@ -166,6 +170,7 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
   bool ssl_write_needs_read_;
 
   SSL* ssl_;
+  // Shared with other adapters; all per-connection state is in |ssl_|.
   SSL_CTX* ssl_ctx_;
 
   // Our key and certificate, mostly useful in peer-to-peer mode.
@@ -0,0 +1,176 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/base/packetbuffer.h"
+
+#if defined(WEBRTC_POSIX)
+#include <pthread.h>
+#endif
+
+#if defined(WEBRTC_WIN)
+#include "webrtc/base/win32.h"
+#endif
+
+#include "webrtc/base/basictypes.h"
+#include "webrtc/base/common.h"
+
+namespace rtc {
+
+namespace {
+
+// The thread-local slot behind PacketBuffer::Signaled().
+class SignaledPacketSlot {
+ public:
+  static SignaledPacketSlot* Instance() {
+    LIBJINGLE_DEFINE_STATIC_LOCAL(SignaledPacketSlot, slot, ());
+    return &slot;
+  }
+
+#if defined(WEBRTC_POSIX)
+  SignaledPacketSlot() { pthread_key_create(&key_, NULL); }
+  ~SignaledPacketSlot() { pthread_key_delete(key_); }
+  PacketBuffer* Get() const {
+    return static_cast<PacketBuffer*>(pthread_getspecific(key_));
+  }
+  void Set(PacketBuffer* packet) { pthread_setspecific(key_, packet); }
+
+ private:
+  pthread_key_t key_;
+#endif
+
+#if defined(WEBRTC_WIN)
+  SignaledPacketSlot() : key_(TlsAlloc()) {}
+  ~SignaledPacketSlot() { TlsFree(key_); }
+  PacketBuffer* Get() const {
+    return static_cast<PacketBuffer*>(TlsGetValue(key_));
+  }
+  void Set(PacketBuffer* packet) { TlsSetValue(key_, packet); }
+
+ private:
+  DWORD key_;
+#endif
+};
+
+}  // namespace
+
+PacketBuffer::PacketBuffer(size_t capacity)
+    : ref_count_(0),
+      buffer_(NULL, 0, capacity) {
+}
+
+PacketBuffer::~PacketBuffer() {
+}
+
+int PacketBuffer::AddRef() {
+  return AtomicOps::Increment(&ref_count_);
+}
+
+int PacketBuffer::Release() {
+  int count = AtomicOps::Decrement(&ref_count_);
+  if (!count) {
+    // Hold on to the pool while it takes the buffer back; this may be the
+    // last reference to it.
+    scoped_refptr<PacketBufferPool> pool;
+    pool.swap(pool_);
+    pool->Return(this);
+  }
+  return count;
+}
+
+bool PacketBuffer::HasOneRef() const {
+  return ref_count_ == 1;
+}
+
+// static
+PacketBuffer* PacketBuffer::Signaled() {
+  return SignaledPacketSlot::Instance()->Get();
+}
+
+// static
+PacketBuffer* PacketBuffer::SignaledWithData(const char* data, size_t length) {
+  PacketBuffer* packet = Signaled();
+  if (!packet || packet->buffer_.data() != data ||
+      packet->buffer_.length() != length) {
+    return NULL;
+  }
+  return packet;
+}
+
+SignaledPacketScope::SignaledPacketScope(PacketBuffer* packet)
+    : previous_(SignaledPacketSlot::Instance()->Get()) {
+  SignaledPacketSlot::Instance()->Set(packet);
+}
+
+SignaledPacketScope::~SignaledPacketScope() {
+  SignaledPacketSlot::Instance()->Set(previous_);
+}
+
+PacketBufferPool::PacketBufferPool(size_t buffer_size,
+                                   size_t max_free_buffers)
+    : ref_count_(0),
+      buffer_size_(buffer_size),
+      max_free_buffers_(max_free_buffers) {
+}
+
+PacketBufferPool::~PacketBufferPool() {
+  for (size_t i = 0; i < free_.size(); ++i) {
+    delete free_[i];
+  }
+}
+
+int PacketBufferPool::AddRef() {
+  return AtomicOps::Increment(&ref_count_);
+}
+
+int PacketBufferPool::Release() {
+  int count = AtomicOps::Decrement(&ref_count_);
+  if (!count) {
+    delete this;
+  }
+  return count;
+}
+
+scoped_refptr<PacketBuffer> PacketBufferPool::Get() {
+  PacketBuffer* buffer = NULL;
+  {
+    CritScope cs(&crit_);
+    if (!free_.empty()) {
+      buffer = free_.back();
+      free_.pop_back();
+    }
+  }
+  if (!buffer) {
+    buffer = new PacketBuffer(buffer_size_);
+  }
+  // A receiver may have taken the memory with Buffer::TransferTo.
+  buffer->buffer_.SetCapacity(buffer_size_);
+  buffer->pool_ = this;
+  return buffer;
+}
+
+size_t PacketBufferPool::free_buffers() const {
+  CritScope cs(&crit_);
+  return free_.size();
+}
+
+void PacketBufferPool::Return(PacketBuffer* buffer) {
+  ASSERT(buffer->ref_count_ == 0);
+  buffer->buffer_.SetLength(0);
+  {
+    CritScope cs(&crit_);
+    if (free_.size() < max_free_buffers_) {
+      free_.push_back(buffer);
+      return;
+    }
+  }
+  delete buffer;
+}
+
+}  // namespace rtc
@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef WEBRTC_BASE_PACKETBUFFER_H_
+#define WEBRTC_BASE_PACKETBUFFER_H_
+
+#include <vector>
+
+#include "webrtc/base/buffer.h"
+#include "webrtc/base/constructormagic.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/scoped_ref_ptr.h"
+
+namespace rtc {
+
+class PacketBufferPool;
+
+// Holds one received packet. Packet buffers are reference counted and come
+// from a PacketBufferPool, which gets them back when the last reference is
+// released. This lets a socket hand the memory it received a packet into all
+// the way up the stack, where the final receiver may keep it or modify it in
+// place (e.g. decrypt it) instead of copying it.
+class PacketBuffer {
+ public:
+  int AddRef();
+  int Release();
+  // Returns true if the caller holds the only reference.
+  bool HasOneRef() const;
+
+  Buffer* buffer() { return &buffer_; }
+  const Buffer* buffer() const { return &buffer_; }
+
+  // Returns the packet that is being signaled on the current thread, or NULL.
+  // A receiver that gets a pointer to exactly this packet's data may take a
+  // reference to the packet, and may modify the data, rather than copy it.
+  // Only the final receiver of a packet should modify it, so code that
+  // passes a packet on to more than one receiver must hide it from them with
+  // a SignaledPacketScope for NULL.
+  static PacketBuffer* Signaled();
+  // Returns Signaled() if |data| and |length| are exactly its data.
+  static PacketBuffer* SignaledWithData(const char* data, size_t length);
+
+ private:
+  friend class PacketBufferPool;
+
+  explicit PacketBuffer(size_t capacity);
+  ~PacketBuffer();
+
+  int ref_count_;
+  // The pool that gets the buffer back; NULL while the buffer is free.
+  scoped_refptr<PacketBufferPool> pool_;
+  Buffer buffer_;
+  DISALLOW_COPY_AND_ASSIGN(PacketBuffer);
+};
+
+// Makes |packet| the one returned by PacketBuffer::Signaled() on the current
+// thread for the lifetime of the object.
+class SignaledPacketScope {
+ public:
+  explicit SignaledPacketScope(PacketBuffer* packet);
+  ~SignaledPacketScope();
+
+ private:
+  PacketBuffer* previous_;
+  DISALLOW_COPY_AND_ASSIGN(SignaledPacketScope);
+};
+
+// Keeps up to |max_free_buffers| released packet buffers of |buffer_size|
+// bytes for reuse. The pool is reference counted, and buffers that are still
+// in use keep it alive. Buffers may be released on any thread.
+class PacketBufferPool {
+ public:
+  PacketBufferPool(size_t buffer_size, size_t max_free_buffers);
+
+  int AddRef();
+  int Release();
+
+  // Returns an empty buffer with a capacity of |buffer_size| bytes.
+  scoped_refptr<PacketBuffer> Get();
+
+  size_t buffer_size() const { return buffer_size_; }
+  size_t free_buffers() const;
+
+ private:
+  friend class PacketBuffer;
+
+  ~PacketBufferPool();
+
+  // Called when the last reference to |buffer| is released.
+  void Return(PacketBuffer* buffer);
+
+  int ref_count_;
+  const size_t buffer_size_;
+  const size_t max_free_buffers_;
+  mutable CriticalSection crit_;
+  std::vector<PacketBuffer*> free_;
+  DISALLOW_COPY_AND_ASSIGN(PacketBufferPool);
+};
+
+}  // namespace rtc
+
+#endif  // WEBRTC_BASE_PACKETBUFFER_H_
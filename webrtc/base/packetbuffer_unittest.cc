@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/base/gunit.h"
+#include "webrtc/base/packetbuffer.h"
+
+namespace rtc {
+
+TEST(PacketBufferPoolTest, ReusesReleasedBuffers) {
+  scoped_refptr<PacketBufferPool> pool(new PacketBufferPool(1500, 1));
+  scoped_refptr<PacketBuffer> packet(pool->Get());
+  EXPECT_TRUE(packet->HasOneRef());
+  EXPECT_EQ(0U, packet->buffer()->length());
+  EXPECT_EQ(1500U, packet->buffer()->capacity());
+  packet->buffer()->SetData("abc", 3);
+  char* data = packet->buffer()->data();
+
+  PacketBuffer* first = packet.get();
+  packet = NULL;
+  EXPECT_EQ(1U, pool->free_buffers());
+  packet = pool->Get();
+  EXPECT_EQ(first, packet.get());
+  EXPECT_EQ(data, packet->buffer()->data());
+  EXPECT_EQ(0U, packet->buffer()->length());
+  EXPECT_EQ(0U, pool->free_buffers());
+}
+
+TEST(PacketBufferPoolTest, KeepsAtMostMaxFreeBuffers) {
+  scoped_refptr<PacketBufferPool> pool(new PacketBufferPool(100, 2));
+  scoped_refptr<PacketBuffer> packets[3];
+  for (int i = 0; i < 3; ++i) {
+    packets[i] = pool->Get();
+  }
+  EXPECT_NE(packets[0].get(), packets[1].get());
+  EXPECT_NE(packets[1].get(), packets[2].get());
+  for (int i = 0; i < 3; ++i) {
+    packets[i] = NULL;
+  }
+  EXPECT_EQ(2U, pool->free_buffers());
+}
+
+TEST(PacketBufferPoolTest, BuffersOutliveThePool) {
+  scoped_refptr<PacketBufferPool> pool(new PacketBufferPool(100, 1));
+  scoped_refptr<PacketBuffer> packet(pool->Get());
+  pool = NULL;
+  packet->buffer()->SetData("abc", 3);
+  EXPECT_EQ(3U, packet->buffer()->length());
+  packet = NULL;
+}
+
+TEST(PacketBufferPoolTest, RestoresCapacityOfTakenBuffers) {
+  scoped_refptr<PacketBufferPool> pool(new PacketBufferPool(100, 1));
+  scoped_refptr<PacketBuffer> packet(pool->Get());
+  packet->buffer()->SetData("abc", 3);
+  Buffer taken;
+  packet->buffer()->TransferTo(&taken);
+  packet = NULL;
+  packet = pool->Get();
+  EXPECT_EQ(100U, packet->buffer()->capacity());
+}
+
+TEST(PacketBufferTest, SignaledPacketScope) {
+  scoped_refptr<PacketBufferPool> pool(new PacketBufferPool(100, 2));
+  scoped_refptr<PacketBuffer> outer(pool->Get());
+  scoped_refptr<PacketBuffer> inner(pool->Get());
+  outer->buffer()->SetData("outer", 5);
+  inner->buffer()->SetData("inner", 5);
+
+  EXPECT_TRUE(PacketBuffer::Signaled() == NULL);
+  {
+    SignaledPacketScope outer_scope(outer.get());
+    EXPECT_EQ(outer.get(), PacketBuffer::Signaled());
+    {
+      SignaledPacketScope inner_scope(inner.get());
+      EXPECT_EQ(inner.get(), PacketBuffer::Signaled());
+    }
+    EXPECT_EQ(outer.get(), PacketBuffer::Signaled());
+
+    const char* data = outer->buffer()->data();
+    EXPECT_EQ(outer.get(), PacketBuffer::SignaledWithData(data, 5));
+    EXPECT_TRUE(PacketBuffer::SignaledWithData(data, 4) == NULL);
+    EXPECT_TRUE(PacketBuffer::SignaledWithData(data + 1, 4) == NULL);
+    EXPECT_TRUE(PacketBuffer::SignaledWithData(inner->buffer()->data(), 5) ==
+                NULL);
+  }
+  EXPECT_TRUE(PacketBuffer::Signaled() == NULL);
+}
+
+}  // namespace rtc
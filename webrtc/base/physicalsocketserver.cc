@@ -49,6 +49,11 @@
 #include "webrtc/base/winping.h"
 #include "webrtc/base/win32socketinit.h"
 
+#if defined(WEBRTC_USE_EPOLL)
+#include <poll.h>
+#include <sys/epoll.h>
+#endif
+
 // stm: this will tell us if we are on OSX
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -96,6 +101,17 @@ static const int ICMP_HEADER_SIZE = 8u;
 static const int ICMP_PING_TIMEOUT_MILLIS = 10000u;
 #endif
 
+#if defined(WEBRTC_LINUX) && !defined(WEBRTC_ANDROID)
+// Maximum number of datagrams passed to a single recvmmsg() or sendmmsg()
+// call. The message headers for a batch live on the stack.
+static const size_t kMaxMmsgBatchSize = 32;
+#endif
+
+#if defined(WEBRTC_POSIX)
+// Maximum number of pieces passed to a single sendmsg() call by SendV.
+static const size_t kMaxSendVCount = 16;
+#endif
+
 class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
  public:
   PhysicalSocket(PhysicalSocketServer* ss, SOCKET s = INVALID_SOCKET)
@@ -131,7 +147,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     udp_ = (SOCK_DGRAM == type);
     UpdateLastError();
     if (udp_)
-      enabled_events_ = DE_READ | DE_WRITE;
+      SetEnabledEvents(DE_READ | DE_WRITE);
     return s_ != INVALID_SOCKET;
   }
 
@@ -213,12 +229,12 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       state_ = CS_CONNECTED;
     } else if (IsBlockingError(GetError())) {
       state_ = CS_CONNECTING;
-      enabled_events_ |= DE_CONNECT;
+      EnableEvents(DE_CONNECT);
     } else {
       return SOCKET_ERROR;
     }
 
-    enabled_events_ |= DE_READ | DE_WRITE;
+    EnableEvents(DE_READ | DE_WRITE);
     return 0;
   }
 
@@ -282,11 +298,44 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(cb));
     if ((sent < 0) && IsBlockingError(GetError())) {
-      enabled_events_ |= DE_WRITE;
+      EnableEvents(DE_WRITE);
     }
     return sent;
   }
 
+#if defined(WEBRTC_POSIX)
+  virtual int SendV(const IoVec* iov, size_t count) {
+    // Sending fewer pieces than asked for is just a short write.
+    count = std::min(count, kMaxSendVCount);
+    iovec iovs[kMaxSendVCount];
+    size_t length = 0;
+    for (size_t i = 0; i < count; ++i) {
+      iovs[i].iov_base = const_cast<void*>(iov[i].data);
+      iovs[i].iov_len = iov[i].length;
+      length += iov[i].length;
+    }
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = count;
+    int sent = ::sendmsg(s_, &msg,
+#if defined(WEBRTC_LINUX) && !defined(WEBRTC_ANDROID)
+        // Suppress SIGPIPE. See Send() for explanation.
+        MSG_NOSIGNAL
+#else
+        0
+#endif
+        );
+    UpdateLastError();
+    MaybeRemapSendError();
+    ASSERT(sent <= static_cast<int>(length));
+    if ((sent < 0) && IsBlockingError(GetError())) {
+      EnableEvents(DE_WRITE);
+    }
+    return sent;
+  }
+#endif
+
   int SendTo(const void* buffer, size_t length, const SocketAddress& addr) {
     sockaddr_storage saddr;
     size_t len = addr.ToSockAddrStorage(&saddr);
@@ -304,7 +353,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(length));
     if ((sent < 0) && IsBlockingError(GetError())) {
-      enabled_events_ |= DE_WRITE;
+      EnableEvents(DE_WRITE);
     }
     return sent;
   }
@@ -319,7 +368,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       LOG(LS_WARNING) << "EOF from socket; deferring close event";
       // Must turn this back on so that the select() loop will notice the close
       // event.
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
       SetError(EWOULDBLOCK);
       return SOCKET_ERROR;
     }
@@ -327,7 +376,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     int error = GetError();
     bool success = (received >= 0) || IsBlockingError(error);
     if (udp_ || success) {
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
     }
     if (!success) {
       LOG_F(LS_VERBOSE) << "Error = " << error;
@@ -347,7 +396,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     int error = GetError();
     bool success = (received >= 0) || IsBlockingError(error);
     if (udp_ || success) {
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
     }
     if (!success) {
       LOG_F(LS_VERBOSE) << "Error = " << error;
@@ -355,12 +404,95 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     return received;
   }
 
+#if defined(WEBRTC_LINUX) && !defined(WEBRTC_ANDROID)
+  virtual int RecvFromBatch(RecvBatchEntry* entries, size_t count) {
+    count = std::min(count, kMaxMmsgBatchSize);
+    mmsghdr msgs[kMaxMmsgBatchSize];
+    iovec iovs[kMaxMmsgBatchSize];
+    sockaddr_storage addrs[kMaxMmsgBatchSize];
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (size_t i = 0; i < count; ++i) {
+      iovs[i].iov_base = entries[i].buffer;
+      iovs[i].iov_len = entries[i].size;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    // MSG_WAITFORONE makes the call non-blocking once the first datagram has
+    // been received, so a blocking socket behaves just like with recvfrom().
+    int received = ::recvmmsg(s_, msgs, static_cast<unsigned int>(count),
+                              MSG_WAITFORONE, NULL);
+    UpdateLastError();
+    for (int i = 0; i < received; ++i) {
+      entries[i].length = msgs[i].msg_len;
+      SocketAddressFromSockAddrStorage(addrs[i], &entries[i].addr);
+    }
+    int error = GetError();
+    bool success = (received >= 0) || IsBlockingError(error);
+    if (udp_ || success) {
+      EnableEvents(DE_READ);
+    }
+    if (!success) {
+      LOG_F(LS_VERBOSE) << "Error = " << error;
+    }
+    return received;
+  }
+
+  virtual int SendToBatch(const SendBatchEntry* entries, size_t count) {
+    mmsghdr msgs[kMaxMmsgBatchSize];
+    iovec iovs[kMaxMmsgBatchSize];
+    sockaddr_storage addrs[kMaxMmsgBatchSize];
+    size_t next = 0;
+    size_t sent = 0;
+    int error = 0;
+    while (next < count) {
+      size_t batch = std::min(count - next, kMaxMmsgBatchSize);
+      memset(msgs, 0, sizeof(msgs[0]) * batch);
+      for (size_t i = 0; i < batch; ++i) {
+        const SendBatchEntry& entry = entries[next + i];
+        iovs[i].iov_base = const_cast<void*>(entry.data);
+        iovs[i].iov_len = entry.length;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen =
+            static_cast<socklen_t>(entry.addr.ToSockAddrStorage(&addrs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      // Suppress SIGPIPE. See Send() for explanation.
+      int result = ::sendmmsg(s_, msgs, static_cast<unsigned int>(batch),
+                              MSG_NOSIGNAL);
+      if (result >= 0) {
+        // A short count means the next datagram would block or failed; the
+        // following call reports which.
+        next += result;
+        sent += result;
+        continue;
+      }
+      UpdateLastError();
+      error = GetError();
+      if (IsBlockingError(error)) {
+        EnableEvents(DE_WRITE);
+        break;
+      }
+      // Only this datagram failed, e.g. because its destination is
+      // unreachable; the ones after it may go to other destinations.
+      LOG_F(LS_VERBOSE) << "Error = " << error << " sending to "
+                        << entries[next].addr.ToSensitiveString();
+      ++next;
+    }
+    // Report the last failure even if later datagrams were sent.
+    SetError(error);
+    return (sent > 0 || count == 0) ? static_cast<int>(sent) : -1;
+  }
+#endif
+
   int Listen(int backlog) {
     int err = ::listen(s_, backlog);
     UpdateLastError();
     if (err == 0) {
       state_ = CS_CONNECTING;
-      enabled_events_ |= DE_ACCEPT;
+      EnableEvents(DE_ACCEPT);
 #ifdef _DEBUG
       dbg_addr_ = "Listening @ ";
       dbg_addr_.append(GetLocalAddress().ToString());
@@ -377,7 +509,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     if (s == INVALID_SOCKET)
       return NULL;
-    enabled_events_ |= DE_ACCEPT;
+    EnableEvents(DE_ACCEPT);
     if (out_addr != NULL)
       SocketAddressFromSockAddrStorage(addr_storage, out_addr);
     return ss_->WrapSocket(s);
@@ -390,7 +522,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     s_ = INVALID_SOCKET;
     state_ = CS_CLOSED;
-    enabled_events_ = 0;
+    SetEnabledEvents(0);
     if (resolver_) {
       resolver_->Destroy(false);
       resolver_ = NULL;
@@ -487,6 +619,20 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     SetError(LAST_SYSTEM_ERROR);
   }
 
+  // All changes to |enabled_events_| go through SetEnabledEvents, so that a
+  // dispatcher can tell its socket server about the new interest set.
+  virtual void SetEnabledEvents(uint8 events) {
+    enabled_events_ = events;
+  }
+
+  void EnableEvents(uint8 events) {
+    SetEnabledEvents(enabled_events_ | events);
+  }
+
+  void DisableEvents(uint8 events) {
+    SetEnabledEvents(enabled_events_ & ~events);
+  }
+
   void MaybeRemapSendError() {
 #if defined(WEBRTC_MAC)
     // https://developer.apple.com/library/mac/documentation/Darwin/
@@ -532,6 +678,15 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
         return -1;
       case OPT_RTP_SENDTIME_EXTN_ID:
         return -1;  // No logging is necessary as this not a OS socket option.
+      case OPT_REUSEPORT:
+#if defined(SO_REUSEPORT)
+        *slevel = SOL_SOCKET;
+        *sopt = SO_REUSEPORT;
+        break;
+#else
+        LOG(LS_WARNING) << "Socket::OPT_REUSEPORT not supported.";
+        return -1;
+#endif
       default:
         ASSERT(false);
         return -1;
@@ -874,6 +1029,13 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     return enabled_events_;
   }
 
+  virtual void SetEnabledEvents(uint8 events) {
+    if (events == enabled_events_)
+      return;
+    enabled_events_ = events;
+    ss_->Update(this);
+  }
+
   virtual void OnPreEvent(uint32 ff) {
     if ((ff & DE_CONNECT) != 0)
       state_ = CS_CONNECTED;
@@ -885,24 +1047,24 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     // Make sure we deliver connect/accept first. Otherwise, consumers may see
     // something like a READ followed by a CONNECT, which would be odd.
     if ((ff & DE_CONNECT) != 0) {
-      enabled_events_ &= ~DE_CONNECT;
+      DisableEvents(DE_CONNECT);
       SignalConnectEvent(this);
     }
     if ((ff & DE_ACCEPT) != 0) {
-      enabled_events_ &= ~DE_ACCEPT;
+      DisableEvents(DE_ACCEPT);
       SignalReadEvent(this);
     }
     if ((ff & DE_READ) != 0) {
-      enabled_events_ &= ~DE_READ;
+      DisableEvents(DE_READ);
       SignalReadEvent(this);
     }
     if ((ff & DE_WRITE) != 0) {
-      enabled_events_ &= ~DE_WRITE;
+      DisableEvents(DE_WRITE);
       SignalWriteEvent(this);
     }
     if ((ff & DE_CLOSE) != 0) {
       // The socket is now dead to us, so stop checking it.
-      enabled_events_ = 0;
+      SetEnabledEvents(0);
       SignalCloseEvent(this, err);
     }
   }
@@ -918,7 +1080,8 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
 
 class FileDispatcher: public Dispatcher, public AsyncFile {
  public:
-  FileDispatcher(int fd, PhysicalSocketServer *ss) : ss_(ss), fd_(fd) {
+  FileDispatcher(int fd, PhysicalSocketServer *ss)
+      : ss_(ss), fd_(fd), flags_(0) {
     set_readable(true);
 
     ss_->Add(this);
@@ -962,6 +1125,7 @@ class FileDispatcher: public Dispatcher, public AsyncFile {
 
   virtual void set_readable(bool value) {
     flags_ = value ? (flags_ | DE_READ) : (flags_ & ~DE_READ);
+    ss_->Update(this);
   }
 
   virtual bool writable() {
@@ -970,6 +1134,7 @@ class FileDispatcher: public Dispatcher, public AsyncFile {
 
   virtual void set_writable(bool value) {
     flags_ = value ? (flags_ | DE_WRITE) : (flags_ & ~DE_WRITE);
+    ss_->Update(this);
   }
 
  private:
@@ -1121,7 +1286,7 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     if (((ff & DE_CONNECT) != 0) && (id_ == cache_id)) {
       if (ff != DE_CONNECT)
         LOG(LS_VERBOSE) << "Signalled with DE_CONNECT: " << ff;
-      enabled_events_ &= ~DE_CONNECT;
+      DisableEvents(DE_CONNECT);
 #ifdef _DEBUG
       dbg_addr_ = "Connected @ ";
       dbg_addr_.append(GetRemoteAddress().ToString());
@@ -1129,15 +1294,15 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
       SignalConnectEvent(this);
     }
     if (((ff & DE_ACCEPT) != 0) && (id_ == cache_id)) {
-      enabled_events_ &= ~DE_ACCEPT;
+      DisableEvents(DE_ACCEPT);
       SignalReadEvent(this);
     }
     if ((ff & DE_READ) != 0) {
-      enabled_events_ &= ~DE_READ;
+      DisableEvents(DE_READ);
       SignalReadEvent(this);
     }
     if (((ff & DE_WRITE) != 0) && (id_ == cache_id)) {
-      enabled_events_ &= ~DE_WRITE;
+      DisableEvents(DE_WRITE);
       SignalWriteEvent(this);
     }
     if (((ff & DE_CLOSE) != 0) && (id_ == cache_id)) {
@@ -1191,7 +1356,19 @@ class Signaler : public EventDispatcher {
 };
 
 PhysicalSocketServer::PhysicalSocketServer()
-    : fWait_(false) {
+    :
+#if defined(WEBRTC_USE_EPOLL)
+      // The size argument is ignored by modern kernels but must be positive.
+      epoll_fd_(epoll_create(FD_SETSIZE)),
+      next_epoll_key_(0),
+#endif
+      fWait_(false) {
+#if defined(WEBRTC_USE_EPOLL)
+  if (epoll_fd_ == -1) {
+    // Not an error, since we can fall back to select().
+    LOG_E(LS_WARNING, EN, errno) << "epoll_create; falling back to select()";
+  }
+#endif
   signal_wakeup_ = new Signaler(this, &fWait_);
 #if defined(WEBRTC_WIN)
   socket_ev_ = WSACreateEvent();
@@ -1207,6 +1384,11 @@ PhysicalSocketServer::~PhysicalSocketServer() {
 #endif
   delete signal_wakeup_;
   ASSERT(dispatchers_.empty());
+#if defined(WEBRTC_USE_EPOLL)
+  if (epoll_fd_ != -1) {
+    close(epoll_fd_);
+  }
+#endif
 }
 
 void PhysicalSocketServer::WakeUp() {
@@ -1260,6 +1442,11 @@ void PhysicalSocketServer::Add(Dispatcher *pdispatcher) {
   if (pos != dispatchers_.end())
     return;
   dispatchers_.push_back(pdispatcher);
+#if defined(WEBRTC_USE_EPOLL)
+  if (epoll_fd_ != -1) {
+    AddEpoll(pdispatcher);
+  }
+#endif
 }
 
 void PhysicalSocketServer::Remove(Dispatcher *pdispatcher) {
@@ -1283,10 +1470,90 @@ void PhysicalSocketServer::Remove(Dispatcher *pdispatcher) {
       --**it;
     }
   }
+#if defined(WEBRTC_USE_EPOLL)
+  if (epoll_fd_ != -1) {
+    RemoveEpoll(pdispatcher);
+  }
+#endif
+}
+
+void PhysicalSocketServer::Update(Dispatcher *pdispatcher) {
+#if defined(WEBRTC_USE_EPOLL)
+  if (epoll_fd_ == -1) {
+    return;
+  }
+
+  CritScope cs(&crit_);
+  UpdateEpoll(pdispatcher);
+#endif
 }
 
 #if defined(WEBRTC_POSIX)
+// Translates the readiness of a dispatcher's descriptor, as reported by
+// select() or epoll, into dispatcher events and delivers them.
+static void ProcessEvents(Dispatcher* pdispatcher, bool readable,
+                          bool writable) {
+  int fd = pdispatcher->GetDescriptor();
+  uint32 ff = 0;
+  int errcode = 0;
+
+  // Reap any error code, which can be signaled through reads or writes.
+  // TODO: Should we set errcode if getsockopt fails?
+  if (readable || writable) {
+    socklen_t len = sizeof(errcode);
+    ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &errcode, &len);
+  }
+
+  // Check readable descriptors. If we're waiting on an accept, signal
+  // that. Otherwise we're waiting for data, check to see if we're
+  // readable or really closed.
+  // TODO: Only peek at TCP descriptors.
+  if (readable) {
+    if (pdispatcher->GetRequestedEvents() & DE_ACCEPT) {
+      ff |= DE_ACCEPT;
+    } else if (errcode || pdispatcher->IsDescriptorClosed()) {
+      ff |= DE_CLOSE;
+    } else {
+      ff |= DE_READ;
+    }
+  }
+
+  // Check writable descriptors. If we're waiting on a connect, detect
+  // success versus failure by the reaped error code.
+  if (writable) {
+    if (pdispatcher->GetRequestedEvents() & DE_CONNECT) {
+      if (!errcode) {
+        ff |= DE_CONNECT;
+      } else {
+        ff |= DE_CLOSE;
+      }
+    } else {
+      ff |= DE_WRITE;
+    }
+  }
+
+  // Tell the descriptor about the event.
+  if (ff != 0) {
+    pdispatcher->OnPreEvent(ff);
+    pdispatcher->OnEvent(ff, errcode);
+  }
+}
+
 bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
+#if defined(WEBRTC_USE_EPOLL)
+  // The epoll set always contains every dispatcher, so when I/O must not be
+  // processed, just wait on the wakeup signal with poll() instead.
+  if (!process_io) {
+    return WaitPoll(cmsWait, signal_wakeup_);
+  }
+  if (epoll_fd_ != -1) {
+    return WaitEpoll(cmsWait);
+  }
+#endif
+  return WaitSelect(cmsWait, process_io);
+}
+
+bool PhysicalSocketServer::WaitSelect(int cmsWait, bool process_io) {
   // Calculate timing information
 
   struct timeval *ptvWait = NULL;
@@ -1372,51 +1639,15 @@ bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
       for (size_t i = 0; i < dispatchers_.size(); ++i) {
         Dispatcher *pdispatcher = dispatchers_[i];
         int fd = pdispatcher->GetDescriptor();
-        uint32 ff = 0;
-        int errcode = 0;
-
-        // Reap any error code, which can be signaled through reads or writes.
-        // TODO: Should we set errcode if getsockopt fails?
-        if (FD_ISSET(fd, &fdsRead) || FD_ISSET(fd, &fdsWrite)) {
-          socklen_t len = sizeof(errcode);
-          ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &errcode, &len);
-        }
-
-        // Check readable descriptors. If we're waiting on an accept, signal
-        // that. Otherwise we're waiting for data, check to see if we're
-        // readable or really closed.
-        // TODO: Only peek at TCP descriptors.
-        if (FD_ISSET(fd, &fdsRead)) {
+        bool readable = FD_ISSET(fd, &fdsRead);
+        if (readable) {
           FD_CLR(fd, &fdsRead);
-          if (pdispatcher->GetRequestedEvents() & DE_ACCEPT) {
-            ff |= DE_ACCEPT;
-          } else if (errcode || pdispatcher->IsDescriptorClosed()) {
-            ff |= DE_CLOSE;
-          } else {
-            ff |= DE_READ;
-          }
         }
-
-        // Check writable descriptors. If we're waiting on a connect, detect
-        // success versus failure by the reaped error code.
-        if (FD_ISSET(fd, &fdsWrite)) {
+        bool writable = FD_ISSET(fd, &fdsWrite);
+        if (writable) {
           FD_CLR(fd, &fdsWrite);
-          if (pdispatcher->GetRequestedEvents() & DE_CONNECT) {
-            if (!errcode) {
-              ff |= DE_CONNECT;
-            } else {
-              ff |= DE_CLOSE;
-            }
-          } else {
-            ff |= DE_WRITE;
-          }
-        }
-
-        // Tell the descriptor about the event.
-        if (ff != 0) {
-          pdispatcher->OnPreEvent(ff);
-          pdispatcher->OnEvent(ff, errcode);
         }
+        ProcessEvents(pdispatcher, readable, writable);
       }
     }
 
@@ -1444,6 +1675,213 @@ bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
   return true;
 }
 
+#if defined(WEBRTC_USE_EPOLL)
+// Maximum number of events returned by a single epoll_wait() call. Any
+// remaining ready descriptors are picked up on the next iteration.
+static const int kMaxEpollEvents = 128;
+
+static uint32 GetEpollEvents(uint32 ff) {
+  uint32 events = 0;
+  if (ff & (DE_READ | DE_ACCEPT)) {
+    events |= EPOLLIN;
+  }
+  if (ff & (DE_WRITE | DE_CONNECT)) {
+    events |= EPOLLOUT;
+  }
+  return events;
+}
+
+void PhysicalSocketServer::AddEpoll(Dispatcher* pdispatcher) {
+  ASSERT(epoll_fd_ != -1);
+  EpollEntry entry;
+  entry.key = ++next_epoll_key_;
+  entry.events = 0;
+  entry.pending = false;
+  epoll_entries_[pdispatcher] = entry;
+  epoll_dispatchers_[entry.key] = pdispatcher;
+  ApplyEpollEntry(pdispatcher, &epoll_entries_[pdispatcher]);
+}
+
+void PhysicalSocketServer::RemoveEpoll(Dispatcher* pdispatcher) {
+  ASSERT(epoll_fd_ != -1);
+  EpollEntryMap::iterator it = epoll_entries_.find(pdispatcher);
+  if (it == epoll_entries_.end()) {
+    return;
+  }
+  if (it->second.events != 0) {
+    int fd = pdispatcher->GetDescriptor();
+    if (fd != -1 && epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL) == -1 &&
+        errno != ENOENT && errno != EBADF) {
+      LOG_E(LS_ERROR, EN, errno) << "epoll_ctl EPOLL_CTL_DEL";
+    }
+  }
+  epoll_dispatchers_.erase(it->second.key);
+  epoll_entries_.erase(it);
+}
+
+void PhysicalSocketServer::UpdateEpoll(Dispatcher* pdispatcher) {
+  ASSERT(epoll_fd_ != -1);
+  EpollEntryMap::iterator it = epoll_entries_.find(pdispatcher);
+  if (it == epoll_entries_.end() || it->second.pending) {
+    return;
+  }
+  // Interest changes are applied just before the next epoll_wait(). This
+  // coalesces the common pattern of a dispatcher disabling an event in
+  // OnEvent() and re-enabling it from the signal handler, which would
+  // otherwise cost two epoll_ctl() calls per packet.
+  it->second.pending = true;
+  pending_epoll_updates_.push_back(pdispatcher);
+}
+
+void PhysicalSocketServer::ApplyEpollEntry(Dispatcher* pdispatcher,
+                                           EpollEntry* entry) {
+  uint32 events = GetEpollEvents(pdispatcher->GetRequestedEvents());
+  if (events == entry->events) {
+    return;
+  }
+
+  int fd = pdispatcher->GetDescriptor();
+  if (fd == -1) {
+    return;
+  }
+
+  // Descriptors without any requested events are removed from the epoll set
+  // entirely, because epoll always reports EPOLLERR and EPOLLHUP, which would
+  // otherwise keep waking us up for a descriptor nobody is interested in.
+  int op;
+  if (entry->events == 0) {
+    op = EPOLL_CTL_ADD;
+  } else if (events == 0) {
+    op = EPOLL_CTL_DEL;
+  } else {
+    op = EPOLL_CTL_MOD;
+  }
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.u64 = entry->key;
+  if (epoll_ctl(epoll_fd_, op, fd, &event) == -1) {
+    LOG_E(LS_ERROR, EN, errno) << "epoll_ctl " << op << " fd=" << fd;
+    return;
+  }
+  entry->events = events;
+}
+
+bool PhysicalSocketServer::WaitEpoll(int cmsWait) {
+  ASSERT(epoll_fd_ != -1);
+  uint32 msStop = 0;
+  if (cmsWait != kForever) {
+    msStop = TimeAfter(cmsWait);
+  }
+
+  struct epoll_event events[kMaxEpollEvents];
+  fWait_ = true;
+
+  while (fWait_) {
+    {
+      CritScope cr(&crit_);
+      for (size_t i = 0; i < pending_epoll_updates_.size(); ++i) {
+        EpollEntryMap::iterator it =
+            epoll_entries_.find(pending_epoll_updates_[i]);
+        if (it == epoll_entries_.end() || !it->second.pending) {
+          // Removed since the update was queued.
+          continue;
+        }
+        it->second.pending = false;
+        ApplyEpollEntry(it->first, &it->second);
+      }
+      pending_epoll_updates_.clear();
+    }
+
+    int cmsNext = -1;
+    if (cmsWait != kForever) {
+      cmsNext = _max(0, TimeUntil(msStop));
+    }
+
+    // Wait then call handlers as appropriate
+    // < 0 means error
+    // 0 means timeout
+    // > 0 means count of descriptors ready
+    int n = epoll_wait(epoll_fd_, events, kMaxEpollEvents, cmsNext);
+
+    if (n < 0) {
+      if (errno != EINTR) {
+        LOG_E(LS_ERROR, EN, errno) << "epoll_wait";
+        return false;
+      }
+      // Else ignore the error and keep going. If this EINTR was for one of the
+      // signals managed by this PhysicalSocketServer, the
+      // PosixSignalDeliveryDispatcher will be in the signaled state in the next
+      // iteration.
+    } else if (n == 0) {
+      // If timeout, return success
+      return true;
+    } else {
+      // We have signaled descriptors
+      CritScope cr(&crit_);
+      for (int i = 0; i < n; ++i) {
+        // Look the dispatcher up by key, since it may have been removed (and
+        // deleted) while handling a previous event.
+        EpollKeyMap::iterator it = epoll_dispatchers_.find(events[i].data.u64);
+        if (it == epoll_dispatchers_.end()) {
+          continue;
+        }
+        Dispatcher* pdispatcher = it->second;
+        // Only report readiness the dispatcher still asks for; epoll reports
+        // errors and hangups regardless of the interest set.
+        uint32 requested = pdispatcher->GetRequestedEvents();
+        bool readable = (requested & (DE_READ | DE_ACCEPT)) &&
+            (events[i].events & (EPOLLIN | EPOLLPRI | EPOLLERR | EPOLLHUP));
+        bool writable = (requested & (DE_WRITE | DE_CONNECT)) &&
+            (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP));
+        ProcessEvents(pdispatcher, readable, writable);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool PhysicalSocketServer::WaitPoll(int cmsWait, Dispatcher* pdispatcher) {
+  ASSERT(pdispatcher);
+  uint32 msStop = 0;
+  if (cmsWait != kForever) {
+    msStop = TimeAfter(cmsWait);
+  }
+
+  struct pollfd fds;
+  memset(&fds, 0, sizeof(fds));
+  fds.fd = pdispatcher->GetDescriptor();
+  fds.events = POLLIN;
+  fWait_ = true;
+
+  while (fWait_) {
+    fds.revents = 0;
+
+    int cmsNext = -1;
+    if (cmsWait != kForever) {
+      cmsNext = _max(0, TimeUntil(msStop));
+    }
+
+    int n = poll(&fds, 1, cmsNext);
+    if (n < 0) {
+      if (errno != EINTR) {
+        LOG_E(LS_ERROR, EN, errno) << "poll";
+        return false;
+      }
+    } else if (n == 0) {
+      return true;
+    } else {
+      CritScope cr(&crit_);
+      ProcessEvents(pdispatcher, true, false);
+    }
+  }
+
+  return true;
+}
+#endif  // WEBRTC_USE_EPOLL
+
 static void GlobalSignalHandler(int signum) {
   PosixSignalHandler::Instance()->OnPosixSignalReceived(signum);
 }
@@ -11,6 +11,7 @@
 #ifndef WEBRTC_BASE_PHYSICALSOCKETSERVER_H__
 #define WEBRTC_BASE_PHYSICALSOCKETSERVER_H__
 
+#include <map>
 #include <vector>
 
 #include "webrtc/base/asyncfile.h"
@@ -22,6 +23,14 @@
 typedef int SOCKET;
 #endif // WEBRTC_POSIX
 
+// On Linux the socket server waits on an epoll set that dispatchers are
+// registered with once, rather than rebuilding fd_sets for select() on every
+// iteration. The select() implementation is still used if epoll is not
+// available at runtime.
+#if defined(WEBRTC_LINUX) && !defined(WEBRTC_USE_EPOLL)
+#define WEBRTC_USE_EPOLL 1
+#endif
+
 namespace rtc {
 
 // Event constants for the Dispatcher class.
@@ -76,6 +85,9 @@ class PhysicalSocketServer : public SocketServer {
 
   void Add(Dispatcher* dispatcher);
   void Remove(Dispatcher* dispatcher);
+  // Must be called by a dispatcher whenever the value returned by its
+  // GetRequestedEvents() changes.
+  void Update(Dispatcher* dispatcher);
 
 #if defined(WEBRTC_POSIX)
   AsyncFile* CreateFile(int fd);
@@ -103,7 +115,37 @@ class PhysicalSocketServer : public SocketServer {
 #if defined(WEBRTC_POSIX)
   static bool InstallSignal(int signum, void (*handler)(int));
 
+  bool WaitSelect(int cms, bool process_io);
+
   scoped_ptr<PosixSignalDispatcher> signal_dispatcher_;
+#endif
+#if defined(WEBRTC_USE_EPOLL)
+  // Registration state of a dispatcher in the epoll set. The key is stored in
+  // the epoll event instead of the dispatcher pointer, so that events for a
+  // dispatcher that was removed after epoll_wait() returned are ignored.
+  struct EpollEntry {
+    uint64 key;
+    // The epoll events currently registered for the descriptor.
+    uint32 events;
+    // True if the dispatcher is queued in |pending_epoll_updates_|.
+    bool pending;
+  };
+  typedef std::map<Dispatcher*, EpollEntry> EpollEntryMap;
+  typedef std::map<uint64, Dispatcher*> EpollKeyMap;
+
+  bool WaitEpoll(int cms);
+  // Waits for |dispatcher| alone to become readable.
+  bool WaitPoll(int cms, Dispatcher* dispatcher);
+  void AddEpoll(Dispatcher* dispatcher);
+  void RemoveEpoll(Dispatcher* dispatcher);
+  void UpdateEpoll(Dispatcher* dispatcher);
+  void ApplyEpollEntry(Dispatcher* dispatcher, EpollEntry* entry);
+
+  int epoll_fd_;
+  uint64 next_epoll_key_;
+  EpollEntryMap epoll_entries_;
+  EpollKeyMap epoll_dispatchers_;
+  DispatcherList pending_epoll_updates_;
 #endif
   DispatcherList dispatchers_;
   IteratorList iterators_;
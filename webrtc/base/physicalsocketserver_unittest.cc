@@ -10,6 +10,10 @@
 
 #include <signal.h>
 #include <stdarg.h>
+#if defined(WEBRTC_POSIX)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/logging.h"
@@ -153,6 +157,68 @@ TEST_F(PhysicalSocketTest, TestGetSetOptionsIPv6) {
   SocketTest::TestGetSetOptionsIPv6();
 }
 
+#if defined(WEBRTC_USE_EPOLL)
+
+class ReadEventCounter : public sigslot::has_slots<> {
+ public:
+  ReadEventCounter() : count_(0) {}
+  void OnReadEvent(AsyncSocket* socket) {
+    char buf[64];
+    SocketAddress addr;
+    if (socket->RecvFrom(buf, sizeof(buf), &addr) > 0) {
+      ++count_;
+    }
+  }
+  int count() const { return count_; }
+
+ private:
+  int count_;
+};
+
+// Descriptors numbered at or above FD_SETSIZE can't be waited on with
+// select(), but must work with the epoll based implementation.
+TEST_F(PhysicalSocketTest, TestUdpDescriptorAboveFdSetSize) {
+  const int kTimeoutMs = 5000;
+  struct rlimit limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &limit));
+  if (limit.rlim_cur <= FD_SETSIZE + 1) {
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max <= FD_SETSIZE + 1) {
+      LOG(LS_WARNING) << "RLIMIT_NOFILE too low, skipping test.";
+      return;
+    }
+    limit.rlim_cur = FD_SETSIZE + 2;
+    ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+  }
+
+  PhysicalSocketServer ss;
+  int s = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_NE(-1, s);
+  int high_fd = dup2(s, FD_SETSIZE + 1);
+  close(s);
+  ASSERT_EQ(FD_SETSIZE + 1, high_fd);
+
+  scoped_ptr<AsyncSocket> receiver(ss.WrapSocket(high_fd));
+  ASSERT_TRUE(receiver.get() != NULL);
+  ASSERT_EQ(0, receiver->Bind(SocketAddress("127.0.0.1", 0)));
+  ReadEventCounter counter;
+  receiver->SignalReadEvent.connect(&counter, &ReadEventCounter::OnReadEvent);
+
+  scoped_ptr<AsyncSocket> sender(ss.CreateAsyncSocket(AF_INET, SOCK_DGRAM));
+  ASSERT_TRUE(sender.get() != NULL);
+  for (int i = 0; i < 3; ++i) {
+    const char data[] = "foo";
+    EXPECT_EQ(static_cast<int>(sizeof(data)),
+              sender->SendTo(data, sizeof(data), receiver->GetLocalAddress()));
+    uint32 start = Time();
+    while (counter.count() <= i && TimeSince(start) < kTimeoutMs) {
+      ss.Wait(10, true);
+    }
+    EXPECT_EQ(i + 1, counter.count());
+  }
+}
+
+#endif  // WEBRTC_USE_EPOLL
+
 #if defined(WEBRTC_POSIX)
 
 class PosixSignalDeliveryTest : public testing::Test {
@@ -562,6 +562,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -716,6 +722,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -855,6 +867,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -993,6 +1011,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -1131,6 +1155,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -1271,6 +1301,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -1411,6 +1447,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -1551,6 +1593,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -1692,6 +1740,12 @@ namespace sigslot {
 			return it == itEnd;
 		}
 
+		size_t connection_count()
+		{
+			lock_block<mt_policy> lock(this);
+			return m_connected_slots.size();
+		}
+
 		void disconnect_all()
 		{
 			lock_block<mt_policy> lock(this);
@@ -123,6 +123,37 @@ inline bool IsBlockingError(int e) {
   return (e == EWOULDBLOCK) || (e == EAGAIN) || (e == EINPROGRESS);
 }
 
+// Describes one datagram slot for Socket::RecvFromBatch. |buffer| and |size|
+// are provided by the caller; |length| and |addr| are filled in on return.
+struct RecvBatchEntry {
+  RecvBatchEntry() : buffer(NULL), size(0), length(0) {}
+
+  void* buffer;
+  size_t size;
+  size_t length;
+  SocketAddress addr;
+};
+
+// Describes one datagram for Socket::SendToBatch.
+struct SendBatchEntry {
+  SendBatchEntry() : data(NULL), length(0) {}
+  SendBatchEntry(const void* data, size_t length, const SocketAddress& addr)
+      : data(data), length(length), addr(addr) {}
+
+  const void* data;
+  size_t length;
+  SocketAddress addr;
+};
+
+// Describes one piece of stream data for Socket::SendV.
+struct IoVec {
+  IoVec() : data(NULL), length(0) {}
+  IoVec(const void* data, size_t length) : data(data), length(length) {}
+
+  const void* data;
+  size_t length;
+};
+
 // General interface for the socket implementations of various networks.  The
 // methods match those of normal UNIX sockets very closely.
 class Socket {
@@ -143,6 +174,66 @@ class Socket {
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr) = 0;
   virtual int Recv(void *pv, size_t cb) = 0;
   virtual int RecvFrom(void *pv, size_t cb, SocketAddress *paddr) = 0;
+
+  // Receives up to |count| datagrams into |entries|. Returns the number of
+  // datagrams received, or -1 if none could be read, in which case the error
+  // is available from GetError(). As with RecvFrom, datagrams that don't fit
+  // in their slot are truncated.
+  // The default implementation calls RecvFrom repeatedly; implementations
+  // that can receive several datagrams with a single system call override it.
+  virtual int RecvFromBatch(RecvBatchEntry* entries, size_t count) {
+    size_t received = 0;
+    for (; received < count; ++received) {
+      RecvBatchEntry& entry = entries[received];
+      int len = RecvFrom(entry.buffer, entry.size, &entry.addr);
+      if (len < 0) {
+        return (received > 0) ? static_cast<int>(received) : -1;
+      }
+      entry.length = static_cast<size_t>(len);
+    }
+    return static_cast<int>(received);
+  }
+
+  // Sends |count| datagrams, each to its own address. A datagram that fails
+  // with an error other than a blocking one is dropped, and the rest are
+  // still sent; sending stops once the socket would block. Returns the number
+  // of datagrams sent, or -1 if none could be sent. If any datagram wasn't
+  // sent, GetError() returns the last error.
+  // The default implementation calls SendTo repeatedly; implementations that
+  // can send several datagrams with a single system call override it.
+  virtual int SendToBatch(const SendBatchEntry* entries, size_t count) {
+    size_t sent = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const SendBatchEntry& entry = entries[i];
+      if (SendTo(entry.data, entry.length, entry.addr) >= 0) {
+        ++sent;
+      } else if (IsBlockingError(GetError())) {
+        break;
+      }
+    }
+    return (sent > 0 || count == 0) ? static_cast<int>(sent) : -1;
+  }
+
+  // Sends the |count| pieces in |iov| as contiguous stream data, like
+  // writev(). Returns the number of bytes sent, which may end in the middle
+  // of a piece if the socket would block, or -1 if nothing could be sent.
+  // The default implementation calls Send for each piece; implementations
+  // that can gather the pieces with a single system call override it.
+  virtual int SendV(const IoVec* iov, size_t count) {
+    size_t sent = 0;
+    for (size_t i = 0; i < count; ++i) {
+      int res = Send(iov[i].data, iov[i].length);
+      if (res < 0) {
+        return (sent > 0) ? static_cast<int>(sent) : -1;
+      }
+      sent += res;
+      if (static_cast<size_t>(res) < iov[i].length) {
+        break;
+      }
+    }
+    return static_cast<int>(sent);
+  }
+
   virtual int Listen(int backlog) = 0;
   virtual Socket *Accept(SocketAddress *paddr) = 0;
   virtual int Close() = 0;
@@ -172,6 +263,8 @@ class Socket {
     OPT_RTP_SENDTIME_EXTN_ID,  // This is a non-traditional socket option param.
                                // This is specific to libjingle and will be used
                                // if SendTime option is needed at socket level.
+    OPT_REUSEPORT,   // allow several sockets to bind the same port; must be
+                     // set before Bind.
   };
   virtual int GetOption(Option opt, int* value) = 0;
   virtual int SetOption(Option opt, int value) = 0;
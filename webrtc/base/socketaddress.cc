@@ -346,6 +346,59 @@ uint32 SocketAddress::StringToIP(const std::string& hostname) {
   return ip;
 }
 
+SocketAddressKey::SocketAddressKey() : port(0), family(0), reserved(0) {
+  memset(ip, 0, sizeof(ip));
+}
+
+SocketAddressKey::SocketAddressKey(const SocketAddress& addr)
+    : port(addr.port()), family(0), reserved(0) {
+  memset(ip, 0, sizeof(ip));
+  const IPAddress& ipaddr = addr.ipaddr();
+  if (ipaddr.family() == AF_INET) {
+    in_addr ip4 = ipaddr.ipv4_address();
+    memcpy(ip, &ip4, sizeof(ip4));
+    family = 4;
+  } else if (ipaddr.family() == AF_INET6) {
+    in6_addr ip6 = ipaddr.ipv6_address();
+    memcpy(ip, &ip6, sizeof(ip6));
+    family = 6;
+  }
+}
+
+SocketAddress SocketAddressKey::ToSocketAddress() const {
+  IPAddress ipaddr;
+  if (family == 4) {
+    in_addr ip4;
+    memcpy(&ip4, ip, sizeof(ip4));
+    ipaddr = IPAddress(ip4);
+  } else if (family == 6) {
+    in6_addr ip6;
+    memcpy(&ip6, ip, sizeof(ip6));
+    ipaddr = IPAddress(ip6);
+  }
+  return SocketAddress(ipaddr, port);
+}
+
+bool SocketAddressKey::operator==(const SocketAddressKey& key) const {
+  return memcmp(this, &key, sizeof(key)) == 0;
+}
+
+bool SocketAddressKey::operator<(const SocketAddressKey& key) const {
+  return memcmp(this, &key, sizeof(key)) < 0;
+}
+
+size_t SocketAddressKey::Hash() const {
+  // FNV-1a over the bytes of the key. Hashing whole words would leave the
+  // low bits of the hash blind to the high bytes of each word, which is where
+  // the last octet of an IPv4 address lands on little-endian machines.
+  const uint8* bytes = reinterpret_cast<const uint8*>(this);
+  uint32 h = 2166136261U;
+  for (size_t i = 0; i < sizeof(*this); ++i) {
+    h = (h ^ bytes[i]) * 16777619U;
+  }
+  return h;
+}
+
 bool SocketAddressFromSockAddrStorage(const sockaddr_storage& addr,
                                       SocketAddress* out) {
   if (!out) {
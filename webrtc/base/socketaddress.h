@@ -205,6 +205,33 @@ class SocketAddress {
   bool literal_;  // Indicates that 'hostname_' contains a literal IP string.
 };
 
+// The IP address and port of a resolved SocketAddress, packed into 20 bytes
+// of plain data. Copying, comparing and hashing it touches no strings, which
+// makes it the better key for maps that are looked up for every packet.
+// The hostname and scope id are not kept, so addresses that only differ in
+// those map to the same key; use it only for resolved addresses.
+struct SocketAddressKey {
+  SocketAddressKey();
+  explicit SocketAddressKey(const SocketAddress& addr);
+
+  SocketAddress ToSocketAddress() const;
+
+  bool operator==(const SocketAddressKey& key) const;
+  bool operator!=(const SocketAddressKey& key) const {
+    return !operator==(key);
+  }
+  // An arbitrary but consistent order, for use in std::map.
+  bool operator<(const SocketAddressKey& key) const;
+
+  size_t Hash() const;
+
+  // IPv4 addresses use the first 4 bytes; unused bytes are 0.
+  uint8 ip[16];
+  uint16 port;
+  uint8 family;  // 0, 4 or 6.
+  uint8 reserved;  // Always 0, so that there is no padding to compare.
+};
+
 bool SocketAddressFromSockAddrStorage(const sockaddr_storage& saddr,
                                       SocketAddress* out);
 SocketAddress EmptySocketAddressWithFamily(int family);
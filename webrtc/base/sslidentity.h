@@ -116,14 +116,25 @@ class SSLCertChain {
   DISALLOW_COPY_AND_ASSIGN(SSLCertChain);
 };
 
+// The type of the key pair of an identity. ECDSA keys on the P-256 curve take
+// a fraction of the time of RSA keys to generate.
+enum KeyType {
+  KT_RSA,
+  KT_ECDSA,
+  KT_DEFAULT = KT_RSA
+};
+
 // Parameters for generating an identity for testing. If common_name is
 // non-empty, it will be used for the certificate's subject and issuer name,
 // otherwise a random string will be used. |not_before| and |not_after| are
 // offsets to the current time in number of seconds.
 struct SSLIdentityParams {
+  SSLIdentityParams() : not_before(0), not_after(0), key_type(KT_DEFAULT) {}
+
   std::string common_name;
   int not_before;  // in seconds.
   int not_after;  // in seconds.
+  KeyType key_type;
 };
 
 // Our identity in an SSL negotiation: a keypair and certificate (both
@@ -137,6 +148,9 @@ class SSLIdentity {
   // Returns NULL on failure.
   // Caller is responsible for freeing the returned object.
   static SSLIdentity* Generate(const std::string& common_name);
+  // Like above, with a key pair of the given type.
+  static SSLIdentity* Generate(const std::string& common_name,
+                               KeyType key_type);
 
   // Generates an identity with the specified validity period.
   static SSLIdentity* GenerateForTest(const SSLIdentityParams& params);
@@ -166,6 +180,7 @@ class SSLIdentity {
 
 extern const char kPemTypeCertificate[];
 extern const char kPemTypeRsaPrivateKey[];
+extern const char kPemTypePrivateKey[];
 
 }  // namespace rtc
 
@@ -0,0 +1,145 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/base/sslidentitypool.h"
+
+#if defined(WEBRTC_LINUX)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "webrtc/base/common.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/thread.h"
+
+namespace rtc {
+
+namespace {
+
+// Niceness of the generating thread, so that key generation only uses what
+// call setup leaves.
+const int kGeneratorNiceness = 10;
+
+// Thread::SetPriority(PRIORITY_IDLE) is only implemented on Windows. On Linux
+// the niceness of a single thread can be changed from within it.
+class GeneratorThread : public Thread {
+ public:
+  GeneratorThread() {
+#if defined(WEBRTC_WIN)
+    SetPriority(PRIORITY_IDLE);
+#endif
+  }
+  virtual ~GeneratorThread() { Stop(); }
+
+  virtual void Run() {
+#if defined(WEBRTC_LINUX)
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                    kGeneratorNiceness) != 0) {
+      LOG_ERR(LS_WARNING) << "Failed to lower the identity generator priority";
+    }
+#endif
+    Thread::Run();
+  }
+};
+
+}  // namespace
+
+SSLIdentityPool::SSLIdentityPool(const std::string& common_name, size_t size)
+    : common_name_(common_name),
+      size_(size),
+      thread_(new GeneratorThread()) {
+  for (int i = 0; i < kNumKeyTypes; ++i) {
+    identities_[i].reserve(size_);
+    used_[i] = false;
+    generating_[i] = false;
+  }
+  thread_->Start();
+  CritScope cs(&crit_);
+  used_[KT_DEFAULT] = true;
+  RefillLocked(KT_DEFAULT);
+}
+
+SSLIdentityPool::~SSLIdentityPool() {
+  thread_->Stop();
+  for (int i = 0; i < kNumKeyTypes; ++i) {
+    for (size_t j = 0; j < identities_[i].size(); ++j) {
+      delete identities_[i][j];
+    }
+  }
+}
+
+SSLIdentity* SSLIdentityPool::Take(KeyType key_type) {
+  CritScope cs(&crit_);
+  used_[key_type] = true;
+  std::vector<SSLIdentity*>& identities = identities_[key_type];
+  SSLIdentity* identity = NULL;
+  if (!identities.empty()) {
+    identity = identities.back();
+    identities.pop_back();
+  }
+  RefillLocked(key_type);
+  return identity;
+}
+
+size_t SSLIdentityPool::ready_count(KeyType key_type) const {
+  CritScope cs(&crit_);
+  return identities_[key_type].size();
+}
+
+size_t SSLIdentityPool::size() const {
+  CritScope cs(&crit_);
+  return size_;
+}
+
+void SSLIdentityPool::SetSize(size_t size) {
+  CritScope cs(&crit_);
+  size_ = size;
+  for (int i = 0; i < kNumKeyTypes; ++i) {
+    std::vector<SSLIdentity*>& identities = identities_[i];
+    while (identities.size() > size_) {
+      delete identities.back();
+      identities.pop_back();
+    }
+    if (used_[i])
+      RefillLocked(static_cast<KeyType>(i));
+  }
+}
+
+void SSLIdentityPool::RefillLocked(KeyType key_type) {
+  if (generating_[key_type] || identities_[key_type].size() >= size_)
+    return;
+  generating_[key_type] = true;
+  thread_->Post(this, key_type);
+}
+
+void SSLIdentityPool::OnMessage(Message* msg) {
+  ASSERT(thread_->IsCurrent());
+  KeyType key_type = static_cast<KeyType>(msg->message_id);
+  // Generated without holding the lock, which is the point of the pool.
+  SSLIdentity* identity = SSLIdentity::Generate(common_name_, key_type);
+
+  CritScope cs(&crit_);
+  generating_[key_type] = false;
+  if (!identity) {
+    // Takers fall back to generating their own; the next Take() retries.
+    LOG(LS_ERROR) << "Failed to generate a pooled identity.";
+    return;
+  }
+  if (identities_[key_type].size() >= size_) {
+    // The pool was made smaller in the meantime.
+    delete identity;
+    return;
+  }
+  identities_[key_type].push_back(identity);
+  RefillLocked(key_type);
+}
+
+}  // namespace rtc
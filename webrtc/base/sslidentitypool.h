@@ -0,0 +1,78 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef WEBRTC_BASE_SSLIDENTITYPOOL_H_
+#define WEBRTC_BASE_SSLIDENTITYPOOL_H_
+
+#include <string>
+#include <vector>
+
+#include "webrtc/base/constructormagic.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/sslidentity.h"
+
+namespace rtc {
+
+class Thread;
+
+// Generates identities ahead of time on a low priority thread, so that taking
+// one does not have to wait for key generation.
+//
+// The pool keeps up to size() identities of each key type ready. It starts
+// with KT_DEFAULT identities; other key types are kept ready once they have
+// been asked for. All methods are thread safe.
+class SSLIdentityPool : public MessageHandler {
+ public:
+  // |common_name| is used for all generated certificates.
+  SSLIdentityPool(const std::string& common_name, size_t size);
+  virtual ~SSLIdentityPool();
+
+  // Returns an identity with a |key_type| key pair, or NULL if none is ready,
+  // in which case the caller has to generate one itself. Either way, the pool
+  // is refilled in the background.
+  // Caller is responsible for freeing the returned object.
+  SSLIdentity* Take(KeyType key_type);
+
+  // The number of |key_type| identities ready to be taken.
+  size_t ready_count(KeyType key_type) const;
+
+  size_t size() const;
+  // Identities beyond the new |size| are discarded.
+  void SetSize(size_t size);
+
+ private:
+  static const int kNumKeyTypes = KT_ECDSA + 1;
+
+  // Starts generating |key_type| identities unless enough are ready or it
+  // already does. Must be called with |crit_| held.
+  void RefillLocked(KeyType key_type);
+
+  // MessageHandler implementation. Generates one identity of the key type in
+  // the message id.
+  virtual void OnMessage(Message* msg);
+
+  const std::string common_name_;
+  mutable CriticalSection crit_;
+  size_t size_;
+  std::vector<SSLIdentity*> identities_[kNumKeyTypes];
+  // Whether the key type has been asked for, and so is kept ready.
+  bool used_[kNumKeyTypes];
+  bool generating_[kNumKeyTypes];
+  // Declared last, so that it is stopped before the identities go away.
+  scoped_ptr<Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLIdentityPool);
+};
+
+}  // namespace rtc
+
+#endif  // WEBRTC_BASE_SSLIDENTITYPOOL_H_
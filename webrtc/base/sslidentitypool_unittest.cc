@@ -0,0 +1,70 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+
+#include "webrtc/base/gunit.h"
+#include "webrtc/base/messagedigest.h"
+#include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/sslidentity.h"
+#include "webrtc/base/sslidentitypool.h"
+
+using rtc::SSLIdentity;
+using rtc::SSLIdentityPool;
+
+static const int kTimeoutMs = 10000;
+
+// The pool fills up with default identities by itself, and refills after
+// identities are taken.
+TEST(SSLIdentityPoolTest, FillsAndRefills) {
+  SSLIdentityPool pool("test", 2);
+  EXPECT_EQ_WAIT(2U, pool.ready_count(rtc::KT_DEFAULT), kTimeoutMs);
+
+  rtc::scoped_ptr<SSLIdentity> identity1(pool.Take(rtc::KT_DEFAULT));
+  rtc::scoped_ptr<SSLIdentity> identity2(pool.Take(rtc::KT_DEFAULT));
+  ASSERT_TRUE(identity1);
+  ASSERT_TRUE(identity2);
+  EXPECT_NE(identity1->certificate().ToPEMString(),
+            identity2->certificate().ToPEMString());
+
+  EXPECT_EQ_WAIT(2U, pool.ready_count(rtc::KT_DEFAULT), kTimeoutMs);
+}
+
+// Other key types are only generated once they are asked for.
+TEST(SSLIdentityPoolTest, GeneratesOtherKeyTypesOnDemand) {
+  SSLIdentityPool pool("test", 1);
+  EXPECT_EQ_WAIT(1U, pool.ready_count(rtc::KT_DEFAULT), kTimeoutMs);
+  EXPECT_EQ(0U, pool.ready_count(rtc::KT_ECDSA));
+
+  delete pool.Take(rtc::KT_ECDSA);
+  EXPECT_EQ_WAIT(1U, pool.ready_count(rtc::KT_ECDSA), kTimeoutMs);
+  rtc::scoped_ptr<SSLIdentity> identity(pool.Take(rtc::KT_ECDSA));
+  ASSERT_TRUE(identity);
+  std::string digest_algorithm;
+  ASSERT_TRUE(identity->certificate().GetSignatureDigestAlgorithm(
+      &digest_algorithm));
+  EXPECT_EQ(rtc::DIGEST_SHA_256, digest_algorithm);
+}
+
+// An empty pool returns NULL rather than waiting.
+TEST(SSLIdentityPoolTest, EmptyPool) {
+  SSLIdentityPool pool("test", 0);
+  EXPECT_TRUE(pool.Take(rtc::KT_DEFAULT) == NULL);
+  EXPECT_EQ(0U, pool.ready_count(rtc::KT_DEFAULT));
+}
+
+// Resizing the pool fills it up or discards identities.
+TEST(SSLIdentityPoolTest, SetSize) {
+  SSLIdentityPool pool("test", 0);
+  pool.SetSize(2);
+  EXPECT_EQ_WAIT(2U, pool.ready_count(rtc::KT_DEFAULT), kTimeoutMs);
+  pool.SetSize(1);
+  EXPECT_EQ(1U, pool.ready_count(rtc::KT_DEFAULT));
+}
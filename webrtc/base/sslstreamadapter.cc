@@ -49,6 +49,7 @@ SSLStreamAdapter* SSLStreamAdapter::Create(StreamInterface* stream) {
 #if SSL_USE_SCHANNEL
 bool SSLStreamAdapter::HaveDtls() { return false; }
 bool SSLStreamAdapter::HaveDtlsSrtp() { return false; }
+bool SSLStreamAdapter::HaveDtlsSrtpGcm() { return false; }
 bool SSLStreamAdapter::HaveExporter() { return false; }
 #elif SSL_USE_OPENSSL
 bool SSLStreamAdapter::HaveDtls() {
@@ -57,6 +58,9 @@ bool SSLStreamAdapter::HaveDtls() {
 bool SSLStreamAdapter::HaveDtlsSrtp() {
   return OpenSSLStreamAdapter::HaveDtlsSrtp();
 }
+bool SSLStreamAdapter::HaveDtlsSrtpGcm() {
+  return OpenSSLStreamAdapter::HaveDtlsSrtpGcm();
+}
 bool SSLStreamAdapter::HaveExporter() {
   return OpenSSLStreamAdapter::HaveExporter();
 }
@@ -67,6 +71,9 @@ bool SSLStreamAdapter::HaveDtls() {
 bool SSLStreamAdapter::HaveDtlsSrtp() {
   return NSSStreamAdapter::HaveDtlsSrtp();
 }
+bool SSLStreamAdapter::HaveDtlsSrtpGcm() {
+  return NSSStreamAdapter::HaveDtlsSrtpGcm();
+}
 bool SSLStreamAdapter::HaveExporter() {
   return NSSStreamAdapter::HaveExporter();
 }
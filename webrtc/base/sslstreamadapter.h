@@ -153,6 +153,9 @@ class SSLStreamAdapter : public StreamAdapterInterface {
   // Capabilities testing
   static bool HaveDtls();
   static bool HaveDtlsSrtp();
+  // Whether the AEAD_AES_128_GCM and AEAD_AES_256_GCM DTLS-SRTP profiles can
+  // be negotiated.
+  static bool HaveDtlsSrtpGcm();
   static bool HaveExporter();
 
  private:
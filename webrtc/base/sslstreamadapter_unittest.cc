@@ -194,10 +194,13 @@ class SSLStreamAdapterTestBase : public testing::Test,
     rtc::SetRandomTestMode(false);
   }
 
-  // Recreate the client/server identities with the specified validity period.
-  // |not_before| and |not_after| are offsets from the current time in number
-  // of seconds.
-  void ResetIdentitiesWithValidity(int not_before, int not_after) {
+  // Recreate the client/server identities with the specified validity period
+  // and key type. |not_before| and |not_after| are offsets from the current
+  // time in number of seconds.
+  void ResetIdentitiesWithValidity(
+      int not_before, int not_after,
+      rtc::KeyType client_key_type = rtc::KT_DEFAULT,
+      rtc::KeyType server_key_type = rtc::KT_DEFAULT) {
     client_stream_ =
         new SSLDummyStream(this, "c2s", &client_buffer_, &server_buffer_);
     server_stream_ =
@@ -213,18 +216,54 @@ class SSLStreamAdapterTestBase : public testing::Test,
     client_params.common_name = "client";
     client_params.not_before = not_before;
     client_params.not_after = not_after;
+    client_params.key_type = client_key_type;
     client_identity_ = rtc::SSLIdentity::GenerateForTest(client_params);
 
     rtc::SSLIdentityParams server_params;
     server_params.common_name = "server";
     server_params.not_before = not_before;
     server_params.not_after = not_after;
+    server_params.key_type = server_key_type;
     server_identity_ = rtc::SSLIdentity::GenerateForTest(server_params);
 
     client_ssl_->SetIdentity(client_identity_);
     server_ssl_->SetIdentity(server_identity_);
   }
 
+  // Recreate the client/server adapters with references to the current
+  // identities. The old adapters are handed to the caller, detached from the
+  // buffers and this test, so that they can stay alive while the new ones
+  // connect.
+  void ResetStreamsWithSameIdentities(
+      rtc::scoped_ptr<rtc::SSLStreamAdapter>* old_client_ssl,
+      rtc::scoped_ptr<rtc::SSLStreamAdapter>* old_server_ssl) {
+    client_buffer_.SignalEvent.disconnect(client_stream_);
+    client_buffer_.SignalEvent.disconnect(server_stream_);
+    server_buffer_.SignalEvent.disconnect(client_stream_);
+    server_buffer_.SignalEvent.disconnect(server_stream_);
+    client_ssl_->SignalEvent.disconnect(this);
+    server_ssl_->SignalEvent.disconnect(this);
+    old_client_ssl->reset(client_ssl_.release());
+    old_server_ssl->reset(server_ssl_.release());
+
+    client_stream_ =
+        new SSLDummyStream(this, "c2s", &client_buffer_, &server_buffer_);
+    server_stream_ =
+        new SSLDummyStream(this, "s2c", &server_buffer_, &client_buffer_);
+
+    client_ssl_.reset(rtc::SSLStreamAdapter::Create(client_stream_));
+    server_ssl_.reset(rtc::SSLStreamAdapter::Create(server_stream_));
+
+    client_ssl_->SignalEvent.connect(this, &SSLStreamAdapterTestBase::OnEvent);
+    server_ssl_->SignalEvent.connect(this, &SSLStreamAdapterTestBase::OnEvent);
+
+    client_identity_ = client_identity_->GetReference();
+    server_identity_ = server_identity_->GetReference();
+    client_ssl_->SetIdentity(client_identity_);
+    server_ssl_->SetIdentity(server_identity_);
+    identities_set_ = false;
+  }
+
   virtual void OnEvent(rtc::StreamInterface *stream, int sig, int err) {
     LOG(LS_INFO) << "SSLStreamAdapterTestBase::OnEvent sig=" << sig;
 
@@ -894,6 +933,57 @@ TEST_F(SSLStreamAdapterTestDTLS, TestCertExpired) {
   TestHandshake();
 }
 
+// Test a handshake and data transfer with ECDSA identities.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSTransferECDSA) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  long one_day = 60 * 60 * 24;
+  ResetIdentitiesWithValidity(-one_day, one_day, rtc::KT_ECDSA,
+                              rtc::KT_ECDSA);
+  TestHandshake();
+  TestTransfer(100);
+}
+
+// Test that the key types of the two ends don't have to match.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSTransferECDSAServer) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  long one_day = 60 * 60 * 24;
+  ResetIdentitiesWithValidity(-one_day, one_day, rtc::KT_RSA, rtc::KT_ECDSA);
+  TestHandshake();
+  TestTransfer(100);
+}
+
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSTransferECDSAClient) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  long one_day = 60 * 60 * 24;
+  ResetIdentitiesWithValidity(-one_day, one_day, rtc::KT_ECDSA, rtc::KT_RSA);
+  TestHandshake();
+  TestTransfer(100);
+}
+
+// Test that adapters using the same identities as connected ones, and so
+// the same SSL contexts, can connect too.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSTransferWithSameIdentities) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  TestHandshake();
+  rtc::scoped_ptr<rtc::SSLStreamAdapter> old_client_ssl;
+  rtc::scoped_ptr<rtc::SSLStreamAdapter> old_server_ssl;
+  ResetStreamsWithSameIdentities(&old_client_ssl, &old_server_ssl);
+  TestHandshake();
+  TestTransfer(100);
+}
+
+// Test that the peer is still verified per connection when the SSL contexts
+// are shared with connected adapters.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSBogusDigestWithSameIdentities) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  TestHandshake();
+  rtc::scoped_ptr<rtc::SSLStreamAdapter> old_client_ssl;
+  rtc::scoped_ptr<rtc::SSLStreamAdapter> old_server_ssl;
+  ResetStreamsWithSameIdentities(&old_client_ssl, &old_server_ssl);
+  SetPeerIdentitiesByDigest(false);
+  TestHandshake(false);
+}
+
 // Test data transfer using certs created from strings.
 TEST_F(SSLStreamAdapterTestDTLSFromPEMStrings, TestTransfer) {
   MAYBE_SKIP_TEST(HaveDtls);
@@ -26,6 +26,7 @@
 #endif
 
 #include "webrtc/base/checks.h"
+#include "webrtc/base/criticalsection.h"
 #include "webrtc/base/timeutils.h"
 
 #define EFFICIENT_IMPLEMENTATION 1
@@ -34,7 +35,44 @@ namespace rtc {
 
 const uint32 HALF = 0x80000000;
 
-uint64 TimeNanos() {
+static ClockInterface* volatile g_clock = NULL;
+
+#if defined(WEBRTC_WIN)
+typedef DWORD ClockThreadId;
+static ClockThreadId CurrentClockThread() { return ::GetCurrentThreadId(); }
+static bool SameClockThread(ClockThreadId a, ClockThreadId b) {
+  return a == b;
+}
+#else
+typedef pthread_t ClockThreadId;
+static ClockThreadId CurrentClockThread() { return pthread_self(); }
+static bool SameClockThread(ClockThreadId a, ClockThreadId b) {
+  return pthread_equal(a, b) != 0;
+}
+#endif
+
+// Returns true if the calling thread is the one that first set a clock.
+// Clocks are swapped while only that thread runs, so a call from any other
+// thread means the clock is changing under threads that read it.
+static bool OnClockThread() {
+  static bool known = false;
+  static ClockThreadId clock_thread;
+  if (!known) {
+    clock_thread = CurrentClockThread();
+    known = true;
+  }
+  return SameClockThread(clock_thread, CurrentClockThread());
+}
+
+ClockInterface* SetClockForTesting(ClockInterface* clock) {
+  DCHECK(OnClockThread());
+  ClockInterface* previous = AtomicOps::AcquireLoadPtr(&g_clock);
+  // Fails only if another thread set a clock at the same time.
+  CHECK(AtomicOps::CompareAndSwapPtr(&g_clock, previous, clock) == previous);
+  return previous;
+}
+
+uint64 SystemTimeNanos() {
   int64 ticks = 0;
 #if defined(WEBRTC_MAC)
   static mach_timebase_info_data_t timebase;
@@ -78,6 +116,13 @@ uint64 TimeNanos() {
   return ticks;
 }
 
+uint64 TimeNanos() {
+  ClockInterface* clock = AtomicOps::AcquireLoadPtr(&g_clock);
+  if (clock)
+    return clock->TimeNanos();
+  return SystemTimeNanos();
+}
+
 uint32 Time() {
   return static_cast<uint32>(TimeNanos() / kNumNanosecsPerMillisec);
 }
@@ -39,6 +39,26 @@ uint32 Time();
 uint64 TimeMicros();
 // Returns the current time in nanoseconds.
 uint64 TimeNanos();
+// Returns the current time of the system clock in nanoseconds, even while a
+// clock is set with SetClockForTesting.
+uint64 SystemTimeNanos();
+
+// A clock that Time(), TimeMicros() and TimeNanos() can read instead of the
+// system clock.
+class ClockInterface {
+ public:
+  virtual ~ClockInterface() {}
+  virtual uint64 TimeNanos() const = 0;
+};
+
+// For tests only.  Makes Time(), TimeMicros() and TimeNanos() read |clock|, or
+// the system clock again if |clock| is NULL, and returns the clock that was in
+// use before.  The clock applies to all threads, including ones that nothing
+// advances it for: while a VirtualClock is set, Time() only moves when its
+// VirtualSocketServers let it.  Set the clock before any other thread starts
+// and restore it after they have stopped.  Debug builds check that every call
+// comes from the same thread.
+ClockInterface* SetClockForTesting(ClockInterface* clock);
 
 // Stores current time in *tm and microseconds in *microseconds.
 void CurrentTmTime(struct tm *tm, int *microseconds);
@@ -14,6 +14,7 @@
 #include <netinet/in.h>
 #endif
 
+#include "webrtc/base/event.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/testclient.h"
@@ -123,6 +124,42 @@ struct Receiver : public MessageHandler, public sigslot::has_slots<> {
   uint32 samples;
 };
 
+// Bounces a packet between two sockets for a number of round trips, then
+// signals |done|.  Starts when the message is dispatched.
+struct PingPong : public MessageHandler, public sigslot::has_slots<> {
+  PingPong(VirtualSocketServer* ss, int round_trips, Event* done)
+      : round_trips(round_trips), count(0), done(done) {
+    SocketAddress any(IPAddress(INADDR_ANY), 0);
+    ping.reset(AsyncUDPSocket::Create(ss, any));
+    pong.reset(AsyncUDPSocket::Create(ss, any));
+    ping->SignalReadPacket.connect(this, &PingPong::OnReadPacket);
+    pong->SignalReadPacket.connect(this, &PingPong::OnReadPacket);
+  }
+
+  void OnMessage(Message* pmsg) {
+    ping->SendTo("ping", 4, pong->GetLocalAddress(), options);
+  }
+
+  void OnReadPacket(AsyncPacketSocket* s, const char* data, size_t size,
+                    const SocketAddress& remote_addr,
+                    const PacketTime& packet_time) {
+    if (s == pong.get()) {
+      pong->SendTo("pong", 4, remote_addr, options);
+    } else if (++count < round_trips) {
+      ping->SendTo("ping", 4, remote_addr, options);
+    } else {
+      done->Set();
+    }
+  }
+
+  scoped_ptr<AsyncUDPSocket> ping;
+  scoped_ptr<AsyncUDPSocket> pong;
+  rtc::PacketOptions options;
+  int round_trips;
+  int count;
+  Event* done;
+};
+
 class VirtualSocketServerTest : public testing::Test {
  public:
   VirtualSocketServerTest() : ss_(new VirtualSocketServer(NULL)),
@@ -959,6 +996,138 @@ TEST_F(VirtualSocketServerTest, CanSendDatagramFromUnboundIPv6ToIPv4Any) {
                           true);
 }
 
+// Tests that in virtual time, the transit delay takes no real time.
+TEST_F(VirtualSocketServerTest, VirtualTimeSkipsDelays) {
+  const int kDelay = 500;
+  const int kRoundTrips = 20;
+  VirtualClock clock;
+  ss_->SetVirtualClock(&clock);
+  ss_->set_delay_mean(kDelay);
+  ss_->UpdateDelayDistribution();
+
+  TestClient* client1 = new TestClient(
+      AsyncUDPSocket::Create(ss_, kIPv4AnyAddress));
+  TestClient* client2 = new TestClient(
+      AsyncUDPSocket::Create(ss_, kIPv4AnyAddress));
+
+  uint32 start = rtc::Time();
+  uint64 real_start = SystemTimeNanos();
+  for (int i = 0; i < kRoundTrips; ++i) {
+    EXPECT_EQ(4, client1->SendTo("ping", 4, client2->address()));
+    EXPECT_TRUE(client2->CheckNextPacket("ping", 4, NULL));
+    EXPECT_EQ(4, client2->SendTo("pong", 4, client1->address()));
+    EXPECT_TRUE(client1->CheckNextPacket("pong", 4, NULL));
+  }
+  int32 elapsed = TimeSince(start);
+  int64 real_elapsed = static_cast<int64>(
+      (SystemTimeNanos() - real_start) / kNumNanosecsPerMillisec);
+  LOG(LS_INFO) << "Simulated " << elapsed << " ms in " << real_elapsed
+               << " ms";
+  // TestClient polls in 1 ms steps, which may add a millisecond per packet.
+  EXPECT_GE(elapsed, 2 * kRoundTrips * kDelay);
+  EXPECT_LE(elapsed, 2 * kRoundTrips * (kDelay + 1));
+  EXPECT_LT(real_elapsed, elapsed / 4);
+
+  delete client1;
+  delete client2;
+  ss_->ProcessMessagesUntilIdle();
+  ss_->set_delay_mean(0);
+  ss_->UpdateDelayDistribution();
+  ss_->SetVirtualClock(NULL);
+}
+
+// Tests that the sockets of a host with a link share its queue and bandwidth.
+TEST_F(VirtualSocketServerTest, LinkLimitsBandwidthAndQueue) {
+  const uint32 kBandwidth = 10000;
+  const uint32 kQueueCapacity = 3000;
+  const uint32 kLinkDelay = 100;
+  // With the UDP header, each packet takes 1000 bytes, or 100 ms on the link.
+  const size_t kPacketSize = 1000 - 28;
+  VirtualClock clock;
+  ss_->SetVirtualClock(&clock);
+
+  AsyncSocket* send_socket1 = ss_->CreateAsyncSocket(SOCK_DGRAM);
+  ASSERT_EQ(0, send_socket1->Bind(kIPv4AnyAddress));
+  AsyncSocket* send_socket2 = ss_->CreateAsyncSocket(SOCK_DGRAM);
+  ASSERT_EQ(0, send_socket2->Bind(
+      SocketAddress(send_socket1->GetLocalAddress().ipaddr(), 0)));
+  TestClient* receiver = new TestClient(
+      AsyncUDPSocket::Create(ss_, kIPv4AnyAddress));
+  const IPAddress sender_ip = send_socket1->GetLocalAddress().ipaddr();
+  ss_->SetLink(sender_ip, kBandwidth, kQueueCapacity, kLinkDelay);
+
+  // Only three packets fit in the queue, even when sent from two sockets.
+  char buf[kPacketSize] = { 0 };
+  uint32 start = rtc::Time();
+  for (int i = 0; i < 5; ++i) {
+    AsyncSocket* socket = (i % 2) ? send_socket2 : send_socket1;
+    EXPECT_EQ(static_cast<int>(kPacketSize),
+              socket->SendTo(buf, kPacketSize, receiver->address()));
+  }
+  ss_->ProcessMessagesUntilIdle();
+  // The last packet leaves the queue after 300 ms and arrives 100 ms later.
+  EXPECT_EQ(400, TimeSince(start));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(receiver->CheckNextPacket(buf, kPacketSize, NULL));
+  }
+  EXPECT_TRUE(receiver->CheckNoPacket());
+
+  delete send_socket1;
+  delete send_socket2;
+  delete receiver;
+  ss_->ProcessMessagesUntilIdle();
+  ss_->RemoveLink(sender_ip);
+  ss_->SetVirtualClock(NULL);
+}
+
+// Tests that servers on different threads can share one virtual clock, each
+// simulating its own subnet.
+TEST(VirtualClockTest, ShardsShareVirtualTime) {
+  const int kShards = 2;
+  const int kDelay = 250;
+  const int kRoundTrips = 20;
+  VirtualClock clock;
+  scoped_ptr<VirtualSocketServer> servers[kShards];
+  scoped_ptr<Thread> threads[kShards];
+  scoped_ptr<PingPong> ping_pongs[kShards];
+  scoped_ptr<Event> done[kShards];
+  for (int i = 0; i < kShards; ++i) {
+    servers[i].reset(new VirtualSocketServer(NULL));
+    servers[i]->SetVirtualClock(&clock);
+    servers[i]->set_delay_mean(kDelay);
+    servers[i]->UpdateDelayDistribution();
+    threads[i].reset(new Thread(servers[i].get()));
+    done[i].reset(new Event(false, false));
+    ping_pongs[i].reset(
+        new PingPong(servers[i].get(), kRoundTrips, done[i].get()));
+  }
+
+  uint32 start = rtc::Time();
+  uint64 real_start = SystemTimeNanos();
+  for (int i = 0; i < kShards; ++i) {
+    threads[i]->Start();
+    threads[i]->Post(ping_pongs[i].get());
+  }
+  for (int i = 0; i < kShards; ++i) {
+    // Event::Wait measures real time.
+    EXPECT_TRUE(done[i]->Wait(10000));
+  }
+  int32 elapsed = TimeSince(start);
+  int64 real_elapsed = static_cast<int64>(
+      (SystemTimeNanos() - real_start) / kNumNanosecsPerMillisec);
+  LOG(LS_INFO) << "Simulated " << elapsed << " ms on " << kShards
+               << " threads in " << real_elapsed << " ms";
+  EXPECT_GE(elapsed, 2 * kRoundTrips * kDelay);
+  EXPECT_LT(real_elapsed, elapsed / 4);
+
+  for (int i = 0; i < kShards; ++i) {
+    threads[i]->Stop();
+    ping_pongs[i].reset();
+    threads[i].reset();
+    servers[i].reset();
+  }
+}
+
 TEST_F(VirtualSocketServerTest, CreatesStandardDistribution) {
   const uint32 kTestMean[] = { 10, 100, 333, 1000 };
   const double kTestDev[] = { 0.25, 0.1, 0.01 };
@@ -20,7 +20,6 @@
 #include "webrtc/base/common.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/physicalsocketserver.h"
-#include "webrtc/base/socketaddresspair.h"
 #include "webrtc/base/thread.h"
 #include "webrtc/base/timeutils.h"
 
@@ -92,6 +91,147 @@ struct MessageAddress : public MessageData {
   SocketAddress addr;
 };
 
+struct VirtualSocketServer::Link {
+  Link(uint32 bandwidth, uint32 queue_capacity, uint32 delay)
+      : bandwidth(bandwidth), queue_capacity(queue_capacity), delay(delay),
+        queue_size(0) {
+  }
+
+  uint32 bandwidth;
+  uint32 queue_capacity;
+  uint32 delay;
+  // Protects the queue, which all the sockets of the host share.
+  CriticalSection crit;
+  VirtualSocket::NetworkQueue queue;
+  size_t queue_size;
+};
+
+// The bindings and connections are keyed by normalized addresses, so that
+// v4-mapped v6 addresses find their v4 counterparts.
+static SocketAddressKey NormalizedKey(const SocketAddress& addr) {
+  return SocketAddressKey(SocketAddress(addr.ipaddr().Normalized(),
+                                        addr.port()));
+}
+
+static uint32 TransmitDelay(uint32 size, uint32 bandwidth) {
+  if (bandwidth == 0)
+    return 0;
+  else
+    return 1000 * size / bandwidth;
+}
+
+static const uint64 kNoDeadline = static_cast<uint64>(-1);
+
+VirtualClock::VirtualClock() {
+  // Start on a whole millisecond, so that waits computed from Time() end
+  // exactly on the millisecond they wait for.
+  now_ = rtc::TimeNanos() / kNumNanosecsPerMillisec * kNumNanosecsPerMillisec;
+  previous_clock_ = SetClockForTesting(this);
+}
+
+VirtualClock::~VirtualClock() {
+  ASSERT(waiters_.empty());
+  SetClockForTesting(previous_clock_);
+}
+
+uint64 VirtualClock::TimeNanos() const {
+  CritScope cs(&crit_);
+  return now_;
+}
+
+void VirtualClock::AdvanceTime(int ms) {
+  CritScope cs(&crit_);
+  now_ += ms * kNumNanosecsPerMillisec;
+  Advance(NULL);
+}
+
+void VirtualClock::Attach(VirtualSocketServer* server) {
+  CritScope cs(&crit_);
+  ASSERT(FindWaiter(server) == NULL);
+  // A server counts as waiting until something is posted to it, so that the
+  // clock doesn't stop for servers whose threads haven't started yet.
+  Waiter waiter;
+  waiter.server = server;
+  waiter.waiting = true;
+  waiter.wake_pending = false;
+  waiter.deadline = kNoDeadline;
+  waiters_.push_back(waiter);
+}
+
+void VirtualClock::Detach(VirtualSocketServer* server) {
+  CritScope cs(&crit_);
+  for (std::vector<Waiter>::iterator it = waiters_.begin();
+       it != waiters_.end(); ++it) {
+    if (it->server == server) {
+      waiters_.erase(it);
+      break;
+    }
+  }
+  Advance(NULL);
+}
+
+bool VirtualClock::BeginWait(VirtualSocketServer* server, int cms) {
+  CritScope cs(&crit_);
+  Waiter* waiter = FindWaiter(server);
+  ASSERT(waiter != NULL);
+  if (waiter->wake_pending) {
+    waiter->wake_pending = false;
+    return true;
+  }
+  waiter->waiting = true;
+  waiter->deadline = (cms == kForever) ?
+      kNoDeadline : now_ + cms * kNumNanosecsPerMillisec;
+  Advance(server);
+  return !waiter->waiting;
+}
+
+void VirtualClock::EndWait(VirtualSocketServer* server) {
+  CritScope cs(&crit_);
+  Waiter* waiter = FindWaiter(server);
+  ASSERT(waiter != NULL);
+  waiter->waiting = false;
+  waiter->wake_pending = false;
+  waiter->deadline = kNoDeadline;
+}
+
+void VirtualClock::WakeUp(VirtualSocketServer* server) {
+  CritScope cs(&crit_);
+  Waiter* waiter = FindWaiter(server);
+  if (waiter) {
+    waiter->waiting = false;
+    waiter->wake_pending = true;
+  }
+}
+
+VirtualClock::Waiter* VirtualClock::FindWaiter(VirtualSocketServer* server) {
+  for (size_t i = 0; i < waiters_.size(); ++i) {
+    if (waiters_[i].server == server)
+      return &waiters_[i];
+  }
+  return NULL;
+}
+
+void VirtualClock::Advance(VirtualSocketServer* caller) {
+  uint64 next = kNoDeadline;
+  for (size_t i = 0; i < waiters_.size(); ++i) {
+    if (!waiters_[i].waiting)
+      return;
+    next = std::min(next, waiters_[i].deadline);
+  }
+  if (next == kNoDeadline)
+    return;
+  now_ = std::max(now_, next);
+  for (size_t i = 0; i < waiters_.size(); ++i) {
+    Waiter& waiter = waiters_[i];
+    if (waiter.deadline <= now_) {
+      waiter.waiting = false;
+      waiter.deadline = kNoDeadline;
+      if (waiter.server != caller)
+        waiter.server->socketserver()->WakeUp();
+    }
+  }
+}
+
 VirtualSocket::VirtualSocket(VirtualSocketServer* server,
                              int family,
                              int type,
@@ -503,7 +643,7 @@ VirtualSocketServer::VirtualSocketServer(SocketServer* ss)
       network_delay_(Time()), next_ipv4_(kInitialNextIPv4),
       next_ipv6_(kInitialNextIPv6), next_port_(kFirstEphemeralPort),
       bindings_(new AddressMap()), connections_(new ConnectionMap()),
-      bandwidth_(0), network_capacity_(kDefaultNetworkCapacity),
+      clock_(NULL), bandwidth_(0), network_capacity_(kDefaultNetworkCapacity),
       send_buffer_capacity_(kDefaultTcpBufferSize),
       recv_buffer_capacity_(kDefaultTcpBufferSize),
       delay_mean_(0), delay_stddev_(0), delay_samples_(NUM_SAMPLES),
@@ -516,8 +656,14 @@ VirtualSocketServer::VirtualSocketServer(SocketServer* ss)
 }
 
 VirtualSocketServer::~VirtualSocketServer() {
+  if (clock_) {
+    clock_->Detach(this);
+  }
   delete bindings_;
   delete connections_;
+  for (LinkMap::iterator it = links_.begin(); it != links_.end(); ++it) {
+    delete it->second;
+  }
   delete delay_dist_;
   if (server_owned_) {
     delete server_;
@@ -582,10 +728,23 @@ bool VirtualSocketServer::Wait(int cmsWait, bool process_io) {
   if (stop_on_idle_ && Thread::Current()->empty()) {
     return false;
   }
-  return socketserver()->Wait(cmsWait, process_io);
+  if (!clock_ || cmsWait == 0) {
+    return socketserver()->Wait(cmsWait, process_io);
+  }
+  // In virtual time, the clock ends the wait as soon as every server that
+  // shares it is waiting.  Until then, or until a message is posted, block
+  // for real.
+  if (!clock_->BeginWait(this, cmsWait)) {
+    socketserver()->Wait(kForever, process_io);
+  }
+  clock_->EndWait(this);
+  return true;
 }
 
 void VirtualSocketServer::WakeUp() {
+  if (clock_) {
+    clock_->WakeUp(this);
+  }
   socketserver()->WakeUp();
 }
 
@@ -606,6 +765,39 @@ void VirtualSocketServer::SetNextPortForTesting(uint16 port) {
   next_port_ = port;
 }
 
+void VirtualSocketServer::SetVirtualClock(VirtualClock* clock) {
+  if (clock_) {
+    clock_->Detach(this);
+  }
+  clock_ = clock;
+  if (clock_) {
+    clock_->Attach(this);
+  }
+}
+
+void VirtualSocketServer::SetLink(const IPAddress& ip, uint32 bandwidth,
+                                  uint32 queue_capacity, uint32 delay) {
+  RemoveLink(ip);
+  links_[ip.Normalized()] = new Link(bandwidth, queue_capacity, delay);
+}
+
+void VirtualSocketServer::RemoveLink(const IPAddress& ip) {
+  LinkMap::iterator it = links_.find(ip.Normalized());
+  if (it != links_.end()) {
+    delete it->second;
+    links_.erase(it);
+  }
+}
+
+VirtualSocketServer::Link* VirtualSocketServer::FindLink(
+    VirtualSocket* socket) {
+  if (links_.empty())
+    return NULL;
+  LinkMap::iterator it =
+      links_.find(socket->local_addr_.ipaddr().Normalized());
+  return (it != links_.end()) ? it->second : NULL;
+}
+
 int VirtualSocketServer::Bind(VirtualSocket* socket,
                               const SocketAddress& addr) {
   ASSERT(NULL != socket);
@@ -614,9 +806,7 @@ int VirtualSocketServer::Bind(VirtualSocket* socket,
   ASSERT(addr.port() != 0);
 
   // Normalize the address (turns v6-mapped addresses into v4-addresses).
-  SocketAddress normalized(addr.ipaddr().Normalized(), addr.port());
-
-  AddressMap::value_type entry(normalized, socket);
+  AddressMap::value_type entry(NormalizedKey(addr), socket);
   return bindings_->insert(entry).second ? 0 : -1;
 }
 
@@ -634,7 +824,7 @@ int VirtualSocketServer::Bind(VirtualSocket* socket, SocketAddress* addr) {
   if (addr->port() == 0) {
     for (int i = 0; i < kEphemeralPortCount; ++i) {
       addr->SetPort(GetNextPort());
-      if (bindings_->find(*addr) == bindings_->end()) {
+      if (bindings_->find(SocketAddressKey(*addr)) == bindings_->end()) {
         break;
       }
     }
@@ -644,18 +834,15 @@ int VirtualSocketServer::Bind(VirtualSocket* socket, SocketAddress* addr) {
 }
 
 VirtualSocket* VirtualSocketServer::LookupBinding(const SocketAddress& addr) {
-  SocketAddress normalized(addr.ipaddr().Normalized(),
-                           addr.port());
-  AddressMap::iterator it = bindings_->find(normalized);
+  AddressMap::iterator it = bindings_->find(NormalizedKey(addr));
   return (bindings_->end() != it) ? it->second : NULL;
 }
 
 int VirtualSocketServer::Unbind(const SocketAddress& addr,
                                 VirtualSocket* socket) {
-  SocketAddress normalized(addr.ipaddr().Normalized(),
-                           addr.port());
-  ASSERT((*bindings_)[normalized] == socket);
-  bindings_->erase(bindings_->find(normalized));
+  AddressMap::iterator it = bindings_->find(NormalizedKey(addr));
+  ASSERT(it != bindings_->end() && it->second == socket);
+  bindings_->erase(it);
   return 0;
 }
 
@@ -664,34 +851,24 @@ void VirtualSocketServer::AddConnection(const SocketAddress& local,
                                         VirtualSocket* remote_socket) {
   // Add this socket pair to our routing table. This will allow
   // multiple clients to connect to the same server address.
-  SocketAddress local_normalized(local.ipaddr().Normalized(),
-                                 local.port());
-  SocketAddress remote_normalized(remote.ipaddr().Normalized(),
-                                  remote.port());
-  SocketAddressPair address_pair(local_normalized, remote_normalized);
-  connections_->insert(std::pair<SocketAddressPair,
-                       VirtualSocket*>(address_pair, remote_socket));
+  ConnectionMap::key_type address_pair(NormalizedKey(local),
+                                       NormalizedKey(remote));
+  connections_->insert(ConnectionMap::value_type(address_pair, remote_socket));
 }
 
 VirtualSocket* VirtualSocketServer::LookupConnection(
     const SocketAddress& local,
     const SocketAddress& remote) {
-  SocketAddress local_normalized(local.ipaddr().Normalized(),
-                                 local.port());
-  SocketAddress remote_normalized(remote.ipaddr().Normalized(),
-                                  remote.port());
-  SocketAddressPair address_pair(local_normalized, remote_normalized);
+  ConnectionMap::key_type address_pair(NormalizedKey(local),
+                                       NormalizedKey(remote));
   ConnectionMap::iterator it = connections_->find(address_pair);
   return (connections_->end() != it) ? it->second : NULL;
 }
 
 void VirtualSocketServer::RemoveConnection(const SocketAddress& local,
                                            const SocketAddress& remote) {
-  SocketAddress local_normalized(local.ipaddr().Normalized(),
-                                local.port());
-  SocketAddress remote_normalized(remote.ipaddr().Normalized(),
-                                 remote.port());
-  SocketAddressPair address_pair(local_normalized, remote_normalized);
+  ConnectionMap::key_type address_pair(NormalizedKey(local),
+                                       NormalizedKey(remote));
   connections_->erase(address_pair);
 }
 
@@ -759,10 +936,11 @@ int VirtualSocketServer::SendUdp(VirtualSocket* socket,
     return -1;
   }
 
-  CritScope cs(&socket->crit_);
+  Link* link = FindLink(socket);
+  CritScope cs(link ? &link->crit : &socket->crit_);
 
   uint32 cur_time = Time();
-  PurgeNetworkPackets(socket, cur_time);
+  PurgeNetworkPackets(socket, link, cur_time);
 
   // Determine whether we have enough bandwidth to accept this packet.  To do
   // this, we need to update the send queue.  Once we know it's current size,
@@ -773,12 +951,14 @@ int VirtualSocketServer::SendUdp(VirtualSocket* socket,
   // simulation of what a normal network would do.
 
   size_t packet_size = data_size + UDP_HEADER_SIZE;
-  if (socket->network_size_ + packet_size > network_capacity_) {
+  size_t queue_size = link ? link->queue_size : socket->network_size_;
+  uint32 capacity = link ? link->queue_capacity : network_capacity_;
+  if (queue_size + packet_size > capacity) {
     LOG(LS_VERBOSE) << "Dropping packet: network capacity exceeded";
     return static_cast<int>(data_size);
   }
 
-  AddPacketToNetwork(socket, recipient, cur_time, data, data_size,
+  AddPacketToNetwork(socket, recipient, link, cur_time, data, data_size,
                      UDP_HEADER_SIZE, false);
 
   return static_cast<int>(data_size);
@@ -799,10 +979,11 @@ void VirtualSocketServer::SendTcp(VirtualSocket* socket) {
     return;
   }
 
-  CritScope cs(&socket->crit_);
+  Link* link = FindLink(socket);
+  CritScope cs(link ? &link->crit : &socket->crit_);
 
   uint32 cur_time = Time();
-  PurgeNetworkPackets(socket, cur_time);
+  PurgeNetworkPackets(socket, link, cur_time);
 
   while (true) {
     size_t available = recv_buffer_capacity_ - recipient->recv_buffer_size_;
@@ -811,8 +992,9 @@ void VirtualSocketServer::SendTcp(VirtualSocket* socket) {
     if (0 == data_size)
       break;
 
-    AddPacketToNetwork(socket, recipient, cur_time, &socket->send_buffer_[0],
-                       data_size, TCP_HEADER_SIZE, true);
+    AddPacketToNetwork(socket, recipient, link, cur_time,
+                       &socket->send_buffer_[0], data_size, TCP_HEADER_SIZE,
+                       true);
     recipient->recv_buffer_size_ += data_size;
 
     size_t new_buffer_size = socket->send_buffer_.size() - data_size;
@@ -835,6 +1017,7 @@ void VirtualSocketServer::SendTcp(VirtualSocket* socket) {
 
 void VirtualSocketServer::AddPacketToNetwork(VirtualSocket* sender,
                                              VirtualSocket* recipient,
+                                             Link* link,
                                              uint32 cur_time,
                                              const char* data,
                                              size_t data_size,
@@ -843,13 +1026,24 @@ void VirtualSocketServer::AddPacketToNetwork(VirtualSocket* sender,
   VirtualSocket::NetworkEntry entry;
   entry.size = data_size + header_size;
 
-  sender->network_size_ += entry.size;
-  uint32 send_delay = SendDelay(static_cast<uint32>(sender->network_size_));
-  entry.done_time = cur_time + send_delay;
-  sender->network_.push_back(entry);
+  uint32 send_delay;
+  if (link) {
+    link->queue_size += entry.size;
+    send_delay = TransmitDelay(static_cast<uint32>(link->queue_size),
+                               link->bandwidth);
+    entry.done_time = cur_time + send_delay;
+    link->queue.push_back(entry);
+  } else {
+    sender->network_size_ += entry.size;
+    send_delay = SendDelay(static_cast<uint32>(sender->network_size_));
+    entry.done_time = cur_time + send_delay;
+    sender->network_.push_back(entry);
+  }
 
   // Find the delay for crossing the many virtual hops of the network.
   uint32 transit_delay = GetRandomTransitDelay();
+  if (link)
+    transit_delay += link->delay;
 
   // Post the packet as a message to be delivered (on our own thread)
   Packet* p = new Packet(data, data_size, sender->local_addr_);
@@ -865,20 +1059,19 @@ void VirtualSocketServer::AddPacketToNetwork(VirtualSocket* sender,
 }
 
 void VirtualSocketServer::PurgeNetworkPackets(VirtualSocket* socket,
+                                              Link* link,
                                               uint32 cur_time) {
-  while (!socket->network_.empty() &&
-         (socket->network_.front().done_time <= cur_time)) {
-    ASSERT(socket->network_size_ >= socket->network_.front().size);
-    socket->network_size_ -= socket->network_.front().size;
-    socket->network_.pop_front();
+  VirtualSocket::NetworkQueue& queue = link ? link->queue : socket->network_;
+  size_t& queue_size = link ? link->queue_size : socket->network_size_;
+  while (!queue.empty() && (queue.front().done_time <= cur_time)) {
+    ASSERT(queue_size >= queue.front().size);
+    queue_size -= queue.front().size;
+    queue.pop_front();
   }
 }
 
 uint32 VirtualSocketServer::SendDelay(uint32 size) {
-  if (bandwidth_ == 0)
-    return 0;
-  else
-    return 1000 * size / bandwidth_;
+  return TransmitDelay(size, bandwidth_);
 }
 
 #if 0
@@ -15,15 +15,71 @@
 
 #include <deque>
 #include <map>
+#include <vector>
 
+#include "webrtc/base/criticalsection.h"
 #include "webrtc/base/messagequeue.h"
 #include "webrtc/base/socketserver.h"
+#include "webrtc/base/timeutils.h"
 
 namespace rtc {
 
 class Packet;
 class VirtualSocket;
-class SocketAddressPair;
+class VirtualSocketServer;
+
+// A clock for VirtualSocketServers that simulate the network in virtual time.
+// While it exists, it replaces the system clock for Time() and friends (see
+// SetClockForTesting).  It stands still while any server attached to it is
+// busy; once they all wait, it jumps straight to the earliest time one of them
+// waits for, so timers and network delays take no real time at all.
+//
+// Several servers on different threads can share one clock, each simulating
+// its own subnet; virtual time then advances in lockstep for all of them.
+// Destroy the clock only after the attached servers and their timers.
+class VirtualClock : public ClockInterface {
+ public:
+  VirtualClock();
+  virtual ~VirtualClock();
+
+  // ClockInterface:
+  virtual uint64 TimeNanos() const;
+
+  // Moves the time forward by |ms| right away, waking the servers whose waits
+  // end by then.
+  void AdvanceTime(int ms);
+
+ private:
+  friend class VirtualSocketServer;
+
+  struct Waiter {
+    VirtualSocketServer* server;
+    bool waiting;
+    bool wake_pending;
+    uint64 deadline;
+  };
+
+  void Attach(VirtualSocketServer* server);
+  void Detach(VirtualSocketServer* server);
+  // Called by |server| before it blocks for |cms| milliseconds.  Returns true
+  // if the wait is already over, either because the time jumped to its end or
+  // because something was posted to the server meanwhile.
+  bool BeginWait(VirtualSocketServer* server, int cms);
+  void EndWait(VirtualSocketServer* server);
+  // Called when a message is posted to |server|.
+  void WakeUp(VirtualSocketServer* server);
+
+  Waiter* FindWaiter(VirtualSocketServer* server);
+  // Requires |crit_|.  If every server waits, moves the time to the earliest
+  // deadline and wakes the servers that wait for it, other than |caller|.
+  void Advance(VirtualSocketServer* caller);
+
+  mutable CriticalSection crit_;
+  uint64 now_;
+  std::vector<Waiter> waiters_;
+  ClockInterface* previous_clock_;
+  DISALLOW_EVIL_CONSTRUCTORS(VirtualClock);
+};
 
 // Simulates a network in the same manner as a loopback interface.  The
 // interface can create as many addresses as you want.  All of the sockets
@@ -80,6 +136,17 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
   // called to recompute the new distribution.
   void UpdateDelayDistribution();
 
+  // Models the access link of the host with address |ip|: the packets that
+  // its sockets send share one queue, which drains at |bandwidth| bytes per
+  // second (0 for no limit) and drops packets once |queue_capacity| bytes are
+  // waiting; each packet then takes another |delay| milliseconds to arrive, on
+  // top of the transit delay.  Sockets on hosts without a link have a queue
+  // of their own, limited by bandwidth() and network_capacity().
+  // Links should be set up before the host starts sending.
+  void SetLink(const IPAddress& ip, uint32 bandwidth, uint32 queue_capacity,
+               uint32 delay);
+  void RemoveLink(const IPAddress& ip);
+
   // Controls the (uniform) probability that any sent packet is dropped.  This
   // is separate from calculations to drop based on queue size.
   double drop_probability() { return drop_prob_; }
@@ -114,6 +181,11 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
   // Sets the next port number to use for testing.
   void SetNextPortForTesting(uint16 port);
 
+  // Runs the network in virtual time on |clock|: waiting for the next packet
+  // or timer takes no real time.  Must be called before the thread that runs
+  // this server starts; NULL goes back to real time.
+  void SetVirtualClock(VirtualClock* clock);
+
  protected:
   // Returns a new IP not used before in this network.
   IPAddress GetNextIP(int family);
@@ -158,13 +230,19 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
   // Moves as much data as possible from the sender's buffer to the network
   void SendTcp(VirtualSocket* socket);
 
-  // Places a packet on the network.
+  // The access link of a host; see SetLink.
+  struct Link;
+
+  // Returns the link of the host |socket| is bound to, or NULL.
+  Link* FindLink(VirtualSocket* socket);
+
+  // Places a packet on the network, queueing it on |link| if there is one.
   void AddPacketToNetwork(VirtualSocket* socket, VirtualSocket* recipient,
-                          uint32 cur_time, const char* data, size_t data_size,
-                          size_t header_size, bool ordered);
+                          Link* link, uint32 cur_time, const char* data,
+                          size_t data_size, size_t header_size, bool ordered);
 
   // Removes stale packets from the network
-  void PurgeNetworkPackets(VirtualSocket* socket, uint32 cur_time);
+  void PurgeNetworkPackets(VirtualSocket* socket, Link* link, uint32 cur_time);
 
   // Computes the number of milliseconds required to send a packet of this size.
   uint32 SendDelay(uint32 size);
@@ -205,8 +283,10 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
  private:
   friend class VirtualSocket;
 
-  typedef std::map<SocketAddress, VirtualSocket*> AddressMap;
-  typedef std::map<SocketAddressPair, VirtualSocket*> ConnectionMap;
+  typedef std::map<SocketAddressKey, VirtualSocket*> AddressMap;
+  typedef std::map<std::pair<SocketAddressKey, SocketAddressKey>,
+                   VirtualSocket*> ConnectionMap;
+  typedef std::map<IPAddress, Link*> LinkMap;
 
   SocketServer* server_;
   bool server_owned_;
@@ -218,6 +298,8 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
   uint16 next_port_;
   AddressMap* bindings_;
   ConnectionMap* connections_;
+  LinkMap links_;
+  VirtualClock* clock_;
 
   uint32 bandwidth_;
   uint32 network_capacity_;
@@ -66,16 +66,12 @@ int AsyncStunTCPSocket::Send(const void *pv, size_t cb,
   if (cb != expected_pkt_len)
     return -1;
 
-  AppendToOutBuffer(pv, cb);
-
   ASSERT(pad_bytes < 4);
-  char padding[4] = {0};
-  AppendToOutBuffer(padding, pad_bytes);
-
-  int res = FlushOutBuffer();
+  static const char padding[4] = {0};
+  rtc::IoVec pieces[] = {rtc::IoVec(pv, cb), rtc::IoVec(padding, pad_bytes)};
+  int res = SendFrame(pieces, ARRAY_SIZE(pieces));
   if (res <= 0) {
     // drop packet if we made no progress
-    ClearOutBuffer();
     return res;
   }
 
@@ -95,26 +91,29 @@ void AsyncStunTCPSocket::ProcessInput(char* data, size_t* len) {
   // |         Channel Number        |            Length             |
   // +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 
-  while (true) {
-    // We need at least 4 bytes to read the STUN or ChannelData packet length.
-    if (*len < kPacketLenOffset + kPacketLenSize)
-      return;
-
+  // Packets are signaled where they are; only a partial packet at the end is
+  // moved to the front, once.
+  size_t pos = 0;
+  // We need at least 4 bytes to read the STUN or ChannelData packet length.
+  while (*len - pos >= kPacketLenOffset + kPacketLenSize) {
     int pad_bytes;
-    size_t expected_pkt_len = GetExpectedLength(data, *len, &pad_bytes);
+    size_t expected_pkt_len =
+        GetExpectedLength(data + pos, *len - pos, &pad_bytes);
     size_t actual_length = expected_pkt_len + pad_bytes;
 
-    if (*len < actual_length) {
-      return;
+    if (*len - pos < actual_length) {
+      break;
     }
 
-    SignalReadPacket(this, data, expected_pkt_len, remote_addr,
+    SignalReadPacket(this, data + pos, expected_pkt_len, remote_addr,
                      rtc::CreatePacketTime(0));
 
-    *len -= actual_length;
-    if (*len > 0) {
-      memmove(data, data + actual_length, *len);
-    }
+    pos += actual_length;
+  }
+
+  *len -= pos;
+  if (*len > 0 && pos > 0) {
+    memmove(data, data + pos, *len);
   }
 }
 
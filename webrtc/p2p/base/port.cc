@@ -218,6 +218,7 @@ void Port::Construct() {
     ice_username_fragment_ = rtc::CreateRandomString(ICE_UFRAG_LENGTH);
     password_ = rtc::CreateRandomString(ICE_PWD_LENGTH);
   }
+  password_key_.SetKey(password_.c_str(), password_.size());
   LOG_J(LS_INFO, this) << "Port created";
 }
 
@@ -238,7 +239,11 @@ Port::~Port() {
 }
 
 Connection* Port::GetConnection(const rtc::SocketAddress& remote_addr) {
-  AddressMap::const_iterator iter = connections_.find(remote_addr);
+  // All unresolved addresses would map to the same key.
+  if (remote_addr.IsUnresolvedIP())
+    return NULL;
+  AddressMap::const_iterator iter =
+      connections_.find(rtc::SocketAddressKey(remote_addr));
   if (iter != connections_.end())
     return iter->second;
   else
@@ -283,7 +288,9 @@ void Port::AddAddress(const rtc::SocketAddress& address,
 }
 
 void Port::AddConnection(Connection* conn) {
-  connections_[conn->remote_candidate().address()] = conn;
+  ASSERT(!conn->remote_candidate().address().IsUnresolvedIP());
+  connections_[rtc::SocketAddressKey(conn->remote_candidate().address())] =
+      conn;
   conn->SignalDestroyed.connect(this, &Port::OnConnectionDestroyed);
   SignalConnectionCreated(this, conn);
 }
@@ -355,17 +362,19 @@ bool Port::IsHybridIce() const {
 bool Port::GetStunMessage(const char* data, size_t size,
                           const rtc::SocketAddress& addr,
                           IceMessage** out_msg, std::string* out_username) {
-  // NOTE: This could clearly be optimized to avoid allocating any memory.
-  //       However, at the data rates we'll be looking at on the client side,
-  //       this probably isn't worth worrying about.
   ASSERT(out_msg != NULL);
   ASSERT(out_username != NULL);
   *out_msg = NULL;
   out_username->clear();
 
-  // Don't bother parsing the packet if we can tell it's not STUN.
+  // Don't bother parsing the packet if we can tell it's not STUN. The view
+  // only looks at the packet in place, so this costs no allocations.
+  StunMessageView view;
+  if (!view.Parse(data, size)) {
+    return false;
+  }
   // In ICE mode, all STUN packets will have a valid fingerprint.
-  if (IsStandardIce() && !StunMessage::ValidateFingerprint(data, size)) {
+  if (IsStandardIce() && !view.ValidateFingerprint()) {
     return false;
   }
 
@@ -415,8 +424,7 @@ bool Port::GetStunMessage(const char* data, size_t size,
     }
 
     // If ICE, and the MESSAGE-INTEGRITY is bad, fail with a 401 Unauthorized
-    if (IsStandardIce() &&
-        !stun_msg->ValidateMessageIntegrity(data, size, password_)) {
+    if (IsStandardIce() && !view.ValidateMessageIntegrity(password_key_)) {
       LOG_J(LS_ERROR, this) << "Received STUN request with bad M-I "
                             << "from " << addr.ToSensitiveString();
       SendBindingErrorResponse(stun_msg.get(), addr, STUN_ERROR_UNAUTHORIZED,
@@ -627,7 +635,7 @@ void Port::SendBindingResponse(StunMessage* request,
   if (IsStandardIce()) {
     response.AddAttribute(
         new StunXorAddressAttribute(STUN_ATTR_XOR_MAPPED_ADDRESS, addr));
-    response.AddMessageIntegrity(password_);
+    response.AddMessageIntegrity(password_key_);
     response.AddFingerprint();
   } else if (IsGoogleIce()) {
     response.AddAttribute(
@@ -680,7 +688,7 @@ void Port::SendBindingErrorResponse(StunMessage* request,
     // because we don't have enough information to determine the shared secret.
     if (error_code != STUN_ERROR_BAD_REQUEST &&
         error_code != STUN_ERROR_UNAUTHORIZED)
-      response.AddMessageIntegrity(password_);
+      response.AddMessageIntegrity(password_key_);
     response.AddFingerprint();
   } else if (IsGoogleIce()) {
     // GICE responses include a username, if one exists.
@@ -718,8 +726,8 @@ void Port::EnablePortPackets() {
 }
 
 void Port::OnConnectionDestroyed(Connection* conn) {
-  AddressMap::iterator iter =
-      connections_.find(conn->remote_candidate().address());
+  AddressMap::iterator iter = connections_.find(
+      rtc::SocketAddressKey(conn->remote_candidate().address()));
   ASSERT(iter != connections_.end());
   connections_.erase(iter);
 
@@ -819,7 +827,7 @@ class ConnectionRequest : public StunRequest {
           new StunUInt32Attribute(STUN_ATTR_PRIORITY, prflx_priority));
 
       // Adding Message Integrity attribute.
-      request->AddMessageIntegrity(connection_->remote_candidate().password());
+      request->AddMessageIntegrity(connection_->remote_password_key_);
       // Adding Fingerprint.
       request->AddFingerprint();
     }
@@ -858,6 +866,7 @@ Connection::Connection(Port* port,
     : port_(port),
       local_candidate_index_(index),
       remote_candidate_(remote_candidate),
+      remote_password_key_(remote_candidate.password()),
       read_state_(STATE_READ_INIT),
       write_state_(STATE_WRITE_INIT),
       connected_(true),
@@ -1047,7 +1056,7 @@ void Connection::OnReadPacket(
       case STUN_BINDING_ERROR_RESPONSE:
         if (port_->IsGoogleIce() ||
             msg->ValidateMessageIntegrity(
-                data, size, remote_candidate().password())) {
+                data, size, remote_password_key_)) {
           requests_.CheckResponse(msg.get());
         }
         // Otherwise silently discard the response message.
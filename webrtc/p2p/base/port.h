@@ -213,8 +213,9 @@ class Port : public PortInterface, public rtc::MessageHandler,
   sigslot::signal1<Port*> SignalPortError;
 
   // Returns a map containing all of the connections of this port, keyed by the
-  // remote address.
-  typedef std::map<rtc::SocketAddress, Connection*> AddressMap;
+  // remote address. Connections are only made to resolved addresses (see
+  // IsCompatibleAddress), so the key needs no hostname.
+  typedef std::map<rtc::SocketAddressKey, Connection*> AddressMap;
   const AddressMap& connections() { return connections_; }
 
   // Returns the connection to the given address or NULL if none exists.
@@ -376,6 +377,8 @@ class Port : public PortInterface, public rtc::MessageHandler,
   // username_fragment().
   std::string ice_username_fragment_;
   std::string password_;
+  // |password_| prepared for checking and signing STUN messages.
+  StunHmacKey password_key_;
   std::vector<Candidate> candidates_;
   AddressMap connections_;
   int timeout_delay_;
@@ -563,6 +566,8 @@ class Connection : public rtc::MessageHandler,
   Port* port_;
   size_t local_candidate_index_;
   Candidate remote_candidate_;
+  // The remote password prepared for checking and signing STUN messages.
+  StunHmacKey remote_password_key_;
   ReadState read_state_;
   WriteState write_state_;
   bool connected_;
@@ -1276,6 +1276,29 @@ TEST_F(PortTest, TestSkipCrossFamilyUdp) {
   TestCrossFamilyPorts(SOCK_DGRAM);
 }
 
+// Tests that no connection is made to, or found for, a remote address whose
+// hostname is not resolved; all such addresses would share one key.
+TEST_F(PortTest, TestNoConnectionToUnresolvedAddress) {
+  scoped_ptr<UDPPort> port1(CreateUdpPort(kLocalAddr1));
+  scoped_ptr<UDPPort> port2(CreateUdpPort(kLocalAddr2));
+  port1->PrepareAddress();
+  port2->PrepareAddress();
+  ASSERT_EQ(1U, port2->Candidates().size());
+
+  Candidate remote = GetCandidate(port2.get());
+  Connection* conn = port1->CreateConnection(remote, Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn != NULL);
+
+  Candidate unresolved(remote);
+  unresolved.set_address(
+      SocketAddress("remote.example.com", remote.address().port()));
+  EXPECT_TRUE(port1->CreateConnection(unresolved, Port::ORIGIN_MESSAGE) ==
+              NULL);
+  EXPECT_TRUE(port1->GetConnection(unresolved.address()) == NULL);
+  EXPECT_EQ(conn, port1->GetConnection(remote.address()));
+  EXPECT_EQ(1U, port1->connections().size());
+}
+
 // This test verifies DSCP value set through SetOption interface can be
 // get through DefaultDscpValue.
 TEST_F(PortTest, TestDefaultDscpValue) {
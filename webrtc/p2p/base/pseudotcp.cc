@@ -10,6 +10,7 @@
 
 #include "webrtc/p2p/base/pseudotcp.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -97,6 +98,11 @@ const uint32 DEFAULT_SND_BUF_SIZE = 90 * 1024;
 // 24 |                             data                              |
 //    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 //
+// An ACK carrying FLAG_SACK has no data; instead its payload is a list of
+// up to MAX_SACK_BLOCKS (left edge, right edge) pairs of 32-bit sequence
+// numbers, as in RFC 2018. It is only sent once both ends have offered
+// TCP_OPT_SACK_PERMITTED in their connect messages.
+//
 //////////////////////////////////////////////////////////////////////
 
 #define PSEUDO_KEEPALIVE 0
@@ -111,6 +117,7 @@ const uint32 DEF_ACK_DELAY = 100; // 100 milliseconds
 
 const uint8 FLAG_CTL = 0x02;
 const uint8 FLAG_RST = 0x04;
+const uint8 FLAG_SACK = 0x08;
 
 const uint8 CTL_CONNECT = 0;
 
@@ -119,6 +126,10 @@ const uint8 TCP_OPT_EOL = 0;  // End of list.
 const uint8 TCP_OPT_NOOP = 1;  // No-op.
 const uint8 TCP_OPT_MSS = 2;  // Maximum segment size.
 const uint8 TCP_OPT_WND_SCALE = 3;  // Window scale factor.
+const uint8 TCP_OPT_SACK_PERMITTED = 4;  // Selective acknowledgements.
+
+const uint32 SACK_BLOCK_SIZE = 8;
+const uint32 MAX_SACK_BLOCKS = 4;
 
 const long DEFAULT_TIMEOUT = 4000; // If there are no pending clocks, wake up every 4 seconds
 const long CLOSED_TIMEOUT = 60 * 1000; // If the connection is closed, once per minute
@@ -191,6 +202,86 @@ void ReportStats() {
 
 #endif
 
+//////////////////////////////////////////////////////////////////////
+// Congestion Control
+//////////////////////////////////////////////////////////////////////
+
+uint32 RenoCongestionControl::OnAck(uint32 cwnd, uint32 ssthresh, uint32 mss,
+                                    uint32 acked, uint32 srtt, uint32 now) {
+  // Slow start, congestion avoidance
+  if (cwnd < ssthresh) {
+    return cwnd + mss;
+  }
+  return cwnd + rtc::_max<uint32>(1, mss * mss / cwnd);
+}
+
+uint32 RenoCongestionControl::OnLoss(uint32 cwnd, uint32 in_flight,
+                                     uint32 mss, uint32 now) {
+  return rtc::_max(in_flight / 2, 2 * mss);
+}
+
+// Constants from RFC 8312: the multiplicative decrease factor and the
+// scaling constant of the cubic function.
+const double CUBIC_BETA = 0.7;
+const double CUBIC_C = 0.4;
+
+CubicCongestionControl::CubicCongestionControl()
+    : w_max_(0), origin_(0), k_(0), w_est_(0), epoch_start_(0) {
+}
+
+uint32 CubicCongestionControl::OnAck(uint32 cwnd, uint32 ssthresh, uint32 mss,
+                                     uint32 acked, uint32 srtt, uint32 now) {
+  if (cwnd < ssthresh) {
+    return cwnd + mss;
+  }
+
+  double segments = static_cast<double>(cwnd) / mss;
+  if (epoch_start_ == 0) {
+    // First ack of a new congestion avoidance epoch.
+    epoch_start_ = now ? now : 1;
+    if (segments < w_max_) {
+      k_ = pow((w_max_ - segments) / CUBIC_C, 1.0 / 3.0);
+      origin_ = w_max_;
+    } else {
+      k_ = 0;
+      origin_ = segments;
+    }
+    w_est_ = segments;
+  }
+
+  // Aim for where the curve will be one RTT from now.
+  double t = (rtc::TimeDiff(now, epoch_start_) + static_cast<int32>(srtt)) /
+      1000.0;
+  double target = origin_ + CUBIC_C * (t - k_) * (t - k_) * (t - k_);
+  // Never grow by more than half the window per RTT.
+  target = rtc::_min(target, 1.5 * segments);
+
+  // In the TCP-friendly region, grow at least as fast as Reno would.
+  w_est_ += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) *
+      rtc::_min<uint32>(acked, mss) / (w_est_ * mss);
+  target = rtc::_max(target, w_est_);
+
+  uint32 increase = 0;
+  if (target > segments) {
+    increase = static_cast<uint32>((target - segments) / segments * mss);
+  }
+  return cwnd + rtc::_max<uint32>(1, increase);
+}
+
+uint32 CubicCongestionControl::OnLoss(uint32 cwnd, uint32 in_flight,
+                                      uint32 mss, uint32 now) {
+  double segments = static_cast<double>(cwnd) / mss;
+  epoch_start_ = 0;
+  // Fast convergence: if the window didn't get back to the previous
+  // maximum, release some bandwidth for new flows.
+  if (segments < w_max_) {
+    w_max_ = segments * (1 + CUBIC_BETA) / 2;
+  } else {
+    w_max_ = segments;
+  }
+  return rtc::_max(static_cast<uint32>(cwnd * CUBIC_BETA), 2 * mss);
+}
+
 //////////////////////////////////////////////////////////////////////
 // PseudoTcp
 //////////////////////////////////////////////////////////////////////
@@ -210,7 +301,9 @@ PseudoTcp::PseudoTcp(IPseudoTcpNotify* notify, uint32 conv)
       m_rbuf_len(DEFAULT_RCV_BUF_SIZE),
       m_rbuf(m_rbuf_len),
       m_sbuf_len(DEFAULT_SND_BUF_SIZE),
-      m_sbuf(m_sbuf_len) {
+      m_sbuf(m_sbuf_len),
+      m_cc(new RenoCongestionControl()),
+      m_packet_buf(new uint8[MAX_PACKET]) {
 
   // Sanity check on buffer sizes (needed for OnTcpWriteable notification logic)
   ASSERT(m_rbuf_len + MIN_PACKET < m_sbuf_len);
@@ -244,6 +337,10 @@ PseudoTcp::PseudoTcp(IPseudoTcpNotify* notify, uint32 conv)
   m_dup_acks = 0;
   m_recover = 0;
 
+  m_rlist_recent = 0;
+  m_sack_enabled = false;
+  m_sacked_bytes = m_sack_high = m_sack_rexmit = 0;
+
   m_ts_recent = m_ts_lastack = 0;
 
   m_rx_rto = DEF_RTO;
@@ -252,6 +349,7 @@ PseudoTcp::PseudoTcp(IPseudoTcpNotify* notify, uint32 conv)
   m_use_nagling = true;
   m_ack_delay = DEF_ACK_DELAY;
   m_support_wnd_scale = true;
+  m_support_sack = true;
 }
 
 PseudoTcp::~PseudoTcp() {
@@ -297,15 +395,17 @@ void PseudoTcp::NotifyClock(uint32 now) {
                    << ") (dup_acks: " << static_cast<unsigned>(m_dup_acks)
                    << ")";
 #endif // _DEBUGMSG
-      if (!transmit(m_slist.begin(), now)) {
+      if (!transmit(0, now)) {
         closedown(ECONNABORTED);
         return;
       }
 
       uint32 nInFlight = m_snd_nxt - m_snd_una;
-      m_ssthresh = rtc::_max(nInFlight / 2, 2 * m_mss);
+      m_ssthresh = m_cc->OnLoss(m_cwnd, nInFlight, m_mss, now);
       //LOG(LS_INFO) << "m_ssthresh: " << m_ssthresh << "  nInFlight: " << nInFlight << "  m_mss: " << m_mss;
       m_cwnd = m_mss;
+      // Holes retransmitted before the timeout may have been lost again.
+      m_sack_rexmit = m_snd_una;
 
       // Back off retransmit timer.  Note: the limit is lower when connecting.
       uint32 rto_limit = (m_state < TCP_ESTABLISHED) ? DEF_RTO : MAX_RTO;
@@ -370,6 +470,8 @@ void PseudoTcp::GetOption(Option opt, int* value) {
     *value = m_sbuf_len;
   } else if (opt == OPT_RCVBUF) {
     *value = m_rbuf_len;
+  } else if (opt == OPT_SACK) {
+    *value = m_support_sack ? 1 : 0;
   } else {
     ASSERT(false);
   }
@@ -385,11 +487,19 @@ void PseudoTcp::SetOption(Option opt, int value) {
   } else if (opt == OPT_RCVBUF) {
     ASSERT(m_state == TCP_LISTEN);
     resizeReceiveBuffer(value);
+  } else if (opt == OPT_SACK) {
+    ASSERT(m_state == TCP_LISTEN);
+    m_support_sack = value != 0;
   } else {
     ASSERT(false);
   }
 }
 
+void PseudoTcp::SetCongestionControl(PseudoTcpCongestionControl* cc) {
+  ASSERT(cc != NULL);
+  m_cc.reset(cc);
+}
+
 uint32 PseudoTcp::GetCongestionWindow() const {
   return m_cwnd;
 }
@@ -511,27 +621,32 @@ IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
 
   uint32 now = Now();
 
-  rtc::scoped_ptr<uint8[]> buffer(new uint8[MAX_PACKET]);
-  long_to_bytes(m_conv, buffer.get());
-  long_to_bytes(seq, buffer.get() + 4);
-  long_to_bytes(m_rcv_nxt, buffer.get() + 8);
+  uint8* buffer = m_packet_buf.get();
+  long_to_bytes(m_conv, buffer);
+  long_to_bytes(seq, buffer + 4);
+  long_to_bytes(m_rcv_nxt, buffer + 8);
   buffer[12] = 0;
   buffer[13] = flags;
   short_to_bytes(
-      static_cast<uint16>(m_rcv_wnd >> m_rwnd_scale), buffer.get() + 14);
+      static_cast<uint16>(m_rcv_wnd >> m_rwnd_scale), buffer + 14);
 
   // Timestamp computations
-  long_to_bytes(now, buffer.get() + 16);
-  long_to_bytes(m_ts_recent, buffer.get() + 20);
+  long_to_bytes(now, buffer + 16);
+  long_to_bytes(m_ts_recent, buffer + 20);
   m_ts_lastack = m_rcv_nxt;
 
+  uint32 sack_len = 0;
   if (len) {
     size_t bytes_read = 0;
     rtc::StreamResult result = m_sbuf.ReadOffset(
-        buffer.get() + HEADER_SIZE, len, offset, &bytes_read);
+        buffer + HEADER_SIZE, len, offset, &bytes_read);
     RTC_UNUSED(result);
     ASSERT(result == rtc::SR_SUCCESS);
     ASSERT(static_cast<uint32>(bytes_read) == len);
+  } else if (m_sack_enabled && (flags == 0) && !m_rlist.empty()) {
+    // Tell the peer which out-of-order data we are holding.
+    sack_len = writeSackBlocks(buffer + HEADER_SIZE);
+    buffer[13] |= FLAG_SACK;
   }
 
 #if _DEBUGMSG >= _DBG_VERBOSE
@@ -546,7 +661,7 @@ IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
 #endif // _DEBUGMSG
 
   IPseudoTcpNotify::WriteResult wres = m_notify->TcpWritePacket(
-      this, reinterpret_cast<char *>(buffer.get()), len + HEADER_SIZE);
+      this, reinterpret_cast<char *>(buffer), len + sack_len + HEADER_SIZE);
   // Note: When len is 0, this is an ACK packet.  We don't read the return value for those,
   // and thus we won't retry.  So go ahead and treat the packet as a success (basically simulate
   // as if it were dropped), which will prevent our timers from being messed up.
@@ -659,6 +774,17 @@ bool PseudoTcp::process(Segment& seg) {
     return false;
   }
 
+  // SACK blocks are carried in place of data; after noting them, treat the
+  // segment as a pure ack.
+  if (seg.flags & FLAG_SACK) {
+    if (m_sack_enabled) {
+      applySackBlocks(seg.data, seg.len);
+    } else {
+      LOG_F(LS_WARNING) << "Unexpected SACK";
+    }
+    seg.len = 0;
+  }
+
   // Check for control data
   bool bConnect = false;
   if (seg.flags & FLAG_CTL) {
@@ -735,14 +861,22 @@ bool PseudoTcp::process(Segment& seg) {
 
     for (uint32 nFree = nAcked; nFree > 0; ) {
       ASSERT(!m_slist.empty());
-      if (nFree < m_slist.front().len) {
-        m_slist.front().len -= nFree;
+      SSegment& front = m_slist.front();
+      if (nFree < front.len) {
+        if (front.bSacked) {
+          m_sacked_bytes -= nFree;
+        }
+        front.seq += nFree;
+        front.len -= nFree;
         nFree = 0;
       } else {
-        if (m_slist.front().len > m_largest) {
-          m_largest = m_slist.front().len;
+        if (front.len > m_largest) {
+          m_largest = front.len;
         }
-        nFree -= m_slist.front().len;
+        if (front.bSacked) {
+          m_sacked_bytes -= front.len;
+        }
+        nFree -= front.len;
         m_slist.pop_front();
       }
     }
@@ -755,11 +889,18 @@ bool PseudoTcp::process(Segment& seg) {
         LOG(LS_INFO) << "exit recovery";
 #endif // _DEBUGMSG
         m_dup_acks = 0;
+      } else if (m_sack_enabled) {
+        // The window isn't inflated while SACKs are in use, so it doesn't
+        // need deflating either; just fill in the reported holes.
+        if (!retransmitHoles(now)) {
+          closedown(ECONNABORTED);
+          return false;
+        }
       } else {
 #if _DEBUGMSG >= _DBG_NORMAL
         LOG(LS_INFO) << "recovery retransmit";
 #endif // _DEBUGMSG
-        if (!transmit(m_slist.begin(), now)) {
+        if (!transmit(0, now)) {
           closedown(ECONNABORTED);
           return false;
         }
@@ -767,12 +908,7 @@ bool PseudoTcp::process(Segment& seg) {
       }
     } else {
       m_dup_acks = 0;
-      // Slow start, congestion avoidance
-      if (m_cwnd < m_ssthresh) {
-        m_cwnd += m_mss;
-      } else {
-        m_cwnd += rtc::_max<uint32>(1, m_mss * m_mss / m_cwnd);
-      }
+      m_cwnd = m_cc->OnAck(m_cwnd, m_ssthresh, m_mss, nAcked, m_rx_srtt, now);
     }
   } else if (seg.ack == m_snd_una) {
     // !?! Note, tcp says don't do this... but otherwise how does a closed window become open?
@@ -788,17 +924,25 @@ bool PseudoTcp::process(Segment& seg) {
         LOG(LS_INFO) << "enter recovery";
         LOG(LS_INFO) << "recovery retransmit";
 #endif // _DEBUGMSG
-        if (!transmit(m_slist.begin(), now)) {
+        if (!transmit(0, now)) {
           closedown(ECONNABORTED);
           return false;
         }
         m_recover = m_snd_nxt;
+        m_sack_rexmit = m_slist.front().seq + m_slist.front().len;
         uint32 nInFlight = m_snd_nxt - m_snd_una;
-        m_ssthresh = rtc::_max(nInFlight / 2, 2 * m_mss);
+        m_ssthresh = m_cc->OnLoss(m_cwnd, nInFlight, m_mss, now);
         //LOG(LS_INFO) << "m_ssthresh: " << m_ssthresh << "  nInFlight: " << nInFlight << "  m_mss: " << m_mss;
-        m_cwnd = m_ssthresh + 3 * m_mss;
+        // With SACK, the bytes that have left the network are known exactly
+        // and are discounted in attemptSend(), so no inflation is needed.
+        m_cwnd = m_sack_enabled ? m_ssthresh : m_ssthresh + 3 * m_mss;
       } else if (m_dup_acks > 3) {
-        m_cwnd += m_mss;
+        if (!m_sack_enabled) {
+          m_cwnd += m_mss;
+        } else if (!retransmitHoles(now)) {
+          closedown(ECONNABORTED);
+          return false;
+        }
       }
     } else {
       m_dup_acks = 0;
@@ -903,10 +1047,10 @@ bool PseudoTcp::process(Segment& seg) {
         bNewData = true;
 
         RList::iterator it = m_rlist.begin();
-        while ((it != m_rlist.end()) && (it->seq <= m_rcv_nxt)) {
-          if (it->seq + it->len > m_rcv_nxt) {
+        while ((it != m_rlist.end()) && (it->first <= m_rcv_nxt)) {
+          if (it->first + it->second > m_rcv_nxt) {
             sflags = sfImmediateAck; // (Fast Recovery)
-            uint32 nAdjust = (it->seq + it->len) - m_rcv_nxt;
+            uint32 nAdjust = (it->first + it->second) - m_rcv_nxt;
 #if _DEBUGMSG >= _DBG_NORMAL
             LOG(LS_INFO) << "Recovered " << nAdjust << " bytes (" << m_rcv_nxt << " -> " << m_rcv_nxt + nAdjust << ")";
 #endif // _DEBUGMSG
@@ -914,20 +1058,20 @@ bool PseudoTcp::process(Segment& seg) {
             m_rcv_nxt += nAdjust;
             m_rcv_wnd -= nAdjust;
           }
-          it = m_rlist.erase(it);
+          m_rlist.erase(it++);
         }
       } else {
 #if _DEBUGMSG >= _DBG_NORMAL
         LOG(LS_INFO) << "Saving " << seg.len << " bytes (" << seg.seq << " -> " << seg.seq + seg.len << ")";
 #endif // _DEBUGMSG
-        RSegment rseg;
-        rseg.seq = seg.seq;
-        rseg.len = seg.len;
-        RList::iterator it = m_rlist.begin();
-        while ((it != m_rlist.end()) && (it->seq < rseg.seq)) {
-          ++it;
+        // If a segment with this sequence number is already saved, keep
+        // whichever is longer.
+        std::pair<RList::iterator, bool> inserted =
+            m_rlist.insert(std::make_pair(seg.seq, seg.len));
+        if (!inserted.second && inserted.first->second < seg.len) {
+          inserted.first->second = seg.len;
         }
-        m_rlist.insert(it, rseg);
+        m_rlist_recent = seg.seq;
       }
     }
   }
@@ -946,7 +1090,8 @@ bool PseudoTcp::process(Segment& seg) {
   return true;
 }
 
-bool PseudoTcp::transmit(const SList::iterator& seg, uint32 now) {
+bool PseudoTcp::transmit(SList::size_type index, uint32 now) {
+  SList::iterator seg = m_slist.begin() + index;
   if (seg->xmit >= ((m_state == TCP_ESTABLISHED) ? 15 : 30)) {
     LOG_F(LS_VERBOSE) << "too many retransmits";
     return false;
@@ -997,10 +1142,12 @@ bool PseudoTcp::transmit(const SList::iterator& seg, uint32 now) {
     SSegment subseg(seg->seq + nTransmit, seg->len - nTransmit, seg->bCtrl);
     //subseg.tstamp = seg->tstamp;
     subseg.xmit = seg->xmit;
+    subseg.bSacked = seg->bSacked;
     seg->len = nTransmit;
 
-    SList::iterator next = seg;
-    m_slist.insert(++next, subseg);
+    // Inserting into the deque invalidates |seg|.
+    m_slist.insert(seg + 1, subseg);
+    seg = m_slist.begin() + index;
   }
 
   if (seg->xmit == 0) {
@@ -1015,6 +1162,137 @@ bool PseudoTcp::transmit(const SList::iterator& seg, uint32 now) {
   return true;
 }
 
+PseudoTcp::SList::size_type PseudoTcp::firstUnsentSegment() const {
+  // Binary search for the end of the prefix of sent segments.
+  SList::size_type low = 0;
+  SList::size_type high = m_slist.size();
+  while (low < high) {
+    SList::size_type mid = low + (high - low) / 2;
+    if (m_slist[mid].xmit > 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+PseudoTcp::SList::size_type PseudoTcp::findSegment(uint32 seq) const {
+  SList::size_type low = 0;
+  SList::size_type high = m_slist.size();
+  while (low < high) {
+    SList::size_type mid = low + (high - low) / 2;
+    if (m_slist[mid].seq < seq) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+uint32 PseudoTcp::writeSackBlocks(uint8* buffer) const {
+  // Per RFC 2018 the first block must hold the most recently received
+  // segment; the rest are the highest remaining blocks, which keeps the
+  // sender's view of the top of the window current.
+  uint32 recent[2] = { 0, 0 };
+  bool have_recent = false;
+  uint32 others[MAX_SACK_BLOCKS - 1][2];
+  uint32 num_others = 0;
+
+  RList::const_iterator it = m_rlist.begin();
+  while (it != m_rlist.end()) {
+    uint32 start = it->first;
+    uint32 end = it->first + it->second;
+    // Coalesce overlapping and adjacent segments.
+    for (++it; (it != m_rlist.end()) && (it->first <= end); ++it) {
+      end = rtc::_max(end, it->first + it->second);
+    }
+    if ((start <= m_rlist_recent) && (m_rlist_recent < end)) {
+      recent[0] = start;
+      recent[1] = end;
+      have_recent = true;
+    } else {
+      uint32* block = others[num_others % (MAX_SACK_BLOCKS - 1)];
+      block[0] = start;
+      block[1] = end;
+      ++num_others;
+    }
+  }
+
+  uint32 written = 0;
+  if (have_recent) {
+    long_to_bytes(recent[0], buffer);
+    long_to_bytes(recent[1], buffer + 4);
+    written += SACK_BLOCK_SIZE;
+  }
+  uint32 count = rtc::_min(num_others, MAX_SACK_BLOCKS - 1);
+  for (uint32 i = 1; i <= count; ++i) {
+    const uint32* block = others[(num_others - i) % (MAX_SACK_BLOCKS - 1)];
+    long_to_bytes(block[0], buffer + written);
+    long_to_bytes(block[1], buffer + written + 4);
+    written += SACK_BLOCK_SIZE;
+  }
+  return written;
+}
+
+void PseudoTcp::applySackBlocks(const char* data, uint32 len) {
+  for (uint32 offset = 0; offset + SACK_BLOCK_SIZE <= len;
+       offset += SACK_BLOCK_SIZE) {
+    uint32 start = bytes_to_long(data + offset);
+    uint32 end = bytes_to_long(data + offset + 4);
+    if ((end <= start) || (end > m_snd_nxt)) {
+      LOG_F(LS_WARNING) << "Invalid SACK block " << start << "-" << end;
+      continue;
+    }
+    if (end <= m_snd_una) {
+      continue;
+    }
+
+    m_sack_high = rtc::_max(m_sack_high, end);
+    // Only whole segments are marked; the receiver stores data in the
+    // units we sent it, so blocks line up with segment boundaries.
+    for (SList::size_type index = findSegment(start);
+         (index < m_slist.size()) && (m_slist[index].xmit > 0) &&
+         (m_slist[index].seq + m_slist[index].len <= end);
+         ++index) {
+      SSegment& seg = m_slist[index];
+      if (!seg.bSacked) {
+        seg.bSacked = true;
+        m_sacked_bytes += seg.len;
+      }
+    }
+  }
+}
+
+bool PseudoTcp::retransmitHoles(uint32 now) {
+  uint32 nPipe = m_snd_nxt - m_snd_una - m_sacked_bytes;
+  uint32 nRoom = (nPipe < m_cwnd) ? (m_cwnd - nPipe) : 0;
+  uint32 nSent = 0;
+
+  // Each call retransmits at least one hole, so that every ack that reports
+  // data leaving the network lets another retransmission in.
+  for (SList::size_type index =
+           findSegment(rtc::_max(m_sack_rexmit, m_snd_una));
+       (index < m_slist.size()) && (m_slist[index].xmit > 0) &&
+       (m_slist[index].seq < m_sack_high);
+       ++index) {
+    if (m_slist[index].bSacked)
+      continue;
+#if _DEBUGMSG >= _DBG_NORMAL
+    LOG(LS_INFO) << "sack retransmit " << m_slist[index].seq;
+#endif // _DEBUGMSG
+    if (!transmit(index, now)) {
+      return false;
+    }
+    m_sack_rexmit = m_slist[index].seq + m_slist[index].len;
+    nSent += m_slist[index].len;
+    if (nSent >= nRoom)
+      break;
+  }
+  return true;
+}
+
 void PseudoTcp::attemptSend(SendFlags sflags) {
   uint32 now = Now();
 
@@ -1034,7 +1312,12 @@ void PseudoTcp::attemptSend(SendFlags sflags) {
     }
     uint32 nWindow = rtc::_min(m_snd_wnd, cwnd);
     uint32 nInFlight = m_snd_nxt - m_snd_una;
-    uint32 nUseable = (nInFlight < nWindow) ? (nWindow - nInFlight) : 0;
+    // SACKed bytes have left the network, so they count against the
+    // receiver's window but not against the congestion window.
+    uint32 nPipe = nInFlight - m_sacked_bytes;
+    uint32 nUseable = rtc::_min(
+        (nInFlight < m_snd_wnd) ? (m_snd_wnd - nInFlight) : 0,
+        (nPipe < cwnd) ? (cwnd - nPipe) : 0);
 
     size_t snd_buffered = 0;
     m_sbuf.GetBuffered(&snd_buffered);
@@ -1088,21 +1371,18 @@ void PseudoTcp::attemptSend(SendFlags sflags) {
     }
 
     // Find the next segment to transmit
-    SList::iterator it = m_slist.begin();
-    while (it->xmit > 0) {
-      ++it;
-      ASSERT(it != m_slist.end());
-    }
-    SList::iterator seg = it;
+    SList::size_type index = firstUnsentSegment();
+    ASSERT(index < m_slist.size());
+    SList::iterator seg = m_slist.begin() + index;
 
     // If the segment is too large, break it into two
     if (seg->len > nAvailable) {
       SSegment subseg(seg->seq + nAvailable, seg->len - nAvailable, seg->bCtrl);
       seg->len = nAvailable;
-      m_slist.insert(++it, subseg);
+      m_slist.insert(seg + 1, subseg);
     }
 
-    if (!transmit(seg, now)) {
+    if (!transmit(index, now)) {
       LOG_F(LS_VERBOSE) << "transmit failed";
       // TODO: consider closing socket
       return;
@@ -1152,6 +1432,11 @@ PseudoTcp::disableWindowScale() {
   m_support_wnd_scale = false;
 }
 
+bool
+PseudoTcp::isSackEnabled() const {
+  return m_sack_enabled;
+}
+
 void
 PseudoTcp::queueConnectMessage() {
   rtc::ByteBuffer buf(rtc::ByteBuffer::ORDER_NETWORK);
@@ -1162,6 +1447,10 @@ PseudoTcp::queueConnectMessage() {
     buf.WriteUInt8(1);
     buf.WriteUInt8(m_rwnd_scale);
   }
+  if (m_support_sack) {
+    buf.WriteUInt8(TCP_OPT_SACK_PERMITTED);
+    buf.WriteUInt8(0);
+  }
   m_snd_wnd = static_cast<uint32>(buf.Length());
   queue(buf.Data(), static_cast<uint32>(buf.Length()), true);
 }
@@ -1212,6 +1501,11 @@ PseudoTcp::parseOptions(const char* data, uint32 len) {
       m_swnd_scale = 0;
     }
   }
+
+  // Both ends have to offer SACK before either may send SACK blocks.
+  m_sack_enabled = m_support_sack &&
+      (options_specified.find(TCP_OPT_SACK_PERMITTED) !=
+       options_specified.end());
 }
 
 void
@@ -11,9 +11,11 @@
 #ifndef WEBRTC_P2P_BASE_PSEUDOTCP_H_
 #define WEBRTC_P2P_BASE_PSEUDOTCP_H_
 
-#include <list>
+#include <deque>
+#include <map>
 
 #include "webrtc/base/basictypes.h"
+#include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/stream.h"
 
 namespace cricket {
@@ -41,6 +43,60 @@ class IPseudoTcpNotify {
   virtual ~IPseudoTcpNotify() {}
 };
 
+//////////////////////////////////////////////////////////////////////
+// PseudoTcpCongestionControl
+//////////////////////////////////////////////////////////////////////
+
+// Decides how the congestion window grows and shrinks. PseudoTcp itself
+// still owns |m_cwnd| and |m_ssthresh| and runs fast retransmit/recovery;
+// the controller only supplies the window arithmetic. All sizes are in
+// bytes and all times are in milliseconds.
+class PseudoTcpCongestionControl {
+ public:
+  virtual ~PseudoTcpCongestionControl() {}
+
+  // Called for every ack that advances the send window outside of loss
+  // recovery. Returns the new congestion window.
+  virtual uint32 OnAck(uint32 cwnd, uint32 ssthresh, uint32 mss,
+                       uint32 acked, uint32 srtt, uint32 now) = 0;
+
+  // Called when a loss is detected, either by fast retransmit or by a
+  // retransmission timeout. Returns the new slow start threshold.
+  virtual uint32 OnLoss(uint32 cwnd, uint32 in_flight, uint32 mss,
+                        uint32 now) = 0;
+};
+
+// Classic Reno: slow start followed by additive increase, halving the
+// window on loss. This is the default.
+class RenoCongestionControl : public PseudoTcpCongestionControl {
+ public:
+  virtual uint32 OnAck(uint32 cwnd, uint32 ssthresh, uint32 mss,
+                       uint32 acked, uint32 srtt, uint32 now);
+  virtual uint32 OnLoss(uint32 cwnd, uint32 in_flight, uint32 mss,
+                        uint32 now);
+};
+
+// CUBIC (RFC 8312). After a loss the window grows as a cubic function of
+// the time since the loss, so it recovers quickly on paths with a large
+// bandwidth-delay product instead of growing by one segment per RTT.
+class CubicCongestionControl : public PseudoTcpCongestionControl {
+ public:
+  CubicCongestionControl();
+
+  virtual uint32 OnAck(uint32 cwnd, uint32 ssthresh, uint32 mss,
+                       uint32 acked, uint32 srtt, uint32 now);
+  virtual uint32 OnLoss(uint32 cwnd, uint32 in_flight, uint32 mss,
+                        uint32 now);
+
+ private:
+  // Window sizes below are in segments.
+  double w_max_;      // Window just before the last reduction.
+  double origin_;     // Plateau of the cubic curve for this epoch.
+  double k_;          // Seconds until the curve reaches |origin_|.
+  double w_est_;      // Reno-equivalent window, for TCP friendliness.
+  uint32 epoch_start_;  // Zero until the first ack after a reduction.
+};
+
 //////////////////////////////////////////////////////////////////////
 // PseudoTcp
 //////////////////////////////////////////////////////////////////////
@@ -89,10 +145,15 @@ class PseudoTcp {
     OPT_ACKDELAY,     // The Delayed ACK timeout (0 == off).
     OPT_RCVBUF,       // Set the receive buffer size, in bytes.
     OPT_SNDBUF,       // Set the send buffer size, in bytes.
+    OPT_SACK,         // Whether to offer selective acknowledgements (0 == off)
   };
   void GetOption(Option opt, int* value);
   void SetOption(Option opt, int value);
 
+  // Replaces the congestion controller, taking ownership of |cc|. The
+  // default is RenoCongestionControl.
+  void SetCongestionControl(PseudoTcpCongestionControl* cc);
+
   // Returns current congestion window in bytes.
   uint32 GetCongestionWindow() const;
 
@@ -121,18 +182,17 @@ class PseudoTcp {
 
   struct SSegment {
     SSegment(uint32 s, uint32 l, bool c)
-        : seq(s), len(l), /*tstamp(0),*/ xmit(0), bCtrl(c) {
+        : seq(s), len(l), /*tstamp(0),*/ xmit(0), bCtrl(c), bSacked(false) {
     }
     uint32 seq, len;
     //uint32 tstamp;
     uint8 xmit;
     bool bCtrl;
+    bool bSacked;  // The peer has reported this segment in a SACK block.
   };
-  typedef std::list<SSegment> SList;
-
-  struct RSegment {
-    uint32 seq, len;
-  };
+  // Segments are only ever transmitted in order, so the ones that have been
+  // sent at least once always form a prefix of the list.
+  typedef std::deque<SSegment> SList;
 
   uint32 queue(const char* data, uint32 len, bool bCtrl);
 
@@ -155,7 +215,20 @@ class PseudoTcp {
   bool clock_check(uint32 now, long& nTimeout);
 
   bool process(Segment& seg);
-  bool transmit(const SList::iterator& seg, uint32 now);
+  bool transmit(SList::size_type index, uint32 now);
+  // Returns the index of the first segment that hasn't been sent yet.
+  SList::size_type firstUnsentSegment() const;
+  // Returns the index of the first segment starting at or after |seq|.
+  SList::size_type findSegment(uint32 seq) const;
+
+  // Appends SACK blocks describing |m_rlist| to |buffer|, returning the
+  // number of bytes written.
+  uint32 writeSackBlocks(uint8* buffer) const;
+  // Marks the segments covered by the SACK blocks in |data|.
+  void applySackBlocks(const char* data, uint32 len);
+  // Retransmits the unacknowledged holes below the highest SACKed sequence
+  // number that haven't yet been retransmitted in this recovery episode.
+  bool retransmitHoles(uint32 now);
 
   void adjustMTU();
 
@@ -167,6 +240,10 @@ class PseudoTcp {
   // support for testing backward compatibility.
   void disableWindowScale();
 
+  // This method is only used in tests, to check whether both ends agreed
+  // to use selective acknowledgements.
+  bool isSackEnabled() const;
+
  private:
   // Queue the connect message with TCP options.
   void queueConnectMessage();
@@ -198,8 +275,10 @@ class PseudoTcp {
   uint32 m_lasttraffic;
 
   // Incoming data
-  typedef std::list<RSegment> RList;
+  // Out-of-order segments, as a map from sequence number to length.
+  typedef std::map<uint32, uint32> RList;
   RList m_rlist;
+  uint32 m_rlist_recent;  // Sequence number of the latest out-of-order data.
   uint32 m_rbuf_len, m_rcv_nxt, m_rcv_wnd, m_lastrecv;
   uint8 m_rwnd_scale;  // Window scale factor.
   rtc::FifoBuffer m_rbuf;
@@ -226,6 +305,14 @@ class PseudoTcp {
   uint8 m_dup_acks;
   uint32 m_recover;
   uint32 m_t_ack;
+  rtc::scoped_ptr<PseudoTcpCongestionControl> m_cc;
+
+  // Selective acknowledgements: whether the peer agreed to them, the number
+  // of in-flight bytes it has reported, the highest sequence number it has
+  // reported, and where the hole retransmission of the current recovery
+  // episode has got to.
+  bool m_sack_enabled;
+  uint32 m_sacked_bytes, m_sack_high, m_sack_rexmit;
 
   // Configuration options
   bool m_use_nagling;
@@ -234,6 +321,12 @@ class PseudoTcp {
   // This is used by unit tests to test backward compatibility of
   // PseudoTcp implementations that don't support window scaling.
   bool m_support_wnd_scale;
+
+  // Whether we offer selective acknowledgements to the peer.
+  bool m_support_sack;
+
+  // Scratch buffer that outgoing packets are assembled in.
+  rtc::scoped_ptr<uint8[]> m_packet_buf;
 };
 
 }  // namespace cricket
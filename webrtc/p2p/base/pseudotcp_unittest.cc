@@ -11,12 +11,16 @@
 #include <vector>
 
 #include "webrtc/p2p/base/pseudotcp.h"
+#include "webrtc/base/asyncudpsocket.h"
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/helpers.h"
 #include "webrtc/base/messagehandler.h"
+#include "webrtc/base/physicalsocketserver.h"
+#include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/stream.h"
 #include "webrtc/base/thread.h"
 #include "webrtc/base/timeutils.h"
+#include "webrtc/base/virtualsocketserver.h"
 
 using cricket::PseudoTcp;
 
@@ -37,6 +41,10 @@ class PseudoTcpForTest : public cricket::PseudoTcp {
   void disableWindowScale() {
     PseudoTcp::disableWindowScale();
   }
+
+  bool isSackEnabled() const {
+    return PseudoTcp::isSackEnabled();
+  }
 };
 
 class PseudoTcpTestBase : public testing::Test,
@@ -97,6 +105,12 @@ class PseudoTcpTestBase : public testing::Test,
   void DisableLocalWindowScale() {
     local_.disableWindowScale();
   }
+  void DisableRemoteSack() {
+    remote_.SetOption(PseudoTcp::OPT_SACK, 0);
+  }
+  void SetLocalCongestionControl(cricket::PseudoTcpCongestionControl* cc) {
+    local_.SetCongestionControl(cc);
+  }
 
  protected:
   int Connect() {
@@ -586,6 +600,169 @@ class PseudoTcpTestReceiveWindow : public PseudoTcpTestBase {
   std::vector<size_t> recv_position_;
 };
 
+// Runs a transfer between two PseudoTcps over UDP sockets on a
+// VirtualSocketServer, so that the latency and loss of the path can be
+// configured, and reports the resulting goodput.
+class PseudoTcpGoodputTest : public testing::Test,
+                             public rtc::MessageHandler,
+                             public cricket::IPseudoTcpNotify,
+                             public sigslot::has_slots<> {
+ public:
+  PseudoTcpGoodputTest()
+      : pss_(new rtc::PhysicalSocketServer),
+        ss_(new rtc::VirtualSocketServer(pss_.get())),
+        ss_scope_(ss_.get()),
+        local_(this, 1),
+        remote_(this, 1),
+        size_(0),
+        sent_(0),
+        received_(0),
+        corrupt_(false),
+        done_(false) {
+  }
+
+  virtual void SetUp() {
+    local_socket_.reset(rtc::AsyncUDPSocket::Create(
+        ss_.get(), rtc::SocketAddress("1.1.1.1", 0)));
+    remote_socket_.reset(rtc::AsyncUDPSocket::Create(
+        ss_.get(), rtc::SocketAddress("2.2.2.2", 0)));
+    ASSERT_TRUE(local_socket_.get() != NULL);
+    ASSERT_TRUE(remote_socket_.get() != NULL);
+    local_socket_->SignalReadPacket.connect(
+        this, &PseudoTcpGoodputTest::OnReadPacket);
+    remote_socket_->SignalReadPacket.connect(
+        this, &PseudoTcpGoodputTest::OnReadPacket);
+    local_.NotifyMTU(1500);
+    remote_.NotifyMTU(1500);
+  }
+
+  // Sends |size| bytes over a path with a one-way latency of |delay| ms
+  // that drops |loss| percent of packets, using |cc| on the sending side.
+  void TestGoodput(const char* name, cricket::PseudoTcpCongestionControl* cc,
+                   bool sack, int size, int delay, int loss) {
+    ss_->set_delay_mean(delay);
+    ss_->set_delay_stddev(0);
+    ss_->UpdateDelayDistribution();
+    ss_->set_drop_probability(loss / 100.0);
+
+    local_.SetCongestionControl(cc);
+    local_.SetOption(PseudoTcp::OPT_SACK, sack);
+    local_.SetOption(PseudoTcp::OPT_SNDBUF, 300000);
+    remote_.SetOption(PseudoTcp::OPT_RCVBUF, 200000);
+    size_ = size;
+
+    uint32 start = rtc::Time();
+    EXPECT_EQ(0, local_.Connect());
+    UpdateClock(&local_, MSG_LCLOCK);
+    EXPECT_TRUE_WAIT(done_, kGoodputTimeoutMs);
+    uint32 elapsed = rtc::_max<uint32>(1, rtc::TimeSince(start));
+    EXPECT_EQ(size, received_);
+    EXPECT_FALSE(corrupt_);
+    EXPECT_EQ(sack, local_.isSackEnabled());
+    LOG(LS_INFO) << name << (sack ? " with SACK" : "") << ", " << delay
+                 << " ms delay, " << loss << "% loss: " << received_
+                 << " bytes in " << elapsed << " ms ("
+                 << static_cast<int64>(received_) * 8 / elapsed << " Kbps)";
+  }
+
+ private:
+  static const int kGoodputTimeoutMs = 30000;
+  enum { MSG_LCLOCK, MSG_RCLOCK };
+
+  void OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data,
+                    size_t size, const rtc::SocketAddress& remote_addr,
+                    const rtc::PacketTime& packet_time) {
+    if (socket == local_socket_.get()) {
+      local_.NotifyPacket(data, size);
+      UpdateClock(&local_, MSG_LCLOCK);
+    } else {
+      remote_.NotifyPacket(data, size);
+      UpdateClock(&remote_, MSG_RCLOCK);
+    }
+  }
+
+  void UpdateClock(PseudoTcp* tcp, uint32 message) {
+    long interval = 0;  // NOLINT
+    tcp->GetNextClock(PseudoTcp::Now(), interval);
+    interval = rtc::_max<int>(interval, 0L);
+    rtc::Thread::Current()->Clear(this, message);
+    rtc::Thread::Current()->PostDelayed(interval, this, message);
+  }
+
+  virtual void OnMessage(rtc::Message* message) {
+    if (message->message_id == MSG_LCLOCK) {
+      local_.NotifyClock(PseudoTcp::Now());
+      UpdateClock(&local_, MSG_LCLOCK);
+    } else if (message->message_id == MSG_RCLOCK) {
+      remote_.NotifyClock(PseudoTcp::Now());
+      UpdateClock(&remote_, MSG_RCLOCK);
+    }
+  }
+
+  // IPseudoTcpNotify interface
+  virtual void OnTcpOpen(PseudoTcp* tcp) {
+    OnTcpWriteable(tcp);
+  }
+  virtual void OnTcpReadable(PseudoTcp* tcp) {
+    if (tcp != &remote_)
+      return;
+    char block[kBlockSize];
+    int rcvd;
+    while ((rcvd = remote_.Recv(block, sizeof(block))) > 0) {
+      for (int i = 0; i < rcvd; ++i) {
+        if (block[i] != static_cast<char>(received_ + i))
+          corrupt_ = true;
+      }
+      received_ += rcvd;
+    }
+    done_ = (received_ == size_);
+  }
+  virtual void OnTcpWriteable(PseudoTcp* tcp) {
+    if (tcp != &local_)
+      return;
+    char block[kBlockSize];
+    while (sent_ < size_) {
+      int tosend = rtc::_min<int>(size_ - sent_, sizeof(block));
+      for (int i = 0; i < tosend; ++i) {
+        block[i] = static_cast<char>(sent_ + i);
+      }
+      int sent = local_.Send(block, tosend);
+      if (sent <= 0)
+        break;
+      sent_ += sent;
+    }
+    UpdateClock(&local_, MSG_LCLOCK);
+  }
+  virtual void OnTcpClosed(PseudoTcp* tcp, uint32 error) {
+    EXPECT_EQ(0U, error);
+  }
+  virtual WriteResult TcpWritePacket(PseudoTcp* tcp,
+                                     const char* buffer, size_t len) {
+    rtc::PacketOptions options;
+    if (tcp == &local_) {
+      local_socket_->SendTo(buffer, len, remote_socket_->GetLocalAddress(),
+                            options);
+    } else {
+      remote_socket_->SendTo(buffer, len, local_socket_->GetLocalAddress(),
+                             options);
+    }
+    return WR_SUCCESS;
+  }
+
+  rtc::scoped_ptr<rtc::PhysicalSocketServer> pss_;
+  rtc::scoped_ptr<rtc::VirtualSocketServer> ss_;
+  rtc::SocketServerScope ss_scope_;
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> local_socket_;
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> remote_socket_;
+  PseudoTcpForTest local_;
+  PseudoTcpForTest remote_;
+  int size_;
+  int sent_;
+  int received_;
+  bool corrupt_;
+  bool done_;
+};
+
 // Basic end-to-end data transfer tests
 
 // Test the normal case of sending data from one side to the other.
@@ -699,6 +876,53 @@ TEST_F(PseudoTcpTest, TestSendLargeInFlight) {
   TestTransfer(1000000);
 }
 
+// Test sending data with a large window and packet loss, so that many
+// out-of-order segments are buffered on the receiving side.
+TEST_F(PseudoTcpTest, TestSendLargeInFlightWithLoss) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetLoss(5);
+  SetRemoteOptRcvBuf(100000);
+  SetLocalOptRcvBuf(100000);
+  SetOptSndBuf(150000);
+  TestTransfer(300000);
+}
+
+// Test that selective acknowledgements are negotiated by default.
+TEST_F(PseudoTcpTest, TestSendBothUseSack) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  TestTransfer(1000000);
+  EXPECT_TRUE(local_.isSackEnabled());
+  EXPECT_TRUE(remote_.isSackEnabled());
+}
+
+// Test that neither side uses SACK when the remote side doesn't offer it.
+TEST_F(PseudoTcpTest, TestSendRemoteNoSack) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  DisableRemoteSack();
+  SetDelay(50);
+  SetLoss(5);
+  TestTransfer(100000);
+  EXPECT_FALSE(local_.isSackEnabled());
+  EXPECT_FALSE(remote_.isSackEnabled());
+}
+
+// Test a lossy transfer with a large window using CUBIC instead of Reno.
+TEST_F(PseudoTcpTest, TestSendLargeInFlightWithLossCubic) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetLoss(5);
+  SetRemoteOptRcvBuf(100000);
+  SetLocalOptRcvBuf(100000);
+  SetOptSndBuf(150000);
+  SetLocalCongestionControl(new cricket::CubicCongestionControl());
+  TestTransfer(300000);
+}
+
 TEST_F(PseudoTcpTest, TestSendBothUseLargeWindowScale) {
   SetLocalMtu(1500);
   SetRemoteMtu(1500);
@@ -839,3 +1063,25 @@ TEST_F(PseudoTcpTest, TestSendWithMismatchedMtus) {
   TestTransfer(1000000);
 }
 */
+
+// Goodput benchmarks over a lossy long-haul path. These log the goodput of
+// each congestion controller with and without SACK.
+TEST_F(PseudoTcpGoodputTest, TestRenoWithLoss) {
+  TestGoodput("Reno", new cricket::RenoCongestionControl(), false,
+              500000, 50, 2);
+}
+
+TEST_F(PseudoTcpGoodputTest, TestRenoWithSackAndLoss) {
+  TestGoodput("Reno", new cricket::RenoCongestionControl(), true,
+              500000, 50, 2);
+}
+
+TEST_F(PseudoTcpGoodputTest, TestCubicWithLoss) {
+  TestGoodput("CUBIC", new cricket::CubicCongestionControl(), false,
+              500000, 50, 2);
+}
+
+TEST_F(PseudoTcpGoodputTest, TestCubicWithSackAndLoss) {
+  TestGoodput("CUBIC", new cricket::CubicCongestionControl(), true,
+              500000, 50, 2);
+}
@@ -189,7 +189,7 @@ void RelayServer::OnInternalPacket(
 
   // If this did not come from an existing connection, it should be a STUN
   // allocate request.
-  ConnectionMap::iterator piter = connections_.find(ap);
+  ConnectionMap::iterator piter = connections_.find(MakeConnectionKey(ap));
   if (piter == connections_.end()) {
     HandleStunAllocate(bytes, size, ap, socket);
     return;
@@ -233,7 +233,7 @@ void RelayServer::OnExternalPacket(
   ASSERT(!ap.destination().IsNil());
 
   // If this connection already exists, then forward the traffic.
-  ConnectionMap::iterator piter = connections_.find(ap);
+  ConnectionMap::iterator piter = connections_.find(MakeConnectionKey(ap));
   if (piter != connections_.end()) {
     // TODO: Check the HMAC.
     RelayServerConnection* ext_conn = piter->second;
@@ -506,13 +506,23 @@ void RelayServer::HandleStunSend(
   }
 }
 
+RelayServer::ConnectionKey RelayServer::MakeConnectionKey(
+    const rtc::SocketAddressPair& ap) {
+  ASSERT(!ap.source().IsUnresolvedIP());
+  ASSERT(!ap.destination().IsUnresolvedIP());
+  return ConnectionKey(rtc::SocketAddressKey(ap.source()),
+                       rtc::SocketAddressKey(ap.destination()));
+}
+
 void RelayServer::AddConnection(RelayServerConnection* conn) {
-  ASSERT(connections_.find(conn->addr_pair()) == connections_.end());
-  connections_[conn->addr_pair()] = conn;
+  ConnectionKey key = MakeConnectionKey(conn->addr_pair());
+  ASSERT(connections_.find(key) == connections_.end());
+  connections_[key] = conn;
 }
 
 void RelayServer::RemoveConnection(RelayServerConnection* conn) {
-  ConnectionMap::iterator iter = connections_.find(conn->addr_pair());
+  ConnectionMap::iterator iter =
+      connections_.find(MakeConnectionKey(conn->addr_pair()));
   ASSERT(iter != connections_.end());
   connections_.erase(iter);
 }
@@ -13,6 +13,7 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "webrtc/p2p/base/port.h"
@@ -72,8 +73,13 @@ class RelayServer : public rtc::MessageHandler,
   typedef std::map<rtc::AsyncSocket*,
                    cricket::ProtocolType> ServerSocketMap;
   typedef std::map<std::string, RelayServerBinding*> BindingMap;
-  typedef std::map<rtc::SocketAddressPair,
-                   RelayServerConnection*> ConnectionMap;
+  // Connections are keyed by their source and destination addresses, which
+  // come from sockets and STUN attributes, so they are always resolved.
+  typedef std::pair<rtc::SocketAddressKey, rtc::SocketAddressKey>
+      ConnectionKey;
+  typedef std::map<ConnectionKey, RelayServerConnection*> ConnectionMap;
+
+  static ConnectionKey MakeConnectionKey(const rtc::SocketAddressPair& ap);
 
   rtc::Thread* thread_;
   bool log_bindings_;
@@ -12,12 +12,15 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include "webrtc/base/byteorder.h"
 #include "webrtc/base/common.h"
 #include "webrtc/base/crc32.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/messagedigest.h"
 #include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/sha1digest.h"
 #include "webrtc/base/stringencode.h"
 
 using rtc::ByteBuffer;
@@ -40,6 +43,210 @@ const char TURN_MAGIC_COOKIE_VALUE[] = { '\x72', '\xC6', '\x4B', '\xC6' };
 const char EMPTY_TRANSACTION_ID[] = "0000000000000000";
 const uint32 STUN_FINGERPRINT_XOR_VALUE = 0x5354554E;
 
+// Block size of SHA-1, used for the HMAC padding.
+static const size_t kStunHmacBlockSize = 64;
+
+// StunHmacKey
+
+StunHmacKey::StunHmacKey() {
+  SetKey(NULL, 0);
+}
+
+StunHmacKey::StunHmacKey(const std::string& key) {
+  SetKey(key.c_str(), key.size());
+}
+
+StunHmacKey::StunHmacKey(const char* key, size_t keylen) {
+  SetKey(key, keylen);
+}
+
+void StunHmacKey::SetKey(const char* key, size_t keylen) {
+  uint8 block_key[kStunHmacBlockSize] = {0};
+  if (keylen > kStunHmacBlockSize) {
+    rtc::Sha1Digest digest;
+    digest.Update(key, keylen);
+    digest.Finish(block_key, sizeof(block_key));
+  } else if (keylen > 0) {
+    memcpy(block_key, key, keylen);
+  }
+
+  // Sha1Digest holds its state by value, so the states after the pads can be
+  // copied for every HMAC.
+  uint8 pad[kStunHmacBlockSize];
+  for (size_t i = 0; i < kStunHmacBlockSize; ++i)
+    pad[i] = 0x36 ^ block_key[i];
+  inner_ = rtc::Sha1Digest();
+  inner_.Update(pad, sizeof(pad));
+  for (size_t i = 0; i < kStunHmacBlockSize; ++i)
+    pad[i] = 0x5c ^ block_key[i];
+  outer_ = rtc::Sha1Digest();
+  outer_.Update(pad, sizeof(pad));
+}
+
+void StunHmacKey::Compute(const char* header, size_t header_len,
+                          const char* body, size_t body_len,
+                          char hmac[kStunMessageIntegritySize]) const {
+  rtc::Sha1Digest digest(inner_);
+  uint8 inner[rtc::Sha1Digest::kSize];
+  digest.Update(header, header_len);
+  digest.Update(body, body_len);
+  digest.Finish(inner, sizeof(inner));
+
+  digest = outer_;
+  digest.Update(inner, sizeof(inner));
+  digest.Finish(hmac, kStunMessageIntegritySize);
+}
+
+// StunMessageView
+
+StunMessageView::StunMessageView()
+    : data_(NULL), size_(0), type_(0), legacy_(false) {
+}
+
+bool StunMessageView::IsStunPacket(const char* data, size_t size) {
+  if (size < kStunHeaderSize)
+    return false;
+  // RTP and RTCP set the MSB of the first byte, STUN has the top two bits
+  // cleared.
+  if ((data[0] & 0xC0) != 0)
+    return false;
+  return rtc::GetBE16(data + 2) + kStunHeaderSize == size &&
+      rtc::GetBE32(data + kStunTransactionIdOffset - kStunMagicCookieLength) ==
+          kStunMagicCookie;
+}
+
+bool StunMessageView::Parse(const char* data, size_t size) {
+  data_ = NULL;
+  size_ = 0;
+  if (size < kStunHeaderSize)
+    return false;
+
+  uint16 type = rtc::GetBE16(data);
+  if (type & 0x8000) {
+    // RTP and RTCP set the MSB of first byte, since first two bits are version,
+    // and version is always 2 (10). If set, this is not a STUN packet.
+    return false;
+  }
+  if (rtc::GetBE16(data + 2) + kStunHeaderSize != size)
+    return false;
+
+  data_ = data;
+  size_ = size;
+  type_ = type;
+  // If the magic cookie is invalid the peer implements RFC3489 rather than
+  // RFC5389.
+  legacy_ = rtc::GetBE32(data + kStunTransactionIdOffset -
+                         kStunMagicCookieLength) != kStunMagicCookie;
+  return true;
+}
+
+const char* StunMessageView::transaction_id() const {
+  return data_ + kStunHeaderSize - transaction_id_length();
+}
+
+size_t StunMessageView::transaction_id_length() const {
+  return legacy_ ? kStunLegacyTransactionIdLength : kStunTransactionIdLength;
+}
+
+bool StunMessageView::NextAttribute(size_t* offset, int* type,
+                                    const char** value, size_t* length) const {
+  size_t pos = (*offset == 0) ? kStunHeaderSize : *offset;
+  if (pos >= size_) {
+    *offset = size_;
+    return false;
+  }
+  if (pos + kStunAttributeHeaderSize > size_)
+    return false;
+
+  size_t attr_length = rtc::GetBE16(data_ + pos + 2);
+  size_t next = pos + kStunAttributeHeaderSize + attr_length;
+  if (next > size_)
+    return false;
+
+  *type = rtc::GetBE16(data_ + pos);
+  *value = data_ + pos + kStunAttributeHeaderSize;
+  *length = attr_length;
+  // The padding of the last attribute may be missing.
+  next += (4 - (attr_length % 4)) % 4;
+  *offset = std::min(next, size_);
+  return true;
+}
+
+bool StunMessageView::GetAttribute(int type, const char** value,
+                                   size_t* length) const {
+  size_t offset = 0;
+  int attr_type;
+  while (NextAttribute(&offset, &attr_type, value, length)) {
+    if (attr_type == type)
+      return true;
+  }
+  return false;
+}
+
+bool StunMessageView::GetUInt32(int type, uint32* value) const {
+  const char* bytes;
+  size_t length;
+  if (!GetAttribute(type, &bytes, &length) || length != sizeof(*value))
+    return false;
+  *value = rtc::GetBE32(bytes);
+  return true;
+}
+
+bool StunMessageView::GetUInt64(int type, uint64* value) const {
+  const char* bytes;
+  size_t length;
+  if (!GetAttribute(type, &bytes, &length) || length != sizeof(*value))
+    return false;
+  *value = rtc::GetBE64(bytes);
+  return true;
+}
+
+bool StunMessageView::ValidateMessageIntegrity(
+    const std::string& password) const {
+  return ValidateMessageIntegrity(password.c_str(), password.size());
+}
+
+// Verifies a STUN message has a valid MESSAGE-INTEGRITY attribute, using the
+// procedure outlined in RFC 5389, section 15.4.
+bool StunMessageView::ValidateMessageIntegrity(const char* key,
+                                               size_t keylen) const {
+  return ValidateMessageIntegrity(StunHmacKey(key, keylen));
+}
+
+bool StunMessageView::ValidateMessageIntegrity(const StunHmacKey& key) const {
+  // Verifying the size of the message.
+  if (!data_ || (size_ % 4) != 0)
+    return false;
+
+  const char* mi;
+  size_t mi_length;
+  if (!GetAttribute(STUN_ATTR_MESSAGE_INTEGRITY, &mi, &mi_length) ||
+      mi_length != kStunMessageIntegritySize) {
+    return false;
+  }
+
+  // The HMAC covers everything up to the M-I attribute, with the header's
+  // length field set as if M-I were the last attribute. Only the header is
+  // copied to patch that length.
+  size_t mi_pos = mi - kStunAttributeHeaderSize - data_;
+  char header[kStunHeaderSize];
+  memcpy(header, data_, kStunHeaderSize);
+  rtc::SetBE16(header + 2, static_cast<uint16>(
+      mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize -
+      kStunHeaderSize));
+
+  char hmac[kStunMessageIntegritySize];
+  key.Compute(header, kStunHeaderSize,
+              data_ + kStunHeaderSize, mi_pos - kStunHeaderSize, hmac);
+
+  // Comparing the calculated HMAC with the one present in the message.
+  return memcmp(mi, hmac, sizeof(hmac)) == 0;
+}
+
+bool StunMessageView::ValidateFingerprint() const {
+  return data_ && StunMessage::ValidateFingerprint(data_, size_);
+}
+
 // StunMessage
 
 StunMessage::StunMessage()
@@ -125,85 +332,16 @@ const StunUInt16ListAttribute* StunMessage::GetUnknownAttributes() const {
       GetAttribute(STUN_ATTR_UNKNOWN_ATTRIBUTES));
 }
 
-// Verifies a STUN message has a valid MESSAGE-INTEGRITY attribute, using the
-// procedure outlined in RFC 5389, section 15.4.
 bool StunMessage::ValidateMessageIntegrity(const char* data, size_t size,
                                            const std::string& password) {
-  // Verifying the size of the message.
-  if ((size % 4) != 0) {
-    return false;
-  }
-
-  // Getting the message length from the STUN header.
-  uint16 msg_length = rtc::GetBE16(&data[2]);
-  if (size != (msg_length + kStunHeaderSize)) {
-    return false;
-  }
-
-  // Finding Message Integrity attribute in stun message.
-  size_t current_pos = kStunHeaderSize;
-  bool has_message_integrity_attr = false;
-  while (current_pos < size) {
-    uint16 attr_type, attr_length;
-    // Getting attribute type and length.
-    attr_type = rtc::GetBE16(&data[current_pos]);
-    attr_length = rtc::GetBE16(&data[current_pos + sizeof(attr_type)]);
-
-    // If M-I, sanity check it, and break out.
-    if (attr_type == STUN_ATTR_MESSAGE_INTEGRITY) {
-      if (attr_length != kStunMessageIntegritySize ||
-          current_pos + attr_length > size) {
-        return false;
-      }
-      has_message_integrity_attr = true;
-      break;
-    }
-
-    // Otherwise, skip to the next attribute.
-    current_pos += sizeof(attr_type) + sizeof(attr_length) + attr_length;
-    if ((attr_length % 4) != 0) {
-      current_pos += (4 - (attr_length % 4));
-    }
-  }
-
-  if (!has_message_integrity_attr) {
-    return false;
-  }
-
-  // Getting length of the message to calculate Message Integrity.
-  size_t mi_pos = current_pos;
-  rtc::scoped_ptr<char[]> temp_data(new char[current_pos]);
-  memcpy(temp_data.get(), data, current_pos);
-  if (size > mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize) {
-    // Stun message has other attributes after message integrity.
-    // Adjust the length parameter in stun message to calculate HMAC.
-    size_t extra_offset = size -
-        (mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize);
-    size_t new_adjusted_len = size - extra_offset - kStunHeaderSize;
-
-    // Writing new length of the STUN message @ Message Length in temp buffer.
-    //      0                   1                   2                   3
-    //      0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-    //     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-    //     |0 0|     STUN Message Type     |         Message Length        |
-    //     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-    rtc::SetBE16(temp_data.get() + 2,
-                       static_cast<uint16>(new_adjusted_len));
-  }
-
-  char hmac[kStunMessageIntegritySize];
-  size_t ret = rtc::ComputeHmac(rtc::DIGEST_SHA_1,
-                                      password.c_str(), password.size(),
-                                      temp_data.get(), mi_pos,
-                                      hmac, sizeof(hmac));
-  ASSERT(ret == sizeof(hmac));
-  if (ret != sizeof(hmac))
-    return false;
+  StunMessageView view;
+  return view.Parse(data, size) && view.ValidateMessageIntegrity(password);
+}
 
-  // Comparing the calculated HMAC with the one present in the message.
-  return memcmp(data + current_pos + kStunAttributeHeaderSize,
-                hmac,
-                sizeof(hmac)) == 0;
+bool StunMessage::ValidateMessageIntegrity(const char* data, size_t size,
+                                           const StunHmacKey& key) {
+  StunMessageView view;
+  return view.Parse(data, size) && view.ValidateMessageIntegrity(key);
 }
 
 bool StunMessage::AddMessageIntegrity(const std::string& password) {
@@ -212,6 +350,10 @@ bool StunMessage::AddMessageIntegrity(const std::string& password) {
 
 bool StunMessage::AddMessageIntegrity(const char* key,
                                       size_t keylen) {
+  return AddMessageIntegrity(StunHmacKey(key, keylen));
+}
+
+bool StunMessage::AddMessageIntegrity(const StunHmacKey& key) {
   // Add the attribute with a dummy value. Since this is a known attribute, it
   // can't fail.
   StunByteStringAttribute* msg_integrity_attr =
@@ -224,19 +366,11 @@ bool StunMessage::AddMessageIntegrity(const char* key,
   if (!Write(&buf))
     return false;
 
-  int msg_len_for_hmac = static_cast<int>(
-      buf.Length() - kStunAttributeHeaderSize - msg_integrity_attr->length());
+  size_t msg_len_for_hmac =
+      buf.Length() - kStunAttributeHeaderSize - msg_integrity_attr->length();
   char hmac[kStunMessageIntegritySize];
-  size_t ret = rtc::ComputeHmac(rtc::DIGEST_SHA_1,
-                                      key, keylen,
-                                      buf.Data(), msg_len_for_hmac,
-                                      hmac, sizeof(hmac));
-  ASSERT(ret == sizeof(hmac));
-  if (ret != sizeof(hmac)) {
-    LOG(LS_ERROR) << "HMAC computation failed. Message-Integrity "
-                  << "has dummy value.";
-    return false;
-  }
+  key.Compute(buf.Data(), kStunHeaderSize, buf.Data() + kStunHeaderSize,
+              msg_len_for_hmac - kStunHeaderSize, hmac);
 
   // Insert correct HMAC into the attribute.
   msg_integrity_attr->CopyBytes(hmac, sizeof(hmac));
@@ -295,66 +429,46 @@ bool StunMessage::AddFingerprint() {
 }
 
 bool StunMessage::Read(ByteBuffer* buf) {
-  if (!buf->ReadUInt16(&type_))
-    return false;
-
-  if (type_ & 0x8000) {
-    // RTP and RTCP set the MSB of first byte, since first two bits are version,
-    // and version is always 2 (10). If set, this is not a STUN packet.
-    return false;
-  }
-
-  if (!buf->ReadUInt16(&length_))
+  // The view checks the header and the attribute framing; the attribute
+  // classes below only decode the values.
+  StunMessageView view;
+  const size_t size = buf->Length();
+  if (!view.Parse(buf->Data(), size))
     return false;
 
-  std::string magic_cookie;
-  if (!buf->ReadString(&magic_cookie, kStunMagicCookieLength))
-    return false;
-
-  std::string transaction_id;
-  if (!buf->ReadString(&transaction_id, kStunTransactionIdLength))
-    return false;
-
-  uint32 magic_cookie_int =
-      *reinterpret_cast<const uint32*>(magic_cookie.data());
-  if (rtc::NetworkToHost32(magic_cookie_int) != kStunMagicCookie) {
-    // If magic cookie is invalid it means that the peer implements
-    // RFC3489 instead of RFC5389.
-    transaction_id.insert(0, magic_cookie);
-  }
-  ASSERT(IsValidTransactionId(transaction_id));
-  transaction_id_ = transaction_id;
-
-  if (length_ != buf->Length())
-    return false;
+  type_ = static_cast<uint16>(view.type());
+  length_ = static_cast<uint16>(view.length());
+  transaction_id_.assign(view.transaction_id(), view.transaction_id_length());
+  ASSERT(IsValidTransactionId(transaction_id_));
+  buf->Consume(kStunHeaderSize);
 
   attrs_->resize(0);
 
-  size_t rest = buf->Length() - length_;
-  while (buf->Length() > rest) {
-    uint16 attr_type, attr_length;
-    if (!buf->ReadUInt16(&attr_type))
-      return false;
-    if (!buf->ReadUInt16(&attr_length))
-      return false;
-
+  size_t offset = 0;
+  int attr_type;
+  const char* attr_value;
+  size_t attr_length;
+  while (view.NextAttribute(&offset, &attr_type, &attr_value, &attr_length)) {
+    buf->Consume(kStunAttributeHeaderSize);
+    // Unknown or malformed attributes are skipped.
     StunAttribute* attr = CreateAttribute(attr_type, attr_length);
-    if (!attr) {
-      // Skip any unknown or malformed attributes.
-      if ((attr_length % 4) != 0) {
-        attr_length += (4 - (attr_length % 4));
-      }
-      if (!buf->Consume(attr_length))
-        return false;
-    } else {
-      if (!attr->Read(buf))
+    if (attr) {
+      if (!attr->Read(buf)) {
+        delete attr;
         return false;
+      }
       attrs_->push_back(attr);
     }
+    // Move to the next attribute, skipping whatever wasn't consumed above,
+    // including the padding.
+    size_t rest = size - offset;
+    if (buf->Length() < rest)
+      return false;
+    buf->Consume(buf->Length() - rest);
   }
 
-  ASSERT(buf->Length() == rest);
-  return true;
+  // A truncated attribute stops the walk before the end of the message.
+  return offset == size;
 }
 
 bool StunMessage::Write(ByteBuffer* buf) const {
@@ -19,6 +19,7 @@
 
 #include "webrtc/base/basictypes.h"
 #include "webrtc/base/bytebuffer.h"
+#include "webrtc/base/sha1digest.h"
 #include "webrtc/base/socketaddress.h"
 
 namespace cricket {
@@ -115,6 +116,28 @@ const size_t kStunLegacyTransactionIdLength = 16;
 // STUN Message Integrity HMAC length.
 const size_t kStunMessageIntegritySize = 20;
 
+// The key of the MESSAGE-INTEGRITY HMAC-SHA1, with the SHA-1 states after
+// hashing the inner and outer key pads computed up front. Computing an HMAC
+// then only hashes the message, without allocating. Meant to be kept next to
+// the password or long-term key it is made from, and reused for every message.
+class StunHmacKey {
+ public:
+  StunHmacKey();
+  explicit StunHmacKey(const std::string& key);
+  StunHmacKey(const char* key, size_t keylen);
+
+  void SetKey(const char* key, size_t keylen);
+
+  // Computes the HMAC of |header| followed by |body| into |hmac|.
+  void Compute(const char* header, size_t header_len,
+               const char* body, size_t body_len,
+               char hmac[kStunMessageIntegritySize]) const;
+
+ private:
+  rtc::Sha1Digest inner_;
+  rtc::Sha1Digest outer_;
+};
+
 class StunAttribute;
 class StunAddressAttribute;
 class StunXorAddressAttribute;
@@ -124,6 +147,65 @@ class StunByteStringAttribute;
 class StunErrorCodeAttribute;
 class StunUInt16ListAttribute;
 
+// A read-only view of a STUN message that lives in a caller-owned buffer.
+// Parse() only checks the fixed header; attributes are located on demand by
+// walking the packet, and their values point into the buffer. Nothing is
+// copied or allocated, which makes this suitable for the per-packet checks on
+// the ICE path. The buffer must outlive the view.
+class StunMessageView {
+ public:
+  StunMessageView();
+
+  // Cheap classifier that only looks at the header: returns true if |data|
+  // starts with an RFC 5389 STUN header (magic cookie present) whose length
+  // field matches |size|.
+  static bool IsStunPacket(const char* data, size_t size);
+
+  // Points the view at |data|. Returns false if the buffer is too short, is
+  // RTP/RTCP, or the header length doesn't match |size|. RFC 3489 messages,
+  // which lack the magic cookie, are accepted.
+  bool Parse(const char* data, size_t size);
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  int type() const { return type_; }
+  size_t length() const { return size_ - kStunHeaderSize; }
+  bool IsLegacy() const { return legacy_; }
+
+  // The transaction ID as it appears on the wire. For RFC 3489 messages this
+  // includes the four bytes where the magic cookie would be.
+  const char* transaction_id() const;
+  size_t transaction_id_length() const;
+
+  // Steps through the attributes in the order they appear. |*offset| must be
+  // 0 for the first call. Returns false at the end of the message, in which
+  // case |*offset| equals size(), or when the next attribute doesn't fit in
+  // the message, in which case |*offset| is left unchanged.
+  bool NextAttribute(size_t* offset, int* type,
+                     const char** value, size_t* length) const;
+
+  // Finds the first attribute of |type|. The value is not copied.
+  bool GetAttribute(int type, const char** value, size_t* length) const;
+  bool GetUInt32(int type, uint32* value) const;
+  bool GetUInt64(int type, uint64* value) const;
+
+  // Validates MESSAGE-INTEGRITY as described in RFC 5389, section 15.4,
+  // hashing the packet where it is rather than a patched copy of it.
+  bool ValidateMessageIntegrity(const std::string& password) const;
+  bool ValidateMessageIntegrity(const char* key, size_t keylen) const;
+  bool ValidateMessageIntegrity(const StunHmacKey& key) const;
+
+  // Returns true if the message has the magic cookie and ends in a valid
+  // FINGERPRINT attribute (RFC 5389, section 15.5).
+  bool ValidateFingerprint() const;
+
+ private:
+  const char* data_;
+  size_t size_;
+  uint16 type_;
+  bool legacy_;
+};
+
 // Records a complete STUN/TURN message.  Each message consists of a type and
 // any number of attributes.  Each attribute is parsed into an instance of an
 // appropriate class (see above).  The Get* methods will return instances of
@@ -164,12 +246,16 @@ class StunMessage {
 
   // Validates that a raw STUN message has a correct MESSAGE-INTEGRITY value.
   // This can't currently be done on a StunMessage, since it is affected by
-  // padding data (which we discard when reading a StunMessage).
+  // padding data (which we discard when reading a StunMessage). See
+  // StunMessageView for doing this without parsing the message first.
   static bool ValidateMessageIntegrity(const char* data, size_t size,
                                        const std::string& password);
+  static bool ValidateMessageIntegrity(const char* data, size_t size,
+                                       const StunHmacKey& key);
   // Adds a MESSAGE-INTEGRITY attribute that is valid for the current message.
   bool AddMessageIntegrity(const std::string& password);
   bool AddMessageIntegrity(const char* key, size_t keylen);
+  bool AddMessageIntegrity(const StunHmacKey& key);
 
   // Verifies that a given buffer is STUN by checking for a correct FINGERPRINT.
   static bool ValidateFingerprint(const char* data, size_t size);
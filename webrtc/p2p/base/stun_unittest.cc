@@ -17,6 +17,7 @@
 #include "webrtc/base/messagedigest.h"
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/socketaddress.h"
+#include "webrtc/base/timeutils.h"
 
 namespace cricket {
 
@@ -1088,6 +1089,138 @@ TEST_F(StunTest, FailToReadRtcpPacket) {
   CheckFailureToRead(kRtcpPacket, sizeof(kRtcpPacket));
 }
 
+// Read the RFC5769 sample request through a StunMessageView.
+TEST_F(StunTest, ReadRfc5769RequestMessageView) {
+  const char* data = reinterpret_cast<const char*>(kRfc5769SampleRequest);
+  size_t size = sizeof(kRfc5769SampleRequest);
+  EXPECT_TRUE(StunMessageView::IsStunPacket(data, size));
+
+  StunMessageView view;
+  ASSERT_TRUE(view.Parse(data, size));
+  EXPECT_EQ(STUN_BINDING_REQUEST, view.type());
+  EXPECT_EQ(size - kStunHeaderSize, view.length());
+  EXPECT_FALSE(view.IsLegacy());
+  ASSERT_EQ(kStunTransactionIdLength, view.transaction_id_length());
+  EXPECT_EQ(0, memcmp(view.transaction_id(), kRfc5769SampleMsgTransactionId,
+                      kStunTransactionIdLength));
+
+  const char* value;
+  size_t length;
+  ASSERT_TRUE(view.GetAttribute(STUN_ATTR_SOFTWARE, &value, &length));
+  EXPECT_EQ(kRfc5769SampleMsgClientSoftware, std::string(value, length));
+  ASSERT_TRUE(view.GetAttribute(STUN_ATTR_USERNAME, &value, &length));
+  EXPECT_EQ(kRfc5769SampleMsgUsername, std::string(value, length));
+  EXPECT_FALSE(view.GetAttribute(STUN_ATTR_ERROR_CODE, &value, &length));
+
+  uint32 fingerprint;
+  ASSERT_TRUE(view.GetUInt32(STUN_ATTR_FINGERPRINT, &fingerprint));
+  EXPECT_EQ(0xe57a3bcf, fingerprint);
+  // USERNAME is not a 32-bit value.
+  EXPECT_FALSE(view.GetUInt32(STUN_ATTR_USERNAME, &fingerprint));
+
+  EXPECT_TRUE(view.ValidateFingerprint());
+  EXPECT_TRUE(view.ValidateMessageIntegrity(kRfc5769SampleMsgPassword));
+  EXPECT_FALSE(view.ValidateMessageIntegrity("InvalidPassword"));
+
+  // Walk all attributes; the FINGERPRINT comes last.
+  size_t offset = 0;
+  int type = 0;
+  int count = 0;
+  while (view.NextAttribute(&offset, &type, &value, &length))
+    ++count;
+  EXPECT_EQ(size, offset);
+  EXPECT_EQ(STUN_ATTR_FINGERPRINT, type);
+  EXPECT_EQ(6, count);
+}
+
+// Test that the view rejects what StunMessage::Read rejects, and accepts
+// RFC3489 messages.
+TEST_F(StunTest, StunMessageViewFramingChecks) {
+  StunMessageView view;
+  EXPECT_FALSE(view.Parse(reinterpret_cast<const char*>(kRtcpPacket),
+                          sizeof(kRtcpPacket)));
+  EXPECT_FALSE(StunMessageView::IsStunPacket(
+      reinterpret_cast<const char*>(kRtcpPacket), sizeof(kRtcpPacket)));
+  EXPECT_FALSE(view.Parse(
+      reinterpret_cast<const char*>(kStunMessageWithZeroLength),
+      kRealLengthOfInvalidLengthTestCases));
+  EXPECT_FALSE(view.Parse(
+      reinterpret_cast<const char*>(kStunMessageWithExcessLength),
+      kRealLengthOfInvalidLengthTestCases));
+  EXPECT_FALSE(view.Parse(
+      reinterpret_cast<const char*>(kStunMessageWithSmallLength),
+      kRealLengthOfInvalidLengthTestCases));
+  EXPECT_FALSE(view.Parse(
+      reinterpret_cast<const char*>(kRfc5769SampleRequest), 12));
+  EXPECT_FALSE(view.ValidateFingerprint());
+
+  unsigned char rfc3489_packet[sizeof(kStunMessageWithIPv4MappedAddress)];
+  memcpy(rfc3489_packet, kStunMessageWithIPv4MappedAddress,
+      sizeof(kStunMessageWithIPv4MappedAddress));
+  memcpy(&rfc3489_packet[4], "ABCD", 4);
+  const char* legacy = reinterpret_cast<const char*>(rfc3489_packet);
+  EXPECT_FALSE(StunMessageView::IsStunPacket(legacy, sizeof(rfc3489_packet)));
+  ASSERT_TRUE(view.Parse(legacy, sizeof(rfc3489_packet)));
+  EXPECT_TRUE(view.IsLegacy());
+  EXPECT_EQ(kStunLegacyTransactionIdLength, view.transaction_id_length());
+  EXPECT_EQ(legacy + 4, view.transaction_id());
+
+  // An attribute that runs past the end of the message stops the walk, and
+  // makes StunMessage::Read fail.
+  unsigned char truncated[sizeof(kStunMessageWithUnknownAttribute)];
+  memcpy(truncated, kStunMessageWithUnknownAttribute, sizeof(truncated));
+  truncated[35] = 0x08;  // USERNAME length 3 -> 8.
+  ASSERT_TRUE(view.Parse(reinterpret_cast<const char*>(truncated),
+                         sizeof(truncated)));
+  const char* value;
+  size_t length;
+  EXPECT_FALSE(view.GetAttribute(STUN_ATTR_USERNAME, &value, &length));
+  StunMessage msg;
+  EXPECT_EQ(0U, ReadStunMessageTestCase(&msg, truncated, sizeof(truncated)));
+}
+
+// Compares the cost of the checks done for an incoming ICE connectivity check
+// using StunMessage, which builds the attribute list, and StunMessageView.
+TEST_F(StunTest, StunMessageViewPerformance) {
+  const char* data = reinterpret_cast<const char*>(kRfc5769SampleRequest);
+  size_t size = sizeof(kRfc5769SampleRequest);
+  const int kIterations = 20000;
+
+  uint64 start = rtc::TimeMicros();
+  int message_ok = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    IceMessage msg;
+    rtc::ByteBuffer buf(data, size);
+    if (StunMessage::ValidateFingerprint(data, size) && msg.Read(&buf) &&
+        msg.GetByteString(STUN_ATTR_USERNAME) &&
+        StunMessage::ValidateMessageIntegrity(data, size,
+                                              kRfc5769SampleMsgPassword)) {
+      ++message_ok;
+    }
+  }
+  uint64 message_us = rtc::TimeMicros() - start;
+
+  start = rtc::TimeMicros();
+  int view_ok = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    StunMessageView view;
+    const char* username;
+    size_t length;
+    if (view.Parse(data, size) && view.ValidateFingerprint() &&
+        view.GetAttribute(STUN_ATTR_USERNAME, &username, &length) &&
+        view.ValidateMessageIntegrity(kRfc5769SampleMsgPassword)) {
+      ++view_ok;
+    }
+  }
+  uint64 view_us = rtc::TimeMicros() - start;
+
+  EXPECT_EQ(kIterations, message_ok);
+  EXPECT_EQ(kIterations, view_ok);
+  LOG(LS_INFO) << "Binding request checks, " << kIterations << " iterations: "
+               << "StunMessage " << message_us << " us, "
+               << "StunMessageView " << view_us << " us";
+}
+
 // Check our STUN message validation code against the RFC5769 test messages.
 TEST_F(StunTest, ValidateMessageIntegrity) {
   // Try the messages from RFC 5769.
@@ -1198,6 +1331,90 @@ TEST_F(StunTest, AddMessageIntegrity) {
         kRfc5769SampleMsgPassword));
 }
 
+// A StunHmacKey can be reused for several messages, and gives the same HMACs
+// as the generic implementation, also for keys longer than a SHA-1 block.
+TEST_F(StunTest, StunHmacKey) {
+  StunHmacKey key(kRfc5769SampleMsgPassword);
+  EXPECT_TRUE(StunMessage::ValidateMessageIntegrity(
+      reinterpret_cast<const char*>(kRfc5769SampleRequest),
+      sizeof(kRfc5769SampleRequest), key));
+  EXPECT_TRUE(StunMessage::ValidateMessageIntegrity(
+      reinterpret_cast<const char*>(kRfc5769SampleResponse),
+      sizeof(kRfc5769SampleResponse), key));
+  EXPECT_FALSE(StunMessage::ValidateMessageIntegrity(
+      reinterpret_cast<const char*>(kRfc5769SampleResponse),
+      sizeof(kRfc5769SampleResponse), StunHmacKey("InvalidPassword")));
+
+  IceMessage msg;
+  rtc::ByteBuffer buf(
+      reinterpret_cast<const char*>(kRfc5769SampleRequestWithoutMI),
+      sizeof(kRfc5769SampleRequestWithoutMI));
+  EXPECT_TRUE(msg.Read(&buf));
+  EXPECT_TRUE(msg.AddMessageIntegrity(key));
+  EXPECT_EQ(0, memcmp(msg.GetByteString(STUN_ATTR_MESSAGE_INTEGRITY)->bytes(),
+                      kCalculatedHmac1, sizeof(kCalculatedHmac1)));
+
+  const std::string kInput = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmn";
+  const std::string keys[] = {"", "key", std::string(64, 'k'),
+                              std::string(100, 'k')};
+  for (size_t i = 0; i < ARRAY_SIZE(keys); ++i) {
+    char expected[kStunMessageIntegritySize];
+    EXPECT_EQ(sizeof(expected), rtc::ComputeHmac(
+        rtc::DIGEST_SHA_1, keys[i].data(), keys[i].size(),
+        kInput.data(), kInput.size(), expected, sizeof(expected)));
+    char hmac[kStunMessageIntegritySize];
+    StunHmacKey(keys[i]).Compute(kInput.data(), 10, kInput.data() + 10,
+                                 kInput.size() - 10, hmac);
+    EXPECT_EQ(0, memcmp(expected, hmac, sizeof(hmac))) << i;
+  }
+}
+
+// Measures the MESSAGE-INTEGRITY and FINGERPRINT work done for each
+// connectivity check: the HMAC with the password given per call, with a
+// prepared StunHmacKey, and the CRC32.
+TEST_F(StunTest, StunCryptoPerformance) {
+  const char* data = reinterpret_cast<const char*>(kRfc5769SampleRequest);
+  size_t size = sizeof(kRfc5769SampleRequest);
+  const int kIterations = 20000;
+
+  uint64 start = rtc::TimeMicros();
+  int password_ok = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    if (StunMessage::ValidateMessageIntegrity(data, size,
+                                              kRfc5769SampleMsgPassword)) {
+      ++password_ok;
+    }
+  }
+  uint64 password_us = rtc::TimeMicros() - start;
+
+  StunHmacKey key(kRfc5769SampleMsgPassword);
+  start = rtc::TimeMicros();
+  int key_ok = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    if (StunMessage::ValidateMessageIntegrity(data, size, key)) {
+      ++key_ok;
+    }
+  }
+  uint64 key_us = rtc::TimeMicros() - start;
+
+  start = rtc::TimeMicros();
+  int fingerprint_ok = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    if (StunMessage::ValidateFingerprint(data, size)) {
+      ++fingerprint_ok;
+    }
+  }
+  uint64 fingerprint_us = rtc::TimeMicros() - start;
+
+  EXPECT_EQ(kIterations, password_ok);
+  EXPECT_EQ(kIterations, key_ok);
+  EXPECT_EQ(kIterations, fingerprint_ok);
+  LOG(LS_INFO) << "STUN crypto, " << kIterations << " iterations: "
+               << "M-I with password " << password_us << " us, "
+               << "M-I with StunHmacKey " << key_us << " us, "
+               << "FINGERPRINT " << fingerprint_us << " us";
+}
+
 // Check our STUN message validation code against the RFC5769 test messages.
 TEST_F(StunTest, ValidateFingerprint) {
   EXPECT_TRUE(StunMessage::ValidateFingerprint(
@@ -11,15 +11,18 @@
 #include "webrtc/base/fakesslidentity.h"
 #include "webrtc/base/gunit.h"
 #include "webrtc/base/network.h"
+#include "webrtc/base/packetbuffer.h"
 #include "webrtc/base/thread.h"
 #include "webrtc/p2p/base/fakesession.h"
 #include "webrtc/p2p/base/p2ptransport.h"
+#include "webrtc/p2p/base/transportchannelproxy.h"
 
 using cricket::Candidate;
 using cricket::Candidates;
 using cricket::Transport;
 using cricket::FakeTransport;
 using cricket::TransportChannel;
+using cricket::TransportChannelProxy;
 using cricket::FakeTransportChannel;
 using cricket::IceRole;
 using cricket::TransportDescription;
@@ -31,6 +34,33 @@ static const char kIcePwd1[] = "TESTICEPWD00000000000001";
 static const char kIceUfrag2[] = "TESTICEUFRAG0002";
 static const char kIcePwd2[] = "TESTICEPWD00000000000002";
 
+static const char kPacket[] = "a packet to unprotect in place";
+
+// Receives packets like a media channel that unprotects them: a packet it is
+// allowed to modify in place gets overwritten.
+class InPlaceReceiver : public sigslot::has_slots<> {
+ public:
+  InPlaceReceiver() : in_place_(false) {}
+
+  void OnReadPacket(TransportChannel* channel, const char* data, size_t size,
+                    const rtc::PacketTime& packet_time, int flags) {
+    received_.assign(data, size);
+    rtc::PacketBuffer* packet =
+        rtc::PacketBuffer::SignaledWithData(data, size);
+    in_place_ = (packet != NULL);
+    if (packet) {
+      memset(packet->buffer()->data(), 0, size);
+    }
+  }
+
+  const std::string& received() const { return received_; }
+  bool in_place() const { return in_place_; }
+
+ private:
+  std::string received_;
+  bool in_place_;
+};
+
 class TransportTest : public testing::Test,
                       public sigslot::has_slots<> {
  public:
@@ -321,3 +351,54 @@ TEST_F(TransportTest, TestGetStats) {
   ASSERT_EQ(1U, stats.channel_stats.size());
   EXPECT_EQ(1, stats.channel_stats[0].component);
 }
+
+// Signals kPacket from |channel| the way a socket does, in a pooled buffer.
+static void SignalPooledPacket(FakeTransportChannel* channel) {
+  rtc::scoped_refptr<rtc::PacketBufferPool> pool(
+      new rtc::PacketBufferPool(sizeof(kPacket), 1));
+  rtc::scoped_refptr<rtc::PacketBuffer> packet(pool->Get());
+  packet->buffer()->SetData(kPacket, sizeof(kPacket));
+  rtc::SignaledPacketScope scope(packet.get());
+  channel->SignalReadPacket(channel, packet->buffer()->data(),
+                            packet->buffer()->length(),
+                            rtc::CreatePacketTime(0), 0);
+}
+
+// Tests that the only channel behind a proxy may modify a packet in place.
+TEST_F(TransportTest, TestProxyHandsOverSignaledPacket) {
+  EXPECT_TRUE(SetupChannel());
+  rtc::scoped_ptr<TransportChannelProxy> proxy(
+      new TransportChannelProxy("audio", "rtp", 1));
+  proxy->SetImplementation(CreateChannel(1));
+  InPlaceReceiver receiver;
+  proxy->SignalReadPacket.connect(&receiver, &InPlaceReceiver::OnReadPacket);
+
+  SignalPooledPacket(channel_);
+  EXPECT_EQ(std::string(kPacket, sizeof(kPacket)), receiver.received());
+  EXPECT_TRUE(receiver.in_place());
+}
+
+// Tests that when channels are bundled onto one transport channel, none of
+// them may modify a packet in place, so each one sees the packet as it was
+// received.
+TEST_F(TransportTest, TestBundledProxiesCopySignaledPacket) {
+  EXPECT_TRUE(SetupChannel());
+  rtc::scoped_ptr<TransportChannelProxy> audio(
+      new TransportChannelProxy("audio", "rtp", 1));
+  rtc::scoped_ptr<TransportChannelProxy> video(
+      new TransportChannelProxy("video", "rtp", 1));
+  audio->SetImplementation(CreateChannel(1));
+  video->SetImplementation(CreateChannel(1));
+  InPlaceReceiver audio_receiver;
+  InPlaceReceiver video_receiver;
+  audio->SignalReadPacket.connect(&audio_receiver,
+                                  &InPlaceReceiver::OnReadPacket);
+  video->SignalReadPacket.connect(&video_receiver,
+                                  &InPlaceReceiver::OnReadPacket);
+
+  SignalPooledPacket(channel_);
+  EXPECT_EQ(std::string(kPacket, sizeof(kPacket)), audio_receiver.received());
+  EXPECT_FALSE(audio_receiver.in_place());
+  EXPECT_EQ(std::string(kPacket, sizeof(kPacket)), video_receiver.received());
+  EXPECT_FALSE(video_receiver.in_place());
+}
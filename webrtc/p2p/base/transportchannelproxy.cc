@@ -13,6 +13,7 @@
 #include "webrtc/p2p/base/transportchannelproxy.h"
 #include "webrtc/base/common.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/packetbuffer.h"
 #include "webrtc/base/thread.h"
 
 namespace cricket {
@@ -229,6 +230,14 @@ void TransportChannelProxy::OnReadPacket(
     const rtc::PacketTime& packet_time, int flags) {
   ASSERT(rtc::Thread::Current() == worker_thread_);
   ASSERT(channel == impl_);
+  if (impl_->SignalReadPacket.connection_count() > 1) {
+    // Under BUNDLE several proxies share |impl_|, and each of them hands the
+    // packet to its own channel. None of them is the final receiver, so none
+    // may modify the packet in place.
+    rtc::SignaledPacketScope shared(NULL);
+    SignalReadPacket(this, data, size, packet_time, flags);
+    return;
+  }
   SignalReadPacket(this, data, size, packet_time, flags);
 }
 
@@ -493,7 +493,7 @@ void TurnPort::OnReadPacket(
     // This must be a response for one of our requests.
     // Check success responses, but not errors, for MESSAGE-INTEGRITY.
     if (IsStunSuccessResponseType(msg_type) &&
-        !StunMessage::ValidateMessageIntegrity(data, size, hash())) {
+        !StunMessage::ValidateMessageIntegrity(data, size, hash_key_)) {
       LOG_J(LS_WARNING, this) << "Received TURN message with invalid "
                               << "message integrity, msg_type=" << msg_type;
       return;
@@ -758,7 +758,7 @@ void TurnPort::AddRequestAuthInfo(StunMessage* msg) {
       STUN_ATTR_REALM, realm_)));
   VERIFY(msg->AddAttribute(new StunByteStringAttribute(
       STUN_ATTR_NONCE, nonce_)));
-  VERIFY(msg->AddMessageIntegrity(hash()));
+  VERIFY(msg->AddMessageIntegrity(hash_key_));
 }
 
 int TurnPort::Send(const void* data, size_t len,
@@ -769,6 +769,7 @@ int TurnPort::Send(const void* data, size_t len,
 void TurnPort::UpdateHash() {
   VERIFY(ComputeStunCredentialHash(credentials_.username, realm_,
                                    credentials_.password, &hash_));
+  hash_key_.SetKey(hash_.c_str(), hash_.size());
 }
 
 bool TurnPort::UpdateNonce(StunMessage* response) {
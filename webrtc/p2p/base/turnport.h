@@ -214,6 +214,7 @@ class TurnPort : public Port {
   std::string realm_;       // From 401/438 response message.
   std::string nonce_;       // From 401/438 response message.
   std::string hash_;        // Digest of username:realm:password
+  StunHmacKey hash_key_;    // |hash_| prepared for MESSAGE-INTEGRITY
 
   int next_channel_number_;
   EntryList entries_;
@@ -10,10 +10,15 @@
 
 #include "webrtc/p2p/base/turnserver.h"
 
+#include <algorithm>
+
 #include "webrtc/p2p/base/asyncstuntcpsocket.h"
+#include "webrtc/p2p/base/basicpacketsocketfactory.h"
 #include "webrtc/p2p/base/common.h"
 #include "webrtc/p2p/base/packetsocketfactory.h"
 #include "webrtc/p2p/base/stun.h"
+#include "webrtc/base/asyncudpsocket.h"
+#include "webrtc/base/bind.h"
 #include "webrtc/base/bytebuffer.h"
 #include "webrtc/base/helpers.h"
 #include "webrtc/base/logging.h"
@@ -21,6 +26,7 @@
 #include "webrtc/base/socketadapters.h"
 #include "webrtc/base/stringencode.h"
 #include "webrtc/base/thread.h"
+#include "webrtc/base/timeutils.h"
 
 namespace cricket {
 
@@ -39,6 +45,11 @@ static const size_t kNonceSize = 40;
 
 static const size_t TURN_CHANNEL_HEADER_SIZE = 4U;
 
+// How many datagrams a ShardedTurnServer shard reads per wakeup, and the
+// largest one it accepts; anything bigger wouldn't survive a typical path MTU.
+static const size_t kShardReceiveBatchSize = 32;
+static const size_t kShardMaxPacketSize = 4096;
+
 // TODO(mallinath) - Move these to a common place.
 inline bool IsTurnChannelData(uint16 msg_type) {
   // The first two bits of a channel data message are 0b01.
@@ -48,6 +59,7 @@ inline bool IsTurnChannelData(uint16 msg_type) {
 // IDs used for posted messages for TurnServer::Allocation.
 enum {
   MSG_ALLOCATION_TIMEOUT,
+  MSG_EXPIRATION_TIMEOUT,
 };
 
 // Encapsulates a TURN allocation.
@@ -66,6 +78,7 @@ class TurnServer::Allocation : public rtc::MessageHandler,
 
   Connection* conn() { return &conn_; }
   const std::string& key() const { return key_; }
+  const StunHmacKey& hmac_key() const { return hmac_key_; }
   const std::string& transaction_id() const { return transaction_id_; }
   const std::string& username() const { return username_; }
   const std::string& last_nonce() const { return last_nonce_; }
@@ -79,8 +92,17 @@ class TurnServer::Allocation : public rtc::MessageHandler,
   sigslot::signal1<Allocation*> SignalDestroyed;
 
  private:
-  typedef std::list<Permission*> PermissionList;
-  typedef std::list<Channel*> ChannelList;
+  // Permissions and channels are kept in lists ordered by expiration time.
+  // Since all entries of a kind have the same lifetime, a refreshed entry is
+  // simply moved to the back of its list, and only the entries at the front
+  // ever need to be checked for expiration. The maps index the list entries
+  // for the per-packet lookups.
+  typedef std::list<Permission> PermissionList;
+  typedef std::map<rtc::IPAddress, PermissionList::iterator> PermissionMap;
+  typedef std::list<Channel> ChannelList;
+  typedef std::map<int, ChannelList::iterator> ChannelIdMap;
+  typedef std::map<rtc::SocketAddressKey, ChannelList::iterator>
+      ChannelAddressMap;
 
   void HandleAllocateRequest(const TurnMessage* msg);
   void HandleRefreshRequest(const TurnMessage* msg);
@@ -96,9 +118,12 @@ class TurnServer::Allocation : public rtc::MessageHandler,
   static int ComputeLifetime(const TurnMessage* msg);
   bool HasPermission(const rtc::IPAddress& addr);
   void AddPermission(const rtc::IPAddress& addr);
-  Permission* FindPermission(const rtc::IPAddress& addr) const;
-  Channel* FindChannel(int channel_id) const;
-  Channel* FindChannel(const rtc::SocketAddress& addr) const;
+  const Permission* FindPermission(const rtc::IPAddress& addr) const;
+  void AddChannel(int channel_id, const rtc::SocketAddress& addr);
+  const Channel* FindChannel(int channel_id) const;
+  const Channel* FindChannel(const rtc::SocketAddress& addr) const;
+  void ExpireEntries();
+  void ScheduleExpiration();
 
   void SendResponse(TurnMessage* msg);
   void SendBadRequestResponse(const TurnMessage* req);
@@ -107,8 +132,6 @@ class TurnServer::Allocation : public rtc::MessageHandler,
   void SendExternal(const void* data, size_t size,
                     const rtc::SocketAddress& peer);
 
-  void OnPermissionDestroyed(Permission* perm);
-  void OnChannelDestroyed(Channel* channel);
   virtual void OnMessage(rtc::Message* msg);
 
   TurnServer* server_;
@@ -116,54 +139,50 @@ class TurnServer::Allocation : public rtc::MessageHandler,
   Connection conn_;
   rtc::scoped_ptr<rtc::AsyncPacketSocket> external_socket_;
   std::string key_;
+  StunHmacKey hmac_key_;
   std::string transaction_id_;
   std::string username_;
   std::string last_nonce_;
   PermissionList perms_;
+  PermissionMap perms_by_addr_;
   ChannelList channels_;
+  ChannelIdMap channels_by_id_;
+  ChannelAddressMap channels_by_addr_;
+  bool expiration_scheduled_;
 };
 
 // Encapsulates a TURN permission.
 // The object is created when a create permission request is received by an
-// allocation, and self-deletes when its lifetime timer expires.
-class TurnServer::Permission : public rtc::MessageHandler {
+// allocation, and is removed by the allocation once its lifetime expires.
+class TurnServer::Permission {
  public:
-  Permission(rtc::Thread* thread, const rtc::IPAddress& peer);
-  ~Permission();
+  explicit Permission(const rtc::IPAddress& peer);
 
   const rtc::IPAddress& peer() const { return peer_; }
+  uint32 expires() const { return expires_; }
   void Refresh();
 
-  sigslot::signal1<Permission*> SignalDestroyed;
-
  private:
-  virtual void OnMessage(rtc::Message* msg);
-
-  rtc::Thread* thread_;
   rtc::IPAddress peer_;
+  uint32 expires_;
 };
 
 // Encapsulates a TURN channel binding.
 // The object is created when a channel bind request is received by an
-// allocation, and self-deletes when its lifetime timer expires.
-class TurnServer::Channel : public rtc::MessageHandler {
+// allocation, and is removed by the allocation once its lifetime expires.
+class TurnServer::Channel {
  public:
-  Channel(rtc::Thread* thread, int id,
-                     const rtc::SocketAddress& peer);
-  ~Channel();
+  Channel(int id, const rtc::SocketAddress& peer);
 
   int id() const { return id_; }
   const rtc::SocketAddress& peer() const { return peer_; }
+  uint32 expires() const { return expires_; }
   void Refresh();
 
-  sigslot::signal1<Channel*> SignalDestroyed;
-
  private:
-  virtual void OnMessage(rtc::Message* msg);
-
-  rtc::Thread* thread_;
   int id_;
   rtc::SocketAddress peer_;
+  uint32 expires_;
 };
 
 static bool InitResponse(const StunMessage* req, StunMessage* resp) {
@@ -310,7 +329,7 @@ void TurnServer::HandleStunMessage(Connection* conn, const char* data,
   }
 
   // Look up the key that we'll use to validate the M-I. If we have an
-  // existing allocation, the key will already be cached.
+  // existing allocation, the key and its HMAC state will already be cached.
   Allocation* allocation = FindAllocation(conn);
   std::string key;
   if (!allocation) {
@@ -321,7 +340,11 @@ void TurnServer::HandleStunMessage(Connection* conn, const char* data,
 
   // Ensure the message is authorized; only needed for requests.
   if (IsStunRequestType(msg.type())) {
-    if (!CheckAuthorization(conn, &msg, data, size, key)) {
+    bool authorized = allocation ?
+        CheckAuthorization(conn, &msg, data, size, key,
+                           allocation->hmac_key()) :
+        CheckAuthorization(conn, &msg, data, size, key, StunHmacKey(key));
+    if (!authorized) {
       return;
     }
   }
@@ -362,7 +385,8 @@ bool TurnServer::GetKey(const StunMessage* msg, std::string* key) {
 bool TurnServer::CheckAuthorization(Connection* conn,
                                     const StunMessage* msg,
                                     const char* data, size_t size,
-                                    const std::string& key) {
+                                    const std::string& key,
+                                    const StunHmacKey& hmac_key) {
   // RFC 5389, 10.2.2.
   ASSERT(IsStunRequestType(msg->type()));
   const StunByteStringAttribute* mi_attr =
@@ -397,7 +421,8 @@ bool TurnServer::CheckAuthorization(Connection* conn,
 
   // Fail if bad username or M-I.
   // We need |data| and |size| for the call to ValidateMessageIntegrity.
-  if (key.empty() || !StunMessage::ValidateMessageIntegrity(data, size, key)) {
+  if (key.empty() ||
+      !StunMessage::ValidateMessageIntegrity(data, size, hmac_key)) {
     SendErrorResponseWithRealmAndNonce(conn, msg, STUN_ERROR_UNAUTHORIZED,
                                        STUN_ERROR_REASON_UNAUTHORIZED);
     return false;
@@ -602,17 +627,25 @@ TurnServer::Connection::Connection(const rtc::SocketAddress& src,
                                    ProtocolType proto,
                                    rtc::AsyncPacketSocket* socket)
     : src_(src),
-      dst_(socket->GetRemoteAddress()),
+      src_key_(src),
+      dst_key_(socket->GetRemoteAddress()),
       proto_(proto),
       socket_(socket) {
+  // Both addresses come from the socket, so they are resolved.
+  ASSERT(!src.IsUnresolvedIP());
 }
 
 bool TurnServer::Connection::operator==(const Connection& c) const {
-  return src_ == c.src_ && dst_ == c.dst_ && proto_ == c.proto_;
+  return src_key_ == c.src_key_ && dst_key_ == c.dst_key_ &&
+      proto_ == c.proto_;
 }
 
 bool TurnServer::Connection::operator<(const Connection& c) const {
-  return src_ < c.src_ || dst_ < c.dst_ || proto_ < c.proto_;
+  if (src_key_ != c.src_key_)
+    return src_key_ < c.src_key_;
+  if (dst_key_ != c.dst_key_)
+    return dst_key_ < c.dst_key_;
+  return proto_ < c.proto_;
 }
 
 std::string TurnServer::Connection::ToString() const {
@@ -620,7 +653,8 @@ std::string TurnServer::Connection::ToString() const {
       "unknown", "udp", "tcp", "ssltcp"
   };
   std::ostringstream ost;
-  ost << src_.ToString() << "-" << dst_.ToString() << ":"<< kProtos[proto_];
+  ost << src_.ToString() << "-" << dst_key_.ToSocketAddress().ToString()
+      << ":" << kProtos[proto_];
   return ost.str();
 }
 
@@ -633,21 +667,16 @@ TurnServer::Allocation::Allocation(TurnServer* server,
       thread_(thread),
       conn_(conn),
       external_socket_(socket),
-      key_(key) {
+      key_(key),
+      hmac_key_(key),
+      expiration_scheduled_(false) {
   external_socket_->SignalReadPacket.connect(
       this, &TurnServer::Allocation::OnExternalPacket);
 }
 
 TurnServer::Allocation::~Allocation() {
-  for (ChannelList::iterator it = channels_.begin();
-       it != channels_.end(); ++it) {
-    delete *it;
-  }
-  for (PermissionList::iterator it = perms_.begin();
-       it != perms_.end(); ++it) {
-    delete *it;
-  }
   thread_->Clear(this, MSG_ALLOCATION_TIMEOUT);
+  thread_->Clear(this, MSG_EXPIRATION_TIMEOUT);
   LOG_J(LS_INFO, this) << "Allocation destroyed";
 }
 
@@ -797,22 +826,15 @@ void TurnServer::Allocation::HandleChannelBindRequest(const TurnMessage* msg) {
 
   // Check that this channel id isn't bound to another transport address, and
   // that this transport address isn't bound to another channel id.
-  Channel* channel1 = FindChannel(channel_id);
-  Channel* channel2 = FindChannel(peer_attr->GetAddress());
+  const Channel* channel1 = FindChannel(channel_id);
+  const Channel* channel2 = FindChannel(peer_attr->GetAddress());
   if (channel1 != channel2) {
     SendBadRequestResponse(msg);
     return;
   }
 
   // Add or refresh this channel.
-  if (!channel1) {
-    channel1 = new Channel(thread_, channel_id, peer_attr->GetAddress());
-    channel1->SignalDestroyed.connect(this,
-        &TurnServer::Allocation::OnChannelDestroyed);
-    channels_.push_back(channel1);
-  } else {
-    channel1->Refresh();
-  }
+  AddChannel(channel_id, peer_attr->GetAddress());
 
   // Channel binds also refresh permissions.
   AddPermission(peer_attr->GetAddress().ipaddr());
@@ -829,7 +851,7 @@ void TurnServer::Allocation::HandleChannelBindRequest(const TurnMessage* msg) {
 void TurnServer::Allocation::HandleChannelData(const char* data, size_t size) {
   // Extract the channel number from the data.
   uint16 channel_id = rtc::GetBE16(data);
-  Channel* channel = FindChannel(channel_id);
+  const Channel* channel = FindChannel(channel_id);
   if (channel) {
     // Send the data to the peer address.
     SendExternal(data + TURN_CHANNEL_HEADER_SIZE,
@@ -846,7 +868,7 @@ void TurnServer::Allocation::OnExternalPacket(
     const rtc::SocketAddress& addr,
     const rtc::PacketTime& packet_time) {
   ASSERT(external_socket_.get() == socket);
-  Channel* channel = FindChannel(addr);
+  const Channel* channel = FindChannel(addr);
   if (channel) {
     // There is a channel bound to this address. Send as a channel message.
     rtc::ByteBuffer buf;
@@ -886,49 +908,90 @@ bool TurnServer::Allocation::HasPermission(const rtc::IPAddress& addr) {
 }
 
 void TurnServer::Allocation::AddPermission(const rtc::IPAddress& addr) {
-  Permission* perm = FindPermission(addr);
-  if (!perm) {
-    perm = new Permission(thread_, addr);
-    perm->SignalDestroyed.connect(
-        this, &TurnServer::Allocation::OnPermissionDestroyed);
-    perms_.push_back(perm);
+  PermissionMap::iterator it = perms_by_addr_.find(addr);
+  if (it == perms_by_addr_.end()) {
+    perms_.push_back(Permission(addr));
+    perms_by_addr_[addr] = --perms_.end();
   } else {
-    perm->Refresh();
+    it->second->Refresh();
+    perms_.splice(perms_.end(), perms_, it->second);
   }
+  ScheduleExpiration();
 }
 
-TurnServer::Permission* TurnServer::Allocation::FindPermission(
+const TurnServer::Permission* TurnServer::Allocation::FindPermission(
     const rtc::IPAddress& addr) const {
-  for (PermissionList::const_iterator it = perms_.begin();
-       it != perms_.end(); ++it) {
-    if ((*it)->peer() == addr)
-      return *it;
+  PermissionMap::const_iterator it = perms_by_addr_.find(addr);
+  return (it != perms_by_addr_.end()) ? &*it->second : NULL;
+}
+
+void TurnServer::Allocation::AddChannel(int channel_id,
+                                        const rtc::SocketAddress& addr) {
+  ChannelIdMap::iterator it = channels_by_id_.find(channel_id);
+  if (it == channels_by_id_.end()) {
+    // Peer addresses come from STUN attributes, so they are resolved.
+    ASSERT(!addr.IsUnresolvedIP());
+    channels_.push_back(Channel(channel_id, addr));
+    channels_by_id_[channel_id] = --channels_.end();
+    channels_by_addr_[rtc::SocketAddressKey(addr)] = --channels_.end();
+  } else {
+    ASSERT(it->second->peer() == addr);
+    it->second->Refresh();
+    channels_.splice(channels_.end(), channels_, it->second);
   }
-  return NULL;
+  ScheduleExpiration();
 }
 
-TurnServer::Channel* TurnServer::Allocation::FindChannel(int channel_id) const {
-  for (ChannelList::const_iterator it = channels_.begin();
-       it != channels_.end(); ++it) {
-    if ((*it)->id() == channel_id)
-      return *it;
-  }
-  return NULL;
+const TurnServer::Channel* TurnServer::Allocation::FindChannel(
+    int channel_id) const {
+  ChannelIdMap::const_iterator it = channels_by_id_.find(channel_id);
+  return (it != channels_by_id_.end()) ? &*it->second : NULL;
 }
 
-TurnServer::Channel* TurnServer::Allocation::FindChannel(
+const TurnServer::Channel* TurnServer::Allocation::FindChannel(
     const rtc::SocketAddress& addr) const {
-  for (ChannelList::const_iterator it = channels_.begin();
-       it != channels_.end(); ++it) {
-    if ((*it)->peer() == addr)
-      return *it;
+  ChannelAddressMap::const_iterator it =
+      channels_by_addr_.find(rtc::SocketAddressKey(addr));
+  return (it != channels_by_addr_.end()) ? &*it->second : NULL;
+}
+
+void TurnServer::Allocation::ExpireEntries() {
+  uint32 now = rtc::Time();
+  while (!perms_.empty() && rtc::TimeDiff(perms_.front().expires(), now) <= 0) {
+    perms_by_addr_.erase(perms_.front().peer());
+    perms_.pop_front();
+  }
+  while (!channels_.empty() &&
+         rtc::TimeDiff(channels_.front().expires(), now) <= 0) {
+    channels_by_id_.erase(channels_.front().id());
+    channels_by_addr_.erase(rtc::SocketAddressKey(channels_.front().peer()));
+    channels_.pop_front();
   }
-  return NULL;
+}
+
+void TurnServer::Allocation::ScheduleExpiration() {
+  // A single timer covers all permissions and channels. It is armed for the
+  // earliest expiration; if that entry gets refreshed in the meantime, the
+  // timer fires early and is simply rearmed for the new front entry.
+  if (expiration_scheduled_ || (perms_.empty() && channels_.empty()))
+    return;
+
+  uint32 next;
+  if (perms_.empty()) {
+    next = channels_.front().expires();
+  } else if (channels_.empty()) {
+    next = perms_.front().expires();
+  } else {
+    next = rtc::TimeMin(perms_.front().expires(), channels_.front().expires());
+  }
+  thread_->PostDelayed(std::max(rtc::TimeUntil(next), 0), this,
+                       MSG_EXPIRATION_TIMEOUT);
+  expiration_scheduled_ = true;
 }
 
 void TurnServer::Allocation::SendResponse(TurnMessage* msg) {
   // Success responses always have M-I.
-  msg->AddMessageIntegrity(key_);
+  msg->AddMessageIntegrity(hmac_key_);
   server_->SendStun(&conn_, msg);
 }
 
@@ -948,64 +1011,116 @@ void TurnServer::Allocation::SendExternal(const void* data, size_t size,
 }
 
 void TurnServer::Allocation::OnMessage(rtc::Message* msg) {
+  if (msg->message_id == MSG_EXPIRATION_TIMEOUT) {
+    expiration_scheduled_ = false;
+    ExpireEntries();
+    ScheduleExpiration();
+    return;
+  }
+
   ASSERT(msg->message_id == MSG_ALLOCATION_TIMEOUT);
   SignalDestroyed(this);
   delete this;
 }
 
-void TurnServer::Allocation::OnPermissionDestroyed(Permission* perm) {
-  PermissionList::iterator it = std::find(perms_.begin(), perms_.end(), perm);
-  ASSERT(it != perms_.end());
-  perms_.erase(it);
-}
-
-void TurnServer::Allocation::OnChannelDestroyed(Channel* channel) {
-  ChannelList::iterator it =
-      std::find(channels_.begin(), channels_.end(), channel);
-  ASSERT(it != channels_.end());
-  channels_.erase(it);
-}
-
-TurnServer::Permission::Permission(rtc::Thread* thread,
-                                   const rtc::IPAddress& peer)
-    : thread_(thread), peer_(peer) {
+TurnServer::Permission::Permission(const rtc::IPAddress& peer)
+    : peer_(peer) {
   Refresh();
 }
 
-TurnServer::Permission::~Permission() {
-  thread_->Clear(this, MSG_ALLOCATION_TIMEOUT);
+void TurnServer::Permission::Refresh() {
+  expires_ = rtc::TimeAfter(kPermissionTimeout);
 }
 
-void TurnServer::Permission::Refresh() {
-  thread_->Clear(this, MSG_ALLOCATION_TIMEOUT);
-  thread_->PostDelayed(kPermissionTimeout, this, MSG_ALLOCATION_TIMEOUT);
+TurnServer::Channel::Channel(int id, const rtc::SocketAddress& peer)
+    : id_(id), peer_(peer) {
+  Refresh();
 }
 
-void TurnServer::Permission::OnMessage(rtc::Message* msg) {
-  ASSERT(msg->message_id == MSG_ALLOCATION_TIMEOUT);
-  SignalDestroyed(this);
-  delete this;
+void TurnServer::Channel::Refresh() {
+  expires_ = rtc::TimeAfter(kChannelTimeout);
 }
 
-TurnServer::Channel::Channel(rtc::Thread* thread, int id,
-                             const rtc::SocketAddress& peer)
-    : thread_(thread), id_(id), peer_(peer) {
-  Refresh();
+ShardedTurnServer::ShardedTurnServer(size_t num_shards)
+    : num_shards_(num_shards),
+      auth_hook_(NULL),
+      enable_otu_nonce_(false) {
+  ASSERT(num_shards_ > 0);
+}
+
+ShardedTurnServer::~ShardedTurnServer() {
+  Stop();
+}
+
+bool ShardedTurnServer::Start(const rtc::SocketAddress& int_addr,
+                              const rtc::SocketAddress& ext_addr) {
+  ASSERT(shards_.empty());
+  int_addr_ = int_addr;
+  ext_addr_ = ext_addr;
+  shards_.resize(num_shards_);
+  // The shards are started one after another, so that the first one can
+  // resolve a wildcard port for the others.
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i].thread = new rtc::Thread();
+    shards_[i].thread->SetName("TurnServerShard", this);
+    shards_[i].thread->Start();
+    if (!shards_[i].thread->Invoke<bool>(
+            rtc::Bind(&ShardedTurnServer::StartShard, this, i))) {
+      Stop();
+      return false;
+    }
+  }
+  LOG(LS_INFO) << "Started " << shards_.size() << " TURN server shards on "
+               << int_addr_.ToString();
+  return true;
 }
 
-TurnServer::Channel::~Channel() {
-  thread_->Clear(this, MSG_ALLOCATION_TIMEOUT);
+void ShardedTurnServer::Stop() {
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    if (shards_[i].thread) {
+      shards_[i].thread->Invoke<void>(
+          rtc::Bind(&ShardedTurnServer::StopShard, this, i));
+      shards_[i].thread->Stop();
+      delete shards_[i].thread;
+    }
+  }
+  shards_.clear();
 }
 
-void TurnServer::Channel::Refresh() {
-  thread_->Clear(this, MSG_ALLOCATION_TIMEOUT);
-  thread_->PostDelayed(kChannelTimeout, this, MSG_ALLOCATION_TIMEOUT);
+bool ShardedTurnServer::StartShard(size_t index) {
+  Shard* shard = &shards_[index];
+  rtc::AsyncSocket* socket = shard->thread->socketserver()->CreateAsyncSocket(
+      int_addr_.family(), SOCK_DGRAM);
+  if (!socket) {
+    return false;
+  }
+  if (socket->SetOption(rtc::Socket::OPT_REUSEPORT, 1) < 0 ||
+      socket->Bind(int_addr_) < 0) {
+    LOG(LS_ERROR) << "Failed to bind TURN server shard to "
+                  << int_addr_.ToString() << ", err=" << socket->GetError();
+    delete socket;
+    return false;
+  }
+  int_addr_ = socket->GetLocalAddress();
+
+  shard->server = new TurnServer(shard->thread);
+  shard->server->set_realm(realm_);
+  shard->server->set_software(software_);
+  shard->server->set_auth_hook(auth_hook_);
+  shard->server->set_enable_otu_nonce(enable_otu_nonce_);
+  rtc::AsyncUDPSocket* udp_socket = new rtc::AsyncUDPSocket(socket);
+  // Each shard serves many clients from one socket, so drain the socket in
+  // batches; the responses to a batch then go out in a single send as well.
+  udp_socket->SetBatchedReceive(kShardReceiveBatchSize, kShardMaxPacketSize);
+  shard->server->AddInternalSocket(udp_socket, PROTO_UDP);
+  shard->server->SetExternalSocketFactory(
+      new rtc::BasicPacketSocketFactory(shard->thread), ext_addr_);
+  return true;
 }
 
-void TurnServer::Channel::OnMessage(rtc::Message* msg) {
-  ASSERT(msg->message_id == MSG_ALLOCATION_TIMEOUT);
-  SignalDestroyed(this);
-  delete this;
+void ShardedTurnServer::StopShard(size_t index) {
+  delete shards_[index].server;
+  shards_[index].server = NULL;
 }
 
 }  // namespace cricket
@@ -15,6 +15,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "webrtc/p2p/base/portinterface.h"
 #include "webrtc/base/asyncpacketsocket.h"
@@ -30,6 +31,7 @@ class Thread;
 
 namespace cricket {
 
+class StunHmacKey;
 class StunMessage;
 class TurnMessage;
 
@@ -108,7 +110,9 @@ class TurnServer : public sigslot::has_slots<> {
 
    private:
     rtc::SocketAddress src_;
-    rtc::SocketAddress dst_;
+    // The allocation maps are keyed by these rather than the addresses.
+    rtc::SocketAddressKey src_key_;
+    rtc::SocketAddressKey dst_key_;
     cricket::ProtocolType proto_;
     rtc::AsyncPacketSocket* socket_;
   };
@@ -135,7 +139,8 @@ class TurnServer : public sigslot::has_slots<> {
   bool GetKey(const StunMessage* msg, std::string* key);
   bool CheckAuthorization(Connection* conn, const StunMessage* msg,
                           const char* data, size_t size,
-                          const std::string& key);
+                          const std::string& key,
+                          const StunHmacKey& hmac_key);
   std::string GenerateNonce() const;
   bool ValidateNonce(const std::string& nonce) const;
 
@@ -185,6 +190,59 @@ class TurnServer : public sigslot::has_slots<> {
   AllocationMap allocations_;
 };
 
+// Runs a TurnServer per worker thread, all listening for UDP on the same
+// address. Each shard binds its own socket with SO_REUSEPORT, and the kernel
+// picks the socket for an incoming packet by hashing its addresses, so every
+// packet from a given client reaches the same shard. Each allocation (and its
+// relayed socket) therefore lives entirely on one thread, and the shards
+// never need to lock or talk to each other.
+// The configuration must be set before Start, and the auth hook must be safe
+// to call from any of the worker threads.
+class ShardedTurnServer {
+ public:
+  explicit ShardedTurnServer(size_t num_shards);
+  ~ShardedTurnServer();
+
+  size_t num_shards() const { return num_shards_; }
+
+  void set_realm(const std::string& realm) { realm_ = realm; }
+  void set_software(const std::string& software) { software_ = software; }
+  void set_auth_hook(TurnAuthInterface* auth_hook) { auth_hook_ = auth_hook; }
+  void set_enable_otu_nonce(bool enable) { enable_otu_nonce_ = enable; }
+
+  // Starts the worker threads, each listening on |int_addr| and allocating
+  // relayed sockets on |ext_addr|. If the port of |int_addr| is 0, all shards
+  // share the port picked for the first one. Returns false if any shard
+  // failed to bind, e.g. because SO_REUSEPORT isn't supported.
+  bool Start(const rtc::SocketAddress& int_addr,
+             const rtc::SocketAddress& ext_addr);
+  // Destroys the servers and their allocations, and stops the threads.
+  void Stop();
+
+  // The address the shards are listening on, once started.
+  const rtc::SocketAddress& address() const { return int_addr_; }
+
+ private:
+  struct Shard {
+    Shard() : thread(NULL), server(NULL) {}
+    rtc::Thread* thread;
+    TurnServer* server;
+  };
+
+  // These run on the shard's own thread.
+  bool StartShard(size_t index);
+  void StopShard(size_t index);
+
+  size_t num_shards_;
+  std::string realm_;
+  std::string software_;
+  TurnAuthInterface* auth_hook_;
+  bool enable_otu_nonce_;
+  rtc::SocketAddress int_addr_;
+  rtc::SocketAddress ext_addr_;
+  std::vector<Shard> shards_;
+};
+
 }  // namespace cricket
 
 #endif  // WEBRTC_P2P_BASE_TURNSERVER_H_
@@ -0,0 +1,440 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "webrtc/p2p/base/stun.h"
+#include "webrtc/p2p/base/testturnserver.h"
+#include "webrtc/p2p/base/turnserver.h"
+#include "webrtc/base/asyncudpsocket.h"
+#include "webrtc/base/bytebuffer.h"
+#include "webrtc/base/gunit.h"
+#include "webrtc/base/helpers.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/physicalsocketserver.h"
+#include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/thread.h"
+#include "webrtc/base/timeutils.h"
+#include "webrtc/base/virtualsocketserver.h"
+
+using rtc::SocketAddress;
+using namespace cricket;
+
+static const SocketAddress kTurnIntAddr("99.99.99.3", 3478);
+static const SocketAddress kTurnExtAddr("99.99.99.5", 0);
+static const SocketAddress kClientAddr("11.11.11.11", 0);
+static const char kTestUsername[] = "test";
+static const int kTimeout = 1000;
+static const int kFirstChannel = 0x4000;
+
+// Accepts any user whose password is the same as the username.
+class TestTurnAuth : public TurnAuthInterface {
+ public:
+  virtual bool GetKey(const std::string& username, const std::string& realm,
+                      std::string* key) {
+    return ComputeStunCredentialHash(username, realm, username, key);
+  }
+};
+
+class TurnServerTest : public testing::Test,
+                       public sigslot::has_slots<> {
+ public:
+  TurnServerTest()
+      : main_(rtc::Thread::Current()),
+        pss_(new rtc::PhysicalSocketServer),
+        ss_(new rtc::VirtualSocketServer(pss_.get())),
+        ss_scope_(ss_.get()),
+        turn_server_(main_, kTurnIntAddr, kTurnExtAddr),
+        server_addr_(kTurnIntAddr),
+        peer_packets_(0) {
+  }
+
+  virtual void SetUp() {
+    CreateClient(ss_.get(), kClientAddr);
+  }
+
+  virtual void TearDown() {
+    for (size_t i = 0; i < peers_.size(); ++i) {
+      delete peers_[i];
+    }
+    peers_.clear();
+  }
+
+ protected:
+  void CreateClient(rtc::SocketFactory* factory, const SocketAddress& addr) {
+    client_.reset(rtc::AsyncUDPSocket::Create(factory, addr));
+    ASSERT_TRUE(client_.get() != NULL);
+    client_->SignalReadPacket.connect(this, &TurnServerTest::OnClientPacket);
+    client_packets_.clear();
+  }
+
+  // Runs the two-step authenticated allocate exchange.
+  bool Allocate() {
+    TurnMessage request;
+    InitRequest(&request, STUN_ALLOCATE_REQUEST);
+    request.AddAttribute(new StunUInt32Attribute(
+        STUN_ATTR_REQUESTED_TRANSPORT, IPPROTO_UDP << 24));
+    SendStun(&request);
+    rtc::scoped_ptr<TurnMessage> response(ReceiveStun());
+    if (!response || response->type() != STUN_ALLOCATE_ERROR_RESPONSE)
+      return false;
+    const StunByteStringAttribute* nonce_attr =
+        response->GetByteString(STUN_ATTR_NONCE);
+    if (!nonce_attr)
+      return false;
+    nonce_ = nonce_attr->GetString();
+    VERIFY(ComputeStunCredentialHash(kTestUsername, kTestRealm,
+                                     kTestUsername, &key_));
+
+    TurnMessage auth_request;
+    InitRequest(&auth_request, STUN_ALLOCATE_REQUEST);
+    auth_request.AddAttribute(new StunUInt32Attribute(
+        STUN_ATTR_REQUESTED_TRANSPORT, IPPROTO_UDP << 24));
+    if (SendAuthenticatedRequest(&auth_request) !=
+        STUN_ALLOCATE_RESPONSE) {
+      return false;
+    }
+    return true;
+  }
+
+  int CreatePermission(const SocketAddress& peer) {
+    TurnMessage request;
+    InitRequest(&request, TURN_CREATE_PERMISSION_REQUEST);
+    request.AddAttribute(new StunXorAddressAttribute(
+        STUN_ATTR_XOR_PEER_ADDRESS, peer));
+    return SendAuthenticatedRequest(&request);
+  }
+
+  int ChannelBind(int channel_id, const SocketAddress& peer) {
+    TurnMessage request;
+    InitRequest(&request, TURN_CHANNEL_BIND_REQUEST);
+    request.AddAttribute(new StunUInt32Attribute(
+        STUN_ATTR_CHANNEL_NUMBER, channel_id << 16));
+    request.AddAttribute(new StunXorAddressAttribute(
+        STUN_ATTR_XOR_PEER_ADDRESS, peer));
+    return SendAuthenticatedRequest(&request);
+  }
+
+  int Refresh(int lifetime_secs) {
+    TurnMessage request;
+    InitRequest(&request, TURN_REFRESH_REQUEST);
+    request.AddAttribute(new StunUInt32Attribute(
+        STUN_ATTR_LIFETIME, lifetime_secs));
+    return SendAuthenticatedRequest(&request);
+  }
+
+  // Runs the server for |ms| of virtual time.
+  void RunFor(int ms) {
+    main_->ProcessMessages(ms);
+  }
+
+  void SendChannelData(int channel_id, const std::string& data) {
+    rtc::ByteBuffer buf;
+    buf.WriteUInt16(static_cast<uint16>(channel_id));
+    buf.WriteUInt16(static_cast<uint16>(data.size()));
+    buf.WriteString(data);
+    rtc::PacketOptions options;
+    client_->SendTo(buf.Data(), buf.Length(), server_addr_, options);
+  }
+
+  // Creates a peer socket, bound to its own IP address.
+  rtc::AsyncPacketSocket* CreatePeer(int index) {
+    SocketAddress addr(rtc::IPAddress(0x16000000 + index), 0);
+    rtc::AsyncPacketSocket* peer = rtc::AsyncUDPSocket::Create(ss_.get(), addr);
+    peer->SignalReadPacket.connect(this, &TurnServerTest::OnPeerPacket);
+    peers_.push_back(peer);
+    return peer;
+  }
+
+  void InitRequest(TurnMessage* msg, int type) {
+    msg->SetType(type);
+    msg->SetTransactionID(rtc::CreateRandomString(kStunTransactionIdLength));
+  }
+
+  // Adds the long-term credentials to |msg|, sends it and returns the type of
+  // the response, or 0 if none arrived.
+  int SendAuthenticatedRequest(TurnMessage* msg) {
+    msg->AddAttribute(new StunByteStringAttribute(
+        STUN_ATTR_USERNAME, kTestUsername));
+    msg->AddAttribute(new StunByteStringAttribute(
+        STUN_ATTR_REALM, kTestRealm));
+    msg->AddAttribute(new StunByteStringAttribute(
+        STUN_ATTR_NONCE, nonce_));
+    msg->AddMessageIntegrity(key_);
+    SendStun(msg);
+    rtc::scoped_ptr<TurnMessage> response(ReceiveStun());
+    if (!response)
+      return 0;
+    const StunAddressAttribute* relayed_attr =
+        response->GetAddress(STUN_ATTR_XOR_RELAYED_ADDRESS);
+    if (relayed_attr)
+      relayed_addr_ = relayed_attr->GetAddress();
+    return response->type();
+  }
+
+  void SendStun(const StunMessage* msg) {
+    rtc::ByteBuffer buf;
+    msg->Write(&buf);
+    rtc::PacketOptions options;
+    client_->SendTo(buf.Data(), buf.Length(), server_addr_, options);
+  }
+
+  TurnMessage* ReceiveStun() {
+    WAIT(!client_packets_.empty(), kTimeout);
+    if (client_packets_.empty())
+      return NULL;
+    std::string packet = client_packets_.front();
+    client_packets_.pop_front();
+    rtc::ByteBuffer buf(packet.data(), packet.size());
+    rtc::scoped_ptr<TurnMessage> msg(new TurnMessage());
+    if (!msg->Read(&buf))
+      return NULL;
+    return msg.release();
+  }
+
+  void OnClientPacket(rtc::AsyncPacketSocket* socket, const char* data,
+                      size_t size, const SocketAddress& remote_addr,
+                      const rtc::PacketTime& packet_time) {
+    client_packets_.push_back(std::string(data, size));
+  }
+
+  void OnPeerPacket(rtc::AsyncPacketSocket* socket, const char* data,
+                    size_t size, const SocketAddress& remote_addr,
+                    const rtc::PacketTime& packet_time) {
+    ++peer_packets_;
+    last_peer_data_.assign(data, size);
+  }
+
+  rtc::Thread* main_;
+  rtc::scoped_ptr<rtc::PhysicalSocketServer> pss_;
+  rtc::scoped_ptr<rtc::VirtualSocketServer> ss_;
+  rtc::SocketServerScope ss_scope_;
+  TestTurnServer turn_server_;
+  SocketAddress server_addr_;
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> client_;
+  std::vector<rtc::AsyncPacketSocket*> peers_;
+  std::deque<std::string> client_packets_;
+  std::string nonce_;
+  std::string key_;
+  SocketAddress relayed_addr_;
+  int peer_packets_;
+  std::string last_peer_data_;
+};
+
+// Test that data from a peer is only relayed once a permission exists.
+TEST_F(TurnServerTest, TestPermission) {
+  ASSERT_TRUE(Allocate());
+  rtc::AsyncPacketSocket* peer = CreatePeer(1);
+  rtc::PacketOptions options;
+  peer->SendTo("ping", 4, relayed_addr_, options);
+  rtc::scoped_ptr<TurnMessage> msg(ReceiveStun());
+  EXPECT_TRUE(msg.get() == NULL);
+
+  EXPECT_EQ(TURN_CREATE_PERMISSION_RESPONSE,
+            CreatePermission(peer->GetLocalAddress()));
+  peer->SendTo("ping", 4, relayed_addr_, options);
+  msg.reset(ReceiveStun());
+  ASSERT_TRUE(msg.get() != NULL);
+  EXPECT_EQ(TURN_DATA_INDICATION, msg->type());
+  const StunByteStringAttribute* data_attr =
+      msg->GetByteString(STUN_ATTR_DATA);
+  ASSERT_TRUE(data_attr != NULL);
+  EXPECT_EQ("ping", data_attr->GetString());
+}
+
+// Test that a bound channel relays data in both directions.
+TEST_F(TurnServerTest, TestChannelBind) {
+  ASSERT_TRUE(Allocate());
+  rtc::AsyncPacketSocket* peer = CreatePeer(1);
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel, peer->GetLocalAddress()));
+  // Rebinding the same channel to the same peer refreshes it.
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel, peer->GetLocalAddress()));
+
+  SendChannelData(kFirstChannel, "hello");
+  EXPECT_EQ_WAIT(1, peer_packets_, kTimeout);
+  EXPECT_EQ("hello", last_peer_data_);
+
+  rtc::PacketOptions options;
+  peer->SendTo("world", 5, relayed_addr_, options);
+  EXPECT_TRUE_WAIT(!client_packets_.empty(), kTimeout);
+  rtc::ByteBuffer buf(client_packets_.front().data(),
+                      client_packets_.front().size());
+  uint16 channel_id, length;
+  ASSERT_TRUE(buf.ReadUInt16(&channel_id));
+  ASSERT_TRUE(buf.ReadUInt16(&length));
+  EXPECT_EQ(kFirstChannel, channel_id);
+  EXPECT_EQ(5, length);
+  std::string data;
+  ASSERT_TRUE(buf.ReadString(&data, length));
+  EXPECT_EQ("world", data);
+}
+
+// Test that a channel can't be bound to a second peer, and that a peer can't
+// be bound to a second channel.
+TEST_F(TurnServerTest, TestChannelBindConflict) {
+  ASSERT_TRUE(Allocate());
+  rtc::AsyncPacketSocket* peer1 = CreatePeer(1);
+  rtc::AsyncPacketSocket* peer2 = CreatePeer(2);
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel, peer1->GetLocalAddress()));
+  EXPECT_EQ(TURN_CHANNEL_BIND_ERROR_RESPONSE,
+            ChannelBind(kFirstChannel, peer2->GetLocalAddress()));
+  EXPECT_EQ(TURN_CHANNEL_BIND_ERROR_RESPONSE,
+            ChannelBind(kFirstChannel + 1, peer1->GetLocalAddress()));
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel + 1, peer2->GetLocalAddress()));
+}
+
+// Test that a permission expires 5 minutes after it was last refreshed.
+TEST_F(TurnServerTest, TestPermissionExpiry) {
+  rtc::VirtualClock clock;
+  ss_->SetVirtualClock(&clock);
+  ASSERT_TRUE(Allocate());
+  rtc::AsyncPacketSocket* peer1 = CreatePeer(1);
+  rtc::AsyncPacketSocket* peer2 = CreatePeer(2);
+  EXPECT_EQ(TURN_CREATE_PERMISSION_RESPONSE,
+            CreatePermission(peer1->GetLocalAddress()));
+  EXPECT_EQ(TURN_CREATE_PERMISSION_RESPONSE,
+            CreatePermission(peer2->GetLocalAddress()));
+
+  // Refresh the first permission only, 3 minutes in.
+  RunFor(3 * 60 * 1000);
+  EXPECT_EQ(TURN_CREATE_PERMISSION_RESPONSE,
+            CreatePermission(peer1->GetLocalAddress()));
+
+  // At 6 minutes, only the refreshed permission is left.
+  RunFor(3 * 60 * 1000);
+  rtc::PacketOptions options;
+  peer2->SendTo("ping", 4, relayed_addr_, options);
+  rtc::scoped_ptr<TurnMessage> msg(ReceiveStun());
+  EXPECT_TRUE(msg.get() == NULL);
+  peer1->SendTo("ping", 4, relayed_addr_, options);
+  msg.reset(ReceiveStun());
+  ASSERT_TRUE(msg.get() != NULL);
+  EXPECT_EQ(TURN_DATA_INDICATION, msg->type());
+
+  // At 9 minutes, the refreshed one has expired as well.
+  RunFor(3 * 60 * 1000);
+  peer1->SendTo("ping", 4, relayed_addr_, options);
+  msg.reset(ReceiveStun());
+  EXPECT_TRUE(msg.get() == NULL);
+  ss_->SetVirtualClock(NULL);
+}
+
+// Test that a channel expires 10 minutes after it was last bound, and that
+// refreshing the allocation doesn't refresh its channels.
+TEST_F(TurnServerTest, TestChannelExpiry) {
+  rtc::VirtualClock clock;
+  ss_->SetVirtualClock(&clock);
+  ASSERT_TRUE(Allocate());
+  rtc::AsyncPacketSocket* peer1 = CreatePeer(1);
+  rtc::AsyncPacketSocket* peer2 = CreatePeer(2);
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel, peer1->GetLocalAddress()));
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel + 1, peer2->GetLocalAddress()));
+
+  // 6 minutes in, keep the allocation and the first channel alive.
+  RunFor(6 * 60 * 1000);
+  EXPECT_EQ(TURN_REFRESH_RESPONSE, Refresh(600));
+  EXPECT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+            ChannelBind(kFirstChannel, peer1->GetLocalAddress()));
+
+  // At 11 minutes, only the rebound channel relays.
+  RunFor(5 * 60 * 1000);
+  EXPECT_EQ(TURN_REFRESH_RESPONSE, Refresh(600));
+  SendChannelData(kFirstChannel + 1, "lost");
+  SendChannelData(kFirstChannel, "hello");
+  EXPECT_EQ_WAIT(1, peer_packets_, kTimeout);
+  EXPECT_EQ("hello", last_peer_data_);
+  RunFor(kTimeout);
+  EXPECT_EQ(1, peer_packets_);
+
+  // At 17 minutes, the rebound channel has expired too.
+  RunFor(6 * 60 * 1000);
+  SendChannelData(kFirstChannel, "lost");
+  RunFor(kTimeout);
+  EXPECT_EQ(1, peer_packets_);
+  ss_->SetVirtualClock(NULL);
+}
+
+// Test that clients spread over the shards of a ShardedTurnServer can each
+// allocate and relay; all packets from a client must reach the same shard.
+TEST_F(TurnServerTest, TestShardedServer) {
+  const int kNumClients = 16;
+  TestTurnAuth auth;
+  ShardedTurnServer sharded_server(4);
+  sharded_server.set_realm(kTestRealm);
+  sharded_server.set_software(kTestSoftware);
+  sharded_server.set_auth_hook(&auth);
+  ASSERT_TRUE(sharded_server.Start(SocketAddress("127.0.0.1", 0),
+                                   SocketAddress("127.0.0.1", 0)));
+  EXPECT_EQ(4U, sharded_server.num_shards());
+  EXPECT_NE(0, sharded_server.address().port());
+  server_addr_ = sharded_server.address();
+
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> peer(rtc::AsyncUDPSocket::Create(
+      pss_.get(), SocketAddress("127.0.0.1", 0)));
+  ASSERT_TRUE(peer.get() != NULL);
+  rtc::PacketOptions options;
+  for (int i = 0; i < kNumClients; ++i) {
+    CreateClient(pss_.get(), SocketAddress("127.0.0.1", 0));
+    ASSERT_TRUE(Allocate());
+    EXPECT_EQ(TURN_CREATE_PERMISSION_RESPONSE,
+              CreatePermission(peer->GetLocalAddress()));
+    peer->SendTo("ping", 4, relayed_addr_, options);
+    rtc::scoped_ptr<TurnMessage> msg(ReceiveStun());
+    ASSERT_TRUE(msg.get() != NULL);
+    EXPECT_EQ(TURN_DATA_INDICATION, msg->type());
+  }
+  client_.reset();
+  sharded_server.Stop();
+}
+
+// Relays data between a single allocation and many peers, each with its own
+// permission and channel, and logs the relay throughput.
+TEST_F(TurnServerTest, TestManyPeersPerf) {
+  const int kNumPeers = 500;
+  const int kNumRounds = 20;
+  ASSERT_TRUE(Allocate());
+  for (int i = 0; i < kNumPeers; ++i) {
+    rtc::AsyncPacketSocket* peer = CreatePeer(i);
+    ASSERT_EQ(TURN_CHANNEL_BIND_RESPONSE,
+              ChannelBind(kFirstChannel + i, peer->GetLocalAddress()));
+  }
+
+  const std::string payload(100, 'x');
+  uint32 start = rtc::Time();
+  for (int round = 0; round < kNumRounds; ++round) {
+    for (int i = 0; i < kNumPeers; ++i) {
+      SendChannelData(kFirstChannel + i, payload);
+    }
+  }
+  EXPECT_EQ_WAIT(kNumPeers * kNumRounds, peer_packets_, 10 * kTimeout);
+
+  rtc::PacketOptions options;
+  for (int round = 0; round < kNumRounds; ++round) {
+    for (int i = 0; i < kNumPeers; ++i) {
+      peers_[i]->SendTo(payload.data(), payload.size(), relayed_addr_,
+                        options);
+    }
+  }
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumPeers * kNumRounds),
+                 client_packets_.size(), 10 * kTimeout);
+  uint32 finish = rtc::Time();
+
+  LOG(LS_INFO) << "Relayed " << 2 * kNumPeers * kNumRounds << " packets for "
+               << kNumPeers << " peers in " << rtc::TimeDiff(finish, start)
+               << " ms";
+}
@@ -0,0 +1,179 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/p2p/base/udpportmux.h"
+
+#include <string.h>
+
+#include "webrtc/p2p/base/stun.h"
+#include "webrtc/p2p/base/stunport.h"
+#include "webrtc/base/common.h"
+#include "webrtc/base/logging.h"
+
+namespace cricket {
+
+UDPPortMux::UDPPortMux(rtc::AsyncPacketSocket* socket)
+    : socket_(socket) {
+  ASSERT(socket_ != NULL);
+  socket_->SignalReadPacket.connect(this, &UDPPortMux::OnReadPacket);
+}
+
+UDPPortMux::~UDPPortMux() {
+  // The ports only borrow the socket.
+  ASSERT(ports_.empty());
+}
+
+UDPPort* UDPPortMux::CreatePort(rtc::Thread* thread,
+                                rtc::PacketSocketFactory* factory,
+                                rtc::Network* network,
+                                const std::string& username,
+                                const std::string& password) {
+  if (ports_.find(username) != ports_.end()) {
+    LOG(LS_WARNING) << "A port with ufrag " << username << " already exists.";
+    return NULL;
+  }
+  UDPPort* port = UDPPort::Create(thread, factory, network, socket_.get(),
+                                  username, password);
+  if (!port)
+    return NULL;
+  // Routing by USERNAME relies on the RFC 5245 "local:remote" format.
+  port->SetIceProtocolType(ICEPROTO_RFC5245);
+  VERIFY(AddPort(port));
+  return port;
+}
+
+bool UDPPortMux::AddPort(UDPPort* port) {
+  ASSERT(port->SharedSocket());
+  const std::string& ufrag = port->username_fragment();
+  if (!ports_.insert(std::make_pair(ufrag, port)).second)
+    return false;
+
+  port->SignalDestroyed.connect(this, &UDPPortMux::OnPortDestroyed);
+  port->SignalConnectionCreated.connect(this,
+                                        &UDPPortMux::OnConnectionCreated);
+  // Pick up connections made before the port was added.
+  Port::AddressMap::const_iterator it;
+  for (it = port->connections().begin(); it != port->connections().end();
+       ++it) {
+    OnConnectionCreated(port, it->second);
+  }
+  return true;
+}
+
+void UDPPortMux::RemovePort(UDPPort* port) {
+  UsernameMap::iterator it = ports_.find(port->username_fragment());
+  if (it == ports_.end() || it->second != port)
+    return;
+  ports_.erase(it);
+
+  // Addresses may have been learned from checks as well as connections, so
+  // all of them are looked at.
+  AddressMap::iterator addr = remote_addresses_.begin();
+  while (addr != remote_addresses_.end()) {
+    if (addr->second == port->username_fragment()) {
+      remote_addresses_.erase(addr++);
+    } else {
+      ++addr;
+    }
+  }
+  port->SignalDestroyed.disconnect(this);
+  port->SignalConnectionCreated.disconnect(this);
+}
+
+UDPPort* UDPPortMux::GetPortForAddress(
+    const rtc::SocketAddress& remote_addr) const {
+  AddressMap::const_iterator it =
+      remote_addresses_.find(rtc::SocketAddressKey(remote_addr));
+  if (it == remote_addresses_.end())
+    return NULL;
+  UsernameMap::const_iterator port = ports_.find(it->second);
+  return port != ports_.end() ? port->second : NULL;
+}
+
+void UDPPortMux::OnReadPacket(rtc::AsyncPacketSocket* socket,
+                              const char* data, size_t size,
+                              const rtc::SocketAddress& remote_addr,
+                              const rtc::PacketTime& packet_time) {
+  ASSERT(socket == socket_.get());
+
+  UDPPort* port = NULL;
+  // Only STUN requests and indications carry a USERNAME. Looking at the
+  // packet through a view keeps this free of allocations.
+  StunMessageView view;
+  const char* username;
+  size_t length;
+  if (StunMessageView::IsStunPacket(data, size) && view.Parse(data, size) &&
+      view.GetAttribute(STUN_ATTR_USERNAME, &username, &length)) {
+    port = GetPortForUsername(username, length);
+    if (port)
+      SetPortForAddress(remote_addr, port);
+  } else {
+    port = GetPortForAddress(remote_addr);
+  }
+
+  if (!port) {
+    LOG(LS_VERBOSE) << "Dropping packet from unknown address "
+                    << remote_addr.ToSensitiveString();
+    return;
+  }
+  port->HandleIncomingPacket(socket, data, size, remote_addr, packet_time);
+}
+
+void UDPPortMux::OnPortDestroyed(PortInterface* port) {
+  // Port::Destroy() only gets here once all connections are gone.
+  UsernameMap::iterator it;
+  for (it = ports_.begin(); it != ports_.end(); ++it) {
+    if (it->second == port) {
+      ports_.erase(it);
+      return;
+    }
+  }
+}
+
+void UDPPortMux::OnConnectionCreated(Port* port, Connection* conn) {
+  SetPortForAddress(conn->remote_candidate().address(),
+                    static_cast<UDPPort*>(port));
+  conn->SignalDestroyed.connect(this, &UDPPortMux::OnConnectionDestroyed);
+}
+
+void UDPPortMux::OnConnectionDestroyed(Connection* conn) {
+  // The address may have moved on to another ufrag since.
+  AddressMap::iterator it = remote_addresses_.find(
+      rtc::SocketAddressKey(conn->remote_candidate().address()));
+  if (it != remote_addresses_.end() &&
+      it->second == conn->port()->username_fragment()) {
+    remote_addresses_.erase(it);
+  }
+}
+
+UDPPort* UDPPortMux::GetPortForUsername(const char* username, size_t length) {
+  // The USERNAME of a check is "<receiver ufrag>:<sender ufrag>".
+  const char* colon = static_cast<const char*>(memchr(username, ':', length));
+  if (!colon)
+    return NULL;
+  ufrag_.assign(username, colon - username);
+  UsernameMap::iterator it = ports_.find(ufrag_);
+  return it != ports_.end() ? it->second : NULL;
+}
+
+void UDPPortMux::SetPortForAddress(const rtc::SocketAddress& addr,
+                                   UDPPort* port) {
+  const std::string& ufrag = port->username_fragment();
+  std::string& routed = remote_addresses_[rtc::SocketAddressKey(addr)];
+  if (routed == ufrag)
+    return;
+  if (!routed.empty()) {
+    LOG(LS_INFO) << "Remote address " << addr.ToSensitiveString()
+                 << " moves from ufrag " << routed << " to " << ufrag;
+  }
+  routed = ufrag;
+}
+
+}  // namespace cricket
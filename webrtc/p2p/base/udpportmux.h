@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef WEBRTC_P2P_BASE_UDPPORTMUX_H_
+#define WEBRTC_P2P_BASE_UDPPORTMUX_H_
+
+#include <map>
+#include <string>
+
+#include "webrtc/base/asyncpacketsocket.h"
+#include "webrtc/base/constructormagic.h"
+#include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/sigslot.h"
+#include "webrtc/base/socketaddress.h"
+
+namespace rtc {
+class Network;
+class PacketSocketFactory;
+class Thread;
+}
+
+namespace cricket {
+
+class Connection;
+class Port;
+class PortInterface;
+class UDPPort;
+
+// Serves any number of UDPPorts from a single UDP socket, so that a server
+// terminating many ICE(-lite) peers needs one socket per interface instead of
+// one per transport channel.
+//
+// Every port is registered under its ICE username fragment. Incoming STUN
+// messages carrying a USERNAME are routed by its local (first) part, so a
+// peer's first connectivity check reaches the right port before any
+// connection exists. The mux remembers the ufrag each remote address last
+// sent a check for, and everything else, including STUN responses and media,
+// is routed by that ufrag. A peer whose address changes, or which moves to
+// another ufrag, is followed as soon as it sends a check from its new
+// address. Connections a port creates also map their remote address to the
+// port's ufrag. This requires RFC 5245 usernames; GICE usernames are not
+// supported.
+class UDPPortMux : public sigslot::has_slots<> {
+ public:
+  // Takes ownership of |socket|, which must be a UDP socket bound to the
+  // address the ports should be reachable at.
+  explicit UDPPortMux(rtc::AsyncPacketSocket* socket);
+  virtual ~UDPPortMux();
+
+  rtc::AsyncPacketSocket* socket() const { return socket_.get(); }
+
+  // Creates a UDPPort on the shared socket and adds it. Returns NULL if a port
+  // with |username| is already registered. The caller owns the port.
+  UDPPort* CreatePort(rtc::Thread* thread,
+                      rtc::PacketSocketFactory* factory,
+                      rtc::Network* network,
+                      const std::string& username,
+                      const std::string& password);
+
+  // Registers a port that was created with socket(). Returns false if its
+  // username fragment is already taken.
+  bool AddPort(UDPPort* port);
+  // Must be called before a port is deleted, unless it is destroyed through
+  // Port::Destroy(), which removes it automatically.
+  void RemovePort(UDPPort* port);
+
+  size_t port_count() const { return ports_.size(); }
+
+  // Returns the port packets from |remote_addr| are delivered to, if any.
+  UDPPort* GetPortForAddress(const rtc::SocketAddress& remote_addr) const;
+
+ private:
+  typedef std::map<std::string, UDPPort*> UsernameMap;
+  // Remote address => ufrag of the port its packets are delivered to.
+  typedef std::map<rtc::SocketAddressKey, std::string> AddressMap;
+
+  void OnReadPacket(rtc::AsyncPacketSocket* socket,
+                    const char* data, size_t size,
+                    const rtc::SocketAddress& remote_addr,
+                    const rtc::PacketTime& packet_time);
+  void OnPortDestroyed(PortInterface* port);
+  void OnConnectionCreated(Port* port, Connection* conn);
+  void OnConnectionDestroyed(Connection* conn);
+
+  // Finds the port for the local part of a STUN USERNAME.
+  UDPPort* GetPortForUsername(const char* username, size_t length);
+  // Routes the packets from |addr| to |port|.
+  void SetPortForAddress(const rtc::SocketAddress& addr, UDPPort* port);
+
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> socket_;
+  UsernameMap ports_;
+  AddressMap remote_addresses_;
+  // Reused for the username lookups to avoid an allocation per packet.
+  std::string ufrag_;
+
+  DISALLOW_COPY_AND_ASSIGN(UDPPortMux);
+};
+
+}  // namespace cricket
+
+#endif  // WEBRTC_P2P_BASE_UDPPORTMUX_H_
@@ -0,0 +1,235 @@
+/*
+ *  Copyright 2015 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+
+#include "webrtc/p2p/base/basicpacketsocketfactory.h"
+#include "webrtc/p2p/base/stun.h"
+#include "webrtc/p2p/base/stunport.h"
+#include "webrtc/p2p/base/udpportmux.h"
+#include "webrtc/base/bytebuffer.h"
+#include "webrtc/base/gunit.h"
+#include "webrtc/base/physicalsocketserver.h"
+#include "webrtc/base/scoped_ptr.h"
+#include "webrtc/base/socketaddress.h"
+#include "webrtc/base/virtualsocketserver.h"
+
+using cricket::Connection;
+using cricket::IceMessage;
+using cricket::PortInterface;
+using cricket::UDPPort;
+using cricket::UDPPortMux;
+using rtc::SocketAddress;
+
+static const SocketAddress kServerAddr("11.11.11.11", 3478);
+static const SocketAddress kClientAddr1("22.22.22.22", 0);
+static const SocketAddress kClientAddr2("33.33.33.33", 0);
+static const char kUfrag1[] = "TESTICEUFRAG0001";
+static const char kUfrag2[] = "TESTICEUFRAG0002";
+static const char kPassword1[] = "TESTICEPWD00000000000001";
+static const char kPassword2[] = "TESTICEPWD00000000000002";
+static const char kRemoteUfrag[] = "RFRG";
+static const int kTimeoutMs = 1000;
+
+class UDPPortMuxTest : public testing::Test,
+                       public sigslot::has_slots<> {
+ public:
+  UDPPortMuxTest()
+      : pss_(new rtc::PhysicalSocketServer),
+        ss_(new rtc::VirtualSocketServer(pss_.get())),
+        ss_scope_(ss_.get()),
+        network_("unittest", "unittest", rtc::IPAddress(INADDR_ANY), 32),
+        socket_factory_(rtc::Thread::Current()),
+        mux_(new UDPPortMux(
+            socket_factory_.CreateUdpSocket(kServerAddr, 0, 0))),
+        last_port_(NULL),
+        last_conn_(NULL) {
+  }
+
+  ~UDPPortMuxTest() {
+    if (port1_)
+      mux_->RemovePort(port1_.get());
+    if (port2_)
+      mux_->RemovePort(port2_.get());
+  }
+
+  void CreatePorts() {
+    port1_.reset(CreatePort(kUfrag1, kPassword1));
+    port2_.reset(CreatePort(kUfrag2, kPassword2));
+    ASSERT_TRUE(port1_ != NULL);
+    ASSERT_TRUE(port2_ != NULL);
+  }
+
+  UDPPort* CreatePort(const std::string& ufrag, const std::string& password) {
+    UDPPort* port = mux_->CreatePort(rtc::Thread::Current(), &socket_factory_,
+                                     &network_, ufrag, password);
+    if (port) {
+      // Like an ICE-lite agent, the ports are always controlled.
+      port->SetIceRole(cricket::ICEROLE_CONTROLLED);
+      port->SignalUnknownAddress.connect(this,
+                                         &UDPPortMuxTest::OnUnknownAddress);
+      port->PrepareAddress();
+    }
+    return port;
+  }
+
+  rtc::AsyncPacketSocket* CreateClient(const SocketAddress& addr) {
+    return socket_factory_.CreateUdpSocket(addr, 0, 0);
+  }
+
+  // Sends a connectivity check for |ufrag| from |client|.
+  void SendBindingRequest(rtc::AsyncPacketSocket* client,
+                          const std::string& ufrag,
+                          const std::string& password) {
+    IceMessage msg;
+    msg.SetType(cricket::STUN_BINDING_REQUEST);
+    msg.SetTransactionID("0123456789ab");
+    msg.AddAttribute(new cricket::StunByteStringAttribute(
+        cricket::STUN_ATTR_USERNAME, ufrag + ":" + kRemoteUfrag));
+    msg.AddAttribute(new cricket::StunUInt64Attribute(
+        cricket::STUN_ATTR_ICE_CONTROLLING, 1));
+    msg.AddMessageIntegrity(password);
+    msg.AddFingerprint();
+    rtc::ByteBuffer buf;
+    msg.Write(&buf);
+    rtc::PacketOptions options;
+    client->SendTo(buf.Data(), buf.Length(), kServerAddr, options);
+  }
+
+  void SendData(rtc::AsyncPacketSocket* client, const std::string& data) {
+    rtc::PacketOptions options;
+    client->SendTo(data.data(), data.size(), kServerAddr, options);
+  }
+
+  // Plays the transport channel: accepts the check and creates a connection.
+  void OnUnknownAddress(PortInterface* port, const SocketAddress& addr,
+                        cricket::ProtocolType proto, IceMessage* msg,
+                        const std::string& remote_username, bool port_muxed) {
+    EXPECT_EQ(kRemoteUfrag, remote_username);
+    last_port_ = port;
+    cricket::Candidate candidate;
+    candidate.set_address(addr);
+    candidate.set_protocol("udp");
+    last_conn_ =
+        port->CreateConnection(candidate, PortInterface::ORIGIN_MESSAGE);
+    ASSERT_TRUE(last_conn_ != NULL);
+    last_conn_->SignalReadPacket.connect(this, &UDPPortMuxTest::OnReadPacket);
+    port->SendBindingResponse(msg, addr);
+  }
+
+  void OnReadPacket(Connection* conn, const char* data, size_t size,
+                    const rtc::PacketTime& packet_time) {
+    received_.assign(data, size);
+  }
+
+ protected:
+  rtc::scoped_ptr<rtc::PhysicalSocketServer> pss_;
+  rtc::scoped_ptr<rtc::VirtualSocketServer> ss_;
+  rtc::SocketServerScope ss_scope_;
+  rtc::Network network_;
+  rtc::BasicPacketSocketFactory socket_factory_;
+  rtc::scoped_ptr<UDPPortMux> mux_;
+  rtc::scoped_ptr<UDPPort> port1_;
+  rtc::scoped_ptr<UDPPort> port2_;
+  PortInterface* last_port_;
+  Connection* last_conn_;
+  std::string received_;
+};
+
+// All ports share the mux's socket and address.
+TEST_F(UDPPortMuxTest, TestPortsShareSocket) {
+  CreatePorts();
+  EXPECT_EQ(2U, mux_->port_count());
+  EXPECT_EQ(mux_->socket()->GetLocalAddress(), port1_->GetLocalAddress());
+  EXPECT_EQ(mux_->socket()->GetLocalAddress(), port2_->GetLocalAddress());
+  ASSERT_EQ(1U, port1_->Candidates().size());
+  EXPECT_EQ(kServerAddr, port1_->Candidates()[0].address());
+
+  // Each ufrag can be used once.
+  EXPECT_TRUE(CreatePort(kUfrag1, kPassword1) == NULL);
+}
+
+// Checks are routed by USERNAME, and the following data by remote address.
+TEST_F(UDPPortMuxTest, TestRouteByUsernameThenAddress) {
+  CreatePorts();
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> client1(CreateClient(kClientAddr1));
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> client2(CreateClient(kClientAddr2));
+
+  SendBindingRequest(client2.get(), kUfrag2, kPassword2);
+  EXPECT_TRUE_WAIT(last_port_ == port2_.get(), kTimeoutMs);
+  Connection* conn2 = last_conn_;
+  EXPECT_EQ(port2_.get(),
+            mux_->GetPortForAddress(client2->GetLocalAddress()));
+
+  SendBindingRequest(client1.get(), kUfrag1, kPassword1);
+  EXPECT_TRUE_WAIT(last_port_ == port1_.get(), kTimeoutMs);
+  Connection* conn1 = last_conn_;
+  EXPECT_EQ(port1_.get(),
+            mux_->GetPortForAddress(client1->GetLocalAddress()));
+
+  last_conn_ = NULL;
+  SendData(client2.get(), "to port 2");
+  EXPECT_EQ_WAIT("to port 2", received_, kTimeoutMs);
+  SendData(client1.get(), "to port 1");
+  EXPECT_EQ_WAIT("to port 1", received_, kTimeoutMs);
+  EXPECT_TRUE(conn1 != conn2);
+}
+
+// Packets for unknown ufrags or from unknown addresses are dropped.
+TEST_F(UDPPortMuxTest, TestDropUnknown) {
+  CreatePorts();
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> client(CreateClient(kClientAddr1));
+
+  SendBindingRequest(client.get(), "NOSUCHUFRAG00000", kPassword1);
+  SendData(client.get(), "dropped");
+  rtc::Thread::Current()->ProcessMessages(100);
+  EXPECT_TRUE(last_port_ == NULL);
+  EXPECT_TRUE(mux_->GetPortForAddress(client->GetLocalAddress()) == NULL);
+}
+
+// Removing a port forgets its ufrag and remote addresses.
+TEST_F(UDPPortMuxTest, TestRemovePort) {
+  CreatePorts();
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> client(CreateClient(kClientAddr1));
+  SendBindingRequest(client.get(), kUfrag1, kPassword1);
+  EXPECT_TRUE_WAIT(last_port_ == port1_.get(), kTimeoutMs);
+
+  mux_->RemovePort(port1_.get());
+  port1_.reset();
+  EXPECT_EQ(1U, mux_->port_count());
+  EXPECT_TRUE(mux_->GetPortForAddress(client->GetLocalAddress()) == NULL);
+
+  // The ufrag can be reused.
+  port1_.reset(CreatePort(kUfrag1, kPassword1));
+  EXPECT_TRUE(port1_ != NULL);
+}
+
+// An address that sends a check for another ufrag is routed to that ufrag's
+// port from then on, even while the old port still has a connection to it.
+TEST_F(UDPPortMuxTest, TestAddressFollowsLatestUfrag) {
+  CreatePorts();
+  rtc::scoped_ptr<rtc::AsyncPacketSocket> client(CreateClient(kClientAddr1));
+  SendBindingRequest(client.get(), kUfrag2, kPassword2);
+  EXPECT_TRUE_WAIT(last_port_ == port2_.get(), kTimeoutMs);
+  Connection* conn2 = last_conn_;
+
+  SendBindingRequest(client.get(), kUfrag1, kPassword1);
+  EXPECT_TRUE_WAIT(last_port_ == port1_.get(), kTimeoutMs);
+  EXPECT_EQ(port1_.get(),
+            mux_->GetPortForAddress(client->GetLocalAddress()));
+  SendData(client.get(), "to port 1");
+  EXPECT_EQ_WAIT("to port 1", received_, kTimeoutMs);
+
+  // Dropping the old connection leaves the new route alone.
+  conn2->Destroy();
+  rtc::Thread::Current()->ProcessMessages(0);
+  EXPECT_EQ(port1_.get(),
+            mux_->GetPortForAddress(client->GetLocalAddress()));
+}
@@ -95,6 +95,8 @@
         'base/turnserver.cc',
         'base/turnserver.h',
         'base/udpport.h',
+        'base/udpportmux.cc',
+        'base/udpportmux.h',
         'client/autoportallocator.h',
         'client/basicportallocator.cc',
         'client/basicportallocator.h',
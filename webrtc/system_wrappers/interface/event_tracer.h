@@ -22,10 +22,16 @@
 //   provided.
 //
 // Parameters for the above two functions are described in trace_event.h.
+//
+// Alternatively, tracing::SetupInternalTracer() installs a built-in recorder
+// that keeps recent events in per-thread ring buffers and can export them as
+// Chrome trace-event JSON, for loading into chrome://tracing or Perfetto.
 
 #ifndef WEBRTC_SYSTEM_WRAPPERS_INTERFACE_EVENT_TRACER_H_
 #define WEBRTC_SYSTEM_WRAPPERS_INTERFACE_EVENT_TRACER_H_
 
+#include <string>
+
 #include "webrtc/common_types.h"
 
 namespace webrtc {
@@ -49,6 +55,29 @@ WEBRTC_DLLEXPORT void SetupEventTracer(
     GetCategoryEnabledPtr get_category_enabled_ptr,
     AddTraceEventPtr add_trace_event_ptr);
 
+namespace tracing {
+
+// Installs the built-in recorder as the event tracer. Like
+// SetupEventTracer(), this must be called before any WebRTC methods.
+// Calling SetupEventTracer() afterwards replaces the recorder.
+WEBRTC_DLLEXPORT void SetupInternalTracer();
+
+// Starts recording the events whose category matches |categories|, a
+// comma-separated list of category names. "*" matches every category and a
+// name prefixed with '-' is excluded, so "*,-rtp" records everything but
+// "rtp". Previously recorded events are discarded.
+WEBRTC_DLLEXPORT void StartInternalCapture(const char* categories);
+
+// Stops recording. The recorded events are kept until the next capture.
+WEBRTC_DLLEXPORT void StopInternalCapture();
+
+// Writes the recorded events to |json| in the Chrome trace-event format.
+// Each thread keeps only its most recent events, so long captures lose
+// their beginning. Call this after StopInternalCapture().
+WEBRTC_DLLEXPORT void ExportInternalTrace(std::string* json);
+
+}  // namespace tracing
+
 // This class defines interface for the event tracing system to call
 // internally. Do not call these methods directly.
 class EventTracer {
@@ -10,6 +10,25 @@
 
 #include "webrtc/system_wrappers/interface/event_tracer.h"
 
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "webrtc/system_wrappers/interface/atomic32.h"
+#include "webrtc/system_wrappers/interface/critical_section_wrapper.h"
+#include "webrtc/system_wrappers/interface/scoped_ptr.h"
+#include "webrtc/system_wrappers/interface/sleep.h"
+#include "webrtc/system_wrappers/interface/thread_wrapper.h"
+#include "webrtc/system_wrappers/interface/tick_util.h"
+#include "webrtc/system_wrappers/interface/trace_event.h"
+
 namespace webrtc {
 
 namespace {
@@ -17,6 +36,418 @@ namespace {
 GetCategoryEnabledPtr g_get_category_enabled_ptr = 0;
 AddTraceEventPtr g_add_trace_event_ptr = 0;
 
+const int kMaxCategories = 64;
+const int kMaxArgs = 2;
+// Must be a power of two.
+const uint32_t kEventsPerThread = 4096;
+const size_t kCopiedStringsSize = 64;
+
+// |enabled| comes first so that the pointer handed out for a category also
+// identifies it when events are added.
+struct TraceCategory {
+  unsigned char enabled;
+  const char* name;
+};
+
+struct TraceEvent {
+  char phase;
+  unsigned char flags;
+  unsigned char num_args;
+  unsigned char arg_types[kMaxArgs];
+  const TraceCategory* category;
+  const char* name;
+  unsigned long long id;
+  int64_t timestamp_us;
+  uint32_t thread_id;
+  const char* arg_names[kMaxArgs];
+  trace_event_internal::TraceValueUnion arg_values[kMaxArgs];
+  // Storage for the strings that the caller asked to have copied; long
+  // strings are truncated.
+  char copied_strings[kCopiedStringsSize];
+};
+
+// Events from one thread. Only the owning thread writes to the ring, and it
+// bumps |count| only once an event is complete, so no locking is needed on
+// the recording path. When the owning thread exits the buffer is retired,
+// and the next thread that starts tracing takes it over.
+struct ThreadBuffer {
+  ThreadBuffer()
+      : thread_id(ThreadWrapper::GetThreadId()), count(0), start(0),
+        retired(false), next(NULL) {
+  }
+
+  uint32_t thread_id;  // Of the current owner.
+  Atomic32 count;
+  uint32_t start;  // Value of |count| when the current capture started.
+  bool retired;  // Guarded by TraceRecorder::crit_.
+  ThreadBuffer* next;
+  TraceEvent events[kEventsPerThread];
+};
+
+const char* CopyString(const char* str, char** cursor, const char* end) {
+  size_t available = end - *cursor;
+  if (available == 0)
+    return "";
+  size_t len = strlen(str);
+  if (len >= available)
+    len = available - 1;
+  char* copy = *cursor;
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  *cursor += len + 1;
+  return copy;
+}
+
+void AppendEscaped(const char* str, std::string* out) {
+  out->push_back('"');
+  for (; *str; ++str) {
+    unsigned char c = static_cast<unsigned char>(*str);
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (c < 0x20) {
+      char escaped[8];
+      sprintf(escaped, "\\u%04x", c);
+      out->append(escaped);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendValue(unsigned char type,
+                 const trace_event_internal::TraceValueUnion& value,
+                 std::string* out) {
+  char buffer[32];
+  switch (type) {
+    case TRACE_VALUE_TYPE_BOOL:
+      out->append(value.as_bool ? "true" : "false");
+      break;
+    case TRACE_VALUE_TYPE_UINT:
+      sprintf(buffer, "%llu", value.as_uint);
+      out->append(buffer);
+      break;
+    case TRACE_VALUE_TYPE_INT:
+      sprintf(buffer, "%lld", value.as_int);
+      out->append(buffer);
+      break;
+    case TRACE_VALUE_TYPE_DOUBLE:
+      // JSON has no representation for NaN or infinity.
+      if (value.as_double == value.as_double &&
+          fabs(value.as_double) <= 1e300) {
+        sprintf(buffer, "%.17g", value.as_double);
+        out->append(buffer);
+      } else {
+        out->append("null");
+      }
+      break;
+    case TRACE_VALUE_TYPE_POINTER:
+      sprintf(buffer, "\"0x%llx\"", static_cast<unsigned long long>(
+          reinterpret_cast<uintptr_t>(value.as_pointer)));
+      out->append(buffer);
+      break;
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING:
+      AppendEscaped(value.as_string ? value.as_string : "NULL", out);
+      break;
+    default:
+      out->append("null");
+      break;
+  }
+}
+
+// Called with the thread's buffer when a thread that has traced exits.
+#if defined(_WIN32)
+void WINAPI RetireThreadBuffer(void* buffer);
+#else
+void RetireThreadBuffer(void* buffer);
+#endif
+
+// The built-in recorder installed by tracing::SetupInternalTracer().
+class TraceRecorder {
+ public:
+  TraceRecorder()
+      : crit_(CriticalSectionWrapper::CreateCriticalSection()),
+        num_categories_(0),
+        buffers_(NULL) {
+#if defined(_WIN32)
+    tls_index_ = FlsAlloc(&RetireThreadBuffer);
+#else
+    pthread_key_create(&tls_key_, &RetireThreadBuffer);
+#endif
+  }
+
+  const unsigned char* GetCategoryEnabled(const char* name) {
+    CriticalSectionScoped cs(crit_.get());
+    for (int i = 0; i < num_categories_; ++i) {
+      if (strcmp(categories_[i].name, name) == 0)
+        return &categories_[i].enabled;
+    }
+    if (num_categories_ == kMaxCategories) {
+      // Out of slots; the category is never recorded.
+      return reinterpret_cast<const unsigned char*>("\0");
+    }
+    TraceCategory* category = &categories_[num_categories_++];
+    category->name = name;
+    category->enabled = IsEnabled(name) ? 1 : 0;
+    return &category->enabled;
+  }
+
+  void AddTraceEvent(char phase,
+                     const unsigned char* category_enabled,
+                     const char* name,
+                     unsigned long long id,
+                     int num_args,
+                     const char** arg_names,
+                     const unsigned char* arg_types,
+                     const unsigned long long* arg_values,
+                     unsigned char flags) {
+    // Count this writer before looking at the flag again, so that Stop()
+    // either sees the writer or the writer sees the category disabled.
+    ++writers_;
+    if (!*category_enabled) {
+      --writers_;
+      return;
+    }
+    ThreadBuffer* buffer = GetThreadBuffer();
+    uint32_t index = static_cast<uint32_t>(buffer->count.Value());
+    TraceEvent* event = &buffer->events[index & (kEventsPerThread - 1)];
+
+    char* cursor = event->copied_strings;
+    const char* end = event->copied_strings + kCopiedStringsSize;
+    bool copy = (flags & TRACE_EVENT_FLAG_COPY) != 0;
+    event->phase = phase;
+    event->flags = flags;
+    event->category = reinterpret_cast<const TraceCategory*>(category_enabled);
+    event->name = copy ? CopyString(name, &cursor, end) : name;
+    event->id = id;
+    event->timestamp_us = TickTime::MicrosecondTimestamp();
+    event->thread_id = buffer->thread_id;
+    event->num_args = static_cast<unsigned char>(
+        num_args < kMaxArgs ? num_args : kMaxArgs);
+    for (int i = 0; i < event->num_args; ++i) {
+      event->arg_names[i] =
+          copy ? CopyString(arg_names[i], &cursor, end) : arg_names[i];
+      event->arg_types[i] = arg_types[i];
+      event->arg_values[i].as_uint = arg_values[i];
+      if (arg_types[i] == TRACE_VALUE_TYPE_COPY_STRING) {
+        event->arg_values[i].as_string =
+            CopyString(event->arg_values[i].as_string, &cursor, end);
+      }
+    }
+
+    ++buffer->count;
+    --writers_;
+  }
+
+  void Start(const char* categories) {
+    CriticalSectionScoped cs(crit_.get());
+    filter_ = categories ? categories : "";
+    for (ThreadBuffer* buffer = buffers_; buffer; buffer = buffer->next) {
+      buffer->start = static_cast<uint32_t>(buffer->count.Value());
+    }
+    for (int i = 0; i < num_categories_; ++i) {
+      categories_[i].enabled = IsEnabled(categories_[i].name) ? 1 : 0;
+    }
+  }
+
+  // Returns once no thread is partway through writing an event, so that
+  // Export() afterwards only sees complete events.
+  void Stop() {
+    {
+      CriticalSectionScoped cs(crit_.get());
+      filter_.clear();
+      for (int i = 0; i < num_categories_; ++i) {
+        categories_[i].enabled = 0;
+      }
+    }
+    // Writers may need |crit_| to get their buffer, so wait without it.
+    // CompareExchange is a full barrier, like the increment in AddTraceEvent.
+    while (!writers_.CompareExchange(0, 0))
+      SleepMs(1);
+  }
+
+  void Export(std::string* json) {
+    CriticalSectionScoped cs(crit_.get());
+#if defined(_WIN32)
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = getpid();
+#endif
+    json->append("{\"traceEvents\":[");
+    bool first = true;
+    for (ThreadBuffer* buffer = buffers_; buffer; buffer = buffer->next) {
+      uint32_t count = static_cast<uint32_t>(buffer->count.Value());
+      uint32_t begin = buffer->start;
+      if (count - begin > kEventsPerThread)
+        begin = count - kEventsPerThread;
+      for (uint32_t i = begin; i != count; ++i) {
+        const TraceEvent& event =
+            buffer->events[i & (kEventsPerThread - 1)];
+        if (!first)
+          json->push_back(',');
+        first = false;
+        AppendEvent(event, pid, json);
+      }
+    }
+    json->append("]}");
+  }
+
+  void Retire(ThreadBuffer* buffer) {
+    CriticalSectionScoped cs(crit_.get());
+    buffer->retired = true;
+  }
+
+ private:
+  // Returns whether the possibly comma-separated category |name| matches the
+  // current filter.
+  bool IsEnabled(const char* name) const {
+    std::string names(name);
+    bool enabled = false;
+    size_t pos = 0;
+    while (pos <= names.size()) {
+      size_t comma = names.find(',', pos);
+      if (comma == std::string::npos)
+        comma = names.size();
+      std::string part = names.substr(pos, comma - pos);
+      if (IsExcluded(part))
+        return false;
+      enabled = enabled || IsIncluded(part);
+      pos = comma + 1;
+    }
+    return enabled;
+  }
+
+  bool IsIncluded(const std::string& name) const {
+    return HasFilterEntry("*") || HasFilterEntry(name);
+  }
+
+  bool IsExcluded(const std::string& name) const {
+    return HasFilterEntry("-" + name);
+  }
+
+  bool HasFilterEntry(const std::string& entry) const {
+    size_t pos = 0;
+    while (pos <= filter_.size()) {
+      size_t comma = filter_.find(',', pos);
+      if (comma == std::string::npos)
+        comma = filter_.size();
+      if (filter_.compare(pos, comma - pos, entry) == 0)
+        return true;
+      pos = comma + 1;
+    }
+    return false;
+  }
+
+  ThreadBuffer* GetThreadBuffer() {
+#if defined(_WIN32)
+    ThreadBuffer* buffer = static_cast<ThreadBuffer*>(FlsGetValue(tls_index_));
+#else
+    ThreadBuffer* buffer =
+        static_cast<ThreadBuffer*>(pthread_getspecific(tls_key_));
+#endif
+    if (buffer)
+      return buffer;
+
+    // First event on this thread. Take over the buffer of a thread that has
+    // exited if there is one, so that thread churn doesn't grow the memory
+    // use. Events carry their thread id, so the ones already in the buffer
+    // can still be exported until they are overwritten.
+    {
+      CriticalSectionScoped cs(crit_.get());
+      for (buffer = buffers_; buffer; buffer = buffer->next) {
+        if (buffer->retired) {
+          buffer->retired = false;
+          buffer->thread_id = ThreadWrapper::GetThreadId();
+          break;
+        }
+      }
+      if (!buffer) {
+        buffer = new ThreadBuffer();
+        buffer->next = buffers_;
+        buffers_ = buffer;
+      }
+    }
+#if defined(_WIN32)
+    FlsSetValue(tls_index_, buffer);
+#else
+    pthread_setspecific(tls_key_, buffer);
+#endif
+    return buffer;
+  }
+
+  static void AppendEvent(const TraceEvent& event, unsigned long pid,
+                          std::string* json) {
+    char buffer[128];
+    json->append("{\"name\":");
+    AppendEscaped(event.name, json);
+    json->append(",\"cat\":");
+    AppendEscaped(event.category->name, json);
+    sprintf(buffer, ",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%lu,\"tid\":%u",
+            event.phase, static_cast<long long>(event.timestamp_us), pid,
+            event.thread_id);
+    json->append(buffer);
+    if (event.flags & TRACE_EVENT_FLAG_HAS_ID) {
+      sprintf(buffer, ",\"id\":\"0x%llx\"", event.id);
+      json->append(buffer);
+    }
+    if (event.num_args > 0) {
+      json->append(",\"args\":{");
+      for (int i = 0; i < event.num_args; ++i) {
+        if (i > 0)
+          json->push_back(',');
+        AppendEscaped(event.arg_names[i], json);
+        json->push_back(':');
+        AppendValue(event.arg_types[i], event.arg_values[i], json);
+      }
+      json->push_back('}');
+    }
+    json->push_back('}');
+  }
+
+  scoped_ptr<CriticalSectionWrapper> crit_;
+  TraceCategory categories_[kMaxCategories];
+  int num_categories_;
+  std::string filter_;
+  ThreadBuffer* buffers_;
+  // Threads inside AddTraceEvent() for an enabled category.
+  Atomic32 writers_;
+#if defined(_WIN32)
+  DWORD tls_index_;
+#else
+  pthread_key_t tls_key_;
+#endif
+};
+
+TraceRecorder* g_recorder = NULL;
+
+#if defined(_WIN32)
+void WINAPI RetireThreadBuffer(void* buffer) {
+#else
+void RetireThreadBuffer(void* buffer) {
+#endif
+  if (buffer)
+    g_recorder->Retire(static_cast<ThreadBuffer*>(buffer));
+}
+
+const unsigned char* InternalGetCategoryEnabled(const char* name) {
+  return g_recorder->GetCategoryEnabled(name);
+}
+
+void InternalAddTraceEvent(char phase,
+                           const unsigned char* category_enabled,
+                           const char* name,
+                           unsigned long long id,
+                           int num_args,
+                           const char** arg_names,
+                           const unsigned char* arg_types,
+                           const unsigned long long* arg_values,
+                           unsigned char flags) {
+  g_recorder->AddTraceEvent(phase, category_enabled, name, id, num_args,
+                            arg_names, arg_types, arg_values, flags);
+}
+
 }  // namespace
 
 void SetupEventTracer(GetCategoryEnabledPtr get_category_enabled_ptr,
@@ -57,4 +488,34 @@ void EventTracer::AddTraceEvent(char phase,
   }
 }
 
+namespace tracing {
+
+void SetupInternalTracer() {
+  // The recorder is never destroyed, since call sites keep pointers to its
+  // category flags.
+  if (!g_recorder)
+    g_recorder = new TraceRecorder();
+  SetupEventTracer(&InternalGetCategoryEnabled, &InternalAddTraceEvent);
+}
+
+void StartInternalCapture(const char* categories) {
+  if (g_recorder)
+    g_recorder->Start(categories);
+}
+
+void StopInternalCapture() {
+  if (g_recorder)
+    g_recorder->Stop();
+}
+
+void ExportInternalTrace(std::string* json) {
+  if (g_recorder) {
+    g_recorder->Export(json);
+  } else {
+    json->append("{\"traceEvents\":[]}");
+  }
+}
+
+}  // namespace tracing
+
 }  // namespace webrtc
@@ -10,8 +10,13 @@
 
 #include "webrtc/system_wrappers/interface/event_tracer.h"
 
+#include <string>
+
 #include "testing/gtest/include/gtest/gtest.h"
+#include "webrtc/system_wrappers/interface/scoped_ptr.h"
+#include "webrtc/system_wrappers/interface/sleep.h"
 #include "webrtc/system_wrappers/interface/static_instance.h"
+#include "webrtc/system_wrappers/interface/thread_wrapper.h"
 #include "webrtc/system_wrappers/interface/trace_event.h"
 
 namespace {
@@ -58,6 +63,48 @@ static void AddTraceEventHandler(char phase,
   TestStatistics::Get()->Increment();
 }
 
+// Uses a single call site, so its category pointer is cached once and the
+// filtering has to happen at runtime.
+void TraceFromOneCallSite() {
+  TRACE_EVENT0("call_site", "TraceFromOneCallSite");
+}
+
+int CountOccurrences(const std::string& haystack, const std::string& needle) {
+  int count = 0;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+bool TraceFromThread(void* obj) {
+  for (int i = 0; i < 100; ++i) {
+    TRACE_EVENT_INSTANT1("thread", "TraceFromThread", "i", i);
+  }
+  return false;
+}
+
+// Fills a whole thread buffer.
+const int kEventsPerBuffer = 4096;
+
+bool TraceFromShortLivedThread(void* obj) {
+  for (int i = 0; i < kEventsPerBuffer; ++i) {
+    TRACE_EVENT_INSTANT0("thread", "ShortLivedThread");
+  }
+  return false;
+}
+
+// Called in a loop until the thread is stopped. Sleeps between bursts, as
+// the thread may run at real-time priority.
+bool TraceUntilStopped(void* obj) {
+  for (int i = 0; i < 100; ++i) {
+    TRACE_EVENT_INSTANT0("busy", "TraceUntilStopped");
+  }
+  webrtc::SleepMs(1);
+  return true;
+}
+
 }  // namespace
 
 namespace webrtc {
@@ -79,4 +126,138 @@ TEST(EventTracerTest, ScopedTraceEvent) {
   TestStatistics::Get()->Reset();
 }
 
+TEST(EventTracerTest, InternalTracerRecordsEnabledCategories) {
+  tracing::SetupInternalTracer();
+  tracing::StartInternalCapture("test");
+  {
+    TRACE_EVENT0("test", "Recorded");
+    TRACE_EVENT_INSTANT0("other", "NotRecorded");
+  }
+  tracing::StopInternalCapture();
+  TRACE_EVENT_INSTANT0("test", "AfterStop");
+
+  std::string json;
+  tracing::ExportInternalTrace(&json);
+  EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+  EXPECT_EQ(1, CountOccurrences(json, "\"name\":\"Recorded\",\"cat\":\"test\","
+                                      "\"ph\":\"B\""));
+  EXPECT_EQ(1, CountOccurrences(json, "\"name\":\"Recorded\",\"cat\":\"test\","
+                                      "\"ph\":\"E\""));
+  EXPECT_EQ(0, CountOccurrences(json, "NotRecorded"));
+  EXPECT_EQ(0, CountOccurrences(json, "AfterStop"));
+}
+
+TEST(EventTracerTest, InternalTracerFiltersAtRuntime) {
+  tracing::SetupInternalTracer();
+  std::string json;
+
+  tracing::StartInternalCapture("*");
+  TraceFromOneCallSite();
+  tracing::StopInternalCapture();
+  tracing::ExportInternalTrace(&json);
+  EXPECT_EQ(2, CountOccurrences(json, "TraceFromOneCallSite"));
+
+  json.clear();
+  tracing::StartInternalCapture("*,-call_site");
+  TraceFromOneCallSite();
+  tracing::StopInternalCapture();
+  tracing::ExportInternalTrace(&json);
+  EXPECT_EQ(0, CountOccurrences(json, "TraceFromOneCallSite"));
+
+  json.clear();
+  tracing::StartInternalCapture("test,call_site");
+  TraceFromOneCallSite();
+  tracing::StopInternalCapture();
+  tracing::ExportInternalTrace(&json);
+  EXPECT_EQ(2, CountOccurrences(json, "TraceFromOneCallSite"));
+}
+
+TEST(EventTracerTest, InternalTracerExportsArguments) {
+  tracing::SetupInternalTracer();
+  tracing::StartInternalCapture("test");
+  TRACE_EVENT_INSTANT2("test", "Arguments", "int", -5, "string", "a\"b");
+  TRACE_EVENT_ASYNC_BEGIN1("test", "Async", 0x2a, "flag", true);
+  TRACE_EVENT_INSTANT1("test", "Copied", "string",
+                       TRACE_STR_COPY(std::string("copy").c_str()));
+  tracing::StopInternalCapture();
+
+  std::string json;
+  tracing::ExportInternalTrace(&json);
+  EXPECT_EQ(1, CountOccurrences(json,
+      "\"args\":{\"int\":-5,\"string\":\"a\\\"b\"}"));
+  EXPECT_EQ(1, CountOccurrences(json, "\"ph\":\"S\""));
+  EXPECT_EQ(1, CountOccurrences(
+      json, "\"id\":\"0x2a\",\"args\":{\"flag\":true}"));
+  EXPECT_EQ(1, CountOccurrences(json, "\"args\":{\"string\":\"copy\"}"));
+}
+
+TEST(EventTracerTest, InternalTracerRecordsPerThread) {
+  tracing::SetupInternalTracer();
+  tracing::StartInternalCapture("thread");
+  scoped_ptr<ThreadWrapper> threads[4];
+  for (int i = 0; i < 4; ++i) {
+    threads[i].reset(ThreadWrapper::CreateThread(&TraceFromThread, NULL));
+    unsigned int id = 0;
+    ASSERT_TRUE(threads[i]->Start(id));
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(threads[i]->Stop());
+  }
+  tracing::StopInternalCapture();
+
+  std::string json;
+  tracing::ExportInternalTrace(&json);
+  EXPECT_EQ(400, CountOccurrences(json, "TraceFromThread"));
+}
+
+// Threads that exit hand their buffers to the threads that come after them,
+// so only a few of these threads' events are still around at the end.
+TEST(EventTracerTest, InternalTracerReusesBuffersOfExitedThreads) {
+  const int kThreads = 64;
+  tracing::SetupInternalTracer();
+  tracing::StartInternalCapture("thread");
+  for (int i = 0; i < kThreads; ++i) {
+    scoped_ptr<ThreadWrapper> thread(
+        ThreadWrapper::CreateThread(&TraceFromShortLivedThread, NULL));
+    unsigned int id = 0;
+    ASSERT_TRUE(thread->Start(id));
+    EXPECT_TRUE(thread->Stop());
+  }
+  tracing::StopInternalCapture();
+
+  std::string json;
+  tracing::ExportInternalTrace(&json);
+  int events = CountOccurrences(json, "ShortLivedThread");
+  EXPECT_GE(events, kEventsPerBuffer);
+  // A thread may start before the previous one has quite finished exiting,
+  // so allow for some extra buffers.
+  EXPECT_LT(events, kThreads * kEventsPerBuffer / 4);
+}
+
+// Threads that keep tracing must not be partway through an event once
+// StopInternalCapture() returns, or the export would change under them.
+TEST(EventTracerTest, InternalTracerStopWaitsForWriters) {
+  tracing::SetupInternalTracer();
+  tracing::StartInternalCapture("busy");
+  scoped_ptr<ThreadWrapper> threads[4];
+  for (int i = 0; i < 4; ++i) {
+    threads[i].reset(ThreadWrapper::CreateThread(&TraceUntilStopped, NULL));
+    unsigned int id = 0;
+    ASSERT_TRUE(threads[i]->Start(id));
+  }
+  SleepMs(20);
+  tracing::StopInternalCapture();
+
+  std::string first;
+  tracing::ExportInternalTrace(&first);
+  SleepMs(20);
+  std::string second;
+  tracing::ExportInternalTrace(&second);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(threads[i]->Stop());
+  }
+  EXPECT_GT(CountOccurrences(first, "TraceUntilStopped"), 0);
+  EXPECT_TRUE(first == second);
+}
+
 }  // namespace webrtc
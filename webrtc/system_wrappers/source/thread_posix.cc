@@ -179,6 +179,13 @@ bool ThreadPosix::Start(unsigned int& thread_id)
   // Set the stack stack size to 1M.
   result |= pthread_attr_setstacksize(&attr_, 1024 * 1024);
   event_->Reset();
+  // Mark the thread as running before it starts; a thread that returns
+  // right away may otherwise finish before this is set, and Stop() would
+  // then wait for it forever.
+  {
+    CriticalSectionScoped cs(crit_state_);
+    dead_ = false;
+  }
   // If pthread_create was successful, a thread was created and is running.
   // Don't return false if it was successful since if there are any other
   // failures the state will be: thread was started but not configured as
@@ -186,11 +193,9 @@ bool ThreadPosix::Start(unsigned int& thread_id)
   // return value means that the thread never started.
   result |= pthread_create(&thread_, &attr_, &StartThread, this);
   if (result != 0) {
-    return false;
-  }
-  {
     CriticalSectionScoped cs(crit_state_);
-    dead_ = false;
+    dead_ = true;
+    return false;
   }
 
   // Wait up to 10 seconds for the OS to call the callback function. Prevents